@@ -16,6 +16,7 @@
 #include <linux/sysfs.h>
 #include <linux/kobject.h>
 #include <linux/completion.h>
+#include <linux/workqueue.h>
 
 /*
 ==================================================================================
@@ -91,6 +92,12 @@ struct ext2_reserve_window_node
 	__u32						rsv_alloc_hit;
 	struct ext2_reserve_window	rsv_window;
 };
+/* reservation windows of a block group. a window never crosses the group end	*/
+struct me2fs_rsv_tree
+{
+	struct rb_root					root;	/* windows sorted by start			*/
+	struct ext2_reserve_window_node	head;	/* dummy, never removed				*/
+};
 
 /*
 ----------------------------------------------------------------------------------
@@ -102,6 +109,7 @@ struct ext2_block_alloc_info
 	struct ext2_reserve_window_node	rsv_window_node;
 	__u32							last_alloc_logical_block;
 	unsigned long					last_alloc_physical_block;
+	__u32							seq_alloc_blocks;	/* in file order		*/
 };
 
 #define	rsv_start		rsv_window._rsv_start
@@ -135,6 +143,9 @@ struct ext2_group_desc
 #define	EXT2_IOC_SETVERSION			FS_IOC_SETVERSION
 #define	EXT2_IOC_GETRSVSZ			_IOR( 'f', 5, long )
 #define	EXT2_IOC_SETRSVSZ			_IOW( 'f', 6, long )
+/* me2fs specific commands														*/
+#define	ME2FS_IOC_COMPACTDIR		_IO( 'f', 64 )
+#define	ME2FS_IOC_BULKSTAT			_IOWR( 'f', 65, struct me2fs_bulkstat_req )
 
 /* ioctl commands in 32 bit emulation											*/
 #define	EXT2_IOC32_GETFLAGS			FS_IOC32_GETFLAGS
@@ -142,6 +153,39 @@ struct ext2_group_desc
 #define	EXT2_IOC32_GETVERSION		FS_IOC32_GETVERSION
 #define	EXT2_IOC32_SETVERSION		FS_IOC32_SETVERSION
 
+/*
+----------------------------------------------------------------------------------
+	Bulkstat
+	attributes of an inode in use as ME2FS_IOC_BULKSTAT returns them. the
+	layout is the same for 32 and 64 bit users
+----------------------------------------------------------------------------------
+*/
+struct me2fs_bstat
+{
+	__u64	bs_ino;							/* inode number						*/
+	__u64	bs_size;						/* size in bytes					*/
+	__u64	bs_blocks;						/* 512 byte blocks					*/
+	__u32	bs_mode;						/* file mode						*/
+	__u32	bs_nlink;						/* links count						*/
+	__u32	bs_uid;							/* owner							*/
+	__u32	bs_gid;							/* group							*/
+	__u32	bs_atime;						/* access time						*/
+	__u32	bs_mtime;						/* modification time				*/
+	__u32	bs_ctime;						/* change time						*/
+	__u32	bs_generation;					/* file version (for NFS)			*/
+	__u32	bs_file_acl;					/* xattr block, 0 if none			*/
+	__u32	bs_flags;						/* file flags						*/
+};
+
+struct me2fs_bulkstat_req
+{
+	__u64	br_ino;							/* in:first inode to look at		*/
+											/* out:inode to go on from			*/
+	__u64	br_buf;							/* user array of me2fs_bstat		*/
+	__u32	br_count;						/* in:entries of br_buf				*/
+	__u32	br_ocount;						/* out:entries filled				*/
+};
+
 
 
 /*
@@ -192,7 +236,8 @@ struct ext2_inode
 			__u16	i_pad1;
 			__le16	l_i_uid_high;			/* reserved						*/
 			__le16	l_i_gid_high;			/* reserved						*/
-			__u32	l_i_reserved2;
+			__le16	l_i_reserved2;			/* checksum of ext4, unused			*/
+			__le16	l_i_me2fs_flags;		/* ME2FS_xxx_FL, see below			*/
 		} linux2;
 		struct
 		{
@@ -253,6 +298,26 @@ struct ext2_inode
 /* flags that are appropriate for non-dir/regular files							*/
 #define	EXT2_OTHER_FLMASK	( EXT2_NODUMP_FL | EXT2_TOPDIR_FL )
 
+/* l_i_me2fs_flags, only used with ME2FS_FEATURE_INCOMPAT_INLINE_DATA			*/
+#define	ME2FS_INLINE_DATA_FL	( 0x0001 )		/* data stored in i_block		*/
+
+/* runs of mapped blocks cached per inode										*/
+#define	ME2FS_EXTENT_CACHE_SIZE		4
+
+/*
+---------------------------------------------------------------------------------
+	Cached Run of Mapped Blocks
+	file blocks e_lblk .. e_lblk + e_len - 1 are on disk blocks e_pblk ..
+	e_pblk + e_len - 1, e_len is 0 if the slot is empty
+---------------------------------------------------------------------------------
+*/
+struct me2fs_extent
+{
+	__u32							e_lblk;
+	__u32							e_pblk;
+	__u32							e_len;
+};
+
 /*
 ---------------------------------------------------------------------------------
 	Me2fs(Ext2) Inode Inoformation
@@ -266,6 +331,7 @@ struct me2fs_inode_info
 	__u8							i_frag_no;
 	__u8							i_frag_size;
 	__u16							i_state;
+	__u16							i_me2fs_flags;	/* ME2FS_xxx_FL				*/
 	__u32							i_file_acl;
 	__u32							i_dir_acl;
 	__u32							i_dtime;
@@ -277,11 +343,38 @@ struct me2fs_inode_info
 	rwlock_t						i_meta_lock;
 	struct mutex					truncate_mutex;
 	struct rw_semaphore				xattr_sem;
+	struct rw_semaphore				i_mmap_sem;		/* faults against punch		*/
 	/* ------------------------------------------------------------------------ */
 	/* block reservation information											*/
 	/* ------------------------------------------------------------------------ */
 	__u32							i_block_group;
 	struct ext2_block_alloc_info	*i_block_alloc_info;
+	/* ------------------------------------------------------------------------ */
+	/* free space and entry summary of directory(built lazily)					*/
+	/* ------------------------------------------------------------------------ */
+	struct me2fs_dir_summary		*i_dir_summary;
+	/* ------------------------------------------------------------------------ */
+	/* directory compaction														*/
+	/* ------------------------------------------------------------------------ */
+	atomic_t						i_dir_streams;	/* readdir in progress		*/
+	struct list_head				i_dir_compact;	/* queued for background	*/
+	unsigned int					i_dir_compact_deferred;	/* till no stream	*/
+	/* ------------------------------------------------------------------------ */
+	/* delayed allocation														*/
+	/* ------------------------------------------------------------------------ */
+	spinlock_t						i_da_lock;
+	unsigned long					i_da_data_blocks;	/* reserved data		*/
+	unsigned long					i_da_meta_blocks;	/* reserved indirect	*/
+	long							i_da_last_ind;	/* last reserved indirect	*/
+	unsigned long					i_falloc_blocks;	/* reserved by fallocate*/
+	qsize_t							i_reserved_quota;
+	/* ------------------------------------------------------------------------ */
+	/* mapped runs found by get block											*/
+	/* ------------------------------------------------------------------------ */
+	spinlock_t						i_extent_lock;
+	unsigned int					i_extent_gen;	/* bumped by truncate		*/
+	unsigned int					i_extent_next;	/* slot replaced next		*/
+	struct me2fs_extent				i_extents[ ME2FS_EXTENT_CACHE_SIZE ];
 };
 
 /* inode dynamic state flags													*/
@@ -357,7 +450,22 @@ struct ext2_super_block
 	/* ------------------------------------------------------------------------ */
 	__le32	s_default_mount_opts;
 	__le32	s_first_meta_bg;				/* first metablock block group		*/
-	__u32	s_reserved[ 190 ];				/* padding to the end				*/
+	/* ------------------------------------------------------------------------ */
+	/* Ext3/4 compatible fields(not used by ext2 itself)						*/
+	/* ------------------------------------------------------------------------ */
+	__le32	s_mkfs_time;					/* when the filesystem was created	*/
+	__le32	s_jnl_blocks[ 17 ];				/* backup of journal inode			*/
+	__le32	s_blocks_count_hi;				/* high 32 bits of blocks count		*/
+	__le32	s_r_blocks_count_hi;			/* high 32 bits of reserved blocks	*/
+	__le32	s_free_blocks_hi;				/* high 32 bits of free blocks		*/
+	__le16	s_min_extra_isize;				/* all inodes have at least # bytes	*/
+	__le16	s_want_extra_isize;				/* new inodes should reserve # bytes*/
+	__le32	s_flags;						/* miscellaneous flags				*/
+	__le16	s_raid_stride;					/* blocks written to a disk at once	*/
+	__le16	s_mmp_update_interval;			/* seconds to wait in mmp checking	*/
+	__le64	s_mmp_block;					/* block for multi-mount protection	*/
+	__le32	s_raid_stripe_width;			/* blocks on all data disks			*/
+	__u32	s_reserved[ 163 ];				/* padding to the end				*/
 
 };
 
@@ -387,6 +495,18 @@ struct ext2_super_block
 /* defines for s_def_resgid														*/
 #define	EXT2_DEF_RESGID			( 0 )
 
+/* defines for s_flags															*/
+#define	EXT2_FLAGS_SIGNED_HASH		( 0x0001 )	/* signed dirhash in use		*/
+#define	EXT2_FLAGS_UNSIGNED_HASH	( 0x0002 )	/* unsigned dirhash in use		*/
+
+/* defines for s_def_hash_version												*/
+#define	EXT2_HASH_LEGACY			( 0 )
+#define	EXT2_HASH_HALF_MD4			( 1 )
+#define	EXT2_HASH_TEA				( 2 )
+#define	EXT2_HASH_LEGACY_UNSIGNED	( 3 )
+#define	EXT2_HASH_HALF_MD4_UNSIGNED	( 4 )
+#define	EXT2_HASH_TEA_UNSIGNED		( 5 )
+
 /* defines for s_feature_compat													*/
 #define	EXT2_FEATURE_COMPAT_DIR_PREALLOC	( 0x0001 )
 #define	EXT2_FEATURE_COMPAT_IMAGC_INODES	( 0x0002 )
@@ -395,7 +515,8 @@ struct ext2_super_block
 #define	EXT2_FEATURE_COMPAT_RESIZE_INO		( 0x0010 )
 #define	EXT2_FEATURE_COMPAT_DIR_INDEX		( 0x0020 )
 
-#define	EXT2_FEATURE_COMPAT_SUPP			EXT2_FEATURE_COMPAT_EXT_ATTR
+#define	EXT2_FEATURE_COMPAT_SUPP	( EXT2_FEATURE_COMPAT_EXT_ATTR	|			\
+									  EXT2_FEATURE_COMPAT_DIR_INDEX )
 
 /* defines for s_feature_ro_compat												*/
 #define	EXT2_FEATURE_RO_COMPAT_SPARSE_SUPER	( 0x0001 )
@@ -414,9 +535,12 @@ struct ext2_super_block
 #define	EXT2_FEATURE_INCOMPAT_RECOVER		( 0x0004 )
 #define	EXT2_FEATURE_INCOMPAT_JOURNAL_DEV	( 0x0008 )
 #define	EXT2_FEATURE_INCOMPAT_META_BG		( 0x0010 )
+/* private to me2fs, so that e2fsck of ext4 never reads its inline data			*/
+#define	ME2FS_FEATURE_INCOMPAT_INLINE_DATA	( 0x80000000 )
 
 #define	EXT2_FEATURE_INCOMPAT_SUPP		( EXT2_FEATURE_INCOMPAT_FILETYPE	|	\
-										  EXT2_FEATURE_INCOMPAT_META_BG )
+										  EXT2_FEATURE_INCOMPAT_META_BG		|	\
+										  ME2FS_FEATURE_INCOMPAT_INLINE_DATA )
 #define	EXT2_FEATURE_INCOMPAT_UNSUPPORTED	~EXT2_FEATURE_INCOMPAT_SUPP
 
 /* defines for s_default_mount_opts and s_mount_opts							*/
@@ -436,6 +560,12 @@ struct ext2_super_block
 #define	EXT2_MOUNT_USRQUOTA					( 0x00020000 )
 #define	EXT2_MOUNT_GRPQUOTA					( 0x00040000 )
 #define	EXT2_MOUNT_RESERVATION				( 0x00080000 )
+#define	EXT2_MOUNT_DIR_COMPACT				( 0x00100000 )
+#define	EXT2_MOUNT_DELALLOC					( 0x00200000 )
+#define	EXT2_MOUNT_DISCARD					( 0x00400000 )
+#define	EXT2_MOUNT_BG_RECLAIM				( 0x00800000 )
+#define	EXT2_MOUNT_PERCPU_IALLOC			( 0x01000000 )
+#define	EXT2_MOUNT_INLINE_DATA				( 0x02000000 )
 
 /* default mount options														*/
 #define	EXT2_DEFM_DEBUG						( 0x0001 )
@@ -462,6 +592,7 @@ struct me2fs_sb_info
 	struct ext2_super_block		*s_esb;
 	struct buffer_head			*s_sbh;
 	struct buffer_head			**s_group_desc;
+	struct super_block			*s_sb;				/* back pointer to vfs		*/
 	/* ------------------------------------------------------------------------ */
 	/* disk informaiont cache													*/
 	/* ------------------------------------------------------------------------ */
@@ -497,9 +628,13 @@ struct me2fs_sb_info
 	struct percpu_counter		s_freeblocks_counter;
 	struct percpu_counter		s_freeinodes_counter;
 	struct percpu_counter		s_dirs_counter;
+	struct percpu_counter		s_dirtyblocks_counter;	/* delalloc reserved	*/
+	/* for reconciliation of free counters with group descriptors				*/
+	struct delayed_work			s_reconcile_work;
+	s64							s_free_blocks_drift;	/* seen last pass		*/
+	s64							s_free_inodes_drift;	/* seen last pass		*/
 	/* for s_mount_state, s_blocks_last, s_overhead_last and msi->s_esb itself	*/
 	spinlock_t					s_lock;
-	spinlock_t					s_rsv_window_lock;
 	/* ------------------------------------------------------------------------ */
 	/* procfs																	*/
 	/* ------------------------------------------------------------------------ */
@@ -509,12 +644,74 @@ struct me2fs_sb_info
 	/* ------------------------------------------------------------------------ */
 	struct kobject				s_kobj;
 	struct completion			s_kobj_unregister;
+	/* ------------------------------------------------------------------------ */
+	/* directory index															*/
+	/* ------------------------------------------------------------------------ */
+	int							s_hash_unsigned;	/* 3 if unsigned, 0 if not	*/
+	/* ------------------------------------------------------------------------ */
+	/* directory readahead														*/
+	/* ------------------------------------------------------------------------ */
+	unsigned long				s_dir_ra_pages;		/* window, 0 disables it	*/
+	/* ------------------------------------------------------------------------ */
+	/* block reservation window sizing											*/
+	/* ------------------------------------------------------------------------ */
+	unsigned long				s_max_rsv_blocks;	/* cap of growing window	*/
+	/* ------------------------------------------------------------------------ */
+	/* block bitmap readahead of group search									*/
+	/* ------------------------------------------------------------------------ */
+	unsigned long				s_bitmap_ra_groups;	/* 0 disables it			*/
+	/* ------------------------------------------------------------------------ */
+	/* inode allocation of parallel creators									*/
+	/* ------------------------------------------------------------------------ */
+	unsigned long				s_ialloc_spread_groups;	/* 0/1 disables it		*/
+	/* ------------------------------------------------------------------------ */
+	/* inode table readahead of inode lookups									*/
+	/* ------------------------------------------------------------------------ */
+	unsigned long				s_itb_ra_blocks;	/* window cap, 0 disables	*/
+	unsigned long				s_itb_ra_last;		/* last block read (ahead)	*/
+	unsigned long				s_itb_ra_window;	/* current window			*/
+	atomic_long_t				s_itb_hits;			/* block was in cache		*/
+	atomic_long_t				s_itb_misses;		/* block was read			*/
+	/* ------------------------------------------------------------------------ */
+	/* raid geometry															*/
+	/* ------------------------------------------------------------------------ */
+	unsigned long				s_raid_stride;		/* option or super block	*/
+	unsigned long				s_raid_stripe_width;/* option or super block	*/
+	unsigned long				s_stripe;			/* aligned to, 0 if none	*/
+	atomic_long_t				s_stripe_allocs;	/* of a stripe or more		*/
+	atomic_long_t				s_stripe_misaligned;/* not starting on a stripe	*/
+	/* ------------------------------------------------------------------------ */
+	/* extent cache of get block												*/
+	/* ------------------------------------------------------------------------ */
+	atomic_long_t				s_extent_hits;		/* mapped from the cache	*/
+	atomic_long_t				s_extent_misses;	/* mapped by the block map	*/
+	/* ------------------------------------------------------------------------ */
+	/* background directory compaction											*/
+	/* ------------------------------------------------------------------------ */
+	spinlock_t					s_dir_compact_lock;
+	struct list_head			s_dir_compact_list;
+	struct delayed_work			s_dir_compact_work;
+	/* ------------------------------------------------------------------------ */
+	/* background reclaim of deleted files										*/
+	/* ------------------------------------------------------------------------ */
+	struct workqueue_struct		*s_reclaim_wq;
+	atomic_long_t				s_reclaim_pending;	/* blocks not freed yet		*/
+	unsigned long				s_reclaim_min_blocks;	/* smaller files inline	*/
+	/* ------------------------------------------------------------------------ */
+	/* free extent index														*/
+	/* ------------------------------------------------------------------------ */
+	struct me2fs_free_map		*s_free_maps;		/* per group, by bgl lock	*/
 
 	/* ------------------------------------------------------------------------ */
 	/* block reservation window													*/
 	/* ------------------------------------------------------------------------ */
-	struct rb_root					s_rsv_window_root;
-	struct ext2_reserve_window_node	s_rsv_window_head;
+	struct me2fs_rsv_tree		*s_rsv_trees;		/* per group, by bgl lock	*/
+
+	/* ------------------------------------------------------------------------ */
+	/* summary of block groups													*/
+	/* ------------------------------------------------------------------------ */
+	struct me2fs_group_info		*s_group_info;		/* per group, by bgl lock	*/
+	struct me2fs_group_index	*s_group_index;		/* groups by free extent	*/
 };
 
 /* EXT2_RESERVATION to reserve data blocks for expanding files					*/
@@ -522,6 +719,25 @@ struct me2fs_sb_info
 /* max window size : 1024(direct blocks) + 3([t,d]indirect blocks				*/
 #define	EXT2_MAX_RESERVE_BLOCKS				1027
 #define	EXT2_RESERVE_WINDOW_NOT_ALLOCATED	0
+/* windows used less than 1/EXT2_RSV_SHRINK_RATIO shrink by half				*/
+#define	EXT2_RSV_SHRINK_RATIO				4
+
+/* pages of a directory read ahead of readdir and lookup						*/
+#define	ME2FS_DEFAULT_DIR_RA_PAGES			8
+
+/* block bitmaps read ahead of the allocator searching groups					*/
+#define	ME2FS_DEFAULT_BITMAP_RA_GROUPS		8
+
+/* deleted files with fewer blocks are freed by the last iput itself			*/
+#define	ME2FS_DEFAULT_RECLAIM_MIN_BLOCKS	4096
+
+/* groups near the parent that cpus spread new files over with percpu_ialloc	*/
+#define	ME2FS_DEFAULT_IALLOC_SPREAD_GROUPS	8
+
+/* largest window of inode table blocks read ahead of inode lookups				*/
+#define	ME2FS_DEFAULT_ITB_RA_BLOCKS			32
+/* first window once inode table misses are found to be near each other			*/
+#define	ME2FS_ITB_RA_MIN_BLOCKS				4
 
 /*
 ----------------------------------------------------------------------------------
@@ -553,6 +769,65 @@ enum
 
 #define	ME2FS_DIR_REC_LEN( name_len )	(((name_len) + 8 + (4 - 1)) & ~(4 -1 ))
 
+/*
+----------------------------------------------------------------------------------
+	Ext2 Hashed Directory Index(htree)
+----------------------------------------------------------------------------------
+*/
+/* ---------------------------------------------------------------------------- */
+/* the root block of an indexed directory keeps "." and "..", and the "..		*/
+/* entry covers the rest of the block, so that a directory reader which			*/
+/* does not know about the index sees ordinary empty space						*/
+/* ---------------------------------------------------------------------------- */
+struct ext2_dx_fake_dirent
+{
+	__le32						inode;
+	__le16						rec_len;
+	__u8						name_len;
+	__u8						file_type;
+};
+
+struct ext2_dx_countlimit
+{
+	__le16						limit;
+	__le16						count;
+};
+
+struct ext2_dx_entry
+{
+	__le32						hash;
+	__le32						block;
+};
+
+struct ext2_dx_root_info
+{
+	__le32						reserved_zero;
+	__u8						hash_version;
+	__u8						info_length;		/* 8						*/
+	__u8						indirect_levels;
+	__u8						unused_flags;
+};
+
+struct ext2_dx_root
+{
+	struct ext2_dx_fake_dirent	dot;
+	char						dot_name[ 4 ];
+	struct ext2_dx_fake_dirent	dotdot;
+	char						dotdot_name[ 4 ];
+	struct ext2_dx_root_info	info;
+	struct ext2_dx_entry		entries[ 0 ];
+};
+
+struct ext2_dx_node
+{
+	struct ext2_dx_fake_dirent	fake;
+	struct ext2_dx_entry		entries[ 0 ];
+};
+
+/* root + one level of index nodes, same as ext3								*/
+#define	EXT2_DX_MAX_LEVELS			2
+#define	EXT2_HTREE_EOF				0x7FFFFFFF
+
 /*
 ==================================================================================
 
@@ -619,6 +894,35 @@ ext2GetFirstBlockNum( struct super_block *sb, unsigned long group_no )
 	return( first_block_num );
 }
 
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsStripeAlign
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long block
+				 < block number >
+	Output		:void
+	Return		:unsigned long
+				 < first stripe boundary at or after the block >
+
+	Description	:round a block number up to a full raid stripe
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+static inline unsigned long
+me2fsStripeAlign( struct super_block *sb, unsigned long block )
+{
+	unsigned long	stripe;
+
+	stripe = ME2FS_SB( sb )->s_stripe;
+
+	if( !stripe )
+	{
+		return( block );
+	}
+
+	return( roundup( block, stripe ) );
+}
+
 /*
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 	Function	:getSbBlockGroupLock
@@ -7,11 +7,17 @@
 #include <linux/buffer_head.h>
 #include <linux/capability.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
 #include <linux/quotaops.h>
+#include <linux/blkdev.h>
+#include <linux/sort.h>
 
 #include "me2fs.h"
 #include "me2fs_util.h"
 #include "me2fs_block.h"
+#include "me2fs_freemap.h"
+#include "me2fs_grpinfo.h"
+#include "me2fs_reclaim.h"
 
 
 /*
@@ -25,7 +31,7 @@ static int isGroupSparse( int group );
 static int testRoot( int group, int multiple );
 struct ext2_reserve_window;
 
-static int hasFreeBlocks( struct me2fs_sb_info *msi );
+static int hasFreeBlocks( struct me2fs_sb_info *msi, unsigned long count );
 static struct buffer_head*
 readBlockBitmap( struct super_block *sb, unsigned long block_group );
 static int
@@ -33,13 +39,19 @@ validBlockBitmap( struct super_block *sb,
 				  struct ext2_group_desc *gdesc,
 				  unsigned long block_group,
 				  struct buffer_head *bh );
-static int
+static long
 tryToAllocate( struct super_block *sb,
 			   unsigned long group,
 			   struct buffer_head *bitmap_bh,
-			   unsigned long grp_goal,
+			   long grp_goal,
 			   unsigned long *count,
 			   struct ext2_reserve_window *my_rsv );
+static unsigned long
+claimBlocks( struct super_block *sb,
+			 unsigned long group,
+			 struct buffer_head *bitmap_bh,
+			 unsigned long grp_goal,
+			 unsigned long count );
 static void
 adjustGroupBlocks( struct super_block *sb,
 				   unsigned long group_no,
@@ -48,34 +60,40 @@ adjustGroupBlocks( struct super_block *sb,
 				   long count );
 static inline int
 isRsvEmpty( struct ext2_reserve_window *rsv );
-static unsigned long
+static long
 tryToAllocateWithRsv( struct super_block *sb,
 					  unsigned int group,
 					  struct buffer_head *bitmap_bh,
-					  unsigned long grp_goal,
+					  long grp_goal,
 					  struct ext2_reserve_window_node *my_rsv,
 					  unsigned long *count );
 static int
 goalInMyReservation( struct ext2_reserve_window *rsv,
-					 unsigned long grp_goal,
+					 long grp_goal,
 					 unsigned int group,
 					 struct super_block *sb );
 static int
 allocNewReservation( struct ext2_reserve_window_node *my_rsv,
-					 unsigned long grp_goal,
+					 long grp_goal,
 					 struct super_block *sb,
 					 unsigned int group,
 					 struct buffer_head *bitmap_bh );
 static void
+resizeReservation( struct super_block *sb,
+				   struct ext2_reserve_window_node *my_rsv );
+static void
 tryToExtendReservation( struct ext2_reserve_window_node *my_rsv,
 						struct super_block *sb,
 						int size );
-static unsigned long
+static long
 searchBitmapNextUsableBlock( unsigned long start,
 							 struct buffer_head *bh,
 							 unsigned long end );
 static struct ext2_reserve_window_node*
 searchReserveWindow( struct rb_root *root, unsigned long goal );
+static void insertReserveWindow( struct rb_root *root,
+								 struct ext2_reserve_window_node *rsv );
+static unsigned long getRsvGroup( struct super_block *sb, unsigned long block );
 static void removeReserveWindow( struct super_block *sb,
 								 struct ext2_reserve_window_node *rsv );
 static void
@@ -88,8 +106,33 @@ findNextReservableWindow( struct ext2_reserve_window_node *search_head,
 						  struct super_block *sb,
 						  unsigned long start_block,
 						  unsigned long last_block );
-static unsigned long
+static long
 findNextUsableBlock( int start, struct buffer_head *bh, int end );
+static unsigned long
+prefetchBlockBitmaps( struct super_block *sb,
+					  unsigned long *next,
+					  unsigned long *left,
+					  unsigned long min_free,
+					  unsigned long nr );
+static long
+trimGroup( struct super_block *sb,
+		   unsigned long group,
+		   unsigned long start,
+		   unsigned long end,
+		   unsigned long minlen );
+static unsigned long
+freeGroupRuns( struct super_block *sb,
+			   unsigned long group,
+			   struct me2fs_free_run *runs,
+			   unsigned int nr );
+static unsigned long
+freeRange( struct super_block *sb,
+		   unsigned long block_num,
+		   unsigned long count );
+static void chargeFreedBlocks( struct super_block *sb,
+							   struct inode *inode,
+							   unsigned long freed );
+static int compareFreeRun( const void *a, const void *b );
 
 /*
 ==================================================================================
@@ -100,6 +143,10 @@ findNextUsableBlock( int start, struct buffer_head *bh, int end );
 */
 #define	IN_RANGE( b, first, len )	( ( ( first ) <= ( b ) )					\
 									  && ( ( b ) <= ( first ) + ( len ) + 1 ) )
+/* below this margin the free block counters are summed up precisely			*/
+#define	FREE_BLOCKS_WATERMARK		( 4 * percpu_counter_batch * nr_cpu_ids )
+/* runs a free batch holds before it is flushed									*/
+#define	FREE_BATCH_RUNS				( PAGE_SIZE / sizeof( struct me2fs_free_run ) )
 
 /*
 ==================================================================================
@@ -256,6 +303,54 @@ unsigned long me2fsCountFreeBlocks( struct super_block *sb )
 	return( desc_count );
 }
 
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsReserveBlocks
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long count
+				 < number of blocks to reserve >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:reserve free blocks for delayed allocation
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsReserveBlocks( struct super_block *sb, unsigned long count )
+{
+	struct me2fs_sb_info	*msi;
+
+	msi = ME2FS_SB( sb );
+
+	if( !hasFreeBlocks( msi, count ) )
+	{
+		return( -ENOSPC );
+	}
+
+	percpu_counter_add( &msi->s_dirtyblocks_counter, count );
+
+	return( 0 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsUnreserveBlocks
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long count
+				 < number of blocks to give back >
+	Output		:void
+	Return		:void
+
+	Description	:give back free blocks reserved for delayed allocation
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsUnreserveBlocks( struct super_block *sb, unsigned long count )
+{
+	percpu_counter_sub( &ME2FS_SB( sb )->s_dirtyblocks_counter, count );
+}
+
 /*
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 	Function	:me2fsNewBlocks
@@ -267,6 +362,8 @@ _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 				 < number of allocating block >
 				 int *err
 				 < result >
+				 int reserved
+				 < blocks and quota are reserved by delayed allocation >
 	Output		:int *err
 				 < result >
 	Return		:unsigned long
@@ -279,7 +376,8 @@ unsigned long
 me2fsNewBlocks( struct inode *inode,
 				unsigned goal,
 				unsigned long *count,
-				int*err )
+				int*err,
+				int reserved )
 {
 	struct super_block		*sb;
 	struct me2fs_sb_info	*msi;
@@ -292,11 +390,18 @@ me2fsNewBlocks( struct inode *inode,
 	unsigned long			group_no;
 	unsigned long			goal_group;
 	unsigned long			free_blocks;
-	unsigned long			grp_alloc_blk;
+	long					grp_alloc_blk;
 	unsigned long			grp_target_blk;
 	unsigned long			ret_block;
 	unsigned long			num;
 	unsigned long			ngroups;
+	unsigned long			min_free;
+	unsigned long			ra_next;
+	unsigned long			ra_left;
+	unsigned long			ra_ahead;
+	unsigned long			ra_groups;
+	unsigned long			stripe;
+	long					index_group;
 	int						bgi;
 	int						performed_allocation;
 	int						ret;
@@ -306,11 +411,10 @@ me2fsNewBlocks( struct inode *inode,
 	unsigned short					windowsz;
 
 	/* ------------------------------------------------------------------------ */
-	/* check quota for allocation of this block									*/
+	/* check quota for allocation of this block. reserved blocks are charged	*/
+	/* by the caller when the allocation succeeds								*/
 	/* ------------------------------------------------------------------------ */
-	ret = dquot_alloc_block( inode, *count );
-
-	if( ret )
+	if( !reserved && ( ret = dquot_alloc_block( inode, *count ) ) )
 	{
 		*err = ret;
 		return( 0 );
@@ -345,12 +449,24 @@ me2fsNewBlocks( struct inode *inode,
 		}
 	}
 
-	if( !hasFreeBlocks( msi ) )
+	if( !reserved && !hasFreeBlocks( msi, 1 ) )
 	{
 		*err = -ENOSPC;
 		goto out;
 	}
 
+	/* ------------------------------------------------------------------------ */
+	/* a large allocation outside a window starts on a stripe and covers whole	*/
+	/* stripes, so that the next one starts on a stripe as well					*/
+	/* ------------------------------------------------------------------------ */
+	stripe = msi->s_stripe;
+
+	if( !my_rsv && stripe && ( stripe <= num ) )
+	{
+		goal	= me2fsStripeAlign( sb, goal );
+		num		= rounddown( num, stripe );
+	}
+
 	/* ------------------------------------------------------------------------ */
 	/* test whether the goal block is free										*/
 	/* ------------------------------------------------------------------------ */
@@ -433,6 +549,59 @@ retry_alloc:
 	ngroups = msi->s_groups_count;
 	smp_rmb( );
 
+	/* ------------------------------------------------------------------------ */
+	/* skip a group if the number of free blocks is less than half of the		*/
+	/* reservation window size, or if it has none at all						*/
+	/* ------------------------------------------------------------------------ */
+	min_free	= my_rsv ? ( windowsz / 2 ) : 0;
+
+	/* ------------------------------------------------------------------------ */
+	/* first ask the group index for a group with a free run of the window,		*/
+	/* or of the request. only if that fails are the groups searched in turn	*/
+	/* ------------------------------------------------------------------------ */
+	index_group = me2fsGroupInfoFind( sb, my_rsv ? windowsz : num );
+
+	if( ( 0 <= index_group ) && ( index_group != group_no ) )
+	{
+		if( !( gdesc = me2fsGetGroupDescriptor( sb, index_group ) ) )
+		{
+			goto io_error;
+		}
+
+		if( !( gdesc_bh = me2fsGetGdescBufferCache( sb, index_group ) ) )
+		{
+			goto io_error;
+		}
+
+		brelse( bitmap_bh );
+		if( !( bitmap_bh = readBlockBitmap( sb, index_group ) ) )
+		{
+			goto io_error;
+		}
+
+		grp_alloc_blk = tryToAllocateWithRsv( sb,
+											  index_group,
+											  bitmap_bh,
+											  -1,
+											  my_rsv,
+											  &num );
+
+		if( 0 <= grp_alloc_blk )
+		{
+			group_no = index_group;
+			goto allocated;
+		}
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* bitmaps of the groups to search are read ahead in the search order, so	*/
+	/* that a cold bitmap is not one synchronous read after another				*/
+	/* ------------------------------------------------------------------------ */
+	ra_next		= ( group_no + 1 ) % ngroups;
+	ra_left		= ngroups;
+	ra_ahead	= 0;
+	ra_groups	= ACCESS_ONCE( msi->s_bitmap_ra_groups );
+
 	/* ------------------------------------------------------------------------ */
 	/* Now search the rest of the group. we assume that group_no and gdesc		*/
 	/* correctly point to the last group visited.								*/
@@ -445,6 +614,13 @@ retry_alloc:
 			group_no = 0;
 		}
 
+		free_blocks = me2fsGetGroupInfo( sb, group_no )->gi_free_blocks;
+
+		if( free_blocks <= min_free )
+		{
+			continue;
+		}
+
 		if( !( gdesc = me2fsGetGroupDescriptor( sb, group_no ) ) )
 		{
 			goto io_error;
@@ -455,14 +631,22 @@ retry_alloc:
 			goto io_error;
 		}
 
-		free_blocks = le16_to_cpu( gdesc->bg_free_blocks_count );
 		/* -------------------------------------------------------------------- */
-		/* skip this group if the number of free blocks is less than half of	*/
-		/* the reservation window size.											*/
+		/* refill the readahead when half of it has been used. this group is	*/
+		/* the first candidate of the first batch								*/
 		/* -------------------------------------------------------------------- */
-		if( my_rsv && ( free_blocks <= ( windowsz / 2 ) ) )
+		if( ra_ahead <= ( ra_groups / 2 ) )
 		{
-			continue;
+			ra_ahead += prefetchBlockBitmaps( sb,
+											  &ra_next,
+											  &ra_left,
+											  min_free,
+											  ra_groups - ra_ahead );
+		}
+
+		if( ra_ahead )
+		{
+			ra_ahead--;
 		}
 
 		brelse( bitmap_bh );
@@ -541,6 +725,16 @@ allocated:
 	adjustGroupBlocks( sb, group_no, gdesc, gdesc_bh, -num );
 	percpu_counter_sub( &msi->s_freeblocks_counter, num );
 
+	if( stripe && ( stripe <= num ) )
+	{
+		atomic_long_inc( &msi->s_stripe_allocs );
+
+		if( ret_block % stripe )
+		{
+			atomic_long_inc( &msi->s_stripe_misaligned );
+		}
+	}
+
 	mark_buffer_dirty( bitmap_bh );
 
 	if( sb->s_flags & MS_SYNCHRONOUS )
@@ -554,8 +748,11 @@ allocated:
 
 	if( num < *count )
 	{
-		dquot_free_block_nodirty( inode, *count - num );
-		mark_inode_dirty( inode );
+		if( !reserved )
+		{
+			dquot_free_block_nodirty( inode, *count - num );
+			mark_inode_dirty( inode );
+		}
 		*count = num;
 	}
 	
@@ -564,7 +761,7 @@ allocated:
 io_error:
 	*err = -EIO;
 out:
-	if( !performed_allocation )
+	if( !performed_allocation && !reserved )
 	{
 		dquot_free_block_nodirty( inode, *count );
 		mark_inode_dirty( inode );
@@ -593,129 +790,239 @@ void me2fsFreeBlocks( struct inode *inode,
 					  unsigned long block_num,
 					  unsigned long count )
 {
-	struct buffer_head		*bitmap_bh;
-	struct buffer_head		*gdesc_bh;
-	unsigned long			block_group;
-	unsigned long			bit;
-	unsigned long			i;
-	unsigned long			overflow;
-	struct super_block		*sb;
-	struct me2fs_sb_info	*msi;
-	struct ext2_group_desc	*gdesc;
-	struct ext2_super_block	*esb;
-	unsigned				freed;
-	unsigned				group_freed;
+	unsigned long	freed;
 
-	sb			= inode->i_sb;
-	esb			= ME2FS_SB( sb )->s_esb;
-	bitmap_bh	= NULL;
-	freed		= 0;
-	
-	if( block_num < le32_to_cpu( esb->s_first_data_block )	||
-		( block_num + count ) < block_num					||
-		le32_to_cpu( esb->s_blocks_count) < ( block_num + count ) )
+	freed = freeRange( inode->i_sb, block_num, count );
+
+	chargeFreedBlocks( inode->i_sb, inode, freed );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInitFreeBatch
+	Input		:struct me2fs_free_batch *batch
+				 < batch to initialize >
+				 struct super_block *sb
+				 < vfs super block >
+				 struct inode *inode
+				 < vfs inode whose blocks are freed, NULL if they are not
+				   charged to any inode >
+	Output		:void
+	Return		:void
+
+	Description	:start collecting blocks to free. the buffer of the batch is
+				 allocated when the first run is added
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsInitFreeBatch( struct me2fs_free_batch *batch,
+						 struct super_block *sb,
+						 struct inode *inode )
+{
+	batch->sb		= sb;
+	batch->inode	= inode;
+	batch->runs		= NULL;
+	batch->nr		= 0;
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFreeBatchAdd
+	Input		:struct me2fs_free_batch *batch
+				 < batch of blocks to free >
+				 unsigned long block_num
+				 < block number to start to free blocks >
+				 unsigned long count
+				 < number of blocks to free >
+	Output		:void
+	Return		:void
+
+	Description	:add a run of blocks to a batch. the blocks stay allocated
+				 until the batch is flushed
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsFreeBatchAdd( struct me2fs_free_batch *batch,
+						unsigned long block_num,
+						unsigned long count )
+{
+	struct me2fs_free_run	*last;
+
+	if( !count )
 	{
-		ME2FS_ERROR( "<ME2FS>%s:error : freeing blocks not in datazone\n",
-					 __func__ );
-		ME2FS_ERROR( "<ME2FS>block = %lu, count %lu\n", block_num, count );
-		goto error_return;
+		return;
 	}
 
-	msi			= ME2FS_SB( sb );
+	if( !batch->runs )
+	{
+		batch->runs = kmalloc( FREE_BATCH_RUNS * sizeof( *batch->runs ),
+							   GFP_NOFS | __GFP_NOWARN );
+
+		/* -------------------------------------------------------------------- */
+		/* without memory the blocks are freed one run at a time as before		*/
+		/* -------------------------------------------------------------------- */
+		if( !batch->runs )
+		{
+			chargeFreedBlocks( batch->sb,
+							   batch->inode,
+							   freeRange( batch->sb, block_num, count ) );
+			return;
+		}
+	}
 
-do_more:
-	overflow	= 0;
-	block_group	= ( block_num - le32_to_cpu( esb->s_first_data_block ) )
-				  / msi->s_blocks_per_group;
-	bit			= ( block_num - le32_to_cpu( esb->s_first_data_block ) )
-				  % msi->s_blocks_per_group;
-	
 	/* ------------------------------------------------------------------------ */
-	/* check to see if we are freeing blocks across a group boundary			*/
+	/* runs freed in file order are often contiguous on disk too				*/
 	/* ------------------------------------------------------------------------ */
-	if( msi->s_blocks_per_group < ( bit + count ) )
+	if( batch->nr )
 	{
-		overflow	= bit + count - msi->s_blocks_per_group;
-		count		= count - overflow;
-	}
+		last = &batch->runs[ batch->nr - 1 ];
 
-	if( likely( bitmap_bh ) )
-	{
-		brelse( bitmap_bh );
+		if( ( last->start + last->count ) == block_num )
+		{
+			last->count += count;
+			return;
+		}
 	}
 
-	if( !( bitmap_bh = readBlockBitmap( sb, block_group ) ) )
+	if( batch->nr == FREE_BATCH_RUNS )
 	{
-		goto error_return;
+		me2fsFreeBatchFlush( batch );
 	}
 
-	gdesc		= me2fsGetGroupDescriptor( sb, block_group );
+	batch->runs[ batch->nr ].start	= block_num;
+	batch->runs[ batch->nr ].count	= count;
+	batch->nr++;
+}
 
-	if( !gdesc )
-	{
-		goto error_return;
-	}
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFreeBatchFlush
+	Input		:struct me2fs_free_batch *batch
+				 < batch of blocks to free >
+	Output		:void
+	Return		:void
 
-	gdesc_bh	= me2fsGetGdescBufferCache( sb, block_group );
+	Description	:free all blocks of a batch. runs are sorted so that each
+				 block group has its bitmap, descriptor and free extent
+				 index updated once, and the free counter and quota are
+				 updated once for the whole batch
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsFreeBatchFlush( struct me2fs_free_batch *batch )
+{
+	struct super_block		*sb;
+	struct me2fs_sb_info	*msi;
+	struct ext2_super_block	*esb;
+	struct me2fs_free_run	*runs;
+	unsigned long			first_data_block;
+	unsigned long			group;
+	unsigned long			freed;
+	unsigned int			i;
+	unsigned int			nr;
+	unsigned int			first;
 
-	if( IN_RANGE( le32_to_cpu( gdesc->bg_block_bitmap ), block_num, count )	||
-		IN_RANGE( le32_to_cpu( gdesc->bg_inode_bitmap ), block_num, count )	||
-		IN_RANGE( block_num,
-				  le32_to_cpu( gdesc->bg_inode_table ),
-				  msi->s_itb_per_group )								||
-		IN_RANGE( block_num + count - 1,
-				  le32_to_cpu( gdesc->bg_inode_table ),
-				  msi->s_itb_per_group ) )
+	if( !batch->nr )
 	{
-		ME2FS_ERROR( "<ME2FS>%s:error:Freeing blocks in system zones\n",
-					 __func__ );
-		ME2FS_ERROR( "<ME2FS>block = %lu, count = %lu\n", block_num, count );
-		goto error_return;
+		return;
 	}
 
-	for( i = 0 , group_freed = 0 ; i < count ; i++ )
+	sb					= batch->sb;
+	msi					= ME2FS_SB( sb );
+	esb					= msi->s_esb;
+	runs				= batch->runs;
+	first_data_block	= le32_to_cpu( esb->s_first_data_block );
+	freed				= 0;
+
+	sort( runs, batch->nr, sizeof( *runs ), compareFreeRun, NULL );
+
+	/* ------------------------------------------------------------------------ */
+	/* merge runs which became adjacent by sorting, drop runs out of the data	*/
+	/* zone, and split runs at group boundaries									*/
+	/* ------------------------------------------------------------------------ */
+	nr = 0;
+	for( i = 0 ; i < batch->nr ; i++ )
 	{
-		if( !ext2_clear_bit_atomic( getSbBlockGroupLock( msi, block_group ),
-									bit + i,
-									bitmap_bh->b_data ) )
+		if( ( runs[ i ].start < first_data_block )						||
+			( ( runs[ i ].start + runs[ i ].count ) < runs[ i ].start )	||
+			( le32_to_cpu( esb->s_blocks_count )
+			  < ( runs[ i ].start + runs[ i ].count ) ) )
+		{
+			ME2FS_ERROR( "<ME2FS>%s:error : freeing blocks not in datazone\n",
+						 __func__ );
+			ME2FS_ERROR( "<ME2FS>block = %lu, count %lu\n",
+						 runs[ i ].start, runs[ i ].count );
+			continue;
+		}
+
+		if( nr && ( ( runs[ nr - 1 ].start + runs[ nr - 1 ].count )
+					== runs[ i ].start ) )
 		{
-			ME2FS_ERROR( "<ME2FS>%s:warning:bit already clreaed for block %lu\n",
-						 __func__, block_num );
+			runs[ nr - 1 ].count += runs[ i ].count;
 		}
 		else
 		{
-			group_freed++;
+			runs[ nr++ ] = runs[ i ];
 		}
 	}
 
-	mark_buffer_dirty( bitmap_bh );
-
-	if( sb->s_flags & MS_SYNCHRONOUS )
+	/* ------------------------------------------------------------------------ */
+	/* free the runs of one group at a time. a run crossing into the next		*/
+	/* group is cut, and its rest is left for the next group					*/
+	/* ------------------------------------------------------------------------ */
+	i = 0;
+	while( i < nr )
 	{
-		sync_dirty_buffer( bitmap_bh );
-	}
+		struct me2fs_free_run	tail;
+		unsigned long			group_end;
+
+		group		= ( runs[ i ].start - first_data_block )
+					  / msi->s_blocks_per_group;
+		group_end	= ext2GetFirstBlockNum( sb, group + 1 );
+		first		= i;
+		tail.count	= 0;
+
+		while( ( i < nr ) && ( runs[ i ].start < group_end ) )
+		{
+			if( group_end < ( runs[ i ].start + runs[ i ].count ) )
+			{
+				tail.start		= group_end;
+				tail.count		= runs[ i ].start + runs[ i ].count
+								  - group_end;
+				runs[ i ].count	= group_end - runs[ i ].start;
+			}
+			i++;
+		}
 
-	adjustGroupBlocks( sb, block_group, gdesc, gdesc_bh, group_freed );
+		freed += freeGroupRuns( sb, group, runs + first, i - first );
 
-	freed += group_freed;
+		if( tail.count )
+		{
+			runs[ --i ] = tail;
+		}
 
-	if( overflow )
-	{
-		block_num	+= count;
-		count		= overflow;
-		goto do_more;
+		cond_resched( );
 	}
 
-error_return:
-	brelse( bitmap_bh );
-	if( freed )
-	{
-		percpu_counter_add( &msi->s_freeblocks_counter, freed );
-#if 0	// quota
-		dquot_free_block_nodirty( inode, freed );
-#endif
-		mark_inode_dirty( inode );
-	}
+	batch->nr = 0;
+
+	chargeFreedBlocks( sb, batch->inode, freed );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsEndFreeBatch
+	Input		:struct me2fs_free_batch *batch
+				 < batch of blocks to free >
+	Output		:void
+	Return		:void
+
+	Description	:free all blocks of a batch and release the batch
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsEndFreeBatch( struct me2fs_free_batch *batch )
+{
+	me2fsFreeBatchFlush( batch );
+
+	kfree( batch->runs );
+	batch->runs = NULL;
 }
 
 /*
@@ -771,64 +1078,79 @@ void me2fsInitBlockAllocInfo( struct inode *inode )
 		
 		alloc_info->last_alloc_logical_block	= 0;
 		alloc_info->last_alloc_physical_block	= 0;
+		alloc_info->seq_alloc_blocks			= 0;
 	}
 
 	ME2FS_I( inode )->i_block_alloc_info = alloc_info;
 }
 /*
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
-	Function	:me2fsInsertReserveWindow
-	Input		:struct superbe_block *sb
+	Function	:me2fsInitReservation
+	Input		:struct super_block *sb
 				 < vfs super block >
-				 struct ext2_reserve_window_node *rsv
-				 < reservation window node to add >
 	Output		:void
-	Return		:void
+	Return		:int
+				 < result >
 
-	Description	:insert a window to the block reservation rb tree
+	Description	:allocate reservation window trees of all block groups
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 */
-void me2fsInsertReserveWindow( struct super_block *sb,
-							   struct ext2_reserve_window_node *rsv )
+int me2fsInitReservation( struct super_block *sb )
 {
-	struct rb_root					*root;
-	struct rb_node					*node;
-	unsigned long					start;
-
-	struct rb_node					**p;
-	struct rb_node					*parent;
-	struct ext2_reserve_window_node	*this;
+	struct me2fs_sb_info			*msi;
+	struct ext2_reserve_window_node	*head;
+	unsigned long					group;
 
-	root	= &ME2FS_SB( sb )->s_rsv_window_root;
-	node	= &rsv->rsv_node;
-	
-	start	= rsv->rsv_start;
+	msi = ME2FS_SB( sb );
 
-	p		= &root->rb_node;
-	parent	= NULL;
+	msi->s_rsv_trees = vzalloc( msi->s_groups_count
+								* sizeof( struct me2fs_rsv_tree ) );
 
-	while( *p )
+	if( !msi->s_rsv_trees )
 	{
-		parent = *p;
+		return( -ENOMEM );
+	}
 
-		this = rb_entry( parent, struct ext2_reserve_window_node, rsv_node );
+	/* ------------------------------------------------------------------------ */
+	/* each tree has a dummy window at block 0, so that searching a tree		*/
+	/* always finds a window before the goal									*/
+	/* ------------------------------------------------------------------------ */
+	for( group = 0 ; group < msi->s_groups_count ; group++ )
+	{
+		msi->s_rsv_trees[ group ].root = RB_ROOT;
 
-		if( start < this->rsv_start )
-		{
-			p = &( ( *p )->rb_left );
-		}
-		else if( this->rsv_end < start )
-		{
-			p = &( ( *p )->rb_right );
-		}
-		else
-		{
-			DBGPRINT( "<ME2FS>%s:bug on\n", __func__ );
-		}
+		head = &msi->s_rsv_trees[ group ].head;
+
+		head->rsv_start		= EXT2_RESERVE_WINDOW_NOT_ALLOCATED;
+		head->rsv_end		= EXT2_RESERVE_WINDOW_NOT_ALLOCATED;
+		head->rsv_alloc_hit	= 0;
+		head->rsv_goal_size	= 0;
+
+		insertReserveWindow( &msi->s_rsv_trees[ group ].root, head );
 	}
 
-	rb_link_node( node, parent, p );
-	rb_insert_color( node, root );
+	return( 0 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDestroyReservation
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:void
+
+	Description	:release reservation window trees of all block groups
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDestroyReservation( struct super_block *sb )
+{
+	struct me2fs_sb_info	*msi;
+
+	msi = ME2FS_SB( sb );
+
+	vfree( msi->s_rsv_trees );
+	msi->s_rsv_trees = NULL;
 }
 /*
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
@@ -856,11 +1178,16 @@ void me2fsDiscardReservation( struct inode *inode )
 		return;
 	}
 
-	rsv_lock	= &ME2FS_SB( inode->i_sb )->s_rsv_window_lock;
 	rsv			= &block_i->rsv_window_node;
 
 	if( !isRsvEmpty( &rsv->rsv_window ) )
 	{
+		/* -------------------------------------------------------------------- */
+		/* only the owner moves its window, under truncate_mutex				*/
+		/* -------------------------------------------------------------------- */
+		rsv_lock = getSbBlockGroupLock( ME2FS_SB( inode->i_sb ),
+										getRsvGroup( inode->i_sb,
+													 rsv->rsv_start ) );
 		spin_lock( rsv_lock );
 		{
 			if( !isRsvEmpty( &rsv->rsv_window ) )
@@ -872,6 +1199,107 @@ void me2fsDiscardReservation( struct inode *inode )
 	}
 }
 /*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsTrimFs
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 struct fstrim_range *range
+				 < range in bytes and minimum length of extents to discard >
+	Output		:struct fstrim_range *range
+				 < len is set to the number of bytes discarded >
+	Return		:int
+				 < result >
+
+	Description	:discard free extents in a range of the file system, one
+				 block group at a time
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsTrimFs( struct super_block *sb, struct fstrim_range *range )
+{
+	struct me2fs_sb_info	*msi;
+	unsigned long			first_data_block;
+	unsigned long			blocks_count;
+	unsigned long			group;
+	unsigned long			last_group;
+	unsigned long			first_bit;
+	unsigned long			last_bit;
+	u64						start;
+	u64						end;
+	u64						minlen;
+	u64						trimmed;
+	long					ret;
+
+	msi					= ME2FS_SB( sb );
+	first_data_block	= le32_to_cpu( msi->s_esb->s_first_data_block );
+	blocks_count		= le32_to_cpu( msi->s_esb->s_blocks_count );
+
+	start	= range->start >> sb->s_blocksize_bits;
+	end		= start + ( range->len >> sb->s_blocksize_bits );
+	minlen	= range->minlen >> sb->s_blocksize_bits;
+
+	if( !minlen )
+	{
+		minlen = 1;
+	}
+
+	if( ( msi->s_blocks_per_group < minlen )	||
+		( blocks_count <= start )				||
+		( range->len < sb->s_blocksize ) )
+	{
+		return( -EINVAL );
+	}
+
+	if( ( blocks_count < end ) || ( end < start ) )
+	{
+		end = blocks_count;
+	}
+
+	if( start < first_data_block )
+	{
+		start = first_data_block;
+	}
+
+	trimmed = 0;
+
+	if( end <= start )
+	{
+		goto out;
+	}
+
+	group		= ( start - first_data_block ) / msi->s_blocks_per_group;
+	first_bit	= ( start - first_data_block ) % msi->s_blocks_per_group;
+	last_group	= ( end - 1 - first_data_block ) / msi->s_blocks_per_group;
+
+	for( ; group <= last_group ; group++ )
+	{
+		/* -------------------------------------------------------------------- */
+		/* the last group of the range, and of the file system, may be short	*/
+		/* -------------------------------------------------------------------- */
+		last_bit = msi->s_blocks_per_group;
+
+		if( group == last_group )
+		{
+			last_bit = ( end - 1 - first_data_block )
+					   % msi->s_blocks_per_group + 1;
+		}
+
+		ret = trimGroup( sb, group, first_bit, last_bit, minlen );
+
+		if( ret < 0 )
+		{
+			return( ret );
+		}
+
+		trimmed		+= ret;
+		first_bit	= 0;
+	}
+
+out:
+	range->len = trimmed << sb->s_blocksize_bits;
+
+	return( 0 );
+}
+/*
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 	Function	:void
 	Input		:void
@@ -946,22 +1374,55 @@ static int testRoot( int group, int multiple )
 	Function	:hasFreeBlocks
 	Input		:struct me2fs_sb_info *msi
 				 < me2fs super block information >
+				 unsigned long count
+				 < number of blocks wanted >
 	Output		:void
 	Return		:int
 				 < result >
 
-	Description	:test whethrer filesystem has free blocks or not
+	Description	:test whethrer filesystem has free blocks or not. blocks
+				 reserved by delayed allocation are not free
 ==================================================================================
 */
-static int hasFreeBlocks( struct me2fs_sb_info *msi )
+static int hasFreeBlocks( struct me2fs_sb_info *msi, unsigned long count )
 {
 	unsigned long	free_blocks;
+	unsigned long	dirty_blocks;
 	unsigned long	root_blocks;
 
-	free_blocks = percpu_counter_read_positive( &msi->s_freeblocks_counter );
-	root_blocks = le32_to_cpu( msi->s_esb->s_r_blocks_count );
+	free_blocks		= percpu_counter_read_positive( &msi->s_freeblocks_counter );
+	dirty_blocks	= percpu_counter_read_positive( &msi->s_dirtyblocks_counter );
+	root_blocks		= le32_to_cpu( msi->s_esb->s_r_blocks_count );
+
+	if( free_blocks < ( dirty_blocks + root_blocks + count
+						+ FREE_BLOCKS_WATERMARK ) )
+	{
+		free_blocks		= percpu_counter_sum_positive(
+									&msi->s_freeblocks_counter );
+		dirty_blocks	= percpu_counter_sum_positive(
+									&msi->s_dirtyblocks_counter );
+
+		/* -------------------------------------------------------------------- */
+		/* blocks of deleted files still being reclaimed come back soon			*/
+		/* -------------------------------------------------------------------- */
+		if( ( free_blocks < ( dirty_blocks + root_blocks + count ) )
+			&& atomic_long_read( &msi->s_reclaim_pending ) )
+		{
+			me2fsWaitReclaim( msi->s_sb );
+
+			free_blocks		= percpu_counter_sum_positive(
+										&msi->s_freeblocks_counter );
+			dirty_blocks	= percpu_counter_sum_positive(
+										&msi->s_dirtyblocks_counter );
+		}
+	}
+
+	if( free_blocks < ( dirty_blocks + count ) )
+	{
+		return( 0 );
+	}
 
-	if( ( free_blocks < ( root_blocks + 1 ) )
+	if( ( free_blocks < ( dirty_blocks + root_blocks + count ) )
 		&& !capable( CAP_SYS_RESOURCE )
 		&& !uid_eq( msi->s_resuid, current_fsuid( ) )
 		&& ( gid_eq( msi->s_resgid, GLOBAL_ROOT_GID )
@@ -994,6 +1455,11 @@ readBlockBitmap( struct super_block *sb, unsigned long block_group )
 	struct buffer_head		*bh;
 	unsigned long			bitmap_blk;
 
+	if( ( bh = me2fsGroupInfoGetBitmap( sb, block_group ) ) )
+	{
+		return( bh );
+	}
+
 	if( !( gdesc = me2fsGetGroupDescriptor( sb, block_group ) ) )
 	{
 		return( NULL );
@@ -1012,6 +1478,7 @@ readBlockBitmap( struct super_block *sb, unsigned long block_group )
 
 	if( likely( bh_uptodate_or_lock( bh ) ) )
 	{
+		me2fsGroupInfoPinBitmap( sb, block_group, bh );
 		return( bh );
 	}
 
@@ -1029,6 +1496,8 @@ readBlockBitmap( struct super_block *sb, unsigned long block_group )
 	/* ------------------------------------------------------------------------ */
 	validBlockBitmap( sb, gdesc, block_group, bh );
 
+	me2fsGroupInfoPinBitmap( sb, block_group, bh );
+
 	return( bh );
 
 }
@@ -1116,23 +1585,25 @@ err_out:
 				 < group number >
 				 struct buffer_head *bitmap_bh
 				 < buffer cache block bitmap belongs to >
-				 unsigned long grp_goal
-				 < block number of goal within the group >
+				 long grp_goal
+				 < block number of goal within the group, -1 if no goal >
 				 unsigned long *count
 				 < number of blocks to allocate >
 				 struct ext2_reserve_window *my_rsv
 				 < reservation window >
-	Output		:void
-	Return		:void
+	Output		:unsigned long *count
+				 < number of allocated blocks >
+	Return		:long
+				 < first allocated block within the group, -1 if failed >
 
 	Description	:attempt to allocate blocks within a given range
 ==================================================================================
 */
-static int
+static long
 tryToAllocate( struct super_block *sb,
 			   unsigned long group,
 			   struct buffer_head *bitmap_bh,
-			   unsigned long grp_goal,
+			   long grp_goal,
 			   unsigned long *count,
 			   struct ext2_reserve_window *my_rsv )
 {
@@ -1140,6 +1611,8 @@ tryToAllocate( struct super_block *sb,
 	unsigned long	start;
 	unsigned long	end;
 	unsigned long	num;
+	unsigned long	found;
+	int				ret;
 
 	num		= 0;
 
@@ -1167,7 +1640,7 @@ tryToAllocate( struct super_block *sb,
 			end = ME2FS_SB( sb )->s_blocks_per_group;
 		}
 
-		if( ( start <= grp_goal ) && ( grp_goal < end ) )
+		if( ( 0 <= grp_goal ) && ( start <= grp_goal ) && ( grp_goal < end ) )
 		{
 			start = grp_goal;
 		}
@@ -1191,10 +1664,29 @@ tryToAllocate( struct super_block *sb,
 	}
 
 repeat:
-	if( grp_goal < 0 )
+	if( ( grp_goal < 0 ) || test_bit_le( grp_goal, bitmap_bh->b_data ) )
 	{
-		grp_goal = findNextUsableBlock( start, bitmap_bh, end );
-		
+		/* -------------------------------------------------------------------- */
+		/* look up a run of *count free blocks in the free extent index, and	*/
+		/* scan the bitmap only if the group has no index						*/
+		/* -------------------------------------------------------------------- */
+		ret = me2fsFreeMapSearch( sb, group, bitmap_bh,
+								  start, end, *count, &found );
+
+		if( ret == 0 )
+		{
+			goto fail_access;
+		}
+
+		if( 0 < ret )
+		{
+			grp_goal = found;
+		}
+		else
+		{
+			grp_goal = findNextUsableBlock( start, bitmap_bh, end );
+		}
+
 		if( grp_goal < 0 )
 		{
 			goto fail_access;
@@ -1215,11 +1707,11 @@ repeat:
 		}
 	}
 
-	start = grp_goal;
+	start	= grp_goal;
+	num		= claimBlocks( sb, group, bitmap_bh, grp_goal,
+						   min( *count, end - grp_goal ) );
 
-	if( ext2_set_bit_atomic( getSbBlockGroupLock( ME2FS_SB( sb ), group ),
-							 grp_goal,
-							 bitmap_bh->b_data ) )
+	if( !num )
 	{
 		/* -------------------------------------------------------------------- */
 		/* the block was already allocated by another thread, or it was			*/
@@ -1235,27 +1727,64 @@ repeat:
 		goto repeat;
 	}
 
-	num++;
-	grp_goal++;
-
-	while( ( num < *count ) &&
-		   ( grp_goal < end ) &&
-		   !ext2_set_bit_atomic( getSbBlockGroupLock( ME2FS_SB( sb ), group ),
-		   						 grp_goal,
-								 bitmap_bh->b_data ) )
-	{
-		num++;
-		grp_goal++;
-	}
-
 	*count = num;
-	return( grp_goal - num );
+	return( grp_goal );
 
 fail_access:
 	*count = num;
 	return( -1 );
 }
 /*
+==================================================================================
+	Function	:claimBlocks
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < group number >
+				 struct buffer_head *bitmap_bh
+				 < buffer cache block bitmap belongs to >
+				 unsigned long grp_goal
+				 < first block to claim within the group >
+				 unsigned long count
+				 < maximum number of blocks to claim >
+	Output		:void
+	Return		:unsigned long
+				 < number of claimed blocks >
+
+	Description	:set bits of free blocks from grp_goal in the bitmap until
+				 an allocated block is met, and take them out of the free
+				 extent index under the block group lock
+==================================================================================
+*/
+static unsigned long
+claimBlocks( struct super_block *sb,
+			 unsigned long group,
+			 struct buffer_head *bitmap_bh,
+			 unsigned long grp_goal,
+			 unsigned long count )
+{
+	unsigned long	num;
+
+	spin_lock( getSbBlockGroupLock( ME2FS_SB( sb ), group ) );
+	{
+		for( num = 0 ; num < count ; num++ )
+		{
+			if( test_and_set_bit_le( grp_goal + num, bitmap_bh->b_data ) )
+			{
+				break;
+			}
+		}
+
+		if( num )
+		{
+			me2fsFreeMapUse( sb, group, grp_goal, num );
+		}
+	}
+	spin_unlock( getSbBlockGroupLock( ME2FS_SB( sb ), group ) );
+
+	return( num );
+}
+/*
 ==================================================================================
 	Function	:adjustGroupBlocks
 	Input		:struct super_block *sb
@@ -1292,6 +1821,7 @@ adjustGroupBlocks( struct super_block *sb,
 
 		free_blocks					= le16_to_cpu( gdesc->bg_free_blocks_count );
 		gdesc->bg_free_blocks_count	= cpu_to_le16( free_blocks + count );
+		me2fsGroupInfoAddBlocks( sb, group_no, count );
 
 		spin_unlock( getSbBlockGroupLock( msi, group_no ) );
 		mark_buffer_dirty( bh );
@@ -1326,30 +1856,30 @@ isRsvEmpty( struct ext2_reserve_window *rsv )
 				 < group number to allocate block >
 				 struct buffer_head *bitmap_bh
 				 < buffer cache for bitmap >
-				 unsigned long grp_goal
+				 long grp_goal
 				 < goal of group >
 				 struct ext2_reserve_window_node *my_rsv
 				 < the windwo >
 				 unsigned long *count
 				 < number of blocks to allocate >
 	Output		:void
-	Return		:unsigned long
-				 < number of allocated blocks >
+	Return		:long
+				 < first allocated block within the group, -1 if failed >
 
 	Description	:allocate new block with reservation window
 ==================================================================================
 */
-static unsigned long
+static long
 tryToAllocateWithRsv( struct super_block *sb,
 					  unsigned int group,
 					  struct buffer_head *bitmap_bh,
-					  unsigned long grp_goal,
+					  long grp_goal,
 					  struct ext2_reserve_window_node *my_rsv,
 					  unsigned long *count )
 {
 	unsigned long	group_first_block;
 	unsigned long	group_last_block;
-	unsigned long	ret;
+	long			ret;
 	unsigned long	num;
 
 	ret = 0;
@@ -1461,7 +1991,7 @@ tryToAllocateWithRsv( struct super_block *sb,
 	Function	:goalInMyReservation
 	Input		:struct ext2_reserve_window *rsv
 				 < window information >
-				 unsigned long grp_goal
+				 long grp_goal
 				 < goal of group >
 				 unsigned int group
 				 < current allocation group number >
@@ -1477,7 +2007,7 @@ tryToAllocateWithRsv( struct super_block *sb,
 */
 static int
 goalInMyReservation( struct ext2_reserve_window *rsv,
-					 unsigned long grp_goal,
+					 long grp_goal,
 					 unsigned int group,
 					 struct super_block *sb )
 {
@@ -1508,7 +2038,7 @@ goalInMyReservation( struct ext2_reserve_window *rsv,
 	Function	:allocNewReservation
 	Input		:struct ext2_reserve_window_node *my_rsv
 				 < the window >
-				 unsigned long grp_goal
+				 long grp_goal
 				 < the goal (group-relative) >
 				 struct super_block *sb
 				 < vfs super block >
@@ -1525,23 +2055,25 @@ goalInMyReservation( struct ext2_reserve_window *rsv,
 */
 static int
 allocNewReservation( struct ext2_reserve_window_node *my_rsv,
-					 unsigned long grp_goal,
+					 long grp_goal,
 					 struct super_block *sb,
 					 unsigned int group,
 					 struct buffer_head *bitmap_bh )
 {
+	struct me2fs_sb_info			*msi;
 	struct ext2_reserve_window_node	*search_head;
 	unsigned long					group_first_block;
 	unsigned long					group_end_block;
 	unsigned long					start_block;
-	unsigned long					first_free_block;
+	long							first_free_block;
 	struct rb_root					*fs_rsv_root;
-	unsigned long					size;
+	unsigned long					old_group;
 	int								ret;
 	spinlock_t						*rsv_lock;
 
-	fs_rsv_root			= &ME2FS_SB( sb )->s_rsv_window_root;
-	rsv_lock			= &ME2FS_SB( sb )->s_rsv_window_lock;
+	msi					= ME2FS_SB( sb );
+	fs_rsv_root			= &msi->s_rsv_trees[ group ].root;
+	rsv_lock			= getSbBlockGroupLock( msi, group );
 
 	group_first_block	= ext2GetFirstBlockNum( sb, group );
 	group_end_block		= group_first_block +
@@ -1556,44 +2088,22 @@ allocNewReservation( struct ext2_reserve_window_node *my_rsv,
 		start_block = grp_goal + group_first_block;
 	}
 
-	size = my_rsv->rsv_goal_size;
-
 	if( !isRsvEmpty( &my_rsv->rsv_window ) )
 	{
+		resizeReservation( sb, my_rsv );
+
 		/* -------------------------------------------------------------------- */
-		/* if the old reservation is cross group boundary and if the goal is 	*/
-		/* inside the old reservation window, we will come here when we just	*/
-		/* failed to allocate from the first part of the window. we still have	*/
-		/* another part that belongs to the next group. in this case, there is	*/
-		/* no point to discard our window and try to allocate a new one in this	*/
-		/* group (which will fail). we should keep the reservation window,		*/
-		/* just simply move on.													*/
-		/*																		*/
-		/* maybe we could shift the start block of the reservation window to	*/
-		/* the first block of next group.										*/
+		/* the window moves to this group, leave the tree of the old one		*/
 		/* -------------------------------------------------------------------- */
-		if( ( my_rsv->rsv_start	<= group_end_block ) &&
-			( group_end_block	<  my_rsv->rsv_end   ) &&
-			( my_rsv->rsv_start <= start_block       ) )
-		{
-			return( -1 );
-		}
+		old_group = getRsvGroup( sb, my_rsv->rsv_start );
 
-		if( ( ( my_rsv->rsv_end - my_rsv->rsv_start + 1 ) / 2 )
-			< my_rsv->rsv_alloc_hit )
+		if( old_group != group )
 		{
-			/* ---------------------------------------------------------------- */
-			/* if the previously allocation hit ratio is greater than 1/2,		*/
-			/* then we double the size of the reservation window the next time,	*/
-			/* otherwise we keep the same size window							*/
-			/* ---------------------------------------------------------------- */
-			size = size * 2;
-			if( EXT2_MAX_RESERVE_BLOCKS < size )
+			spin_lock( getSbBlockGroupLock( msi, old_group ) );
 			{
-				size = EXT2_MAX_RESERVE_BLOCKS;
+				removeReserveWindow( sb, my_rsv );
 			}
-
-			my_rsv->rsv_goal_size = size;
+			spin_unlock( getSbBlockGroupLock( msi, old_group ) );
 		}
 	}
 
@@ -1682,6 +2192,75 @@ retry:
 	goto retry;
 }
 /*
+==================================================================================
+	Function	:resizeReservation
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 struct ext2_reserve_window_node *my_rsv
+				 < the window being replaced >
+	Output		:void
+	Return		:void
+
+	Description	:choose the size of the next window from the use of the old
+				 one and from the write pattern of the file
+==================================================================================
+*/
+static void
+resizeReservation( struct super_block *sb,
+				   struct ext2_reserve_window_node *my_rsv )
+{
+	struct me2fs_sb_info			*msi;
+	struct ext2_block_alloc_info	*block_i;
+	unsigned long					window;
+	unsigned long					size;
+	unsigned long					cap;
+
+	msi		= ME2FS_SB( sb );
+	block_i	= container_of( my_rsv,
+							struct ext2_block_alloc_info,
+							rsv_window_node );
+
+	window	= my_rsv->rsv_end - my_rsv->rsv_start + 1;
+	size	= my_rsv->rsv_goal_size;
+
+	/* ------------------------------------------------------------------------ */
+	/* a window never crosses the group end, so it cannot grow beyond a group	*/
+	/* ------------------------------------------------------------------------ */
+	cap = max_t( unsigned long,
+				 msi->s_max_rsv_blocks,
+				 EXT2_DEFAULT_RESERVE_BLOCKS );
+	cap = min_t( unsigned long, cap, msi->s_blocks_per_group );
+
+	if( ( ( window / 2 ) < my_rsv->rsv_alloc_hit ) &&
+		( my_rsv->rsv_alloc_hit <= block_i->seq_alloc_blocks ) )
+	{
+		/* -------------------------------------------------------------------- */
+		/* more than half of the window was used, and all of it in file order.	*/
+		/* a streaming writer, double the window the next time					*/
+		/* -------------------------------------------------------------------- */
+		if( size < cap )
+		{
+			size = min_t( unsigned long, size * 2, cap );
+		}
+	}
+	else if( ( my_rsv->rsv_alloc_hit < ( window / EXT2_RSV_SHRINK_RATIO ) ) ||
+			 ( block_i->seq_alloc_blocks == 0 ) )
+	{
+		/* -------------------------------------------------------------------- */
+		/* the window was mostly left unused, or the last write was out of		*/
+		/* order. a random writer, halve the window so it holds less space		*/
+		/* -------------------------------------------------------------------- */
+		if( EXT2_DEFAULT_RESERVE_BLOCKS < size )
+		{
+			size = max_t( unsigned long,
+						  size / 2,
+						  EXT2_DEFAULT_RESERVE_BLOCKS );
+		}
+	}
+
+	my_rsv->rsv_goal_size = size;
+}
+/*
 ==================================================================================
 	Function	:searchReserveWindow
 	Input		:struct rb_root *root
@@ -1740,48 +2319,128 @@ searchReserveWindow( struct rb_root *root, unsigned long goal )
 }
 /*
 ==================================================================================
-	Function	:removeReserveWindow
-	Input		:struct super_block *sb
-				 < vfs super block >
+	Function	:insertReserveWindow
+	Input		:struct rb_root *root
+				 < reservation tree of a block group >
 				 struct ext2_reserve_window_node *rsv
-				 < reservation window >
+				 < reservation window node to add >
 	Output		:void
 	Return		:void
 
-	Description	:unlink a window from the reservation rb tree
+	Description	:insert a window to the block reservation rb tree
 ==================================================================================
 */
-static void removeReserveWindow( struct super_block *sb,
+static void insertReserveWindow( struct rb_root *root,
 								 struct ext2_reserve_window_node *rsv )
 {
-	rsv->rsv_start		= EXT2_RESERVE_WINDOW_NOT_ALLOCATED;
-	rsv->rsv_end		= EXT2_RESERVE_WINDOW_NOT_ALLOCATED;
+	struct rb_node					*node;
+	unsigned long					start;
 
-	rsv->rsv_alloc_hit	= 0;
+	struct rb_node					**p;
+	struct rb_node					*parent;
+	struct ext2_reserve_window_node	*this;
 
-	rb_erase( &rsv->rsv_node, &ME2FS_SB( sb )->s_rsv_window_root );
-}
-/*
-==================================================================================
-	Function	:searchBitmapNextUsableBlock
-	Input		:unsigned long start
-				 < start block >
-				 struct buffer_head *bh
-				 < buffer cache contains the block group bitmap >
-				 unsigned long end
-				 < end block >
-	Output		:void
-	Return		:unsigned long
-				 < free block number >
+	node	= &rsv->rsv_node;
+	
+	start	= rsv->rsv_start;
 
-	Description	:search forward through the actual bitmap on disk unitl finding
-				 a free bit
-==================================================================================
-*/
-static unsigned long
-searchBitmapNextUsableBlock( unsigned long start,
-							 struct buffer_head *bh,
-							 unsigned long end )
+	p		= &root->rb_node;
+	parent	= NULL;
+
+	while( *p )
+	{
+		parent = *p;
+
+		this = rb_entry( parent, struct ext2_reserve_window_node, rsv_node );
+
+		if( start < this->rsv_start )
+		{
+			p = &( ( *p )->rb_left );
+		}
+		else if( this->rsv_end < start )
+		{
+			p = &( ( *p )->rb_right );
+		}
+		else
+		{
+			DBGPRINT( "<ME2FS>%s:bug on\n", __func__ );
+		}
+	}
+
+	rb_link_node( node, parent, p );
+	rb_insert_color( node, root );
+}
+/*
+==================================================================================
+	Function	:getRsvGroup
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long block
+				 < block number in a reservation window >
+	Output		:void
+	Return		:unsigned long
+				 < group whose tree holds the window >
+
+	Description	:get block group of a reservation window
+==================================================================================
+*/
+static unsigned long getRsvGroup( struct super_block *sb, unsigned long block )
+{
+	struct me2fs_sb_info	*msi;
+
+	msi = ME2FS_SB( sb );
+
+	return( ( block - le32_to_cpu( msi->s_esb->s_first_data_block ) )
+			/ msi->s_blocks_per_group );
+}
+/*
+==================================================================================
+	Function	:removeReserveWindow
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 struct ext2_reserve_window_node *rsv
+				 < reservation window >
+	Output		:void
+	Return		:void
+
+	Description	:unlink a window from the reservation rb tree
+==================================================================================
+*/
+static void removeReserveWindow( struct super_block *sb,
+								 struct ext2_reserve_window_node *rsv )
+{
+	struct me2fs_rsv_tree	*tree;
+
+	tree = &ME2FS_SB( sb )->s_rsv_trees[ getRsvGroup( sb, rsv->rsv_start ) ];
+
+	rsv->rsv_start		= EXT2_RESERVE_WINDOW_NOT_ALLOCATED;
+	rsv->rsv_end		= EXT2_RESERVE_WINDOW_NOT_ALLOCATED;
+
+	rsv->rsv_alloc_hit	= 0;
+
+	rb_erase( &rsv->rsv_node, &tree->root );
+}
+/*
+==================================================================================
+	Function	:searchBitmapNextUsableBlock
+	Input		:unsigned long start
+				 < start block >
+				 struct buffer_head *bh
+				 < buffer cache contains the block group bitmap >
+				 unsigned long end
+				 < end block >
+	Output		:void
+	Return		:long
+				 < free block number >
+
+	Description	:search forward through the actual bitmap on disk unitl finding
+				 a free bit
+==================================================================================
+*/
+static long
+searchBitmapNextUsableBlock( unsigned long start,
+							 struct buffer_head *bh,
+							 unsigned long end )
 {
 	unsigned long	next;
 
@@ -1818,10 +2477,13 @@ tryToExtendReservation( struct ext2_reserve_window_node *my_rsv,
 {
 	struct ext2_reserve_window_node	*next_rsv;
 	struct rb_node					*next_rb;
+	unsigned long					group;
+	unsigned long					limit;
 	spinlock_t						*rsv_lock;
 	int								ret;
 
-	rsv_lock = &ME2FS_SB( sb )->s_rsv_window_lock;
+	group		= getRsvGroup( sb, my_rsv->rsv_start );
+	rsv_lock	= getSbBlockGroupLock( ME2FS_SB( sb ), group );
 
 	ret = spin_trylock( rsv_lock );
 	{
@@ -1830,9 +2492,13 @@ tryToExtendReservation( struct ext2_reserve_window_node *my_rsv,
 			return;
 		}
 
+		/* -------------------------------------------------------------------- */
+		/* grow up to the next window, or up to the end of the group			*/
+		/* -------------------------------------------------------------------- */
 		if( !( next_rb = rb_next( &my_rsv->rsv_node ) ) )
 		{
-			my_rsv->rsv_end += size;
+			limit = ext2GetFirstBlockNum( sb, group )
+					+ ME2FS_SB( sb )->s_blocks_per_group - 1;
 		}
 		else
 		{
@@ -1840,14 +2506,16 @@ tryToExtendReservation( struct ext2_reserve_window_node *my_rsv,
 								 struct ext2_reserve_window_node,
 								 rsv_node );
 
-			if( size <= ( next_rsv->rsv_start - my_rsv->rsv_end - 1 ) )
-			{
-				my_rsv->rsv_end += size;
-			}
-			else
-			{
-				my_rsv->rsv_end = next_rsv->rsv_start - 1;
-			}
+			limit = next_rsv->rsv_start - 1;
+		}
+
+		if( size <= ( limit - my_rsv->rsv_end ) )
+		{
+			my_rsv->rsv_end += size;
+		}
+		else
+		{
+			my_rsv->rsv_end = limit;
 		}
 	}
 	spin_unlock( rsv_lock );
@@ -1883,11 +2551,27 @@ findNextReservableWindow( struct ext2_reserve_window_node *search_head,
 	struct ext2_reserve_window_node	*rsv;
 	struct ext2_reserve_window_node	*prev;
 	unsigned long					cur;
+	unsigned long					stripe;
 	int								size;
 
 	size	= my_rsv->rsv_goal_size;
 	cur		= start_block;
 
+	/* ------------------------------------------------------------------------ */
+	/* a window of a stripe or more is made of whole stripes and starts on one	*/
+	/* ------------------------------------------------------------------------ */
+	stripe	= ME2FS_SB( sb )->s_stripe;
+
+	if( stripe && ( stripe <= size ) )
+	{
+		size	= roundup( size, stripe );
+		cur		= me2fsStripeAlign( sb, cur );
+	}
+	else
+	{
+		stripe	= 0;
+	}
+
 	if( !( rsv = search_head ) )
 	{
 		return( -1 );
@@ -1898,6 +2582,11 @@ findNextReservableWindow( struct ext2_reserve_window_node *search_head,
 		if( cur <= rsv->rsv_end )
 		{
 			cur = rsv->rsv_end + 1;
+
+			if( stripe )
+			{
+				cur = me2fsStripeAlign( sb, cur );
+			}
 		}
 
 		if( last_block < cur )
@@ -1920,10 +2609,7 @@ findNextReservableWindow( struct ext2_reserve_window_node *search_head,
 
 		if( ( cur + size ) <= rsv->rsv_start )
 		{
-			/* ---------------------------------------------------------------- */
-			/* found a reservable space big enough. we could have a reservation	*/
-			/* across the group boundary here									*/
-			/* ---------------------------------------------------------------- */
+			/* found a reservable space big enough								*/
 			break;
 		}
 	}
@@ -1949,9 +2635,19 @@ findNextReservableWindow( struct ext2_reserve_window_node *search_head,
 	my_rsv->rsv_end			= cur + size - 1;
 	my_rsv->rsv_alloc_hit	= 0;
 
+	/* ------------------------------------------------------------------------ */
+	/* a window stays in the tree of one group, so it must not cross the end	*/
+	/* ------------------------------------------------------------------------ */
+	if( last_block < my_rsv->rsv_end )
+	{
+		my_rsv->rsv_end = last_block;
+	}
+
 	if( prev != my_rsv )
 	{
-		me2fsInsertReserveWindow( sb, my_rsv );
+		insertReserveWindow( &ME2FS_SB( sb )->s_rsv_trees[
+								getRsvGroup( sb, cur ) ].root,
+							 my_rsv );
 	}
 
 	return( 0 );
@@ -1967,13 +2663,13 @@ findNextReservableWindow( struct ext2_reserve_window_node *search_head,
 				 int end
 				 < end block >
 	Output		:void
-	Return		:unsigned long
+	Return		:long
 				 < found block number >
 
 	Description	:find an allocatable block in a bitmap.
 ==================================================================================
 */
-static unsigned long
+static long
 findNextUsableBlock( int start, struct buffer_head *bh, int end )
 {
 	unsigned long	here;
@@ -2026,6 +2722,537 @@ findNextUsableBlock( int start, struct buffer_head *bh, int end )
 	return( searchBitmapNextUsableBlock( here, bh, end ) );
 }
 /*
+==================================================================================
+	Function	:prefetchBlockBitmaps
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long *next
+				 < next group to look at >
+				 unsigned long *left
+				 < number of groups not looked at yet >
+				 unsigned long min_free
+				 < groups with no more free blocks than this are skipped >
+				 unsigned long nr
+				 < number of bitmaps to read ahead >
+	Output		:unsigned long *next
+				 < group after the last one looked at >
+				 unsigned long *left
+				 < decreased by the number of groups looked at >
+	Return		:unsigned long
+				 < number of groups chosen >
+
+	Description	:start reading block bitmaps of the next groups that the
+				 allocator will search, chosen by the free counts of their
+				 group summaries
+==================================================================================
+*/
+static unsigned long
+prefetchBlockBitmaps( struct super_block *sb,
+					  unsigned long *next,
+					  unsigned long *left,
+					  unsigned long min_free,
+					  unsigned long nr )
+{
+	struct me2fs_sb_info	*msi;
+	struct ext2_group_desc	*gdesc;
+	struct buffer_head		*bh;
+	struct blk_plug			plug;
+	unsigned long			group;
+	unsigned long			chosen;
+
+	msi		= ME2FS_SB( sb );
+	chosen	= 0;
+
+	blk_start_plug( &plug );
+
+	while( ( chosen < nr ) && *left )
+	{
+		group	= *next;
+		*next	= ( group + 1 ) % msi->s_groups_count;
+		( *left )--;
+
+		if( me2fsGetGroupInfo( sb, group )->gi_free_blocks <= min_free )
+		{
+			continue;
+		}
+
+		chosen++;
+
+		if( !( gdesc = me2fsGetGroupDescriptor( sb, group ) ) )
+		{
+			continue;
+		}
+
+		if( !( bh = sb_getblk( sb, le32_to_cpu( gdesc->bg_block_bitmap ) ) ) )
+		{
+			continue;
+		}
+
+		if( !buffer_uptodate( bh ) )
+		{
+			ll_rw_block( READA, 1, &bh );
+		}
+
+		brelse( bh );
+	}
+
+	blk_finish_plug( &plug );
+
+	return( chosen );
+}
+/*
+==================================================================================
+	Function	:trimGroup
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 unsigned long start
+				 < first block to trim (group relative) >
+				 unsigned long end
+				 < end of blocks to trim (group relative, exclusive) >
+				 unsigned long minlen
+				 < minimum number of blocks of an extent to discard >
+	Output		:void
+	Return		:long
+				 < number of blocks discarded, or error >
+
+	Description	:discard free extents of a block group
+==================================================================================
+*/
+static long
+trimGroup( struct super_block *sb,
+		   unsigned long group,
+		   unsigned long start,
+		   unsigned long end,
+		   unsigned long minlen )
+{
+	struct me2fs_sb_info	*msi;
+	struct ext2_group_desc	*gdesc;
+	struct buffer_head		*bitmap_bh;
+	spinlock_t				*lock;
+	unsigned long			group_first;
+	unsigned long			free;
+	unsigned long			used;
+	unsigned long			i;
+	long					trimmed;
+	int						err;
+
+	msi = ME2FS_SB( sb );
+
+	if( !( gdesc = me2fsGetGroupDescriptor( sb, group ) ) )
+	{
+		return( -EIO );
+	}
+
+	if( le16_to_cpu( gdesc->bg_free_blocks_count ) < minlen )
+	{
+		return( 0 );
+	}
+
+	if( !( bitmap_bh = readBlockBitmap( sb, group ) ) )
+	{
+		return( -EIO );
+	}
+
+	lock		= getSbBlockGroupLock( msi, group );
+	group_first	= ext2GetFirstBlockNum( sb, group );
+	trimmed		= 0;
+	err			= 0;
+
+	while( start < end )
+	{
+		/* -------------------------------------------------------------------- */
+		/* find the next free extent and take it from the allocator by setting	*/
+		/* its bits. the lock is held only while looking at the bitmap, never	*/
+		/* while the discard is in flight										*/
+		/* -------------------------------------------------------------------- */
+		spin_lock( lock );
+		{
+			free = find_next_zero_bit_le( bitmap_bh->b_data, end, start );
+			used = end;
+
+			if( free < end )
+			{
+				used = find_next_bit_le( bitmap_bh->b_data, end, free );
+			}
+
+			if( ( free < end ) && ( minlen <= ( used - free ) ) )
+			{
+				for( i = free ; i < used ; i++ )
+				{
+					set_bit_le( i, bitmap_bh->b_data );
+				}
+				me2fsFreeMapUse( sb, group, free, used - free );
+			}
+		}
+		spin_unlock( lock );
+
+		if( end <= free )
+		{
+			break;
+		}
+
+		if( minlen <= ( used - free ) )
+		{
+			err = sb_issue_discard( sb,
+									group_first + free,
+									used - free,
+									GFP_NOFS,
+									0 );
+
+			/* ---------------------------------------------------------------- */
+			/* give the extent back whether the discard succeeded or not. the	*/
+			/* free counts were never changed. the bitmap may have been written	*/
+			/* back with the extent taken meanwhile, so write it again			*/
+			/* ---------------------------------------------------------------- */
+			spin_lock( lock );
+			{
+				for( i = free ; i < used ; i++ )
+				{
+					clear_bit_le( i, bitmap_bh->b_data );
+				}
+				me2fsFreeMapRelease( sb, group, free, used - free );
+			}
+			spin_unlock( lock );
+
+			mark_buffer_dirty( bitmap_bh );
+
+			if( err )
+			{
+				break;
+			}
+
+			trimmed += used - free;
+		}
+
+		start = used;
+
+		if( fatal_signal_pending( current ) )
+		{
+			err = -ERESTARTSYS;
+			break;
+		}
+
+		cond_resched( );
+	}
+
+	brelse( bitmap_bh );
+
+	if( err && !trimmed )
+	{
+		return( err );
+	}
+
+	return( trimmed );
+}
+/*
+==================================================================================
+	Function	:freeGroupRuns
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 struct me2fs_free_run *runs
+				 < runs of blocks in the group, sorted by block number >
+				 unsigned int nr
+				 < number of runs >
+	Output		:void
+	Return		:unsigned long
+				 < number of blocks freed >
+
+	Description	:free runs of blocks in a block group, updating its bitmap,
+				 descriptor and free extent index once for all the runs
+==================================================================================
+*/
+static unsigned long
+freeGroupRuns( struct super_block *sb,
+			   unsigned long group,
+			   struct me2fs_free_run *runs,
+			   unsigned int nr )
+{
+	struct me2fs_sb_info	*msi;
+	struct buffer_head		*bitmap_bh;
+	struct buffer_head		*gdesc_bh;
+	struct ext2_group_desc	*gdesc;
+	unsigned long			group_first;
+	unsigned long			block_num;
+	unsigned long			count;
+	unsigned long			bit;
+	unsigned long			i;
+	unsigned long			cleared;
+	unsigned long			group_freed;
+	unsigned int			n;
+	int						invalid;
+
+	msi			= ME2FS_SB( sb );
+	group_first	= ext2GetFirstBlockNum( sb, group );
+
+	if( !( bitmap_bh = readBlockBitmap( sb, group ) ) )
+	{
+		return( 0 );
+	}
+
+	gdesc		= me2fsGetGroupDescriptor( sb, group );
+
+	if( !gdesc )
+	{
+		brelse( bitmap_bh );
+		return( 0 );
+	}
+
+	gdesc_bh	= me2fsGetGdescBufferCache( sb, group );
+
+	for( n = 0 ; n < nr ; n++ )
+	{
+		block_num	= runs[ n ].start;
+		count		= runs[ n ].count;
+
+		if( IN_RANGE( le32_to_cpu( gdesc->bg_block_bitmap ), block_num, count )	||
+			IN_RANGE( le32_to_cpu( gdesc->bg_inode_bitmap ), block_num, count )	||
+			IN_RANGE( block_num,
+					  le32_to_cpu( gdesc->bg_inode_table ),
+					  msi->s_itb_per_group )								||
+			IN_RANGE( block_num + count - 1,
+					  le32_to_cpu( gdesc->bg_inode_table ),
+					  msi->s_itb_per_group ) )
+		{
+			ME2FS_ERROR( "<ME2FS>%s:error:Freeing blocks in system zones\n",
+						 __func__ );
+			ME2FS_ERROR( "<ME2FS>block = %lu, count = %lu\n",
+						 block_num, count );
+			runs[ n ].count = 0;
+			continue;
+		}
+
+		/* -------------------------------------------------------------------- */
+		/* discard while the bits are still set. once they are cleared the		*/
+		/* blocks may be allocated and written again before the discard is done	*/
+		/* -------------------------------------------------------------------- */
+		if( msi->s_mount_opt & EXT2_MOUNT_DISCARD )
+		{
+			int	err;
+
+			if( ( err = sb_issue_discard( sb, block_num, count, GFP_NOFS, 0 ) ) )
+			{
+				ME2FS_ERROR( "<ME2FS>%s:warning:discard failed (%d) "
+							 "block = %lu, count = %lu\n",
+							 __func__, err, block_num, count );
+			}
+		}
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* clear the bits and give the blocks back to the free extent index under	*/
+	/* the same lock, so that the index never sees a half updated range			*/
+	/* ------------------------------------------------------------------------ */
+	group_freed	= 0;
+	invalid		= 0;
+
+	spin_lock( getSbBlockGroupLock( msi, group ) );
+	{
+		for( n = 0 ; n < nr ; n++ )
+		{
+			block_num	= runs[ n ].start;
+			count		= runs[ n ].count;
+			bit			= block_num - group_first;
+
+			if( !count )
+			{
+				continue;
+			}
+
+			for( i = 0 , cleared = 0 ; i < count ; i++ )
+			{
+				if( !test_and_clear_bit_le( bit + i, bitmap_bh->b_data ) )
+				{
+					ME2FS_ERROR( "<ME2FS>%s:warning:bit already clreaed for block %lu\n",
+								 __func__, block_num + i );
+				}
+				else
+				{
+					cleared++;
+				}
+			}
+
+			if( cleared == count )
+			{
+				if( !invalid )
+				{
+					me2fsFreeMapRelease( sb, group, bit, count );
+				}
+			}
+			else
+			{
+				invalid = 1;
+			}
+
+			group_freed += cleared;
+		}
+
+		if( invalid )
+		{
+			me2fsFreeMapInvalidate( sb, group );
+		}
+	}
+	spin_unlock( getSbBlockGroupLock( msi, group ) );
+
+	if( group_freed )
+	{
+		mark_buffer_dirty( bitmap_bh );
+
+		if( sb->s_flags & MS_SYNCHRONOUS )
+		{
+			sync_dirty_buffer( bitmap_bh );
+		}
+
+		adjustGroupBlocks( sb, group, gdesc, gdesc_bh, group_freed );
+	}
+
+	brelse( bitmap_bh );
+
+	return( group_freed );
+}
+
+/*
+==================================================================================
+	Function	:freeRange
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long block_num
+				 < block number to start to free blocks >
+				 unsigned long count
+				 < number of blocks to free >
+	Output		:void
+	Return		:unsigned long
+				 < number of blocks freed >
+
+	Description	:free a range of blocks which may cross group boundaries.
+				 the caller charges the freed blocks
+==================================================================================
+*/
+static unsigned long
+freeRange( struct super_block *sb,
+		   unsigned long block_num,
+		   unsigned long count )
+{
+	struct me2fs_sb_info	*msi;
+	struct ext2_super_block	*esb;
+	struct me2fs_free_run	run;
+	unsigned long			block_group;
+	unsigned long			bit;
+	unsigned long			overflow;
+	unsigned long			freed;
+
+	msi		= ME2FS_SB( sb );
+	esb		= msi->s_esb;
+	freed	= 0;
+	
+	if( block_num < le32_to_cpu( esb->s_first_data_block )	||
+		( block_num + count ) < block_num					||
+		le32_to_cpu( esb->s_blocks_count) < ( block_num + count ) )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:error : freeing blocks not in datazone\n",
+					 __func__ );
+		ME2FS_ERROR( "<ME2FS>block = %lu, count %lu\n", block_num, count );
+		return( 0 );
+	}
+
+	do
+	{
+		overflow	= 0;
+		block_group	= ( block_num - le32_to_cpu( esb->s_first_data_block ) )
+					  / msi->s_blocks_per_group;
+		bit			= ( block_num - le32_to_cpu( esb->s_first_data_block ) )
+					  % msi->s_blocks_per_group;
+
+		/* -------------------------------------------------------------------- */
+		/* check to see if we are freeing blocks across a group boundary		*/
+		/* -------------------------------------------------------------------- */
+		if( msi->s_blocks_per_group < ( bit + count ) )
+		{
+			overflow	= bit + count - msi->s_blocks_per_group;
+			count		= count - overflow;
+		}
+
+		run.start	= block_num;
+		run.count	= count;
+
+		freed		+= freeGroupRuns( sb, block_group, &run, 1 );
+
+		block_num	+= count;
+		count		= overflow;
+	} while( overflow );
+
+	return( freed );
+}
+
+/*
+==================================================================================
+	Function	:chargeFreedBlocks
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 struct inode *inode
+				 < vfs inode whose blocks were freed, or NULL >
+				 unsigned long freed
+				 < number of blocks freed >
+	Output		:void
+	Return		:void
+
+	Description	:give freed blocks back to the free block counter and to
+				 the quota of the inode
+==================================================================================
+*/
+static void chargeFreedBlocks( struct super_block *sb,
+							   struct inode *inode,
+							   unsigned long freed )
+{
+	if( !freed )
+	{
+		return;
+	}
+
+	percpu_counter_add( &ME2FS_SB( sb )->s_freeblocks_counter, freed );
+
+	if( inode )
+	{
+		dquot_free_block_nodirty( inode, freed );
+		mark_inode_dirty( inode );
+	}
+}
+
+/*
+==================================================================================
+	Function	:compareFreeRun
+	Input		:const void *a
+				 < run of blocks >
+				 const void *b
+				 < run of blocks >
+	Output		:void
+	Return		:int
+				 < -1 : a is first, 1 : b is first, 0 : same start >
+
+	Description	:compare runs of a free batch by their first block
+==================================================================================
+*/
+static int compareFreeRun( const void *a, const void *b )
+{
+	const struct me2fs_free_run	*ra = a;
+	const struct me2fs_free_run	*rb = b;
+
+	if( ra->start < rb->start )
+	{
+		return( -1 );
+	}
+
+	if( rb->start < ra->start )
+	{
+		return( 1 );
+	}
+
+	return( 0 );
+}
+/*
 ==================================================================================
 	Function	:void
 	Input		:void
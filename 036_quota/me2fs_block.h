@@ -23,6 +23,31 @@
 
 ==================================================================================
 */
+/*
+---------------------------------------------------------------------------------
+	Run of Blocks to Free
+---------------------------------------------------------------------------------
+*/
+struct me2fs_free_run
+{
+	unsigned long			start;
+	unsigned long			count;
+};
+
+/*
+---------------------------------------------------------------------------------
+	Batch of Blocks to Free
+	runs freed by one truncate, collected to be sorted and applied to each
+	block group at once
+---------------------------------------------------------------------------------
+*/
+struct me2fs_free_batch
+{
+	struct super_block		*sb;
+	struct inode			*inode;				/* charged, or NULL				*/
+	struct me2fs_free_run	*runs;
+	unsigned int			nr;
+};
 
 /*
 ==================================================================================
@@ -104,6 +129,37 @@ _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 */
 unsigned long me2fsCountFreeBlocks( struct super_block *sb );
 
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsReserveBlocks
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long count
+				 < number of blocks to reserve >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:reserve free blocks for delayed allocation
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsReserveBlocks( struct super_block *sb, unsigned long count );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsUnreserveBlocks
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long count
+				 < number of blocks to give back >
+	Output		:void
+	Return		:void
+
+	Description	:give back free blocks reserved for delayed allocation
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsUnreserveBlocks( struct super_block *sb, unsigned long count );
+
 /*
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 	Function	:me2fsNewBlocks
@@ -115,6 +171,8 @@ _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 				 < number of allocating block >
 				 int *err
 				 < result >
+				 int reserved
+				 < blocks and quota are reserved by delayed allocation >
 	Output		:int *err
 				 < result >
 	Return		:unsigned long
@@ -127,7 +185,8 @@ unsigned long
 me2fsNewBlocks( struct inode *inode,
 				unsigned goal,
 				unsigned long *count,
-				int*err );
+				int*err,
+				int reserved );
 
 /*
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
@@ -148,6 +207,76 @@ void me2fsFreeBlocks( struct inode *inode,
 					  unsigned long block_num,
 					  unsigned long count );
 
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInitFreeBatch
+	Input		:struct me2fs_free_batch *batch
+				 < batch to initialize >
+				 struct super_block *sb
+				 < vfs super block >
+				 struct inode *inode
+				 < vfs inode whose blocks are freed, NULL if they are not
+				   charged to any inode >
+	Output		:void
+	Return		:void
+
+	Description	:start collecting blocks to free. the buffer of the batch is
+				 allocated when the first run is added
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsInitFreeBatch( struct me2fs_free_batch *batch,
+						 struct super_block *sb,
+						 struct inode *inode );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFreeBatchAdd
+	Input		:struct me2fs_free_batch *batch
+				 < batch of blocks to free >
+				 unsigned long block_num
+				 < block number to start to free blocks >
+				 unsigned long count
+				 < number of blocks to free >
+	Output		:void
+	Return		:void
+
+	Description	:add a run of blocks to a batch. the blocks stay allocated
+				 until the batch is flushed
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsFreeBatchAdd( struct me2fs_free_batch *batch,
+						unsigned long block_num,
+						unsigned long count );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFreeBatchFlush
+	Input		:struct me2fs_free_batch *batch
+				 < batch of blocks to free >
+	Output		:void
+	Return		:void
+
+	Description	:free all blocks of a batch. runs are sorted so that each
+				 block group has its bitmap, descriptor and free extent
+				 index updated once, and the free counter and quota are
+				 updated once for the whole batch
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsFreeBatchFlush( struct me2fs_free_batch *batch );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsEndFreeBatch
+	Input		:struct me2fs_free_batch *batch
+				 < batch of blocks to free >
+	Output		:void
+	Return		:void
+
+	Description	:free all blocks of a batch and release the batch
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsEndFreeBatch( struct me2fs_free_batch *batch );
+
 /*
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 	Function	:me2fsGetBlocksUsedByGroupTable
@@ -179,19 +308,30 @@ void me2fsInitBlockAllocInfo( struct inode *inode );
 
 /*
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
-	Function	:me2fsInsertReserveWindow
-	Input		:struct superbe_block *sb
+	Function	:me2fsInitReservation
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:allocate reservation window trees of all block groups
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInitReservation( struct super_block *sb );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDestroyReservation
+	Input		:struct super_block *sb
 				 < vfs super block >
-				 struct ext2_reserve_window_node *rsv
-				 < reservation window node to add >
 	Output		:void
 	Return		:void
 
-	Description	:insert a window to the block reservation rb tree
+	Description	:release reservation window trees of all block groups
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 */
-void me2fsInsertReserveWindow( struct super_block *sb,
-							   struct ext2_reserve_window_node *rsv );
+void me2fsDestroyReservation( struct super_block *sb );
 
 /*
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
@@ -207,4 +347,22 @@ _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 */
 void me2fsDiscardReservation( struct inode *inode );
 
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsTrimFs
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 struct fstrim_range *range
+				 < range in bytes and minimum length of extents to discard >
+	Output		:struct fstrim_range *range
+				 < len is set to the number of bytes discarded >
+	Return		:int
+				 < result >
+
+	Description	:discard free extents in a range of the file system, one
+				 block group at a time
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsTrimFs( struct super_block *sb, struct fstrim_range *range );
+
 #endif	// __ME2FS_BLOCK_H__
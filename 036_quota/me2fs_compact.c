@@ -0,0 +1,604 @@
+/********************************************************************************
+	File			: me2fs_compact.c
+	Description		: Directory compaction of my ext2 file system
+
+*********************************************************************************/
+#include <linux/buffer_head.h>
+#include <linux/pagemap.h>
+#include <linux/slab.h>
+#include <linux/quotaops.h>
+
+#include "me2fs.h"
+#include "me2fs_util.h"
+#include "me2fs_inode.h"
+#include "me2fs_dir.h"
+#include "me2fs_compact.h"
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static int packDirBlocks( struct inode *dir,
+						  char *buf,
+						  unsigned long *nr_packed );
+static int writeCompactBlock( struct inode *dir,
+							  unsigned long block,
+							  char *buf,
+							  struct ext2_dir_entry *last );
+static void dirCompactWorker( struct work_struct *work );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+/* quiet period after the last deletion before background compaction runs		*/
+#define	DIR_COMPACT_DELAY		( 5 * HZ )
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsCompactDir
+	Input		:struct inode *dir
+				 < vfs inode of directory, i_mutex is held by caller >
+	Output		:void
+	Return		:int
+				 < result, -EBUSY while readdir of the directory is in progress >
+
+	Description	:repack live entries of a directory into the fewest blocks
+				 and truncate the freed blocks at the tail
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsCompactDir( struct inode *dir )
+{
+	struct me2fs_inode_info	*mei;
+	unsigned long			nr_blocks;
+	unsigned long			nr_packed;
+	char					*buf;
+	int						err;
+
+	mei = ME2FS_I( dir );
+
+	if( !S_ISDIR( dir->i_mode ) )
+	{
+		return( -ENOTDIR );
+	}
+
+	if( IS_APPEND( dir ) || IS_IMMUTABLE( dir ) )
+	{
+		return( -EPERM );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* entries move to lower offsets. a stream in the middle of readdir would	*/
+	/* skip or repeat them, so leave the directory as it is						*/
+	/* ------------------------------------------------------------------------ */
+	if( atomic_read( &mei->i_dir_streams ) )
+	{
+		return( -EBUSY );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* count blocks needed first, so that a broken page is found before any		*/
+	/* block is rewritten														*/
+	/* ------------------------------------------------------------------------ */
+	nr_blocks = dir->i_size >> dir->i_blkbits;
+
+	if( ( err = packDirBlocks( dir, NULL, &nr_packed ) ) )
+	{
+		return( err );
+	}
+
+	if( nr_blocks <= nr_packed )
+	{
+		return( 0 );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* an indexed directory is rewritten in linear format, which is only worth	*/
+	/* it when everything fits in a single block								*/
+	/* ------------------------------------------------------------------------ */
+	if( ( mei->i_flags & EXT2_INDEX_FL ) && ( 1 < nr_packed ) )
+	{
+		return( -EOPNOTSUPP );
+	}
+
+	if( !( buf = kmalloc( dir->i_sb->s_blocksize, GFP_NOFS ) ) )
+	{
+		return( -ENOMEM );
+	}
+
+	me2fsDirSummaryDrop( dir );
+
+	err = packDirBlocks( dir, buf, &nr_packed );
+
+	kfree( buf );
+
+	if( err )
+	{
+		return( err );
+	}
+
+	if( mei->i_flags & EXT2_INDEX_FL )
+	{
+		mei->i_flags &= ~EXT2_INDEX_FL;
+		mark_inode_dirty( dir );
+	}
+
+	err = me2fsSetInodeSize( dir, ( loff_t )nr_packed << dir->i_blkbits );
+
+	dir->i_version++;
+
+	DBGPRINT( "<ME2FS>%s:compacted dir [%lu] from %lu to %lu blocks\n",
+			  __func__, dir->i_ino, nr_blocks, nr_packed );
+
+	return( err );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsQueueDirCompaction
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+	Output		:void
+	Return		:void
+
+	Description	:queue a directory for background compaction
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsQueueDirCompaction( struct inode *dir )
+{
+	struct me2fs_sb_info	*msi;
+	struct me2fs_inode_info	*mei;
+
+	msi = ME2FS_SB( dir->i_sb );
+	mei = ME2FS_I( dir );
+
+	spin_lock( &msi->s_dir_compact_lock );
+	{
+		if( list_empty( &mei->i_dir_compact ) )
+		{
+			/* the queue holds a reference until the worker is done with it		*/
+			ihold( dir );
+			list_add_tail( &mei->i_dir_compact, &msi->s_dir_compact_list );
+		}
+	}
+	spin_unlock( &msi->s_dir_compact_lock );
+
+	/* ------------------------------------------------------------------------ */
+	/* push the work back while deletions go on									*/
+	/* ------------------------------------------------------------------------ */
+	mod_delayed_work( system_wq, &msi->s_dir_compact_work, DIR_COMPACT_DELAY );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsResumeDirCompaction
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+	Output		:void
+	Return		:void
+
+	Description	:queue a directory again whose compaction was deferred by
+				 readdir streams, once the last of them is released
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsResumeDirCompaction( struct inode *dir )
+{
+	struct me2fs_sb_info	*msi;
+	struct me2fs_inode_info	*mei;
+	unsigned int			deferred;
+
+	msi = ME2FS_SB( dir->i_sb );
+	mei = ME2FS_I( dir );
+
+	spin_lock( &msi->s_dir_compact_lock );
+	{
+		deferred					= mei->i_dir_compact_deferred;
+		mei->i_dir_compact_deferred	= 0;
+	}
+	spin_unlock( &msi->s_dir_compact_lock );
+
+	if( deferred )
+	{
+		me2fsQueueDirCompaction( dir );
+	}
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInitDirCompaction
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:void
+
+	Description	:initialize background compaction of a file system
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsInitDirCompaction( struct super_block *sb )
+{
+	struct me2fs_sb_info	*msi;
+
+	msi = ME2FS_SB( sb );
+
+	spin_lock_init( &msi->s_dir_compact_lock );
+	INIT_LIST_HEAD( &msi->s_dir_compact_list );
+	INIT_DELAYED_WORK( &msi->s_dir_compact_work, dirCompactWorker );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsStopDirCompaction
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:void
+
+	Description	:stop background compaction and release queued directories
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsStopDirCompaction( struct super_block *sb )
+{
+	struct me2fs_sb_info	*msi;
+	struct me2fs_inode_info	*mei;
+	LIST_HEAD( queued );
+
+	msi = ME2FS_SB( sb );
+
+	cancel_delayed_work_sync( &msi->s_dir_compact_work );
+
+	spin_lock( &msi->s_dir_compact_lock );
+	{
+		list_splice_init( &msi->s_dir_compact_list, &queued );
+	}
+	spin_unlock( &msi->s_dir_compact_lock );
+
+	while( !list_empty( &queued ) )
+	{
+		mei = list_first_entry( &queued, struct me2fs_inode_info, i_dir_compact );
+		list_del_init( &mei->i_dir_compact );
+		iput( &mei->vfs_inode );
+	}
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:void
+	Input		:void
+	Output		:void
+	Return		:void
+
+	Description	:void
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Local Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+==================================================================================
+	Function	:packDirBlocks
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 char *buf
+				 < block buffer, NULL to count blocks only >
+				 unsigned long *nr_packed
+				 < output >
+	Output		:unsigned long *nr_packed
+				 < number of blocks after packing >
+	Return		:int
+				 < result >
+
+	Description	:pack live entries in directory order from the first block.
+				 a block being written never holds an entry which has not
+				 been read yet, because packing the entries of the first n
+				 blocks never needs more than n blocks
+==================================================================================
+*/
+static int packDirBlocks( struct inode *dir,
+						  char *buf,
+						  unsigned long *nr_packed )
+{
+	struct page				*page;
+	struct ext2_dir_entry	*dent;
+	struct ext2_dir_entry	*last;
+	unsigned long			block_size;
+	unsigned long			blocks_per_page;
+	unsigned long			nr_blocks;
+	unsigned long			block;
+	unsigned long			dst;
+	unsigned long			used;
+	int						err;
+
+	block_size		= dir->i_sb->s_blocksize;
+	blocks_per_page	= PAGE_CACHE_SIZE >> dir->i_blkbits;
+	nr_blocks		= dir->i_size >> dir->i_blkbits;
+	page			= NULL;
+	last			= NULL;
+	dst				= 0;
+	used			= 0;
+	err				= 0;
+
+	if( buf )
+	{
+		memset( buf, 0, block_size );
+	}
+
+	for( block = 0 ; block < nr_blocks ; block++ )
+	{
+		char	*start;
+		char	*end;
+
+		if( !( block % blocks_per_page ) )
+		{
+			if( page )
+			{
+				me2fsPutDirPageCache( page );
+			}
+
+			page = me2fsGetDirPageCache( dir, block / blocks_per_page );
+
+			if( IS_ERR( page ) )
+			{
+				err		= PTR_ERR( page );
+				page	= NULL;
+				goto out;
+			}
+		}
+
+		start	= ( char* )page_address( page )
+				  + ( ( block % blocks_per_page ) << dir->i_blkbits );
+		end		= start + block_size;
+
+		for( dent = ( struct ext2_dir_entry* )start					;
+			 ( char* )dent < end										;
+			 dent = ( struct ext2_dir_entry* )( ( char* )dent
+												+ le16_to_cpu( dent->rec_len ) ) )
+		{
+			unsigned long	len;
+
+			if( !dent->inode )
+			{
+				continue;
+			}
+
+			len = ME2FS_DIR_REC_LEN( dent->name_len );
+
+			/* ---------------------------------------------------------------- */
+			/* the entry does not fit in the current block, go to next one		*/
+			/* ---------------------------------------------------------------- */
+			if( block_size < ( used + len ) )
+			{
+				if( buf )
+				{
+					if( ( err = writeCompactBlock( dir, dst, buf, last ) ) )
+					{
+						goto out;
+					}
+
+					memset( buf, 0, block_size );
+				}
+
+				dst++;
+				used = 0;
+			}
+
+			if( buf )
+			{
+				last = ( struct ext2_dir_entry* )( buf + used );
+				memcpy( last, dent, 8 + dent->name_len );
+				last->rec_len = cpu_to_le16( len );
+			}
+
+			used += len;
+		}
+	}
+
+	if( buf )
+	{
+		err = writeCompactBlock( dir, dst, buf, last );
+	}
+
+	*nr_packed = dst + 1;
+
+out:
+	if( page )
+	{
+		me2fsPutDirPageCache( page );
+	}
+
+	return( err );
+}
+
+/*
+==================================================================================
+	Function	:writeCompactBlock
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 unsigned long block
+				 < logical block to write >
+				 char *buf
+				 < packed contents of the block >
+				 struct ext2_dir_entry *last
+				 < last entry in the buffer >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:extend the last entry to the end of the block and write the
+				 block through page cache
+==================================================================================
+*/
+static int writeCompactBlock( struct inode *dir,
+							  unsigned long block,
+							  char *buf,
+							  struct ext2_dir_entry *last )
+{
+	struct page		*page;
+	unsigned long	block_size;
+	loff_t			pos;
+	int				err;
+
+	block_size		= dir->i_sb->s_blocksize;
+	last->rec_len	= cpu_to_le16( buf + block_size - ( char* )last );
+	pos				= ( loff_t )block << dir->i_blkbits;
+
+	page = me2fsGetDirPageCache( dir, pos >> PAGE_CACHE_SHIFT );
+
+	if( IS_ERR( page ) )
+	{
+		return( PTR_ERR( page ) );
+	}
+
+	lock_page( page );
+
+	if( ( err = me2fsPrepareWriteBlock( page, pos, block_size ) ) )
+	{
+		unlock_page( page );
+		me2fsPutDirPageCache( page );
+		return( err );
+	}
+
+	memcpy( ( char* )page_address( page ) + ( pos & ~PAGE_CACHE_MASK ),
+			buf,
+			block_size );
+
+	err = me2fsCommitBlockWrite( page, pos, block_size );
+
+	me2fsPutDirPageCache( page );
+
+	return( err );
+}
+
+/*
+==================================================================================
+	Function	:dirCompactWorker
+	Input		:struct work_struct *work
+				 < work of a file system >
+	Output		:void
+	Return		:void
+
+	Description	:compact queued directories in background
+==================================================================================
+*/
+static void dirCompactWorker( struct work_struct *work )
+{
+	struct me2fs_sb_info	*msi;
+	struct me2fs_inode_info	*mei;
+	struct inode			*dir;
+	int						err;
+	int						retry;
+	LIST_HEAD( queued );
+
+	msi = container_of( to_delayed_work( work ),
+						struct me2fs_sb_info,
+						s_dir_compact_work );
+
+	spin_lock( &msi->s_dir_compact_lock );
+	{
+		list_splice_init( &msi->s_dir_compact_list, &queued );
+	}
+	spin_unlock( &msi->s_dir_compact_lock );
+
+	while( !list_empty( &queued ) )
+	{
+		mei = list_first_entry( &queued, struct me2fs_inode_info, i_dir_compact );
+		dir = &mei->vfs_inode;
+
+		/* -------------------------------------------------------------------- */
+		/* the file system is frozen, try again later							*/
+		/* -------------------------------------------------------------------- */
+		if( !sb_start_write_trylock( dir->i_sb ) )
+		{
+			break;
+		}
+
+		err = 0;
+
+		if( !( dir->i_sb->s_flags & MS_RDONLY ) )
+		{
+			dquot_initialize( dir );
+
+			mutex_lock( &dir->i_mutex );
+			{
+				if( dir->i_nlink )
+				{
+					err = me2fsCompactDir( dir );
+				}
+			}
+			mutex_unlock( &dir->i_mutex );
+		}
+
+		sb_end_write( dir->i_sb );
+
+		/* -------------------------------------------------------------------- */
+		/* a directory a stream is reading is not polled. the last stream to be	*/
+		/* released queues it again. the lock orders this against the release,	*/
+		/* so a stream gone meanwhile only needs another try					*/
+		/* -------------------------------------------------------------------- */
+		retry = 0;
+
+		spin_lock( &msi->s_dir_compact_lock );
+		{
+			list_del_init( &mei->i_dir_compact );
+
+			if( err == -EBUSY )
+			{
+				if( atomic_read( &mei->i_dir_streams ) )
+				{
+					mei->i_dir_compact_deferred = 1;
+				}
+				else
+				{
+					retry = 1;
+				}
+			}
+		}
+		spin_unlock( &msi->s_dir_compact_lock );
+
+		if( retry )
+		{
+			me2fsQueueDirCompaction( dir );
+		}
+
+		iput( dir );
+	}
+
+	if( list_empty( &queued ) )
+	{
+		return;
+	}
+
+	spin_lock( &msi->s_dir_compact_lock );
+	{
+		list_splice( &queued, &msi->s_dir_compact_list );
+	}
+	spin_unlock( &msi->s_dir_compact_lock );
+
+	queue_delayed_work( system_wq, &msi->s_dir_compact_work, DIR_COMPACT_DELAY );
+}
@@ -0,0 +1,109 @@
+/*********************************************************************************
+	File			: me2fs_compact.h
+	Description		: Definitions for directory compaction
+
+*********************************************************************************/
+#ifndef	__ME2FS_COMPACT_H__
+#define	__ME2FS_COMPACT_H__
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsCompactDir
+	Input		:struct inode *dir
+				 < vfs inode of directory, i_mutex is held by caller >
+	Output		:void
+	Return		:int
+				 < result, -EBUSY while readdir of the directory is in progress >
+
+	Description	:repack live entries of a directory into the fewest blocks
+				 and truncate the freed blocks at the tail
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsCompactDir( struct inode *dir );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsQueueDirCompaction
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+	Output		:void
+	Return		:void
+
+	Description	:queue a directory for background compaction
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsQueueDirCompaction( struct inode *dir );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsResumeDirCompaction
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+	Output		:void
+	Return		:void
+
+	Description	:queue a directory again whose compaction was deferred by
+				 readdir streams, once the last of them is released
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsResumeDirCompaction( struct inode *dir );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInitDirCompaction
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:void
+
+	Description	:initialize background compaction of a file system
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsInitDirCompaction( struct super_block *sb );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsStopDirCompaction
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:void
+
+	Description	:stop background compaction and release queued directories
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsStopDirCompaction( struct super_block *sb );
+
+#endif	// __ME2FS_COMPACT_H__
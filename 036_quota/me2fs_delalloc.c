@@ -0,0 +1,883 @@
+/********************************************************************************
+	File			: me2fs_delalloc.c
+	Description		: Delayed allocation of my ext2 file system
+
+*********************************************************************************/
+#include <linux/buffer_head.h>
+#include <linux/pagemap.h>
+#include <linux/writeback.h>
+#include <linux/blkdev.h>
+#include <linux/quotaops.h>
+
+#include "me2fs.h"
+#include "me2fs_util.h"
+#include "me2fs_block.h"
+#include "me2fs_inode.h"
+#include "me2fs_delalloc.h"
+#include "me2fs_inline.h"
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+struct da_run;
+
+static int reserveBlock( struct inode *inode, sector_t iblock );
+static void releaseBlocks( struct inode *inode, unsigned long count );
+static unsigned long
+metaBlocksToReserve( struct inode *inode, sector_t iblock, long *ind );
+static int
+collectPage( struct page *page, struct writeback_control *wbc, void *data );
+static int flushRun( struct da_run *run );
+static void mapRunBuffers( struct da_run *run,
+						   sector_t block,
+						   unsigned long count,
+						   sector_t phys );
+static unsigned long
+getDelayedRange( struct page *page, struct inode *inode, sector_t *first );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+/* block number of a buffer waiting for allocation								*/
+#define	DA_DELAYED_BLOCK		( ( sector_t )~0ULL )
+/* maximum number of pages allocated together									*/
+#define	DA_MAX_RUN_PAGES		32
+
+/*
+---------------------------------------------------------------------------------
+	Run of Delayed Blocks
+	locked pages whose delayed blocks are contiguous in the file
+---------------------------------------------------------------------------------
+*/
+struct da_run
+{
+	struct inode				*inode;
+	struct writeback_control	*wbc;
+	struct page					*pages[ DA_MAX_RUN_PAGES ];
+	int							nr_pages;
+	sector_t					first;		/* first delayed block				*/
+	unsigned long				len;		/* number of delayed blocks			*/
+	int							err;
+};
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDaGetBlockPrep
+	Input		:struct inode *inode
+				 < vfs inode >
+				 sector_t iblock
+				 < block number in file >
+				 struct buffer_head *bh_result
+				 < buffer of the page being written >
+				 int create
+				 < not used, a block is never allocated here >
+	Output		:struct buffer_head *bh_result
+				 < mapped, or delayed if the block is a hole >
+	Return		:int
+				 < result >
+
+	Description	:get_block of write_begin. reserve space and quota for a hole
+				 instead of allocating it
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDaGetBlockPrep( struct inode *inode,
+						 sector_t iblock,
+						 struct buffer_head *bh_result,
+						 int create )
+{
+	int		ret;
+
+	ret = me2fsGetBlock( inode, iblock, bh_result, 0 );
+
+	if( ret || buffer_mapped( bh_result ) )
+	{
+		return( ret );
+	}
+
+	if( ( ret = reserveBlock( inode, iblock ) ) )
+	{
+		return( ret );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* mapped to an invalid block so that write_begin does not ask again, and	*/
+	/* new so that the rest of the buffer is zeroed								*/
+	/* ------------------------------------------------------------------------ */
+	map_bh( bh_result, inode->i_sb, DA_DELAYED_BLOCK );
+	set_buffer_new( bh_result );
+	set_buffer_delay( bh_result );
+
+	return( 0 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDaGetBlockWrite
+	Input		:struct inode *inode
+				 < vfs inode >
+				 sector_t iblock
+				 < block number in file >
+				 struct buffer_head *bh_result
+				 < buffer of the page being written back >
+				 int create
+				 < 0 : plain lookup, 1 : creation >
+	Output		:struct buffer_head *bh_result
+				 < buffer cache for the block >
+	Return		:int
+				 < result >
+
+	Description	:get_block of writeback. a delayed block is allocated from
+				 its reservation
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDaGetBlockWrite( struct inode *inode,
+						  sector_t iblock,
+						  struct buffer_head *bh_result,
+						  int create )
+{
+	int		ret;
+
+	if( !buffer_delay( bh_result ) )
+	{
+		return( me2fsGetBlock( inode, iblock, bh_result, create ) );
+	}
+
+	ret = me2fsGetBlock( inode,
+						 iblock,
+						 bh_result,
+						 ME2FS_GET_BLOCKS_DELALLOC );
+
+	/* ------------------------------------------------------------------------ */
+	/* the block was found already allocated, its reservation is not used		*/
+	/* ------------------------------------------------------------------------ */
+	if( !ret && !buffer_new( bh_result ) )
+	{
+		releaseBlocks( inode, 1 );
+	}
+
+	return( ret );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDaWritePages
+	Input		:struct address_space *mapping
+				 < address space of a regular file >
+				 struct writeback_control *wbc
+				 < writeback control information >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:write back dirty pages, allocating each run of contiguous
+				 delayed blocks with one allocation
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDaWritePages( struct address_space *mapping,
+					   struct writeback_control *wbc )
+{
+	struct da_run	run;
+	struct blk_plug	plug;
+	int				ret;
+	int				err;
+
+	/* pages of an inline file have no block to allocate						*/
+	if( me2fsHasInlineData( mapping->host ) )
+	{
+		return( generic_writepages( mapping, wbc ) );
+	}
+
+	run.inode		= mapping->host;
+	run.wbc			= wbc;
+	run.nr_pages	= 0;
+	run.first		= 0;
+	run.len			= 0;
+	run.err			= 0;
+
+	blk_start_plug( &plug );
+
+	ret = write_cache_pages( mapping, wbc, collectPage, &run );
+
+	/* ------------------------------------------------------------------------ */
+	/* the last run is still held												*/
+	/* ------------------------------------------------------------------------ */
+	err = flushRun( &run );
+
+	blk_finish_plug( &plug );
+
+	if( !ret )
+	{
+		ret = err ? err : run.err;
+	}
+
+	return( ret );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDaInvalidatePage
+	Input		:struct page *page
+				 < page to invalidate >
+				 unsigned int offset
+				 < start of range in the page >
+				 unsigned int length
+				 < length of range >
+	Output		:void
+	Return		:void
+
+	Description	:give back reservations of delayed blocks being dropped
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDaInvalidatePage( struct page *page,
+							unsigned int offset,
+							unsigned int length )
+{
+	struct buffer_head	*head;
+	struct buffer_head	*bh;
+	unsigned int		curr_off;
+	unsigned int		stop;
+	unsigned long		nr_delayed;
+
+	if( page_has_buffers( page ) )
+	{
+		head		= page_buffers( page );
+		bh			= head;
+		curr_off	= 0;
+		stop		= offset + length;
+		nr_delayed	= 0;
+
+		/* -------------------------------------------------------------------- */
+		/* the same buffers as block_invalidatepage( ) discards					*/
+		/* -------------------------------------------------------------------- */
+		do
+		{
+			if( stop < ( curr_off + bh->b_size ) )
+			{
+				break;
+			}
+
+			if( ( offset <= curr_off ) && buffer_delay( bh ) )
+			{
+				clear_buffer_delay( bh );
+				nr_delayed++;
+			}
+
+			curr_off += bh->b_size;
+		} while( ( bh = bh->b_this_page ) != head );
+
+		if( nr_delayed )
+		{
+			releaseBlocks( page->mapping->host, nr_delayed );
+		}
+	}
+
+	block_invalidatepage( page, offset, length );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDaClaimBlocks
+	Input		:struct inode *inode
+				 < vfs inode >
+				 unsigned long data_blks
+				 < number of data blocks just allocated >
+				 unsigned long meta_blks
+				 < number of indirect blocks just allocated >
+	Output		:void
+	Return		:void
+
+	Description	:turn reservations into allocated blocks and charged quota
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDaClaimBlocks( struct inode *inode,
+						 unsigned long data_blks,
+						 unsigned long meta_blks )
+{
+	struct me2fs_inode_info	*mi;
+	unsigned long			claimed_data;
+	unsigned long			claimed_meta;
+	unsigned long			unused_meta;
+
+	mi			= ME2FS_I( inode );
+	unused_meta	= 0;
+
+	spin_lock( &mi->i_da_lock );
+	{
+		claimed_data = min( data_blks, mi->i_da_data_blocks );
+		claimed_meta = min( meta_blks, mi->i_da_meta_blocks );
+
+		mi->i_da_data_blocks -= claimed_data;
+		mi->i_da_meta_blocks -= claimed_meta;
+
+		/* -------------------------------------------------------------------- */
+		/* indirect blocks are reserved for the worst case. what is left when	*/
+		/* the last delayed block is allocated is not needed					*/
+		/* -------------------------------------------------------------------- */
+		if( !mi->i_da_data_blocks )
+		{
+			unused_meta				= mi->i_da_meta_blocks;
+			mi->i_da_meta_blocks	= 0;
+		}
+	}
+	spin_unlock( &mi->i_da_lock );
+
+	if( claimed_data < data_blks )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:allocated more blocks than reserved "
+					 "- ino=%lu, blocks=%lu, reserved=%lu\n",
+					 __func__, inode->i_ino, data_blks, claimed_data );
+	}
+
+	me2fsUnreserveBlocks( inode->i_sb,
+						  claimed_data + claimed_meta + unused_meta );
+
+	dquot_claim_block( inode, claimed_data + claimed_meta );
+
+	if( ( claimed_data + claimed_meta ) < ( data_blks + meta_blks ) )
+	{
+		dquot_alloc_block_nofail( inode, data_blks + meta_blks
+										 - claimed_data - claimed_meta );
+	}
+
+	if( unused_meta )
+	{
+		dquot_release_reservation_block( inode, unused_meta );
+	}
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDaReleaseInode
+	Input		:struct inode *inode
+				 < vfs inode being evicted >
+	Output		:void
+	Return		:void
+
+	Description	:give back reservations left on an inode
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDaReleaseInode( struct inode *inode )
+{
+	struct me2fs_inode_info	*mi;
+	unsigned long			left;
+
+	mi = ME2FS_I( inode );
+
+	spin_lock( &mi->i_da_lock );
+	{
+		left					= mi->i_da_data_blocks + mi->i_da_meta_blocks;
+		mi->i_da_data_blocks	= 0;
+		mi->i_da_meta_blocks	= 0;
+	}
+	spin_unlock( &mi->i_da_lock );
+
+	if( left )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:reservation left on evicted inode "
+					 "- ino=%lu, blocks=%lu\n", __func__, inode->i_ino, left );
+		me2fsUnreserveBlocks( inode->i_sb, left );
+		dquot_release_reservation_block( inode, left );
+	}
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGetReservedSpace
+	Input		:struct inode *inode
+				 < vfs inode >
+	Output		:void
+	Return		:qsize_t*
+				 < space reserved in quota for the inode >
+
+	Description	:get_reserved_space of dquot operations
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+qsize_t *me2fsGetReservedSpace( struct inode *inode )
+{
+	return( &ME2FS_I( inode )->i_reserved_quota );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDaFlushReserved
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:int
+				 < 1:delayed blocks were written back, worth retrying 0:not >
+
+	Description	:write back delayed blocks of the file system so that their
+				 worst-case indirect reservations are given back. must not
+				 be called with a page of the file system locked
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDaFlushReserved( struct super_block *sb )
+{
+	if( percpu_counter_sum( &ME2FS_SB( sb )->s_dirtyblocks_counter ) <= 0 )
+	{
+		return( 0 );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* umount may hold s_umount, in which case there is nothing to wait for		*/
+	/* ------------------------------------------------------------------------ */
+	if( !try_to_writeback_inodes_sb( sb, WB_REASON_FS_FREE_SPACE ) )
+	{
+		return( 0 );
+	}
+
+	return( 1 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:void
+	Input		:void
+	Output		:void
+	Return		:void
+
+	Description	:void
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Local Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+==================================================================================
+	Function	:reserveBlock
+	Input		:struct inode *inode
+				 < vfs inode >
+				 sector_t iblock
+				 < block number in file >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:reserve quota and free space for a delayed block and the
+				 indirect blocks it may need
+==================================================================================
+*/
+static int reserveBlock( struct inode *inode, sector_t iblock )
+{
+	struct me2fs_inode_info	*mi;
+	unsigned long			meta;
+	long					ind;
+	int						ret;
+
+	mi = ME2FS_I( inode );
+
+	spin_lock( &mi->i_da_lock );
+	{
+		meta = metaBlocksToReserve( inode, iblock, &ind );
+	}
+	spin_unlock( &mi->i_da_lock );
+
+	if( ( ret = dquot_reserve_block( inode, 1 + meta ) ) )
+	{
+		return( ret );
+	}
+
+	if( ( ret = me2fsReserveBlocks( inode->i_sb, 1 + meta ) ) )
+	{
+		dquot_release_reservation_block( inode, 1 + meta );
+		return( ret );
+	}
+
+	spin_lock( &mi->i_da_lock );
+	{
+		mi->i_da_data_blocks++;
+		mi->i_da_meta_blocks	+= meta;
+		mi->i_da_last_ind		= ind;
+	}
+	spin_unlock( &mi->i_da_lock );
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:releaseBlocks
+	Input		:struct inode *inode
+				 < vfs inode >
+				 unsigned long count
+				 < number of delayed blocks no longer needed >
+	Output		:void
+	Return		:void
+
+	Description	:give back reservations of delayed blocks
+==================================================================================
+*/
+static void releaseBlocks( struct inode *inode, unsigned long count )
+{
+	struct me2fs_inode_info	*mi;
+	unsigned long			release;
+
+	mi = ME2FS_I( inode );
+
+	spin_lock( &mi->i_da_lock );
+	{
+		if( mi->i_da_data_blocks < count )
+		{
+			ME2FS_ERROR( "<ME2FS>%s:releasing more blocks than reserved "
+						 "- ino=%lu, blocks=%lu, reserved=%lu\n",
+						 __func__, inode->i_ino,
+						 count, mi->i_da_data_blocks );
+			count = mi->i_da_data_blocks;
+		}
+
+		mi->i_da_data_blocks	-= count;
+		release					= count;
+
+		if( !mi->i_da_data_blocks )
+		{
+			release					+= mi->i_da_meta_blocks;
+			mi->i_da_meta_blocks	= 0;
+		}
+	}
+	spin_unlock( &mi->i_da_lock );
+
+	if( release )
+	{
+		me2fsUnreserveBlocks( inode->i_sb, release );
+		dquot_release_reservation_block( inode, release );
+	}
+}
+
+/*
+==================================================================================
+	Function	:metaBlocksToReserve
+	Input		:struct inode *inode
+				 < vfs inode >
+				 sector_t iblock
+				 < block number in file >
+				 long *ind
+				 < output >
+	Output		:long *ind
+				 < number of the indirect block which maps iblock >
+	Return		:unsigned long
+				 < number of indirect blocks to reserve >
+
+	Description	:reserve the whole indirect path the first time a delayed
+				 block falls under an indirect block, and nothing while the
+				 following blocks stay under the same one. caller holds
+				 i_da_lock
+==================================================================================
+*/
+static unsigned long
+metaBlocksToReserve( struct inode *inode, sector_t iblock, long *ind )
+{
+	struct me2fs_inode_info	*mi;
+	unsigned int			addr_bits;
+
+	mi			= ME2FS_I( inode );
+	addr_bits	= inode->i_sb->s_blocksize_bits - 2;
+
+	if( iblock < ME2FS_NDIR_BLOCKS )
+	{
+		*ind = -1;
+		return( 0 );
+	}
+
+	*ind = ( iblock - ME2FS_NDIR_BLOCKS ) >> addr_bits;
+
+	if( mi->i_da_data_blocks && ( *ind == mi->i_da_last_ind ) )
+	{
+		return( 0 );
+	}
+
+	if( *ind < 1 )
+	{
+		return( 1 );
+	}
+
+	if( *ind < ( 1 + ( 1L << addr_bits ) ) )
+	{
+		return( 2 );
+	}
+
+	return( 3 );
+}
+
+/*
+==================================================================================
+	Function	:collectPage
+	Input		:struct page *page
+				 < locked page cleared for writeback >
+				 struct writeback_control *wbc
+				 < writeback control information >
+				 void *data
+				 < current run >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:add a page with delayed blocks to the current run, or write
+				 it out. a page kept in the run stays locked until the run
+				 is flushed
+==================================================================================
+*/
+static int
+collectPage( struct page *page, struct writeback_control *wbc, void *data )
+{
+	struct da_run	*run;
+	sector_t		first;
+	unsigned long	count;
+	int				ret;
+
+	run		= data;
+	count	= getDelayedRange( page, run->inode, &first );
+
+	if( count &&
+		run->nr_pages &&
+		( run->nr_pages < DA_MAX_RUN_PAGES ) &&
+		( first == ( run->first + run->len ) ) )
+	{
+		run->pages[ run->nr_pages++ ]	= page;
+		run->len						+= count;
+		return( 0 );
+	}
+
+	if( ( ret = flushRun( run ) ) )
+	{
+		run->err = ret;
+	}
+
+	if( count )
+	{
+		run->pages[ run->nr_pages++ ]	= page;
+		run->first						= first;
+		run->len						= count;
+		return( 0 );
+	}
+
+	return( block_write_full_page( page, me2fsDaGetBlockWrite, wbc ) );
+}
+
+/*
+==================================================================================
+	Function	:flushRun
+	Input		:struct da_run *run
+				 < run of delayed blocks >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:allocate the delayed blocks of the run as contiguously as
+				 possible and write out its pages
+==================================================================================
+*/
+static int flushRun( struct da_run *run )
+{
+	struct inode		*inode;
+	struct buffer_head	tmp_bh;
+	sector_t			block;
+	unsigned long		left;
+	unsigned long		count;
+	int					err;
+	int					ret;
+	int					i;
+
+	if( !run->nr_pages )
+	{
+		return( 0 );
+	}
+
+	inode	= run->inode;
+	block	= run->first;
+	left	= run->len;
+	err		= 0;
+
+	while( left )
+	{
+		tmp_bh.b_state	= 0;
+		tmp_bh.b_size	= left << inode->i_blkbits;
+
+		err = me2fsGetBlock( inode, block, &tmp_bh, ME2FS_GET_BLOCKS_DELALLOC );
+
+		if( err )
+		{
+			/* ---------------------------------------------------------------- */
+			/* the rest is retried block by block when the pages are written	*/
+			/* ---------------------------------------------------------------- */
+			break;
+		}
+
+		if( !buffer_mapped( &tmp_bh ) )
+		{
+			err = -EIO;
+			break;
+		}
+
+		count = tmp_bh.b_size >> inode->i_blkbits;
+
+		if( !buffer_new( &tmp_bh ) )
+		{
+			releaseBlocks( inode, count );
+		}
+
+		mapRunBuffers( run, block, count, tmp_bh.b_blocknr );
+
+		block	+= count;
+		left	-= count;
+	}
+
+	for( i = 0 ; i < run->nr_pages ; i++ )
+	{
+		ret = block_write_full_page( run->pages[ i ],
+									 me2fsDaGetBlockWrite,
+									 run->wbc );
+		if( ret && !err )
+		{
+			err = ret;
+		}
+	}
+
+	run->nr_pages	= 0;
+	run->len		= 0;
+
+	return( err );
+}
+
+/*
+==================================================================================
+	Function	:mapRunBuffers
+	Input		:struct da_run *run
+				 < run of delayed blocks >
+				 sector_t block
+				 < first block in file just allocated >
+				 unsigned long count
+				 < number of blocks >
+				 sector_t phys
+				 < first block on disk >
+	Output		:void
+	Return		:void
+
+	Description	:map delayed buffers of the run to the allocated blocks
+==================================================================================
+*/
+static void mapRunBuffers( struct da_run *run,
+						   sector_t block,
+						   unsigned long count,
+						   sector_t phys )
+{
+	struct buffer_head	*head;
+	struct buffer_head	*bh;
+	sector_t			iblock;
+	int					i;
+
+	for( i = 0 ; i < run->nr_pages ; i++ )
+	{
+		head	= page_buffers( run->pages[ i ] );
+		bh		= head;
+		iblock	= ( sector_t )run->pages[ i ]->index
+				  << ( PAGE_CACHE_SHIFT - run->inode->i_blkbits );
+
+		do
+		{
+			if( buffer_delay( bh ) &&
+				( block <= iblock ) && ( iblock < ( block + count ) ) )
+			{
+				bh->b_blocknr = phys + ( iblock - block );
+				clear_buffer_delay( bh );
+				clear_buffer_new( bh );
+				unmap_underlying_metadata( bh->b_bdev, bh->b_blocknr );
+			}
+			iblock++;
+		} while( ( bh = bh->b_this_page ) != head );
+	}
+}
+
+/*
+==================================================================================
+	Function	:getDelayedRange
+	Input		:struct page *page
+				 < locked page >
+				 struct inode *inode
+				 < vfs inode >
+				 sector_t *first
+				 < output >
+	Output		:sector_t *first
+				 < first delayed block of the page >
+	Return		:unsigned long
+				 < number of contiguous delayed blocks from first >
+
+	Description	:find the delayed blocks of a page within i_size
+==================================================================================
+*/
+static unsigned long
+getDelayedRange( struct page *page, struct inode *inode, sector_t *first )
+{
+	struct buffer_head	*head;
+	struct buffer_head	*bh;
+	sector_t			iblock;
+	sector_t			last_block;
+	loff_t				size;
+	unsigned long		count;
+
+	size = i_size_read( inode );
+
+	if( !page_has_buffers( page ) || !size )
+	{
+		return( 0 );
+	}
+
+	head		= page_buffers( page );
+	bh			= head;
+	iblock		= ( sector_t )page->index
+				  << ( PAGE_CACHE_SHIFT - inode->i_blkbits );
+	last_block	= ( size - 1 ) >> inode->i_blkbits;
+	count		= 0;
+
+	do
+	{
+		if( last_block < iblock )
+		{
+			break;
+		}
+
+		if( buffer_delay( bh ) )
+		{
+			if( !count )
+			{
+				*first = iblock;
+			}
+			count++;
+		}
+		else if( count )
+		{
+			break;
+		}
+		iblock++;
+	} while( ( bh = bh->b_this_page ) != head );
+
+	return( count );
+}
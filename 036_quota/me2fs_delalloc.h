@@ -0,0 +1,192 @@
+/*********************************************************************************
+	File			: me2fs_delalloc.h
+	Description		: Definitions for delayed allocation
+
+*********************************************************************************/
+#ifndef	__ME2FS_DELALLOC_H__
+#define	__ME2FS_DELALLOC_H__
+
+#include <linux/quota.h>
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDaGetBlockPrep
+	Input		:struct inode *inode
+				 < vfs inode >
+				 sector_t iblock
+				 < block number in file >
+				 struct buffer_head *bh_result
+				 < buffer of the page being written >
+				 int create
+				 < not used, a block is never allocated here >
+	Output		:struct buffer_head *bh_result
+				 < mapped, or delayed if the block is a hole >
+	Return		:int
+				 < result >
+
+	Description	:get_block of write_begin. reserve space and quota for a hole
+				 instead of allocating it
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDaGetBlockPrep( struct inode *inode,
+						 sector_t iblock,
+						 struct buffer_head *bh_result,
+						 int create );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDaGetBlockWrite
+	Input		:struct inode *inode
+				 < vfs inode >
+				 sector_t iblock
+				 < block number in file >
+				 struct buffer_head *bh_result
+				 < buffer of the page being written back >
+				 int create
+				 < 0 : plain lookup, 1 : creation >
+	Output		:struct buffer_head *bh_result
+				 < buffer cache for the block >
+	Return		:int
+				 < result >
+
+	Description	:get_block of writeback. a delayed block is allocated from
+				 its reservation
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDaGetBlockWrite( struct inode *inode,
+						  sector_t iblock,
+						  struct buffer_head *bh_result,
+						  int create );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDaWritePages
+	Input		:struct address_space *mapping
+				 < address space of a regular file >
+				 struct writeback_control *wbc
+				 < writeback control information >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:write back dirty pages, allocating each run of contiguous
+				 delayed blocks with one allocation
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDaWritePages( struct address_space *mapping,
+					   struct writeback_control *wbc );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDaInvalidatePage
+	Input		:struct page *page
+				 < page to invalidate >
+				 unsigned int offset
+				 < start of range in the page >
+				 unsigned int length
+				 < length of range >
+	Output		:void
+	Return		:void
+
+	Description	:give back reservations of delayed blocks being dropped
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDaInvalidatePage( struct page *page,
+							unsigned int offset,
+							unsigned int length );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDaClaimBlocks
+	Input		:struct inode *inode
+				 < vfs inode >
+				 unsigned long data_blks
+				 < number of data blocks just allocated >
+				 unsigned long meta_blks
+				 < number of indirect blocks just allocated >
+	Output		:void
+	Return		:void
+
+	Description	:turn reservations into allocated blocks and charged quota
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDaClaimBlocks( struct inode *inode,
+						 unsigned long data_blks,
+						 unsigned long meta_blks );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDaReleaseInode
+	Input		:struct inode *inode
+				 < vfs inode being evicted >
+	Output		:void
+	Return		:void
+
+	Description	:give back reservations left on an inode
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDaReleaseInode( struct inode *inode );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGetReservedSpace
+	Input		:struct inode *inode
+				 < vfs inode >
+	Output		:void
+	Return		:qsize_t*
+				 < space reserved in quota for the inode >
+
+	Description	:get_reserved_space of dquot operations
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+qsize_t *me2fsGetReservedSpace( struct inode *inode );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDaFlushReserved
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:int
+				 < 1:delayed blocks were written back, worth retrying 0:not >
+
+	Description	:write back delayed blocks of the file system so that their
+				 worst-case indirect reservations are given back. must not
+				 be called with a page of the file system locked
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDaFlushReserved( struct super_block *sb );
+
+#endif	// __ME2FS_DELALLOC_H__
@@ -6,11 +6,15 @@
 #include <linux/buffer_head.h>
 #include <linux/pagemap.h>
 #include <linux/swap.h>
+#include <linux/slab.h>
+#include <asm/unaligned.h>
 
 #include "me2fs.h"
 #include "me2fs_util.h"
 #include "me2fs_inode.h"
 #include "me2fs_dir.h"
+#include "me2fs_dx.h"
+#include "me2fs_compact.h"
 
 
 
@@ -29,6 +33,7 @@
 ---------------------------------------------------------------------------------
 */
 static int me2fsReadDir( struct file *file, struct dir_context *ctx );
+static int me2fsReleaseDir( struct inode *inode, struct file *file );
 /*
 ---------------------------------------------------------------------------------
 
@@ -37,18 +42,25 @@ static int me2fsReadDir( struct file *file, struct dir_context *ctx );
 ---------------------------------------------------------------------------------
 */
 static inline unsigned long getDirNumPages( struct inode *inode );
-static struct page*
-me2fsGetDirPageCache( struct inode *inode, unsigned long index );
-static inline void me2fsPutDirPageCache( struct page *page );
 static unsigned long
 me2fsGetPageLastByte( struct inode *inode, unsigned long page_nr );
+static struct me2fs_dir_summary *getDirSummary( struct inode *dir );
+static int
+resizeDirSummary( struct me2fs_dir_summary *summary, unsigned long nr_alloc );
+static void freeDirSummary( struct me2fs_dir_summary *summary );
+static inline unsigned int dirGapBucket( unsigned short gap );
+static void
+linkGapBlock( struct me2fs_dir_summary *summary, unsigned long block );
+static void
+unlinkGapBlock( struct me2fs_dir_summary *summary, unsigned long block );
+static void checkDirPage( struct inode *dir, struct page *page );
 static inline int
-me2fsStrncmp( int len, const char* const name, struct ext2_dir_entry *dent );
-static inline void
-setDirEntryType( struct ext2_dir_entry *dent, struct inode *inode );
-static inline int
-prepareWriteBlock( struct page *page, loff_t pos, unsigned long len );
-static int commitBlockWrite( struct page *page, loff_t pos, unsigned long len );
+isSameName( const unsigned char *name1, const unsigned char *name2, int len );
+static int isDirSparse( struct inode *dir );
+static void readaheadDirPages( struct inode *dir,
+							   struct file_ra_state *ra,
+							   struct file *file,
+							   unsigned long index );
 
 /*
 ==================================================================================
@@ -57,6 +69,10 @@ static int commitBlockWrite( struct page *page, loff_t pos, unsigned long len );
 
 ==================================================================================
 */
+/* inode numbers collected from a page of directory for inode prefetch			*/
+#define	PREFETCH_INOS	( PAGE_SIZE / sizeof( unsigned long ) )
+/* smaller directories are not worth compacting in background					*/
+#define	DIR_COMPACT_MIN_BLOCKS	8
 
 /*
 ==================================================================================
@@ -71,6 +87,7 @@ const struct file_operations me2fs_dir_operations =
 	.read			= generic_read_dir,
 	.iterate		= me2fsReadDir,
 	//.open			= me2fsOpen,
+	.release		= me2fsReleaseDir,
 	.fsync			= generic_file_fsync,
 };
 
@@ -156,13 +173,42 @@ me2fsFindDirEntry( struct inode *dir,
 {
 	struct page				*page;
 	struct ext2_dir_entry	*dent;
-	unsigned long			rec_len;
 	unsigned long			page_index;
-	const char				*name = child->name;
-	int						namelen;
+	int						err;
+	struct file_ra_state	ra;
+	struct me2fs_dir_scan	scan;
+
+	/* ------------------------------------------------------------------------ */
+	/* look up through the hash index if the directory has one					*/
+	/* ------------------------------------------------------------------------ */
+	if( me2fsIsDxDir( dir ) )
+	{
+		dent = me2fsDxFindEntry( dir, child, res_page, &err );
+
+		if( dent || ( err != -EFSCORRUPTED ) )
+		{
+			return( dent );
+		}
+
+		ME2FS_ERROR( "<ME2FS>%s:falling back to linear search [#%lu]\n",
+					 __func__, dir->i_ino );
+
+		/* -------------------------------------------------------------------- */
+		/* stop using the broken index, or every lookup probes it again			*/
+		/* -------------------------------------------------------------------- */
+		ME2FS_I( dir )->i_flags &= ~EXT2_INDEX_FL;
+		mark_inode_dirty( dir );
+	}
 
-	namelen	= child->len;
-	rec_len	= ME2FS_DIR_REC_LEN( namelen );
+	scan.name		= child->name;
+	scan.len		= child->len;
+	scan.need		= 0;
+	scan.find_live	= 0;
+
+	/* ------------------------------------------------------------------------ */
+	/* a lookup has no file, keep its readahead state on the stack				*/
+	/* ------------------------------------------------------------------------ */
+	file_ra_state_init( &ra, dir->i_mapping );
 
 	for( page_index = 0							;
 		 page_index < getDirNumPages( dir )	;
@@ -171,6 +217,8 @@ me2fsFindDirEntry( struct inode *dir,
 		char	*start;
 		char	*end;
 
+		readaheadDirPages( dir, &ra, NULL, page_index );
+
 		page = ( struct page* )me2fsGetDirPageCache( dir, page_index );
 
 		if( IS_ERR( page ) )
@@ -180,33 +228,11 @@ me2fsFindDirEntry( struct inode *dir,
 		}
 
 		start	= ( char* )page_address( ( const struct page* )page );
-		end		= start
-				  + me2fsGetPageLastByte( dir, page_index )
-				  - rec_len;
-		dent	= ( struct ext2_dir_entry* )start;
+		end		= start + me2fsGetPageLastByte( dir, page_index );
 
-		while( ( char* )dent <= end )
+		if( ( dent = me2fsScanDirEntries( dir, start, end, &scan ) ) )
 		{
-			unsigned long	d_rec_len;
-
-			if( dent->rec_len == 0 )
-			{
-				ME2FS_ERROR( "<ME2FS>%s:zero-length directoryentry\n", __func__ );
-				me2fsPutDirPageCache( page );
-				goto not_found;
-			}
-
-			if( me2fsStrncmp( namelen, name, dent ) )
-			{
-				goto found;
-			}
-
-			/* ---------------------------------------------------------------- */
-			/* go to next entry													*/
-			/* ---------------------------------------------------------------- */
-			d_rec_len	= le16_to_cpu( dent->rec_len );
-
-			dent = ( struct ext2_dir_entry* )( ( char* )dent + d_rec_len );
+			goto found;
 		}
 
 		me2fsPutDirPageCache( page );
@@ -253,7 +279,7 @@ int me2fsMakeEmpty( struct inode *inode, struct inode *parent )
 	/* get block size in file system											*/
 	block_size = inode->i_sb->s_blocksize;
 
-	if( ( err = prepareWriteBlock( page, 0, block_size ) ) )
+	if( ( err = me2fsPrepareWriteBlock( page, 0, block_size ) ) )
 	{
 		/* failed to prepare													*/
 		unlock_page( page );
@@ -273,7 +299,7 @@ int me2fsMakeEmpty( struct inode *inode, struct inode *parent )
 	dent->rec_len	= cpu_to_le16( ME2FS_DIR_REC_LEN( dent->name_len ) );
 	memcpy( dent->name, ".\0\0", 4 );
 	dent->inode = cpu_to_le32( inode->i_ino );
-	setDirEntryType( dent, inode );
+	me2fsSetDirEntryType( dent, inode );
 
 	/* -------------------------------------------------------------------------*/
 	/* make dot dot																*/
@@ -283,7 +309,7 @@ int me2fsMakeEmpty( struct inode *inode, struct inode *parent )
 	dent->rec_len	= cpu_to_le16( block_size - ME2FS_DIR_REC_LEN( 1 ) );
 	dent->inode		= cpu_to_le32( parent->i_ino );
 	memcpy( dent->name, "..\0", 4 );
-	setDirEntryType( dent, inode );
+	me2fsSetDirEntryType( dent, inode );
 
 
 	kunmap_atomic( start );
@@ -291,7 +317,7 @@ int me2fsMakeEmpty( struct inode *inode, struct inode *parent )
 	/* -------------------------------------------------------------------------*/
 	/* commit write block of empty contents										*/
 	/* -------------------------------------------------------------------------*/
-	err = commitBlockWrite( page, 0, block_size );
+	err = me2fsCommitBlockWrite( page, 0, block_size );
 
 	page_cache_release( page );
 
@@ -313,34 +339,85 @@ _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 */
 int me2fsAddLink( struct dentry *dentry, struct inode *inode )
 {
-	struct inode			*dir;
-	struct page				*page;
-	struct ext2_dir_entry	*dent;
-	const char				*link_name = dentry->d_name.name;
-	int						link_name_len;
-	unsigned long			block_size;
-	unsigned long			link_rec_len;
-	unsigned short			rec_len;
-	unsigned short			name_len;
-	unsigned long			page_index;
-	loff_t					pos;
-	int						err;
+	struct inode				*dir;
+	struct page					*page;
+	struct ext2_dir_entry		*dent;
+	const char					*link_name = dentry->d_name.name;
+	int							link_name_len;
+	unsigned long				block_size;
+	unsigned long				link_rec_len;
+	unsigned short				rec_len;
+	unsigned short				name_len;
+	unsigned long				page_index;
+	loff_t						pos;
+	int							err;
+	struct me2fs_dir_summary	*summary;
+	struct me2fs_dir_scan		scan;
 
 	dir				= dentry->d_parent->d_inode;
 	link_name_len	= dentry->d_name.len;
 	link_rec_len	= ME2FS_DIR_REC_LEN( link_name_len );
 
+	scan.name		= dentry->d_name.name;
+	scan.len		= link_name_len;
+	scan.need		= link_rec_len;
+	scan.find_live	= 0;
+
 	block_size		= dir->i_sb->s_blocksize;
 
+	/* ------------------------------------------------------------------------ */
+	/* add to the leaf which covers the hash of the name						*/
+	/* ------------------------------------------------------------------------ */
+	if( me2fsIsDxDir( dir ) )
+	{
+		err = me2fsDxAddLink( dentry, inode );
+
+		if( err != -EFSCORRUPTED )
+		{
+			return( err );
+		}
+
+		/* -------------------------------------------------------------------- */
+		/* the index is broken, stop using it and treat the directory as linear	*/
+		/* -------------------------------------------------------------------- */
+		ME2FS_I( dir )->i_flags &= ~EXT2_INDEX_FL;
+		mark_inode_dirty( dir );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* skip the blocks which are known to have no room for the entry. the vfs	*/
+	/* has already checked that the name does not exist under i_mutex			*/
+	/* ------------------------------------------------------------------------ */
+	page_index = 0;
+
+	if( ( summary = getDirSummary( dir ) ) )
+	{
+		unsigned long	block;
+		unsigned int	bucket;
+
+		/* every block on a bucket from the one of the record up has room		*/
+		bucket = find_next_bit( summary->gap_nonempty,
+								ME2FS_DIR_GAP_BUCKETS,
+								dirGapBucket( link_rec_len ) );
+
+		if( bucket < ME2FS_DIR_GAP_BUCKETS )
+		{
+			block = summary->gap_head[ bucket ];
+		}
+		else
+		{
+			block = summary->nr_blocks;
+		}
+
+		page_index = ( block << dir->i_blkbits ) >> PAGE_CACHE_SHIFT;
+	}
+
 	/* ------------------------------------------------------------------------ */
 	/* find entry space in the directory										*/
 	/* ------------------------------------------------------------------------ */
-	for( page_index = 0							;
-		 page_index <= getDirNumPages( dir )	;
-		 page_index++ )
+	for( ; page_index <= getDirNumPages( dir ) ; page_index++ )
 	{
 		char	*start;
-		char	*end;
 		char	*dir_end;
 
 		page = ( struct page* )me2fsGetDirPageCache( dir, page_index );
@@ -357,67 +434,53 @@ int me2fsAddLink( struct dentry *dentry, struct inode *inode )
 		start	= ( char* )page_address( ( const struct page* )page );
 		dir_end	= start
 				  + me2fsGetPageLastByte( dir, page_index );
-		dent	= ( struct ext2_dir_entry* )start;
-		
-		end		= start + PAGE_CACHE_SIZE - link_rec_len;
 
 		/* -------------------------------------------------------------------- */
 		/* find entry space in the page cache of the directory					*/
 		/* -------------------------------------------------------------------- */
-		while( ( char* )dent <= end )
+		if( ( dent = me2fsScanDirEntries( dir, start, dir_end, &scan ) ) )
 		{
-			if( ( char* )dent == dir_end )
-			{
-				/* ------------------------------------------------------------ */
-				/* reach i_size													*/
-				/* ------------------------------------------------------------ */
-				name_len		= 0;
-				rec_len			= block_size;
-				dent->rec_len	= cpu_to_le16( rec_len );
-				dent->inode		= 0;
-				
-				goto got_it;
-			}
-
-			/* ---------------------------------------------------------------- */
-			/* invalid entry													*/
-			/* ---------------------------------------------------------------- */
-			if( !dent->rec_len )
-			{
-				ME2FS_ERROR( "<ME2FS>%s:zero-length directory entry\n", __func__ );
-				err = -EIO;
-				goto out_unlock;
-			}
-
 			/* ---------------------------------------------------------------- */
 			/* the entry already exists											*/
 			/* ---------------------------------------------------------------- */
-			if( me2fsStrncmp( link_name_len, link_name, dent ) )
+			if( scan.found == ME2FS_SCAN_NAME )
 			{
 				err = -EEXIST;
 				goto out_unlock;
 			}
 
+			/* ---------------------------------------------------------------- */
+			/* found empty entry or room after a live entry						*/
+			/* ---------------------------------------------------------------- */
 			name_len	= ME2FS_DIR_REC_LEN( dent->name_len );
 			rec_len		= le16_to_cpu( dent->rec_len );
 
-			/* ---------------------------------------------------------------- */
-			/* found empty entry												*/
-			/* ---------------------------------------------------------------- */
-			if( !dent->inode && ( link_rec_len <= rec_len ) )
-			{
-				goto got_it;
-			}
+			goto got_it;
+		}
 
+		if( dir_end < ( start + PAGE_CACHE_SIZE ) )
+		{
 			/* ---------------------------------------------------------------- */
-			/* detected deteleted entry											*/
+			/* reach i_size														*/
 			/* ---------------------------------------------------------------- */
-			if( ( name_len + link_rec_len ) <= rec_len )
+			if( me2fsDxCanIndex( dir ) )
 			{
-				goto got_it;
+				/* ------------------------------------------------------------ */
+				/* the first block is full, build the index instead of growing	*/
+				/* the directory linearly										*/
+				/* ------------------------------------------------------------ */
+				unlock_page( page );
+				me2fsPutDirPageCache( page );
+				return( me2fsDxMakeIndexed( dentry, inode ) );
 			}
 
-			dent = ( struct ext2_dir_entry* )( ( char* )dent + rec_len );
+			dent			= ( struct ext2_dir_entry* )dir_end;
+			name_len		= 0;
+			rec_len			= block_size;
+			dent->rec_len	= cpu_to_le16( rec_len );
+			dent->inode		= 0;
+			
+			goto got_it;
 		}
 
 		unlock_page( page );
@@ -432,7 +495,7 @@ got_it:
 	pos = page_offset( page )
 		  + ( ( char* )dent - ( char* )page_address( page ) );
 	
-	if( ( err = prepareWriteBlock( page, pos, rec_len ) ) )
+	if( ( err = me2fsPrepareWriteBlock( page, pos, rec_len ) ) )
 	{
 		goto out_unlock;
 	}
@@ -456,12 +519,19 @@ got_it:
 	dent->name_len	= link_name_len;
 	memcpy( dent->name, link_name, link_name_len );
 	dent->inode		= cpu_to_le32( inode->i_ino );
-	setDirEntryType( dent, inode );
+	me2fsSetDirEntryType( dent, inode );
 
-	err = commitBlockWrite( page, pos, rec_len );
+	err = me2fsCommitBlockWrite( page, pos, rec_len );
+	me2fsDirSummaryUpdate( dir,
+						   page,
+						   ( char* )dent - ( char* )page_address( page ),
+						   1 );
 	dir->i_mtime = CURRENT_TIME_SEC;
 	dir->i_ctime = dir->i_mtime;
-	ME2FS_I( dir )->i_flags &= ~EXT2_BTREE_FL;
+	if( !me2fsHasDirIndex( dir->i_sb ) )
+	{
+		ME2FS_I( dir )->i_flags &= ~EXT2_BTREE_FL;
+	}
 	mark_inode_dirty( dir );
 	
 	me2fsPutDirPageCache( page );
@@ -489,16 +559,28 @@ _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 */
 int me2fsIsEmptyDir( struct inode *inode )
 {
-	struct page		*page;
-	unsigned long	i;
+	struct me2fs_dir_summary	*summary;
+	struct page					*page;
+	unsigned long				i;
+	struct me2fs_dir_scan		scan;
+
+	if( ( summary = getDirSummary( inode ) ) )
+	{
+		return( summary->nr_live == 0 );
+	}
 
+	/* ------------------------------------------------------------------------ */
+	/* no memory for the summary, scan the directory							*/
+	/* ------------------------------------------------------------------------ */
 	page			= NULL;
+	scan.len		= 0;
+	scan.need		= 0;
+	scan.find_live	= 1;
 
 	for( i = 0 ; i < getDirNumPages( inode ) ; i++ )
 	{
-		char					*start;
-		char					*end;
-		struct ext2_dir_entry	*dent;
+		char	*start;
+		char	*end;
 
 		page = me2fsGetDirPageCache( inode, i );
 
@@ -508,48 +590,17 @@ int me2fsIsEmptyDir( struct inode *inode )
 		}
 
 		start	= page_address( page );
-		dent	= ( struct ext2_dir_entry* )start;
-
-		end		= start + ( me2fsGetPageLastByte( inode, i )
-							- ME2FS_DIR_REC_LEN( 1 ) );
+		end		= start + me2fsGetPageLastByte( inode, i );
 
-		while( ( char* )dent <= end )
+		/* -------------------------------------------------------------------- */
+		/* index blocks are seen as empty entries								*/
+		/* -------------------------------------------------------------------- */
+		if( me2fsScanDirEntries( inode, start, end, &scan ) )
 		{
-			if( dent->rec_len == 0 )
-			{
-				ME2FS_ERROR( "<ME2FS>%s:zero-length directory entry\n",
-							 __func__ );
-			}
-
-			if( dent->inode != 0 )
-			{
-				if( dent->name[ 0 ] != '.' )
-				{
-					goto not_empty;
-				}
-				if( 2 < dent->name_len )
-				{
-					goto not_empty;
-				}
-				if( dent->name_len < 2 )
-				{
-					if( dent->inode != cpu_to_le32( inode->i_ino ) )
-					{
-						goto not_empty;
-					}
-				}
-				else if( dent->name[ 1 ] != '.' )
-				{
-					goto not_empty;
-				}
-
-				/* goto next entry												*/
-				dent = ( struct ext2_dir_entry* )
-							( ( char* )dent + le16_to_cpu( dent->rec_len ) );
-			}
-
-			me2fsPutDirPageCache( page );
+			goto not_empty;
 		}
+
+		me2fsPutDirPageCache( page );
 	}
 
 	return( 1 );
@@ -613,19 +664,33 @@ int me2fsDeleteDirEntry( struct ext2_dir_entry *dir, struct page *page )
 
 	pos = page_offset( page ) + from;
 	lock_page( page );
-	err = prepareWriteBlock( page, pos, to - from );
+	err = me2fsPrepareWriteBlock( page, pos, to - from );
 	if( pde )
 	{
 		pde->rec_len = le16_to_cpu( to - from );
 	}
 	dir->inode					= 0;
-	err							= commitBlockWrite( page, pos, to - from );
+	err							= me2fsCommitBlockWrite( page, pos, to - from );
+	me2fsDirSummaryUpdate( inode, page, from, -1 );
 	inode->i_mtime				= CURRENT_TIME_SEC;
 	inode->i_ctime				= inode->i_mtime;
-	ME2FS_I( inode )->i_flags	&= ~EXT2_BTREE_FL;
+
+	/* ------------------------------------------------------------------------ */
+	/* the index stays valid because leaves are never merged					*/
+	/* ------------------------------------------------------------------------ */
+	if( !me2fsHasDirIndex( inode->i_sb ) )
+	{
+		ME2FS_I( inode )->i_flags &= ~EXT2_BTREE_FL;
+	}
 
 	mark_inode_dirty( inode );
 
+	if( ( ME2FS_SB( inode->i_sb )->s_mount_opt & EXT2_MOUNT_DIR_COMPACT )
+		&& isDirSparse( inode ) )
+	{
+		me2fsQueueDirCompaction( inode );
+	}
+
 out:
 	me2fsPutDirPageCache( page );
 	return( err );
@@ -700,10 +765,10 @@ void me2fsSetLink( struct inode *dir,
 	len = le16_to_cpu( dent->rec_len );
 
 	lock_page( page );
-	err = prepareWriteBlock( page, pos, len );
+	err = me2fsPrepareWriteBlock( page, pos, len );
 	dent->inode = cpu_to_le32( inode->i_ino );
-	setDirEntryType( dent, inode );
-	err = commitBlockWrite( page, pos, len );
+	me2fsSetDirEntryType( dent, inode );
+	err = me2fsCommitBlockWrite( page, pos, len );
 	me2fsPutDirPageCache( page );
 
 	if( update_times )
@@ -712,7 +777,10 @@ void me2fsSetLink( struct inode *dir,
 		dir->i_ctime = dir->i_mtime;
 	}
 
-	ME2FS_I( dir )->i_flags &= ~EXT2_BTREE_FL;
+	if( !me2fsHasDirIndex( dir->i_sb ) )
+	{
+		ME2FS_I( dir )->i_flags &= ~EXT2_BTREE_FL;
+	}
 
 	mark_inode_dirty( dir );
 
@@ -720,90 +788,501 @@ void me2fsSetLink( struct inode *dir,
 }
 /*
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
-	Function	:void
-	Input		:void
+	Function	:me2fsGetDirPageCache
+	Input		:struct inode *inode
+				 < vfs inode of directory >
+				 unsigned long index
+				 < index of page cache >
 	Output		:void
-	Return		:void
+	Return		:struct page*
+				 < page to which logical block attributes >
 
-	Description	:void
+	Description	:get page cache of the directory
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 */
+struct page*
+me2fsGetDirPageCache( struct inode *inode, unsigned long index )
+{
+	struct page	*page;
 
-/*
-++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+	/* ------------------------------------------------------------------------ */
+	/* read blocks from device and map them										*/
+	/* ------------------------------------------------------------------------ */
+	/* find get a page from mapping if there is not allocated then alloc to it	*/
+	/* and fill it. if there is cached page then return it						*/
+	page = read_mapping_page( inode->i_mapping, index, NULL );
 
-	< Local Functions >
+	if( !IS_ERR( page ) )
+	{
+		kmap( page );
 
-++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
-*/
-/*
----------------------------------------------------------------------------------
+		/* -------------------------------------------------------------------- */
+		/* entries are validated once while the page stays in cache, so that	*/
+		/* scanners can walk them without checking each record					*/
+		/* -------------------------------------------------------------------- */
+		if( !PageChecked( page ) )
+		{
+			checkDirPage( inode, page );
+		}
 
-	File Operations for Directory
+		if( PageError( page ) )
+		{
+			me2fsPutDirPageCache( page );
+			return( ERR_PTR( -EIO ) );
+		}
+	}
 
----------------------------------------------------------------------------------
+	return( page );
+}
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsPutDirPageCache
+	Input		:struct page *page
+				 < page to put >
+	Output		:void
+	Return		:void
+
+	Description	:put page
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 */
+void me2fsPutDirPageCache( struct page *page )
+{
+	kunmap( page );
+	page_cache_release( page );
+}
 /*
-==================================================================================
-	Function	:me2fsReadDir
-	Input		:struct file *file
-				 < vfs file object >
-				 struct dir_context *ctx
-				 < context of reading directory >
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsSetDirEntryType
+	Input		:struct ext2_dir_entry *dent
+				 < directory entry >
+				 struct inode *inode
+				 < vfs inode >
 	Output		:void
 	Return		:void
 
-	Description	:void
-==================================================================================
+	Description	:set file type of vfs to ext2 directory entry
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 */
-static int me2fsReadDir( struct file *file, struct dir_context *ctx )
+void
+me2fsSetDirEntryType( struct ext2_dir_entry *dent, struct inode *inode )
 {
-	struct super_block		*sb;
-	struct inode			*inode;
-	unsigned long			offset;
-	unsigned long			page_index;
-	unsigned char			ftype_table[ EXT2_FT_MAX ] =
-	{
-		[ EXT2_FT_UNKNOWN	]	= DT_UNKNOWN,
-		[ EXT2_FT_REG_FILE	]	= DT_REG,
-		[ EXT2_FT_DIR		]	= DT_DIR,
-		[ EXT2_FT_CHRDEV	]	= DT_CHR,
-		[ EXT2_FT_BLKDEV	]	= DT_BLK,
-		[ EXT2_FT_FIFO		]	= DT_FIFO,
-		[ EXT2_FT_SOCK		]	= DT_SOCK,
-		[ EXT2_FT_SYMLINK	]	= DT_LNK,
-	};
+	struct me2fs_sb_info	*msi;
+	umode_t					mode;
 
-	inode = file_inode( file );
+	mode	= inode->i_mode;
+	msi		= ME2FS_SB( inode->i_sb );
 
-	/* ------------------------------------------------------------------------ */
-	/* whether position exceeds last of mininum dir entry or not				*/
-	/* ------------------------------------------------------------------------ */
-	if( ( inode->i_size - ( 1 + 8 + 3 ) ) < ctx->pos )
+	if( msi->s_esb->s_feature_incompat
+		& cpu_to_le32( EXT2_FEATURE_INCOMPAT_FILETYPE ) )
 	{
-		/* there is no more entry in the directory								*/
-		return( 0 );
+		dent->file_type = me2fs_type_by_mode[ ( mode & S_IFMT ) >> S_SHIFT ];
 	}
-
-	sb		= inode->i_sb;
-	offset	= ctx->pos & ~PAGE_CACHE_MASK;
-
-	for( page_index = ctx->pos >> PAGE_CACHE_SHIFT	;
-		 page_index < getDirNumPages( inode )		;
-		 page_index++ )
+	else
 	{
-		struct page				*page;
-		struct ext2_dir_entry	*dent;
-		char					*start;
+		dent->file_type = 0;
+	}
+}
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsPrepareWriteBlock
+	Input		:struct page *page
+				 < page of file >
+				 loff_t pos
+				 < position in file >
+				 unsigned long len
+				 < length of write data >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:prepare to write a block
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int
+me2fsPrepareWriteBlock( struct page *page, loff_t pos, unsigned long len )
+{
+	return( __block_write_begin( page, pos, ( unsigned )len, me2fsGetBlock ) );
+}
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsCommitBlockWrite
+	Input		:struct page *page
+				 < page of file >
+				 loff_t pos
+				 < offset in file >
+				 unsigned long len
+				 < length to commit >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:commit block write
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsCommitBlockWrite( struct page *page, loff_t pos, unsigned long len )
+{
+	struct address_space	*mapping;
+	struct inode			*dir;
+	int						err;
+
+	mapping	= page->mapping;
+	dir		= mapping->host;
+	err		= 0;
+
+	/* ------------------------------------------------------------------------ */
+	/* commit block write														*/
+	/* ------------------------------------------------------------------------ */
+	block_write_end( NULL, mapping, pos, len, len, page, NULL );
+
+	if( dir->i_size < ( pos + len ) )
+	{
+		i_size_write( dir, pos + len );
+		mark_inode_dirty( dir );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* sync file and inode														*/
+	/* ------------------------------------------------------------------------ */
+	if( IS_DIRSYNC( dir ) )
+	{
+		if( !( err = write_one_page( page, 1 ) ) )
+		{
+			err = sync_inode_metadata( dir, 1 );
+		}
+	}
+	else
+	{
+		unlock_page( page );
+	}
+
+	return( err );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsScanDirEntries
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 char *start
+				 < first entry to scan >
+				 char *end
+				 < end of entries to scan >
+				 struct me2fs_dir_scan *scan
+				 < query and output >
+	Output		:struct me2fs_dir_scan *scan
+				 < kind of found entry and summary of scanned entries >
+	Return		:struct ext2_dir_entry*
+				 < first entry which satisfies the query, or NULL >
+
+	Description	:scan directory entries of a page which has been checked
+				 by me2fsGetDirPageCache
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+struct ext2_dir_entry*
+me2fsScanDirEntries( struct inode *dir,
+					 char *start,
+					 char *end,
+					 struct me2fs_dir_scan *scan )
+{
+	struct ext2_dir_entry	*dent;
+	unsigned short			rec_len;
+	unsigned short			gap;
+	__le32					self;
+
+	self			= cpu_to_le32( dir->i_ino );
+	scan->found		= ME2FS_SCAN_NONE;
+	scan->max_gap	= 0;
+	scan->nr_live	= 0;
+
+	for( dent = ( struct ext2_dir_entry* )start								;
+		 ( char* )dent < end													;
+		 dent = ( struct ext2_dir_entry* )( ( char* )dent + rec_len ) )
+	{
+		rec_len = le16_to_cpu( dent->rec_len );
+
+		if( !dent->inode )
+		{
+			gap = rec_len;
+		}
+		else
+		{
+			/* ---------------------------------------------------------------- */
+			/* compare lengths first, most names differ in length				*/
+			/* ---------------------------------------------------------------- */
+			if( ( dent->name_len == scan->len )
+				&& isSameName( dent->name, scan->name, scan->len ) )
+			{
+				scan->found = ME2FS_SCAN_NAME;
+				return( dent );
+			}
+
+			gap = rec_len - ME2FS_DIR_REC_LEN( dent->name_len );
+
+			/* ---------------------------------------------------------------- */
+			/* dot and dot dot do not make the directory non-empty				*/
+			/* ---------------------------------------------------------------- */
+			if( ( dent->name[ 0 ] != '.' )
+				|| ( 2 < dent->name_len )
+				|| ( ( dent->name_len == 1 ) && ( dent->inode != self ) )
+				|| ( ( dent->name_len == 2 ) && ( dent->name[ 1 ] != '.' ) ) )
+			{
+				scan->nr_live++;
+
+				if( scan->find_live )
+				{
+					scan->found = ME2FS_SCAN_LIVE;
+					return( dent );
+				}
+			}
+		}
+
+		if( scan->max_gap < gap )
+		{
+			scan->max_gap = gap;
+		}
+
+		if( scan->need && ( scan->need <= gap ) )
+		{
+			scan->found = ME2FS_SCAN_ROOM;
+			return( dent );
+		}
+	}
+
+	return( NULL );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDirSummaryUpdate
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 struct page *page
+				 < mapped page cache which contains the modified block >
+				 unsigned long offset
+				 < offset in the page of the modification >
+				 int live
+				 < change of the number of live entries >
+	Output		:void
+	Return		:void
+
+	Description	:refresh the summary entry of a modified directory block
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDirSummaryUpdate( struct inode *dir,
+							struct page *page,
+							unsigned long offset,
+							int live )
+{
+	struct me2fs_dir_summary	*summary;
+	unsigned long				block;
+	unsigned long				nr_blocks;
+	struct me2fs_dir_scan		scan;
+	char						*start;
+
+	if( !( summary = ME2FS_I( dir )->i_dir_summary ) )
+	{
+		return;
+	}
+
+	offset		&= ~( dir->i_sb->s_blocksize - 1 );
+	block		= ( page_offset( page ) + offset ) >> dir->i_blkbits;
+	nr_blocks	= dir->i_size >> dir->i_blkbits;
+
+	/* ------------------------------------------------------------------------ */
+	/* only a block appended by this modification can be summarized here.		*/
+	/* other blocks of unknown contents make the summary stale					*/
+	/* ------------------------------------------------------------------------ */
+	if( nr_blocks != summary->nr_blocks )
+	{
+		if( ( nr_blocks != ( summary->nr_blocks + 1 ) )
+			|| ( block != summary->nr_blocks ) )
+		{
+			goto drop;
+		}
+
+		if( summary->nr_alloc < nr_blocks )
+		{
+			if( resizeDirSummary( summary, summary->nr_alloc * 2 ) )
+			{
+				goto drop;
+			}
+		}
+
+		summary->nr_blocks			= nr_blocks;
+		summary->max_gap[ block ]	= 0;
+		linkGapBlock( summary, block );
+	}
+
+	if( summary->max_gap[ block ] == dir->i_sb->s_blocksize )
+	{
+		summary->nr_empty--;
+	}
+
+	unlinkGapBlock( summary, block );
+
+	start			= ( char* )page_address( page ) + offset;
+	scan.len		= 0;
+	scan.need		= 0;
+	scan.find_live	= 0;
+
+	me2fsScanDirEntries( dir, start, start + dir->i_sb->s_blocksize, &scan );
+
+	summary->max_gap[ block ] = scan.max_gap;
+	linkGapBlock( summary, block );
+
+	if( summary->max_gap[ block ] == dir->i_sb->s_blocksize )
+	{
+		summary->nr_empty++;
+	}
+
+	summary->nr_live += live;
+
+	return;
+
+drop:
+	me2fsDirSummaryDrop( dir );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDirSummaryDrop
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+	Output		:void
+	Return		:void
+
+	Description	:release the summary of a directory. it is built again
+				 on demand
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDirSummaryDrop( struct inode *dir )
+{
+	struct me2fs_dir_summary	*summary;
+
+	summary							= ME2FS_I( dir )->i_dir_summary;
+	ME2FS_I( dir )->i_dir_summary	= NULL;
+
+	if( summary )
+	{
+		freeDirSummary( summary );
+	}
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:void
+	Input		:void
+	Output		:void
+	Return		:void
+
+	Description	:void
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Local Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+---------------------------------------------------------------------------------
+
+	File Operations for Directory
+
+---------------------------------------------------------------------------------
+*/
+/*
+==================================================================================
+	Function	:me2fsReadDir
+	Input		:struct file *file
+				 < vfs file object >
+				 struct dir_context *ctx
+				 < context of reading directory >
+	Output		:void
+	Return		:void
+
+	Description	:void
+==================================================================================
+*/
+static int me2fsReadDir( struct file *file, struct dir_context *ctx )
+{
+	struct super_block		*sb;
+	struct inode			*inode;
+	unsigned long			offset;
+	unsigned long			page_index;
+	unsigned long			*inos;
+	int						nr_inos;
+	int						ret;
+	unsigned char			ftype_table[ EXT2_FT_MAX ] =
+	{
+		[ EXT2_FT_UNKNOWN	]	= DT_UNKNOWN,
+		[ EXT2_FT_REG_FILE	]	= DT_REG,
+		[ EXT2_FT_DIR		]	= DT_DIR,
+		[ EXT2_FT_CHRDEV	]	= DT_CHR,
+		[ EXT2_FT_BLKDEV	]	= DT_BLK,
+		[ EXT2_FT_FIFO		]	= DT_FIFO,
+		[ EXT2_FT_SOCK		]	= DT_SOCK,
+		[ EXT2_FT_SYMLINK	]	= DT_LNK,
+	};
+
+	inode = file_inode( file );
+
+	/* ------------------------------------------------------------------------ */
+	/* whether position exceeds last of mininum dir entry or not				*/
+	/* ------------------------------------------------------------------------ */
+	if( ( inode->i_size - ( 1 + 8 + 3 ) ) < ctx->pos )
+	{
+		/* there is no more entry in the directory								*/
+		return( 0 );
+	}
+
+	sb		= inode->i_sb;
+	offset	= ctx->pos & ~PAGE_CACHE_MASK;
+	ret		= 0;
+
+	/* ------------------------------------------------------------------------ */
+	/* positions of this stream are offsets in the directory, which must not	*/
+	/* be moved by compaction until the stream is released						*/
+	/* ------------------------------------------------------------------------ */
+	if( !file->private_data )
+	{
+		file->private_data = ME2FS_I( inode );
+		atomic_inc( &ME2FS_I( inode )->i_dir_streams );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* inode numbers emitted from a page. stat usually follows readdir, so		*/
+	/* their inode table blocks are read ahead. no prefetch without memory		*/
+	/* ------------------------------------------------------------------------ */
+	inos	= ( unsigned long* )__get_free_page( GFP_KERNEL );
+	nr_inos	= 0;
+
+	/* ------------------------------------------------------------------------ */
+	/* an indexed directory is read in block order as well. its index blocks	*/
+	/* are seen as empty entries, so positions stay plain byte offsets			*/
+	/* ------------------------------------------------------------------------ */
+
+	for( page_index = ctx->pos >> PAGE_CACHE_SHIFT	;
+		 page_index < getDirNumPages( inode )		;
+		 page_index++ )
+	{
+		struct page				*page;
+		struct ext2_dir_entry	*dent;
+		char					*start;
 		char					*end;
 
+		readaheadDirPages( inode, &file->f_ra, file, page_index );
+
 		page = ( struct page* )me2fsGetDirPageCache( inode, page_index );
 
 		if( IS_ERR( page ) )
 		{
 			ME2FS_ERROR( "<ME2FS>bad page in %lu\n", inode->i_ino );
 			ctx->pos += PAGE_CACHE_SIZE - offset;
-			return( PTR_ERR( page ) );
+			ret = PTR_ERR( page );
+			goto out;
 		}
 
 		start	= ( char* )page_address( ( const struct page* )page );
@@ -821,7 +1300,8 @@ static int me2fsReadDir( struct file *file, struct dir_context *ctx )
 			{
 				ME2FS_ERROR( "<ME2FS>error:zero-length directory entry\n" );
 				me2fsPutDirPageCache( page );
-				return( -EIO );
+				ret = -EIO;
+				goto out;
 			}
 
 			if( dent->inode )
@@ -841,270 +1321,659 @@ static int me2fsReadDir( struct file *file, struct dir_context *ctx )
 				{
 					break;
 				}
+
+				if( inos && ( nr_inos < PREFETCH_INOS ) )
+				{
+					inos[ nr_inos++ ] = le32_to_cpu( dent->inode );
+				}
+			}
+
+			/* ---------------------------------------------------------------- */
+			/* go to next entry													*/
+			/* ---------------------------------------------------------------- */
+			rec_len	= le16_to_cpu( dent->rec_len );
+
+			ctx->pos+= rec_len;
+			dent	= ( struct ext2_dir_entry* )( ( char* )dent + rec_len );
+		}
+
+		me2fsPutDirPageCache( page );
+
+		me2fsPrefetchInodeTables( sb, inos, nr_inos );
+		nr_inos = 0;
+	}
+
+out:
+	if( inos )
+	{
+		free_page( ( unsigned long )inos );
+	}
+
+	return( ret );
+}
+
+/*
+==================================================================================
+	Function	:me2fsReleaseDir
+	Input		:struct inode *inode
+				 < vfs inode of directory >
+				 struct file *file
+				 < vfs file object >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:unregister a readdir stream of the directory
+==================================================================================
+*/
+static int me2fsReleaseDir( struct inode *inode, struct file *file )
+{
+	if( file->private_data )
+	{
+		if( atomic_dec_and_test( &ME2FS_I( inode )->i_dir_streams ) )
+		{
+			me2fsResumeDirCompaction( inode );
+		}
+	}
+
+	return( 0 );
+}
+/*
+---------------------------------------------------------------------------------
+
+	Helper Functions for Directory
+
+---------------------------------------------------------------------------------
+*/
+/*
+==================================================================================
+	Function	:getDirNumPages
+	Input		:struct inode *inode
+				 < vfs inode of a directory >
+	Output		:void
+	Return		:unsigned long
+				 < number of pages to be cached for directory >
+
+	Description	:get number of pages to be cached for directory
+==================================================================================
+*/
+static inline unsigned long getDirNumPages( struct inode *inode )
+{
+	return( ( inode->i_size + PAGE_CACHE_SIZE - 1 ) >> PAGE_CACHE_SHIFT );
+}
+
+/*
+==================================================================================
+	Function	:me2fsGetPageLastByte
+	Input		:struct inode *inode
+				 < vfs inode >
+				 unsigned long page_nr
+				 < page number >
+	Output		:void
+	Return		:unsigned long
+				 < last byte in that page >
+
+	Description	:return the offset int page `page_nr' of the last valid
+				 byte in that page, plus one.
+==================================================================================
+*/
+static unsigned long
+me2fsGetPageLastByte( struct inode *inode, unsigned long page_nr )
+{
+	unsigned long	last_byte;
+
+	last_byte = inode->i_size - ( page_nr << PAGE_CACHE_SHIFT );
+
+	if( last_byte > PAGE_CACHE_SIZE )
+	{
+		return( PAGE_CACHE_SIZE );
+	}
+
+	return( last_byte );
+}
+
+/*
+==================================================================================
+	Function	:getDirSummary
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+	Output		:void
+	Return		:struct me2fs_dir_summary*
+				 < summary of the directory, NULL if not available >
+
+	Description	:get the summary of a directory. build it by reading all
+				 blocks of the directory if it has not been built yet
+==================================================================================
+*/
+static struct me2fs_dir_summary *getDirSummary( struct inode *dir )
+{
+	struct me2fs_dir_summary	*summary;
+	struct page					*page;
+	unsigned long				nr_blocks;
+	unsigned long				blocks_per_page;
+	unsigned long				block;
+	struct me2fs_dir_scan		scan;
+
+	nr_blocks = dir->i_size >> dir->i_blkbits;
+
+	if( ( summary = ME2FS_I( dir )->i_dir_summary ) )
+	{
+		if( summary->nr_blocks == nr_blocks )
+		{
+			return( summary );
+		}
+
+		me2fsDirSummaryDrop( dir );
+	}
+
+	if( !( summary = kmalloc( sizeof( *summary ), GFP_NOFS ) ) )
+	{
+		return( NULL );
+	}
+
+	summary->nr_blocks	= nr_blocks;
+	summary->nr_alloc	= 0;
+	summary->nr_live	= 0;
+	summary->nr_empty	= 0;
+	summary->max_gap	= NULL;
+	summary->gap_next	= NULL;
+	summary->gap_prev	= NULL;
+	memset( summary->gap_head, 0xFF, sizeof( summary->gap_head ) );
+	bitmap_zero( summary->gap_nonempty, ME2FS_DIR_GAP_BUCKETS );
+
+	if( resizeDirSummary( summary, nr_blocks ? nr_blocks : 1 ) )
+	{
+		freeDirSummary( summary );
+		return( NULL );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* scan all blocks of the directory											*/
+	/* ------------------------------------------------------------------------ */
+	blocks_per_page	= PAGE_CACHE_SIZE >> dir->i_blkbits;
+	page			= NULL;
+	scan.len		= 0;
+	scan.need		= 0;
+	scan.find_live	= 0;
+
+	for( block = 0 ; block < nr_blocks ; block++ )
+	{
+		char	*start;
+
+		if( !( block % blocks_per_page ) )
+		{
+			if( page )
+			{
+				me2fsPutDirPageCache( page );
+			}
+
+			page = me2fsGetDirPageCache( dir, block / blocks_per_page );
+
+			if( IS_ERR( page ) )
+			{
+				page = NULL;
+				goto error;
 			}
+		}
 
-			/* ---------------------------------------------------------------- */
-			/* go to next entry													*/
-			/* ---------------------------------------------------------------- */
-			rec_len	= le16_to_cpu( dent->rec_len );
+		start = ( char* )page_address( page )
+				+ ( ( block % blocks_per_page ) << dir->i_blkbits );
 
-			ctx->pos+= rec_len;
-			dent	= ( struct ext2_dir_entry* )( ( char* )dent + rec_len );
+		me2fsScanDirEntries( dir, start, start + dir->i_sb->s_blocksize, &scan );
+
+		summary->max_gap[ block ]	= scan.max_gap;
+		summary->nr_live			+= scan.nr_live;
+		linkGapBlock( summary, block );
+
+		if( summary->max_gap[ block ] == dir->i_sb->s_blocksize )
+		{
+			summary->nr_empty++;
 		}
+	}
 
+	if( page )
+	{
 		me2fsPutDirPageCache( page );
 	}
 
-	return( 0 );
-}
-/*
----------------------------------------------------------------------------------
+	ME2FS_I( dir )->i_dir_summary = summary;
 
-	Helper Functions for Directory
+	return( summary );
 
----------------------------------------------------------------------------------
-*/
-/*
-==================================================================================
-	Function	:getDirNumPages
-	Input		:struct inode *inode
-				 < vfs inode of a directory >
-	Output		:void
-	Return		:unsigned long
-				 < number of pages to be cached for directory >
+error:
+	if( page )
+	{
+		me2fsPutDirPageCache( page );
+	}
 
-	Description	:get number of pages to be cached for directory
-==================================================================================
-*/
-static inline unsigned long getDirNumPages( struct inode *inode )
-{
-	return( ( inode->i_size + PAGE_CACHE_SIZE - 1 ) >> PAGE_CACHE_SHIFT );
+	freeDirSummary( summary );
+
+	return( NULL );
 }
 
 /*
 ==================================================================================
-	Function	:me2fsGetDirPageCache
-	Input		:struct inode *inode
-				 < vfs inode of directory >
-				 unsigned long index
-				 < index of page cache >
+	Function	:resizeDirSummary
+	Input		:struct me2fs_dir_summary *summary
+				 < summary of a directory >
+				 unsigned long nr_alloc
+				 < number of blocks to make room for >
 	Output		:void
-	Return		:struct page*
-				 < page to which logical block attributes >
+	Return		:int
+				 < result >
 
-	Description	:get page cache of the directory
+	Description	:grow the per block arrays of a summary
 ==================================================================================
 */
-static struct page*
-me2fsGetDirPageCache( struct inode *inode, unsigned long index )
+static int
+resizeDirSummary( struct me2fs_dir_summary *summary, unsigned long nr_alloc )
 {
-	struct page	*page;
+	unsigned short	*max_gap;
+	unsigned int	*gap_next;
+	unsigned int	*gap_prev;
 
-	/* ------------------------------------------------------------------------ */
-	/* read blocks from device and map them										*/
-	/* ------------------------------------------------------------------------ */
-	/* find get a page from mapping if there is not allocated then alloc to it	*/
-	/* and fill it. if there is cached page then return it						*/
-	page = read_mapping_page( inode->i_mapping, index, NULL );
+	max_gap = krealloc( summary->max_gap,
+						nr_alloc * sizeof( *max_gap ),
+						GFP_NOFS | __GFP_NOWARN );
 
-	if( !IS_ERR( page ) )
+	if( !max_gap )
 	{
-		kmap( page );
-		/* Actually linux ext2 module verifies page at here */
-		if( PageError( page ) )
-		{
-			me2fsPutDirPageCache( page );
-			return( ERR_PTR( -EIO ) );
-		}
+		return( -ENOMEM );
 	}
 
-	return( page );
+	summary->max_gap = max_gap;
+
+	gap_next = krealloc( summary->gap_next,
+						 nr_alloc * sizeof( *gap_next ),
+						 GFP_NOFS | __GFP_NOWARN );
+
+	if( !gap_next )
+	{
+		return( -ENOMEM );
+	}
+
+	summary->gap_next = gap_next;
+
+	gap_prev = krealloc( summary->gap_prev,
+						 nr_alloc * sizeof( *gap_prev ),
+						 GFP_NOFS | __GFP_NOWARN );
+
+	if( !gap_prev )
+	{
+		return( -ENOMEM );
+	}
+
+	summary->gap_prev	= gap_prev;
+	summary->nr_alloc	= nr_alloc;
+
+	return( 0 );
 }
 
 /*
 ==================================================================================
-	Function	:me2fsPutDirPageCache
-	Input		:struct page *page
-				 < page to put >
+	Function	:freeDirSummary
+	Input		:struct me2fs_dir_summary *summary
+				 < summary of a directory >
 	Output		:void
 	Return		:void
 
-	Description	:put page
+	Description	:free a summary and its per block arrays
 ==================================================================================
 */
-static inline void me2fsPutDirPageCache( struct page *page )
+static void freeDirSummary( struct me2fs_dir_summary *summary )
 {
-	kunmap( page );
-	page_cache_release( page );
+	kfree( summary->gap_prev );
+	kfree( summary->gap_next );
+	kfree( summary->max_gap );
+	kfree( summary );
 }
+
 /*
 ==================================================================================
-	Function	:me2fsGetPageLastByte
-	Input		:struct inode *inode
-				 < vfs inode >
-				 unsigned long page_nr
-				 < page number >
+	Function	:dirGapBucket
+	Input		:unsigned short gap
+				 < largest free gap of a block, or room needed >
 	Output		:void
-	Return		:unsigned long
-				 < last byte in that page >
+	Return		:unsigned int
+				 < bucket of the gap >
 
-	Description	:return the offset int page `page_nr' of the last valid
-				 byte in that page, plus one.
+	Description	:get the bucket of a gap. a record fits in every block on
+				 the bucket of its length and above, as lengths are in 4
+				 bytes
 ==================================================================================
 */
-static unsigned long
-me2fsGetPageLastByte( struct inode *inode, unsigned long page_nr )
+static inline unsigned int dirGapBucket( unsigned short gap )
 {
-	unsigned long	last_byte;
+	return( min_t( unsigned int, gap >> 2, ME2FS_DIR_GAP_BUCKETS - 1 ) );
+}
 
-	last_byte = inode->i_size - ( page_nr << PAGE_CACHE_SHIFT );
+/*
+==================================================================================
+	Function	:linkGapBlock
+	Input		:struct me2fs_dir_summary *summary
+				 < summary of a directory >
+				 unsigned long block
+				 < block whose max_gap is set >
+	Output		:void
+	Return		:void
 
-	if( last_byte > PAGE_CACHE_SIZE )
+	Description	:link a block on the bucket of its largest gap
+==================================================================================
+*/
+static void
+linkGapBlock( struct me2fs_dir_summary *summary, unsigned long block )
+{
+	unsigned int	bucket;
+	unsigned int	head;
+
+	bucket	= dirGapBucket( summary->max_gap[ block ] );
+	head	= summary->gap_head[ bucket ];
+
+	summary->gap_prev[ block ]	= ME2FS_DIR_NO_BLOCK;
+	summary->gap_next[ block ]	= head;
+
+	if( head != ME2FS_DIR_NO_BLOCK )
 	{
-		return( PAGE_CACHE_SIZE );
+		summary->gap_prev[ head ] = block;
 	}
 
-	return( last_byte );
+	summary->gap_head[ bucket ] = block;
+	set_bit( bucket, summary->gap_nonempty );
 }
+
 /*
 ==================================================================================
-	Function	:me2fsStrncmp
-	Input		:int len
-				 < length of name >
-				 const char* const name
-				 < name of comparison >
-				 struct ext2_dir_entry *dent
-				 < directory entry to be compared >
+	Function	:unlinkGapBlock
+	Input		:struct me2fs_dir_summary *summary
+				 < summary of a directory >
+				 unsigned long block
+				 < block linked by its current max_gap >
 	Output		:void
 	Return		:void
 
-	Description	:compare name and name of direcotry entry
-				 < 0 : mismatch, 1 : match >
+	Description	:unlink a block from the bucket of its largest gap
 ==================================================================================
 */
-static inline int
-me2fsStrncmp( int len, const char* const name, struct ext2_dir_entry *dent )
+static void
+unlinkGapBlock( struct me2fs_dir_summary *summary, unsigned long block )
 {
-	if( len != dent->name_len )
+	unsigned int	bucket;
+	unsigned int	next;
+	unsigned int	prev;
+
+	bucket	= dirGapBucket( summary->max_gap[ block ] );
+	next	= summary->gap_next[ block ];
+	prev	= summary->gap_prev[ block ];
+
+	if( prev != ME2FS_DIR_NO_BLOCK )
 	{
-		return( 0 );
+		summary->gap_next[ prev ] = next;
 	}
-	
-	if( !dent->inode )
+	else
 	{
-		return( 0 );
+		summary->gap_head[ bucket ] = next;
+	}
+
+	if( next != ME2FS_DIR_NO_BLOCK )
+	{
+		summary->gap_prev[ next ] = prev;
 	}
 
-	return( !memcmp( name, dent->name, len ) );
+	if( summary->gap_head[ bucket ] == ME2FS_DIR_NO_BLOCK )
+	{
+		clear_bit( bucket, summary->gap_nonempty );
+	}
 }
+
 /*
 ==================================================================================
-	Function	:setDirEntryType
-	Input		:struct ext2_dir_entry *dent
-				 < directory entry >
-				 struct inode *inode
-				 < vfs inode >
+	Function	:checkDirPage
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 struct page *page
+				 < page cache of the directory >
 	Output		:void
 	Return		:void
 
-	Description	:set file type of vfs to ext2 directory entry
+	Description	:validate all entries of a page up to i_size. the page is
+				 marked checked, and marked error as well if it is broken
 ==================================================================================
 */
-static inline void
-setDirEntryType( struct ext2_dir_entry *dent, struct inode *inode )
+static void checkDirPage( struct inode *dir, struct page *page )
 {
-	struct me2fs_sb_info	*msi;
-	umode_t					mode;
+	struct super_block		*sb;
+	struct ext2_dir_entry	*dent;
+	char					*kaddr;
+	const char				*reason;
+	unsigned long			block_size;
+	unsigned long			limit;
+	unsigned long			offs;
+	unsigned long			rec_len;
+	unsigned long			max_ino;
 
-	mode	= inode->i_mode;
-	msi		= ME2FS_SB( inode->i_sb );
+	sb			= dir->i_sb;
+	kaddr		= page_address( page );
+	block_size	= sb->s_blocksize;
+	max_ino		= le32_to_cpu( ME2FS_SB( sb )->s_esb->s_inodes_count );
+	limit		= PAGE_CACHE_SIZE;
+	dent		= ( struct ext2_dir_entry* )kaddr;
+	rec_len		= 0;
 
-	if( msi->s_esb->s_feature_incompat
-		& cpu_to_le32( EXT2_FEATURE_INCOMPAT_FILETYPE ) )
+	if( ( dir->i_size >> PAGE_CACHE_SHIFT ) == page->index )
 	{
-		dent->file_type = me2fs_type_by_mode[ ( mode & S_IFMT ) >> S_SHIFT ];
+		limit = dir->i_size & ~PAGE_CACHE_MASK;
+
+		if( limit & ( block_size - 1 ) )
+		{
+			reason	= "size of directory is not a multiple of block size";
+			offs	= 0;
+			goto bad_entry;
+		}
 	}
-	else
+
+	for( offs = 0 ; offs < limit ; offs += rec_len )
 	{
-		dent->file_type = 0;
+		dent	= ( struct ext2_dir_entry* )( kaddr + offs );
+		rec_len	= le16_to_cpu( dent->rec_len );
+
+		if( rec_len < ME2FS_DIR_REC_LEN( 1 ) )
+		{
+			reason = "rec_len is smaller than minimal";
+			goto bad_entry;
+		}
+
+		if( rec_len & 3 )
+		{
+			reason = "unaligned directory entry";
+			goto bad_entry;
+		}
+
+		if( rec_len < ME2FS_DIR_REC_LEN( dent->name_len ) )
+		{
+			reason = "rec_len is too small for name_len";
+			goto bad_entry;
+		}
+
+		if( ( ( offs + rec_len - 1 ) ^ offs ) & ~( block_size - 1 ) )
+		{
+			reason = "directory entry across blocks";
+			goto bad_entry;
+		}
+
+		if( max_ino < le32_to_cpu( dent->inode ) )
+		{
+			reason = "inode out of bounds";
+			goto bad_entry;
+		}
+
+		if( dent->inode && !dent->name_len )
+		{
+			reason = "zero-length name";
+			goto bad_entry;
+		}
 	}
+
+	SetPageChecked( page );
+	return;
+
+bad_entry:
+	ME2FS_ERROR( "<ME2FS>%s:bad entry in directory #%lu: %s - "
+				 "offset=%lu, inode=%lu, rec_len=%lu, name_len=%d\n",
+				 __func__, dir->i_ino, reason,
+				 ( page->index << PAGE_CACHE_SHIFT ) + offs,
+				 ( unsigned long )le32_to_cpu( dent->inode ),
+				 rec_len, dent->name_len );
+	SetPageChecked( page );
+	SetPageError( page );
 }
 
 /*
 ==================================================================================
-	Function	:prepareWriteBlock
-	Input		:struct page *page
-				 < page of file >
-				 loff_t pos
-				 < position in file >
-				 unsigned long len
-				 < length of write data >
+	Function	:isSameName
+	Input		:const unsigned char *name1
+				 < name to compare >
+				 const unsigned char *name2
+				 < name to compare >
+				 int len
+				 < length of both names >
 	Output		:void
 	Return		:int
-				 < result >
+				 < 0:differ 1:same >
 
-	Description	:prepare to write a block
+	Description	:compare names a word at a time, then the rest a byte at
+				 a time. names need not be aligned
 ==================================================================================
 */
 static inline int
-prepareWriteBlock( struct page *page, loff_t pos, unsigned long len )
+isSameName( const unsigned char *name1, const unsigned char *name2, int len )
 {
-	return( __block_write_begin( page, pos, ( unsigned )len, me2fsGetBlock ) );
+	while( sizeof( unsigned long ) <= len )
+	{
+		if( get_unaligned( ( const unsigned long* )name1 )
+			!= get_unaligned( ( const unsigned long* )name2 ) )
+		{
+			return( 0 );
+		}
+
+		name1	+= sizeof( unsigned long );
+		name2	+= sizeof( unsigned long );
+		len		-= sizeof( unsigned long );
+	}
+
+	while( len-- )
+	{
+		if( *name1++ != *name2++ )
+		{
+			return( 0 );
+		}
+	}
+
+	return( 1 );
 }
 
 /*
 ==================================================================================
-	Function	:commitBlockWrite
-	Input		:struct page *page
-				 < page of file >
-				 loff_t pos
-				 < offset in file >
-				 unsigned long len
-				 < length to commit >
+	Function	:isDirSparse
+	Input		:struct inode *dir
+				 < vfs inode of directory >
 	Output		:void
 	Return		:int
-				 < result >
+				 < 0:keep 1:worth compacting >
 
-	Description	:commit block write
+	Description	:test whether half or more of the blocks of a linear
+				 directory hold no live entry
+==================================================================================
+*/
+static int isDirSparse( struct inode *dir )
+{
+	struct me2fs_dir_summary	*summary;
+
+	/* indexed directories are compacted only on request						*/
+	if( ME2FS_I( dir )->i_flags & EXT2_INDEX_FL )
+	{
+		return( 0 );
+	}
+
+	if( !( summary = getDirSummary( dir ) ) )
+	{
+		return( 0 );
+	}
+
+	return( ( DIR_COMPACT_MIN_BLOCKS <= summary->nr_blocks )
+			&& ( summary->nr_blocks <= ( summary->nr_empty * 2 ) ) );
+}
+
+/*
+==================================================================================
+	Function	:readaheadDirPages
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 struct file_ra_state *ra
+				 < readahead state >
+				 struct file *file
+				 < file of the directory, NULL for lookup >
+				 unsigned long index
+				 < index of the page to be read next >
+	Output		:void
+	Return		:void
+
+	Description	:start asynchronous read of the pages following index so
+				 that a sequential scan of a cold directory does not wait
+				 for each page
 ==================================================================================
 */
-static int commitBlockWrite( struct page *page, loff_t pos, unsigned long len )
+static void readaheadDirPages( struct inode *dir,
+							   struct file_ra_state *ra,
+							   struct file *file,
+							   unsigned long index )
 {
 	struct address_space	*mapping;
-	struct inode			*dir;
-	int						err;
+	struct page				*page;
+	unsigned long			nr_pages;
+	unsigned long			window;
+	unsigned int			ra_pages;
 
-	mapping	= page->mapping;
-	dir		= mapping->host;
-	err		= 0;
+	mapping		= dir->i_mapping;
+	nr_pages	= getDirNumPages( dir );
+	window		= ACCESS_ONCE( ME2FS_SB( dir->i_sb )->s_dir_ra_pages );
 
-	/* ------------------------------------------------------------------------ */
-	/* commit block write														*/
-	/* ------------------------------------------------------------------------ */
-	block_write_end( NULL, mapping, pos, len, len, page, NULL );
+	if( !window || ( nr_pages <= index ) )
+	{
+		return;
+	}
 
-	if( dir->i_size < ( pos + len ) )
+	if( ( nr_pages - index ) < window )
 	{
-		i_size_write( dir, pos + len );
-		mark_inode_dirty( dir );
+		window = nr_pages - index;
 	}
 
 	/* ------------------------------------------------------------------------ */
-	/* sync file and inode														*/
+	/* the window only caps this readahead. the state of the file keeps its		*/
+	/* own size for whoever else reads it										*/
 	/* ------------------------------------------------------------------------ */
-	if( IS_DIRSYNC( dir ) )
+	ra_pages		= ra->ra_pages;
+	ra->ra_pages	= window;
+
+	/* ------------------------------------------------------------------------ */
+	/* start a new window on a miss, or push the window forward when the scan	*/
+	/* reaches the marked page of the previous one								*/
+	/* ------------------------------------------------------------------------ */
+	if( !( page = find_get_page( mapping, index ) ) )
 	{
-		if( !( err = write_one_page( page, 1 ) ) )
-		{
-			err = sync_inode_metadata( dir, 1 );
-		}
+		page_cache_sync_readahead( mapping, ra, file, index, window );
 	}
 	else
 	{
-		unlock_page( page );
+		if( PageReadahead( page ) )
+		{
+			page_cache_async_readahead( mapping, ra, file,
+										page, index, window );
+		}
+
+		page_cache_release( page );
 	}
 
-	return( err );
+	ra->ra_pages = ra_pages;
 }
 
 /*
@@ -23,6 +23,52 @@ extern const struct file_operations me2fs_dir_operations;
 
 ==================================================================================
 */
+/* buckets of blocks by the largest gap in 4 bytes, the last one fits any name	*/
+#define	ME2FS_DIR_GAP_BUCKETS	( ( ME2FS_DIR_REC_LEN( 255 ) >> 2 ) + 1 )
+#define	ME2FS_DIR_NO_BLOCK		( ~0U )
+
+/*
+---------------------------------------------------------------------------------
+	Directory Summary
+	protected by i_mutex of the directory. every block is linked on the
+	bucket of its largest gap, so that add link finds a block with room
+	without looking at the others
+---------------------------------------------------------------------------------
+*/
+struct me2fs_dir_summary
+{
+	unsigned long	nr_blocks;		/* number of summarized blocks				*/
+	unsigned long	nr_alloc;		/* number of allocated slots of max_gap		*/
+	unsigned long	nr_live;		/* live entries except dot and dot dot		*/
+	unsigned long	nr_empty;		/* blocks without any live entry			*/
+	unsigned short	*max_gap;		/* largest free gap of each block			*/
+	unsigned int	*gap_next;		/* next block on the same bucket			*/
+	unsigned int	*gap_prev;		/* previous block on the same bucket		*/
+	unsigned int	gap_head[ ME2FS_DIR_GAP_BUCKETS ];
+	DECLARE_BITMAP( gap_nonempty, ME2FS_DIR_GAP_BUCKETS );
+};
+
+/*
+---------------------------------------------------------------------------------
+	Directory Entry Scan
+	query and result of me2fsScanDirEntries
+---------------------------------------------------------------------------------
+*/
+struct me2fs_dir_scan
+{
+	const unsigned char	*name;		/* name to find								*/
+	int					len;		/* length of name, 0 finds no name			*/
+	unsigned short		need;		/* room to find, 0 finds no room			*/
+	int					find_live;	/* find entry except dot and dot dot		*/
+	int					found;		/* what the returned entry is for			*/
+	unsigned short		max_gap;	/* largest free gap of scanned entries		*/
+	unsigned long		nr_live;	/* live entries except dot and dot dot		*/
+};
+
+#define	ME2FS_SCAN_NONE		0
+#define	ME2FS_SCAN_NAME		1		/* entry has the name						*/
+#define	ME2FS_SCAN_ROOM		2		/* entry has room for need bytes			*/
+#define	ME2FS_SCAN_LIVE		3		/* entry is neither dot nor dot dot			*/
 
 /*
 ==================================================================================
@@ -31,7 +77,6 @@ extern const struct file_operations me2fs_dir_operations;
 
 ==================================================================================
 */
-
 /*
 ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
@@ -183,4 +228,149 @@ void me2fsSetLink( struct inode *dir,
 				   struct inode *inode,
 				   int update_times );
 
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGetDirPageCache
+	Input		:struct inode *inode
+				 < vfs inode of directory >
+				 unsigned long index
+				 < index of page cache >
+	Output		:void
+	Return		:struct page*
+				 < page to which logical block attributes >
+
+	Description	:get page cache of the directory
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+struct page*
+me2fsGetDirPageCache( struct inode *inode, unsigned long index );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsPutDirPageCache
+	Input		:struct page *page
+				 < page to put >
+	Output		:void
+	Return		:void
+
+	Description	:put page
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsPutDirPageCache( struct page *page );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsSetDirEntryType
+	Input		:struct ext2_dir_entry *dent
+				 < directory entry >
+				 struct inode *inode
+				 < vfs inode >
+	Output		:void
+	Return		:void
+
+	Description	:set file type of vfs to ext2 directory entry
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void
+me2fsSetDirEntryType( struct ext2_dir_entry *dent, struct inode *inode );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsPrepareWriteBlock
+	Input		:struct page *page
+				 < page of file >
+				 loff_t pos
+				 < position in file >
+				 unsigned long len
+				 < length of write data >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:prepare to write a block
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int
+me2fsPrepareWriteBlock( struct page *page, loff_t pos, unsigned long len );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsCommitBlockWrite
+	Input		:struct page *page
+				 < page of file >
+				 loff_t pos
+				 < offset in file >
+				 unsigned long len
+				 < length to commit >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:commit block write
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsCommitBlockWrite( struct page *page, loff_t pos, unsigned long len );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsScanDirEntries
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 char *start
+				 < first entry to scan >
+				 char *end
+				 < end of entries to scan >
+				 struct me2fs_dir_scan *scan
+				 < query and output >
+	Output		:struct me2fs_dir_scan *scan
+				 < kind of found entry and summary of scanned entries >
+	Return		:struct ext2_dir_entry*
+				 < first entry which satisfies the query, or NULL >
+
+	Description	:scan directory entries of a page which has been checked
+				 by me2fsGetDirPageCache
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+struct ext2_dir_entry*
+me2fsScanDirEntries( struct inode *dir,
+					 char *start,
+					 char *end,
+					 struct me2fs_dir_scan *scan );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDirSummaryUpdate
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 struct page *page
+				 < mapped page cache which contains the modified block >
+				 unsigned long offset
+				 < offset in the page of the modification >
+				 int live
+				 < change of the number of live entries >
+	Output		:void
+	Return		:void
+
+	Description	:refresh the summary entry of a modified directory block
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDirSummaryUpdate( struct inode *dir,
+							struct page *page,
+							unsigned long offset,
+							int live );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDirSummaryDrop
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+	Output		:void
+	Return		:void
+
+	Description	:release the summary of a directory. it is built again
+				 on demand
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDirSummaryDrop( struct inode *dir );
+
 #endif	// __ME2FS_DIR_H__
@@ -0,0 +1,1728 @@
+/********************************************************************************
+	File			: me2fs_dx.c
+	Description		: Hashed directory index(htree) of my ext2 file system
+
+*********************************************************************************/
+#include <linux/buffer_head.h>
+#include <linux/pagemap.h>
+#include <linux/sort.h>
+#include <linux/slab.h>
+
+#include "me2fs.h"
+#include "me2fs_util.h"
+#include "me2fs_dir.h"
+#include "me2fs_hash.h"
+#include "me2fs_dx.h"
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+struct dx_frame;
+struct dx_map_entry;
+
+static void*
+getDirBlock( struct inode *dir, unsigned long block, struct page **res_page );
+static void*
+appendDirBlock( struct inode *dir, unsigned long *block, struct page **res_page );
+static int
+beginDirBlockWrite( struct inode *dir, struct page *page, unsigned long block );
+static int
+endDirBlockWrite( struct inode *dir, struct page *page, unsigned long block );
+static struct dx_frame*
+dxProbe( struct qstr *name,
+		 struct inode *dir,
+		 struct me2fs_dx_hash_info *hinfo,
+		 struct dx_frame *frames,
+		 int *err );
+static void dxReleaseFrames( struct dx_frame *frames );
+static unsigned dxRootLimit( struct inode *dir, unsigned info_size );
+static unsigned dxNodeLimit( struct inode *dir );
+static int dxNextBlock( struct inode *dir,
+						u32 hash,
+						struct dx_frame *frames,
+						struct dx_frame *frame );
+static int dxInsertBlock( struct inode *dir,
+						  struct dx_frame *frame,
+						  u32 hash,
+						  unsigned long block );
+static int dxSplitIndex( struct inode *dir,
+						 struct dx_frame *frames,
+						 struct dx_frame **res_frame );
+static int dxSplitLeaf( struct inode *dir,
+						struct dx_frame *frame,
+						struct me2fs_dx_hash_info *hinfo,
+						struct page *page,
+						void *start,
+						unsigned long block,
+						struct dentry *dentry,
+						struct inode *inode );
+static int dxCompareMap( const void *a, const void *b );
+static struct ext2_dir_entry*
+searchDirBlock( struct inode *dir, void *start, struct qstr *child );
+static int addDirEntryToBlock( struct inode *dir,
+							   struct page *page,
+							   void *start,
+							   struct dentry *dentry,
+							   struct inode *inode );
+static void*
+packDirEntries( struct inode *dir,
+				void *to,
+				void *from,
+				struct dx_map_entry *map,
+				int count );
+static void removeDirEntries( struct inode *dir,
+							  void *start,
+							  struct dx_map_entry *map,
+							  int count );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+#define	DX_GET_BLOCK( entry )													\
+	( le32_to_cpu( ( entry )->block ) & 0x00FFFFFF )
+#define	DX_SET_BLOCK( entry, value )											\
+	( ( entry )->block = cpu_to_le32( value ) )
+#define	DX_GET_HASH( entry )	le32_to_cpu( ( entry )->hash )
+#define	DX_SET_HASH( entry, value )												\
+	( ( entry )->hash = cpu_to_le32( value ) )
+/* the first entry of each index block holds count and limit instead of hash	*/
+#define	DX_COUNTLIMIT( entries )	( ( struct ext2_dx_countlimit* )( entries ) )
+#define	DX_GET_COUNT( entries )	le16_to_cpu( DX_COUNTLIMIT( entries )->count )
+#define	DX_GET_LIMIT( entries )	le16_to_cpu( DX_COUNTLIMIT( entries )->limit )
+#define	DX_SET_COUNT( entries, value )											\
+	( DX_COUNTLIMIT( entries )->count = cpu_to_le16( value ) )
+#define	DX_SET_LIMIT( entries, value )											\
+	( DX_COUNTLIMIT( entries )->limit = cpu_to_le16( value ) )
+
+/* ---------------------------------------------------------------------------- */
+/* an index block on the path from the root to a leaf							*/
+/* ---------------------------------------------------------------------------- */
+struct dx_frame
+{
+	struct page				*page;
+	struct ext2_dx_entry	*entries;
+	struct ext2_dx_entry	*at;
+	unsigned long			block;
+};
+
+/* ---------------------------------------------------------------------------- */
+/* live entry of a leaf block, used to split the leaf							*/
+/* ---------------------------------------------------------------------------- */
+struct dx_map_entry
+{
+	u32						hash;
+	u16						offs;
+	u16						size;
+};
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsHasDirIndex
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:int
+				 < 0:dir_index feature is off 1:on >
+
+	Description	:test dir_index feature of the file system
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsHasDirIndex( struct super_block *sb )
+{
+	struct me2fs_sb_info	*msi;
+
+	msi = ME2FS_SB( sb );
+
+	return( ( msi->s_esb->s_feature_compat
+			  & cpu_to_le32( EXT2_FEATURE_COMPAT_DIR_INDEX ) ) != 0 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsIsDxDir
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+	Output		:void
+	Return		:int
+				 < 0:linear directory 1:indexed directory >
+
+	Description	:test whether the directory is looked up through the index
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsIsDxDir( struct inode *dir )
+{
+	if( !me2fsHasDirIndex( dir->i_sb ) )
+	{
+		return( 0 );
+	}
+
+	if( !( ME2FS_I( dir )->i_flags & EXT2_INDEX_FL ) )
+	{
+		return( 0 );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* root and at least one leaf												*/
+	/* ------------------------------------------------------------------------ */
+	return( ( dir->i_size >> dir->i_blkbits ) >= 2 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDxCanIndex
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+	Output		:void
+	Return		:int
+				 < 0:keep linear 1:convert >
+
+	Description	:test whether a linear directory should be converted into
+				 an indexed one when its first block is full
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDxCanIndex( struct inode *dir )
+{
+	if( !me2fsHasDirIndex( dir->i_sb ) )
+	{
+		return( 0 );
+	}
+
+	if( ME2FS_I( dir )->i_flags & EXT2_INDEX_FL )
+	{
+		return( 0 );
+	}
+
+	return( dir->i_size == dir->i_sb->s_blocksize );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDxFindEntry
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 struct qstr *child
+				 < query;child of directory >
+				 struct page **res_page
+				 < output >
+				 int *err
+				 < output >
+	Output		:struct page **res_page
+				 < the entry was found in >
+				 int *err
+				 < 0 or error, -EFSCORRUPTED if index is broken >
+	Return		:struct ext2_dir_entry*
+				 < found entry >
+
+	Description	:find an entry through the hash index. page is returned
+				 mapped and unlocked.
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+struct ext2_dir_entry*
+me2fsDxFindEntry( struct inode *dir,
+				  struct qstr *child,
+				  struct page **res_page,
+				  int *err )
+{
+	struct dx_frame				frames[ EXT2_DX_MAX_LEVELS ];
+	struct dx_frame				*frame;
+	struct me2fs_dx_hash_info	hinfo;
+	struct ext2_dir_entry		*dent;
+	struct page					*page;
+	void						*start;
+	int							retval;
+
+	memset( frames, 0, sizeof( frames ) );
+
+	if( !( frame = dxProbe( child, dir, &hinfo, frames, err ) ) )
+	{
+		return( NULL );
+	}
+
+	dent = NULL;
+
+	do
+	{
+		start = getDirBlock( dir, DX_GET_BLOCK( frame->at ), &page );
+
+		if( IS_ERR( start ) )
+		{
+			*err = PTR_ERR( start );
+			goto out;
+		}
+
+		dent = searchDirBlock( dir, start, child );
+
+		if( dent )
+		{
+			*res_page	= page;
+			*err		= 0;
+			goto out;
+		}
+
+		me2fsPutDirPageCache( page );
+
+		/* -------------------------------------------------------------------- */
+		/* the name may continue to next leaf on hash collision					*/
+		/* -------------------------------------------------------------------- */
+		retval = dxNextBlock( dir, hinfo.hash, frames, frame );
+
+		if( retval < 0 )
+		{
+			*err = retval;
+			goto out;
+		}
+	} while( retval == 1 );
+
+	*err = 0;
+
+out:
+	dxReleaseFrames( frames );
+	return( dent );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDxAddLink
+	Input		:struct dentry *dentry
+				 < vfs dentry >
+				 struct inode *inode
+				 < vfs inode >
+	Output		:void
+	Return		:int
+				 < result, -EFSCORRUPTED if index is broken >
+
+	Description	:add link to an indexed directory
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDxAddLink( struct dentry *dentry, struct inode *inode )
+{
+	struct inode				*dir;
+	struct dx_frame				frames[ EXT2_DX_MAX_LEVELS ];
+	struct dx_frame				*frame;
+	struct me2fs_dx_hash_info	hinfo;
+	struct page					*page;
+	unsigned long				block;
+	void						*start;
+	int							err;
+
+	dir = dentry->d_parent->d_inode;
+
+	memset( frames, 0, sizeof( frames ) );
+
+	if( !( frame = dxProbe( &dentry->d_name, dir, &hinfo, frames, &err ) ) )
+	{
+		return( err );
+	}
+
+	block = DX_GET_BLOCK( frame->at );
+	start = getDirBlock( dir, block, &page );
+
+	if( IS_ERR( start ) )
+	{
+		err = PTR_ERR( start );
+		goto out;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* try to add to the leaf block at first									*/
+	/* ------------------------------------------------------------------------ */
+	err = addDirEntryToBlock( dir, page, start, dentry, inode );
+
+	if( err != -ENOSPC )
+	{
+		goto out_put;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* the leaf is full. make room in the index for a new leaf if needed		*/
+	/* ------------------------------------------------------------------------ */
+	if( DX_GET_COUNT( frame->entries ) == DX_GET_LIMIT( frame->entries ) )
+	{
+		if( ( err = dxSplitIndex( dir, frames, &frame ) ) )
+		{
+			goto out_put;
+		}
+	}
+
+	err = dxSplitLeaf( dir, frame, &hinfo, page, start, block, dentry, inode );
+
+out_put:
+	me2fsPutDirPageCache( page );
+out:
+	dxReleaseFrames( frames );
+	return( err );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDxMakeIndexed
+	Input		:struct dentry *dentry
+				 < vfs dentry >
+				 struct inode *inode
+				 < vfs inode >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:convert a full single block directory into an indexed
+				 directory and add link to it
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDxMakeIndexed( struct dentry *dentry, struct inode *inode )
+{
+	struct inode			*dir;
+	struct me2fs_sb_info	*msi;
+	struct ext2_dx_root		*root;
+	struct ext2_dir_entry	*dent;
+	struct ext2_dir_entry	*last;
+	struct ext2_dx_entry	*entries;
+	struct page				*root_page;
+	struct page				*leaf_page;
+	unsigned long			block_size;
+	unsigned long			leaf_block;
+	char					*leaf;
+	char					*to;
+	char					*end;
+	int						hash_version;
+	int						err;
+
+	dir			= dentry->d_parent->d_inode;
+	msi			= ME2FS_SB( dir->i_sb );
+	block_size	= dir->i_sb->s_blocksize;
+
+	/* ------------------------------------------------------------------------ */
+	/* entries are moved across blocks, summarize them again later				*/
+	/* ------------------------------------------------------------------------ */
+	me2fsDirSummaryDrop( dir );
+
+	root = getDirBlock( dir, 0, &root_page );
+
+	if( IS_ERR( root ) )
+	{
+		return( PTR_ERR( root ) );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* the root overlays dot and dot dot, so they must be in canonical form		*/
+	/* ------------------------------------------------------------------------ */
+	if( ( le16_to_cpu( root->dot.rec_len ) != ME2FS_DIR_REC_LEN( 1 ) ) ||
+		( root->dotdot.name_len != 2 ) ||
+		( le16_to_cpu( root->dotdot.rec_len ) < ME2FS_DIR_REC_LEN( 2 ) ) )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:invalid dot entries of directory #%lu\n",
+					 __func__, dir->i_ino );
+		err = -EIO;
+		goto out_put_root;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* move entries other than dot and dot dot to a new leaf block				*/
+	/* ------------------------------------------------------------------------ */
+	leaf = appendDirBlock( dir, &leaf_block, &leaf_page );
+
+	if( IS_ERR( leaf ) )
+	{
+		err = PTR_ERR( leaf );
+		goto out_put_root;
+	}
+
+	dent	= ( struct ext2_dir_entry* )( ( char* )&root->dotdot
+										  + le16_to_cpu( root->dotdot.rec_len ) );
+	end		= ( char* )root + block_size;
+	to		= leaf;
+	last	= NULL;
+
+	while( ( char* )dent < end )
+	{
+		unsigned short	rec_len;
+
+		rec_len = le16_to_cpu( dent->rec_len );
+
+		if( !rec_len || ( end < ( ( char* )dent + rec_len ) ) )
+		{
+			ME2FS_ERROR( "<ME2FS>%s:invalid directory entry\n", __func__ );
+			break;
+		}
+
+		if( dent->inode )
+		{
+			unsigned short	new_rec_len;
+
+			new_rec_len = ME2FS_DIR_REC_LEN( dent->name_len );
+			memcpy( to, dent, new_rec_len );
+			last			= ( struct ext2_dir_entry* )to;
+			last->rec_len	= cpu_to_le16( new_rec_len );
+			to				+= new_rec_len;
+		}
+
+		dent = ( struct ext2_dir_entry* )( ( char* )dent + rec_len );
+	}
+
+	if( last )
+	{
+		last->rec_len = cpu_to_le16( leaf + block_size - ( char* )last );
+	}
+	else
+	{
+		last			= ( struct ext2_dir_entry* )leaf;
+		last->inode		= 0;
+		last->name_len	= 0;
+		last->rec_len	= cpu_to_le16( block_size );
+	}
+
+	if( ( err = endDirBlockWrite( dir, leaf_page, leaf_block ) ) )
+	{
+		goto out_put_leaf;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* rewrite the first block into the root of index							*/
+	/* ------------------------------------------------------------------------ */
+	if( ( err = beginDirBlockWrite( dir, root_page, 0 ) ) )
+	{
+		goto out_put_leaf;
+	}
+
+	hash_version = msi->s_esb->s_def_hash_version;
+
+	if( EXT2_HASH_TEA < hash_version )
+	{
+		hash_version = EXT2_HASH_HALF_MD4;
+	}
+
+	root->dotdot.rec_len = cpu_to_le16( block_size - ME2FS_DIR_REC_LEN( 1 ) );
+	memset( &root->info, 0, end - ( char* )&root->info );
+	root->info.hash_version		= hash_version;
+	root->info.info_length		= sizeof( root->info );
+	root->info.indirect_levels	= 0;
+
+	entries = root->entries;
+	DX_SET_LIMIT( entries, dxRootLimit( dir, sizeof( root->info ) ) );
+	DX_SET_COUNT( entries, 1 );
+	DX_SET_BLOCK( entries, leaf_block );
+
+	if( ( err = endDirBlockWrite( dir, root_page, 0 ) ) )
+	{
+		goto out_put_leaf;
+	}
+
+	ME2FS_I( dir )->i_flags |= EXT2_INDEX_FL;
+	mark_inode_dirty( dir );
+
+	me2fsPutDirPageCache( leaf_page );
+	me2fsPutDirPageCache( root_page );
+
+	DBGPRINT( "<ME2FS>%s:directory #%lu is indexed\n", __func__, dir->i_ino );
+
+	return( me2fsDxAddLink( dentry, inode ) );
+
+out_put_leaf:
+	me2fsPutDirPageCache( leaf_page );
+out_put_root:
+	me2fsPutDirPageCache( root_page );
+	return( err );
+}
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Local Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+==================================================================================
+	Function	:getDirBlock
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 unsigned long block
+				 < logical block number in the directory >
+				 struct page **res_page
+				 < output >
+	Output		:struct page **res_page
+				 < mapped page cache which contains the block >
+	Return		:void*
+				 < start of the block or error pointer >
+
+	Description	:get a directory block through page cache
+==================================================================================
+*/
+static void*
+getDirBlock( struct inode *dir, unsigned long block, struct page **res_page )
+{
+	struct page		*page;
+	unsigned int	shift;
+	unsigned long	offset;
+
+	shift	= PAGE_CACHE_SHIFT - dir->i_blkbits;
+	offset	= ( block << dir->i_blkbits ) & ~PAGE_CACHE_MASK;
+
+	page	= me2fsGetDirPageCache( dir, block >> shift );
+
+	if( IS_ERR( page ) )
+	{
+		return( ( void* )page );
+	}
+
+	*res_page = page;
+
+	return( ( char* )page_address( page ) + offset );
+}
+
+/*
+==================================================================================
+	Function	:appendDirBlock
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 unsigned long *block
+				 < output >
+				 struct page **res_page
+				 < output >
+	Output		:unsigned long *block
+				 < logical block number of the new block >
+				 struct page **res_page
+				 < mapped and locked page cache of the new block >
+	Return		:void*
+				 < start of the block or error pointer >
+
+	Description	:allocate a new block at the end of the directory. the caller
+				 fills it and commits it by endDirBlockWrite
+==================================================================================
+*/
+static void*
+appendDirBlock( struct inode *dir, unsigned long *block, struct page **res_page )
+{
+	struct page	*page;
+	void		*start;
+	int			err;
+
+	*block	= dir->i_size >> dir->i_blkbits;
+	start	= getDirBlock( dir, *block, &page );
+
+	if( IS_ERR( start ) )
+	{
+		return( start );
+	}
+
+	if( ( err = beginDirBlockWrite( dir, page, *block ) ) )
+	{
+		me2fsPutDirPageCache( page );
+		return( ERR_PTR( err ) );
+	}
+
+	memset( start, 0, dir->i_sb->s_blocksize );
+
+	*res_page = page;
+
+	return( start );
+}
+
+/*
+==================================================================================
+	Function	:beginDirBlockWrite
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 struct page *page
+				 < page cache which contains the block >
+				 unsigned long block
+				 < logical block number in the directory >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:lock the page and prepare to write whole block
+==================================================================================
+*/
+static int
+beginDirBlockWrite( struct inode *dir, struct page *page, unsigned long block )
+{
+	loff_t	pos;
+	int		err;
+
+	pos = ( loff_t )block << dir->i_blkbits;
+
+	lock_page( page );
+
+	if( ( err = me2fsPrepareWriteBlock( page, pos, dir->i_sb->s_blocksize ) ) )
+	{
+		unlock_page( page );
+	}
+
+	return( err );
+}
+
+/*
+==================================================================================
+	Function	:endDirBlockWrite
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 struct page *page
+				 < page cache which contains the block >
+				 unsigned long block
+				 < logical block number in the directory >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:commit write of whole block and unlock the page
+==================================================================================
+*/
+static int
+endDirBlockWrite( struct inode *dir, struct page *page, unsigned long block )
+{
+	loff_t	pos;
+
+	pos = ( loff_t )block << dir->i_blkbits;
+
+	return( me2fsCommitBlockWrite( page, pos, dir->i_sb->s_blocksize ) );
+}
+
+/*
+==================================================================================
+	Function	:dxProbe
+	Input		:struct qstr *name
+				 < name to look up >
+				 struct inode *dir
+				 < vfs inode of directory >
+				 struct me2fs_dx_hash_info *hinfo
+				 < output >
+				 struct dx_frame *frames
+				 < output >
+				 int *err
+				 < output >
+	Output		:struct me2fs_dx_hash_info *hinfo
+				 < hash of the name >
+				 struct dx_frame *frames
+				 < path from the root to the leaf >
+				 int *err
+				 < error if probe failed >
+	Return		:struct dx_frame*
+				 < bottom frame which points to the leaf >
+
+	Description	:walk down the index to the leaf for the name
+==================================================================================
+*/
+static struct dx_frame*
+dxProbe( struct qstr *name,
+		 struct inode *dir,
+		 struct me2fs_dx_hash_info *hinfo,
+		 struct dx_frame *frames,
+		 int *err )
+{
+	struct ext2_dx_root		*root;
+	struct ext2_dx_entry	*entries;
+	struct ext2_dx_entry	*p;
+	struct ext2_dx_entry	*q;
+	struct ext2_dx_entry	*m;
+	struct dx_frame			*frame;
+	struct page				*page;
+	unsigned long			nblocks;
+	unsigned				count;
+	unsigned				levels;
+	u32						hash;
+
+	frame	= frames;
+	nblocks	= dir->i_size >> dir->i_blkbits;
+	root	= getDirBlock( dir, 0, &page );
+
+	if( IS_ERR( root ) )
+	{
+		*err = PTR_ERR( root );
+		return( NULL );
+	}
+
+	frame->page		= page;
+	frame->block	= 0;
+
+	if( root->info.reserved_zero ||
+		( ( root->info.hash_version != EXT2_HASH_LEGACY ) &&
+		  ( root->info.hash_version != EXT2_HASH_HALF_MD4 ) &&
+		  ( root->info.hash_version != EXT2_HASH_TEA ) ) )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:unrecognized hash version %u\n",
+					 __func__, root->info.hash_version );
+		goto fail;
+	}
+
+	if( root->info.unused_flags & 1 )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:unimplemented hash flags %#06x\n",
+					 __func__, root->info.unused_flags );
+		goto fail;
+	}
+
+	if( EXT2_DX_MAX_LEVELS <= ( levels = root->info.indirect_levels ) )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:unimplemented hash depth %u\n",
+					 __func__, levels );
+		goto fail;
+	}
+
+	hinfo->hash_version	= root->info.hash_version
+						  + ME2FS_SB( dir->i_sb )->s_hash_unsigned;
+	hinfo->seed			= ME2FS_SB( dir->i_sb )->s_esb->s_hash_seed;
+	me2fsDirHash( ( const char* )name->name, name->len, hinfo );
+	hash				= hinfo->hash;
+
+	entries = ( struct ext2_dx_entry* )( ( char* )&root->info
+										 + root->info.info_length );
+
+	if( DX_GET_LIMIT( entries ) != dxRootLimit( dir, root->info.info_length ) )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:dx entry limit is wrong\n", __func__ );
+		goto fail;
+	}
+
+	for( ; ; )
+	{
+		unsigned long	block;
+		void			*node;
+
+		count = DX_GET_COUNT( entries );
+
+		if( !count || ( DX_GET_LIMIT( entries ) < count ) )
+		{
+			ME2FS_ERROR( "<ME2FS>%s:dx entry count is wrong\n", __func__ );
+			goto fail;
+		}
+
+		/* -------------------------------------------------------------------- */
+		/* binary search for the last entry whose hash is not above ours		*/
+		/* -------------------------------------------------------------------- */
+		p = entries + 1;
+		q = entries + count - 1;
+
+		while( p <= q )
+		{
+			m = p + ( q - p ) / 2;
+
+			if( hash < DX_GET_HASH( m ) )
+			{
+				q = m - 1;
+			}
+			else
+			{
+				p = m + 1;
+			}
+		}
+
+		frame->entries	= entries;
+		frame->at		= p - 1;
+		block			= DX_GET_BLOCK( frame->at );
+
+		/* -------------------------------------------------------------------- */
+		/* the leaf is read by the caller, check it as well as index nodes		*/
+		/* -------------------------------------------------------------------- */
+		if( nblocks <= block )
+		{
+			ME2FS_ERROR( "<ME2FS>%s:dx block %lu is out of directory\n",
+						 __func__, block );
+			goto fail;
+		}
+
+		if( !levels-- )
+		{
+			return( frame );
+		}
+
+		node = getDirBlock( dir, block, &page );
+
+		if( IS_ERR( node ) )
+		{
+			dxReleaseFrames( frames );
+			*err = PTR_ERR( node );
+			return( NULL );
+		}
+
+		frame++;
+		frame->page		= page;
+		frame->block	= block;
+		entries			= ( ( struct ext2_dx_node* )node )->entries;
+
+		if( DX_GET_LIMIT( entries ) != dxNodeLimit( dir ) )
+		{
+			ME2FS_ERROR( "<ME2FS>%s:dx node limit is wrong\n", __func__ );
+			goto fail;
+		}
+	}
+
+fail:
+	dxReleaseFrames( frames );
+	*err = -EFSCORRUPTED;
+	return( NULL );
+}
+
+/*
+==================================================================================
+	Function	:dxReleaseFrames
+	Input		:struct dx_frame *frames
+				 < path of index blocks >
+	Output		:void
+	Return		:void
+
+	Description	:put page caches of the path
+==================================================================================
+*/
+static void dxReleaseFrames( struct dx_frame *frames )
+{
+	int		i;
+
+	for( i = 0 ; i < EXT2_DX_MAX_LEVELS ; i++ )
+	{
+		if( frames[ i ].page )
+		{
+			me2fsPutDirPageCache( frames[ i ].page );
+			frames[ i ].page = NULL;
+		}
+	}
+}
+
+/*
+==================================================================================
+	Function	:dxRootLimit
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 unsigned info_size
+				 < size of root information >
+	Output		:void
+	Return		:unsigned
+				 < max number of index entries in the root >
+
+	Description	:get capacity of the root block
+==================================================================================
+*/
+static unsigned dxRootLimit( struct inode *dir, unsigned info_size )
+{
+	unsigned	entry_space;
+
+	entry_space = dir->i_sb->s_blocksize
+				  - ME2FS_DIR_REC_LEN( 1 )
+				  - ME2FS_DIR_REC_LEN( 2 )
+				  - info_size;
+
+	return( entry_space / sizeof( struct ext2_dx_entry ) );
+}
+
+/*
+==================================================================================
+	Function	:dxNodeLimit
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+	Output		:void
+	Return		:unsigned
+				 < max number of index entries in a node >
+
+	Description	:get capacity of an index node block
+==================================================================================
+*/
+static unsigned dxNodeLimit( struct inode *dir )
+{
+	unsigned	entry_space;
+
+	entry_space = dir->i_sb->s_blocksize - ME2FS_DIR_REC_LEN( 0 );
+
+	return( entry_space / sizeof( struct ext2_dx_entry ) );
+}
+
+/*
+==================================================================================
+	Function	:dxNextBlock
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 u32 hash
+				 < hash of the name >
+				 struct dx_frame *frames
+				 < path of index blocks >
+				 struct dx_frame *frame
+				 < bottom frame >
+	Output		:struct dx_frame *frames
+				 < path to the next leaf >
+	Return		:int
+				 < 1:next leaf may have the hash 0:not -errno:error >
+
+	Description	:advance the path to the next leaf if the hash collides
+==================================================================================
+*/
+static int dxNextBlock( struct inode *dir,
+						u32 hash,
+						struct dx_frame *frames,
+						struct dx_frame *frame )
+{
+	struct dx_frame	*p;
+	unsigned long	nblocks;
+	int				num_frames;
+	u32				bhash;
+
+	p			= frame;
+	num_frames	= 0;
+	nblocks		= dir->i_size >> dir->i_blkbits;
+
+	/* ------------------------------------------------------------------------ */
+	/* find the lowest level which has a next entry								*/
+	/* ------------------------------------------------------------------------ */
+	for( ; ; )
+	{
+		if( ++( p->at ) < ( p->entries + DX_GET_COUNT( p->entries ) ) )
+		{
+			break;
+		}
+
+		if( p == frames )
+		{
+			return( 0 );
+		}
+
+		num_frames++;
+		p--;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* the next leaf continues our hash only if its low bit marks collision		*/
+	/* ------------------------------------------------------------------------ */
+	bhash = DX_GET_HASH( p->at );
+
+	if( ( bhash & ~1 ) != hash )
+	{
+		return( 0 );
+	}
+
+	while( num_frames-- )
+	{
+		struct page		*page;
+		unsigned long	block;
+		void			*node;
+
+		block = DX_GET_BLOCK( p->at );
+
+		if( nblocks <= block )
+		{
+			ME2FS_ERROR( "<ME2FS>%s:dx block %lu is out of directory\n",
+						 __func__, block );
+			return( -EFSCORRUPTED );
+		}
+
+		node = getDirBlock( dir, block, &page );
+
+		if( IS_ERR( node ) )
+		{
+			return( PTR_ERR( node ) );
+		}
+
+		p++;
+		me2fsPutDirPageCache( p->page );
+		p->page		= page;
+		p->block	= block;
+		p->entries	= ( ( struct ext2_dx_node* )node )->entries;
+		p->at		= p->entries;
+	}
+
+	if( nblocks <= DX_GET_BLOCK( p->at ) )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:dx block %u is out of directory\n",
+					 __func__, DX_GET_BLOCK( p->at ) );
+		return( -EFSCORRUPTED );
+	}
+
+	return( 1 );
+}
+
+/*
+==================================================================================
+	Function	:dxInsertBlock
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 struct dx_frame *frame
+				 < index block to insert into >
+				 u32 hash
+				 < lowest hash of the new block >
+				 unsigned long block
+				 < new block >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:insert an index entry just after frame->at
+==================================================================================
+*/
+static int dxInsertBlock( struct inode *dir,
+						  struct dx_frame *frame,
+						  u32 hash,
+						  unsigned long block )
+{
+	struct ext2_dx_entry	*entries;
+	struct ext2_dx_entry	*new;
+	unsigned				count;
+	int						err;
+
+	entries	= frame->entries;
+	new		= frame->at + 1;
+	count	= DX_GET_COUNT( entries );
+
+	if( ( err = beginDirBlockWrite( dir, frame->page, frame->block ) ) )
+	{
+		return( err );
+	}
+
+	memmove( new + 1, new, ( char* )( entries + count ) - ( char* )new );
+	DX_SET_HASH( new, hash );
+	DX_SET_BLOCK( new, block );
+	DX_SET_COUNT( entries, count + 1 );
+
+	return( endDirBlockWrite( dir, frame->page, frame->block ) );
+}
+
+/*
+==================================================================================
+	Function	:dxSplitIndex
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 struct dx_frame *frames
+				 < path of index blocks >
+				 struct dx_frame **res_frame
+				 < bottom frame which is full >
+	Output		:struct dx_frame **res_frame
+				 < bottom frame which has room >
+	Return		:int
+				 < result >
+
+	Description	:make room in the bottom index block by splitting it, or by
+				 adding a level under the root
+==================================================================================
+*/
+static int dxSplitIndex( struct inode *dir,
+						 struct dx_frame *frames,
+						 struct dx_frame **res_frame )
+{
+	struct dx_frame			*frame;
+	struct ext2_dx_entry	*entries;
+	struct ext2_dx_entry	*entries2;
+	struct ext2_dx_node		*node2;
+	struct page				*page2;
+	unsigned long			block2;
+	unsigned				count;
+	unsigned				levels;
+	int						err;
+
+	frame	= *res_frame;
+	entries	= frame->entries;
+	count	= DX_GET_COUNT( entries );
+	levels	= frame - frames;
+
+	if( levels &&
+		( DX_GET_COUNT( frames->entries ) == DX_GET_LIMIT( frames->entries ) ) )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:directory index full [#%lu]\n",
+					 __func__, dir->i_ino );
+		return( -ENOSPC );
+	}
+
+	node2 = appendDirBlock( dir, &block2, &page2 );
+
+	if( IS_ERR( node2 ) )
+	{
+		return( PTR_ERR( node2 ) );
+	}
+
+	node2->fake.inode	= 0;
+	node2->fake.rec_len	= cpu_to_le16( dir->i_sb->s_blocksize );
+	entries2			= node2->entries;
+
+	if( levels )
+	{
+		unsigned	count1;
+		unsigned	count2;
+		u32			hash2;
+
+		/* -------------------------------------------------------------------- */
+		/* split the index node into halves										*/
+		/* -------------------------------------------------------------------- */
+		count1	= count / 2;
+		count2	= count - count1;
+		hash2	= DX_GET_HASH( entries + count1 );
+
+		memcpy( entries2, entries + count1,
+				count2 * sizeof( struct ext2_dx_entry ) );
+		DX_SET_COUNT( entries2, count2 );
+		DX_SET_LIMIT( entries2, dxNodeLimit( dir ) );
+
+		if( ( err = endDirBlockWrite( dir, page2, block2 ) ) )
+		{
+			me2fsPutDirPageCache( page2 );
+			return( err );
+		}
+
+		if( ( err = beginDirBlockWrite( dir, frame->page, frame->block ) ) )
+		{
+			me2fsPutDirPageCache( page2 );
+			return( err );
+		}
+
+		DX_SET_COUNT( entries, count1 );
+
+		if( ( err = endDirBlockWrite( dir, frame->page, frame->block ) ) )
+		{
+			me2fsPutDirPageCache( page2 );
+			return( err );
+		}
+
+		/* -------------------------------------------------------------------- */
+		/* follow the half which has our position								*/
+		/* -------------------------------------------------------------------- */
+		if( ( entries + count1 ) <= frame->at )
+		{
+			frame->at = entries2 + ( frame->at - ( entries + count1 ) );
+			me2fsPutDirPageCache( frame->page );
+			frame->page		= page2;
+			frame->block	= block2;
+			frame->entries	= entries2;
+		}
+		else
+		{
+			me2fsPutDirPageCache( page2 );
+		}
+
+		return( dxInsertBlock( dir, frames, hash2, block2 ) );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* the root is full, move its entries to a new node and add a level			*/
+	/* ------------------------------------------------------------------------ */
+	memcpy( entries2, entries, count * sizeof( struct ext2_dx_entry ) );
+	DX_SET_LIMIT( entries2, dxNodeLimit( dir ) );
+
+	if( ( err = endDirBlockWrite( dir, page2, block2 ) ) )
+	{
+		me2fsPutDirPageCache( page2 );
+		return( err );
+	}
+
+	if( ( err = beginDirBlockWrite( dir, frame->page, frame->block ) ) )
+	{
+		me2fsPutDirPageCache( page2 );
+		return( err );
+	}
+
+	DX_SET_COUNT( entries, 1 );
+	DX_SET_BLOCK( entries, block2 );
+	( ( struct ext2_dx_root* )page_address( frame->page ) )->info.indirect_levels = 1;
+
+	if( ( err = endDirBlockWrite( dir, frame->page, frame->block ) ) )
+	{
+		me2fsPutDirPageCache( page2 );
+		return( err );
+	}
+
+	frame[ 1 ].page		= page2;
+	frame[ 1 ].block	= block2;
+	frame[ 1 ].entries	= entries2;
+	frame[ 1 ].at		= entries2 + ( frame->at - entries );
+	frame->at			= entries;
+
+	*res_frame = frame + 1;
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:dxSplitLeaf
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 struct dx_frame *frame
+				 < bottom frame which points to the leaf >
+				 struct me2fs_dx_hash_info *hinfo
+				 < hash of the new name >
+				 struct page *page
+				 < page cache which contains the leaf >
+				 void *start
+				 < start of the leaf block >
+				 unsigned long block
+				 < logical block number of the leaf >
+				 struct dentry *dentry
+				 < vfs dentry to add >
+				 struct inode *inode
+				 < vfs inode to add >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:move upper half of hash range to a new leaf and add link
+==================================================================================
+*/
+static int dxSplitLeaf( struct inode *dir,
+						struct dx_frame *frame,
+						struct me2fs_dx_hash_info *hinfo,
+						struct page *page,
+						void *start,
+						unsigned long block,
+						struct dentry *dentry,
+						struct inode *inode )
+{
+	struct dx_map_entry			*map;
+	struct me2fs_dx_hash_info	h;
+	struct ext2_dir_entry		*dent;
+	struct page					*page2;
+	unsigned long				block_size;
+	unsigned long				block2;
+	char						*data2;
+	char						*tmp;
+	unsigned					size;
+	int							count;
+	int							move;
+	int							split;
+	int							i;
+	int							err;
+	u32							hash2;
+	int							continued;
+
+	me2fsDirSummaryDrop( dir );
+
+	block_size	= dir->i_sb->s_blocksize;
+	map			= kmalloc( ( block_size / ME2FS_DIR_REC_LEN( 1 ) )
+						   * sizeof( struct dx_map_entry ), GFP_NOFS );
+	tmp			= kmalloc( block_size, GFP_NOFS );
+
+	if( !map || !tmp )
+	{
+		err = -ENOMEM;
+		goto out;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* hash every live entry of the leaf										*/
+	/* ------------------------------------------------------------------------ */
+	h		= *hinfo;
+	count	= 0;
+	dent	= ( struct ext2_dir_entry* )start;
+
+	while( ( char* )dent < ( ( char* )start + block_size ) )
+	{
+		if( dent->inode )
+		{
+			me2fsDirHash( dent->name, dent->name_len, &h );
+			map[ count ].hash	= h.hash;
+			map[ count ].offs	= ( char* )dent - ( char* )start;
+			map[ count ].size	= ME2FS_DIR_REC_LEN( dent->name_len );
+			count++;
+		}
+
+		dent = ( struct ext2_dir_entry* )( ( char* )dent
+										   + le16_to_cpu( dent->rec_len ) );
+	}
+
+	if( count < 2 )
+	{
+		err = -ENOSPC;
+		goto out;
+	}
+
+	sort( map, count, sizeof( struct dx_map_entry ), dxCompareMap, NULL );
+
+	/* ------------------------------------------------------------------------ */
+	/* move about a half of bytes in upper hash range							*/
+	/* ------------------------------------------------------------------------ */
+	size = 0;
+	move = 0;
+
+	for( i = count - 1 ; 0 <= i ; i-- )
+	{
+		if( ( block_size / 2 ) < ( size + map[ i ].size / 2 ) )
+		{
+			break;
+		}
+		size += map[ i ].size;
+		move++;
+	}
+
+	split = count - move;
+
+	if( !split )
+	{
+		split = 1;
+	}
+	else if( split == count )
+	{
+		split = count - 1;
+	}
+
+	hash2		= map[ split ].hash;
+	continued	= ( hash2 == map[ split - 1 ].hash );
+
+	/* ------------------------------------------------------------------------ */
+	/* fill the new leaf														*/
+	/* ------------------------------------------------------------------------ */
+	data2 = appendDirBlock( dir, &block2, &page2 );
+
+	if( IS_ERR( data2 ) )
+	{
+		err = PTR_ERR( data2 );
+		goto out;
+	}
+
+	packDirEntries( dir, data2, start, map + split, count - split );
+
+	if( ( err = endDirBlockWrite( dir, page2, block2 ) ) )
+	{
+		goto out_put;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* remove the moved entries from the old leaf in place. the rest keep		*/
+	/* their offsets, so that readdir in progress does not skip any of them		*/
+	/* ------------------------------------------------------------------------ */
+	if( ( err = beginDirBlockWrite( dir, page, block ) ) )
+	{
+		goto out_put;
+	}
+
+	removeDirEntries( dir, start, map + split, count - split );
+
+	if( ( err = endDirBlockWrite( dir, page, block ) ) )
+	{
+		goto out_put;
+	}
+
+	if( ( err = dxInsertBlock( dir, frame, hash2 + continued, block2 ) ) )
+	{
+		goto out_put;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* add the new entry to the half which covers its hash						*/
+	/* ------------------------------------------------------------------------ */
+	if( hash2 <= hinfo->hash )
+	{
+		err = addDirEntryToBlock( dir, page2, data2, dentry, inode );
+	}
+	else if( ( err = addDirEntryToBlock( dir, page, start, dentry, inode ) )
+			 == -ENOSPC )
+	{
+		/* -------------------------------------------------------------------- */
+		/* no gap left in the old leaf is large enough for the name. only then	*/
+		/* are the entries packed and moved										*/
+		/* -------------------------------------------------------------------- */
+		memset( tmp, 0, block_size );
+		packDirEntries( dir, tmp, start, map, split );
+
+		if( ( err = beginDirBlockWrite( dir, page, block ) ) )
+		{
+			goto out_put;
+		}
+
+		memcpy( start, tmp, block_size );
+
+		if( ( err = endDirBlockWrite( dir, page, block ) ) )
+		{
+			goto out_put;
+		}
+
+		err = addDirEntryToBlock( dir, page, start, dentry, inode );
+	}
+
+out_put:
+	me2fsPutDirPageCache( page2 );
+out:
+	kfree( tmp );
+	kfree( map );
+	return( err );
+}
+
+/*
+==================================================================================
+	Function	:dxCompareMap
+	Input		:const void *a
+				 < map entry >
+				 const void *b
+				 < map entry >
+	Output		:void
+	Return		:int
+				 < order of a and b >
+
+	Description	:compare map entries by hash
+==================================================================================
+*/
+static int dxCompareMap( const void *a, const void *b )
+{
+	const struct dx_map_entry	*ma;
+	const struct dx_map_entry	*mb;
+
+	ma = a;
+	mb = b;
+
+	if( ma->hash < mb->hash )
+	{
+		return( -1 );
+	}
+
+	if( mb->hash < ma->hash )
+	{
+		return( 1 );
+	}
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:searchDirBlock
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 void *start
+				 < start of a directory block >
+				 struct qstr *child
+				 < name to look up >
+	Output		:void
+	Return		:struct ext2_dir_entry*
+				 < found entry or NULL >
+
+	Description	:look up a name in a single directory block
+==================================================================================
+*/
+static struct ext2_dir_entry*
+searchDirBlock( struct inode *dir, void *start, struct qstr *child )
+{
+	struct me2fs_dir_scan	scan;
+
+	scan.name		= child->name;
+	scan.len		= child->len;
+	scan.need		= 0;
+	scan.find_live	= 0;
+
+	return( me2fsScanDirEntries( dir,
+								 ( char* )start,
+								 ( char* )start + dir->i_sb->s_blocksize,
+								 &scan ) );
+}
+
+/*
+==================================================================================
+	Function	:addDirEntryToBlock
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 struct page *page
+				 < page cache which contains the block >
+				 void *start
+				 < start of the block >
+				 struct dentry *dentry
+				 < vfs dentry to add >
+				 struct inode *inode
+				 < vfs inode to add >
+	Output		:void
+	Return		:int
+				 < result, -ENOSPC if the block has no room >
+
+	Description	:add link to a single directory block
+==================================================================================
+*/
+static int addDirEntryToBlock( struct inode *dir,
+							   struct page *page,
+							   void *start,
+							   struct dentry *dentry,
+							   struct inode *inode )
+{
+	struct ext2_dir_entry	*dent;
+	const char				*name;
+	int						name_len;
+	unsigned short			rec_len;
+	unsigned short			used_len;
+	loff_t					pos;
+	int						err;
+	struct me2fs_dir_scan	scan;
+
+	name			= ( const char* )dentry->d_name.name;
+	name_len		= dentry->d_name.len;
+
+	scan.name		= dentry->d_name.name;
+	scan.len		= name_len;
+	scan.need		= ME2FS_DIR_REC_LEN( name_len );
+	scan.find_live	= 0;
+
+	dent = me2fsScanDirEntries( dir,
+								( char* )start,
+								( char* )start + dir->i_sb->s_blocksize,
+								&scan );
+
+	if( !dent )
+	{
+		return( -ENOSPC );
+	}
+
+	if( scan.found == ME2FS_SCAN_NAME )
+	{
+		return( -EEXIST );
+	}
+
+	rec_len		= le16_to_cpu( dent->rec_len );
+	used_len	= dent->inode ? ME2FS_DIR_REC_LEN( dent->name_len ) : 0;
+
+	pos = page_offset( page ) + ( ( char* )dent - ( char* )page_address( page ) );
+
+	lock_page( page );
+
+	if( ( err = me2fsPrepareWriteBlock( page, pos, rec_len ) ) )
+	{
+		unlock_page( page );
+		return( err );
+	}
+
+	if( dent->inode )
+	{
+		struct ext2_dir_entry	*new_dent;
+
+		new_dent			= ( struct ext2_dir_entry* )( ( char* )dent
+														  + used_len );
+		new_dent->rec_len	= cpu_to_le16( rec_len - used_len );
+		dent->rec_len		= cpu_to_le16( used_len );
+		dent				= new_dent;
+	}
+
+	dent->name_len	= name_len;
+	memcpy( dent->name, name, name_len );
+	dent->inode		= cpu_to_le32( inode->i_ino );
+	me2fsSetDirEntryType( dent, inode );
+
+	err = me2fsCommitBlockWrite( page, pos, rec_len );
+
+	me2fsDirSummaryUpdate( dir,
+						   page,
+						   ( char* )start - ( char* )page_address( page ),
+						   1 );
+
+	dir->i_mtime = CURRENT_TIME_SEC;
+	dir->i_ctime = dir->i_mtime;
+	mark_inode_dirty( dir );
+
+	return( err );
+}
+
+/*
+==================================================================================
+	Function	:packDirEntries
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 void *to
+				 < block to pack into >
+				 void *from
+				 < block which has the entries >
+				 struct dx_map_entry *map
+				 < entries to pack >
+				 int count
+				 < number of entries >
+	Output		:void *to
+				 < packed block >
+	Return		:void*
+				 < last entry >
+
+	Description	:copy entries without gaps, the last one gets the rest of block
+==================================================================================
+*/
+static void*
+packDirEntries( struct inode *dir,
+				void *to,
+				void *from,
+				struct dx_map_entry *map,
+				int count )
+{
+	struct ext2_dir_entry	*last;
+	char					*cur;
+	int						i;
+
+	cur		= to;
+	last	= NULL;
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		memcpy( cur, ( char* )from + map[ i ].offs, map[ i ].size );
+		last			= ( struct ext2_dir_entry* )cur;
+		last->rec_len	= cpu_to_le16( map[ i ].size );
+		cur				+= map[ i ].size;
+	}
+
+	last->rec_len = cpu_to_le16( ( char* )to + dir->i_sb->s_blocksize
+								 - ( char* )last );
+
+	return( last );
+}
+
+/*
+==================================================================================
+	Function	:removeDirEntries
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 void *start
+				 < start of the block >
+				 struct dx_map_entry *map
+				 < entries to remove >
+				 int count
+				 < number of entries >
+	Output		:void
+	Return		:void
+
+	Description	:remove entries from a block without moving the others. the
+				 space of an entry goes to the one before it, as a delete
+				 does
+==================================================================================
+*/
+static void removeDirEntries( struct inode *dir,
+							  void *start,
+							  struct dx_map_entry *map,
+							  int count )
+{
+	struct ext2_dir_entry	*dent;
+	struct ext2_dir_entry	*prev;
+	char					*end;
+	int						i;
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		dent = ( struct ext2_dir_entry* )( ( char* )start + map[ i ].offs );
+		dent->inode = 0;
+	}
+
+	prev	= NULL;
+	dent	= ( struct ext2_dir_entry* )start;
+	end		= ( char* )start + dir->i_sb->s_blocksize;
+
+	while( ( char* )dent < end )
+	{
+		struct ext2_dir_entry	*next;
+
+		next = ( struct ext2_dir_entry* )( ( char* )dent
+										   + le16_to_cpu( dent->rec_len ) );
+
+		if( !dent->inode && prev )
+		{
+			prev->rec_len = cpu_to_le16( le16_to_cpu( prev->rec_len )
+										 + le16_to_cpu( dent->rec_len ) );
+		}
+		else
+		{
+			prev = dent;
+		}
+
+		dent = next;
+	}
+}
@@ -0,0 +1,150 @@
+/*********************************************************************************
+	File			: me2fs_dx.h
+	Description		: Definitions for hashed directory index
+
+*********************************************************************************/
+#ifndef	__ME2FS_DX_H__
+#define	__ME2FS_DX_H__
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+/* the index is broken and the caller should fall back to linear format.		*/
+/* older kernels lack the errno, alias it the same way as ext4 and xfs do		*/
+#ifndef	EFSCORRUPTED
+#define	EFSCORRUPTED			EUCLEAN
+#endif
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsHasDirIndex
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:int
+				 < 0:dir_index feature is off 1:on >
+
+	Description	:test dir_index feature of the file system
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsHasDirIndex( struct super_block *sb );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsIsDxDir
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+	Output		:void
+	Return		:int
+				 < 0:linear directory 1:indexed directory >
+
+	Description	:test whether the directory is looked up through the index
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsIsDxDir( struct inode *dir );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDxCanIndex
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+	Output		:void
+	Return		:int
+				 < 0:keep linear 1:convert >
+
+	Description	:test whether a linear directory should be converted into
+				 an indexed one when its first block is full
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDxCanIndex( struct inode *dir );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDxFindEntry
+	Input		:struct inode *dir
+				 < vfs inode of directory >
+				 struct qstr *child
+				 < query;child of directory >
+				 struct page **res_page
+				 < output >
+				 int *err
+				 < output >
+	Output		:struct page **res_page
+				 < the entry was found in >
+				 int *err
+				 < 0 or error, -EFSCORRUPTED if index is broken >
+	Return		:struct ext2_dir_entry*
+				 < found entry >
+
+	Description	:find an entry through the hash index. page is returned
+				 mapped and unlocked.
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+struct ext2_dir_entry*
+me2fsDxFindEntry( struct inode *dir,
+				  struct qstr *child,
+				  struct page **res_page,
+				  int *err );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDxAddLink
+	Input		:struct dentry *dentry
+				 < vfs dentry >
+				 struct inode *inode
+				 < vfs inode >
+	Output		:void
+	Return		:int
+				 < result, -EFSCORRUPTED if index is broken >
+
+	Description	:add link to an indexed directory
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDxAddLink( struct dentry *dentry, struct inode *inode );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDxMakeIndexed
+	Input		:struct dentry *dentry
+				 < vfs dentry >
+				 struct inode *inode
+				 < vfs inode >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:convert a full single block directory into an indexed
+				 directory and add link to it
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDxMakeIndexed( struct dentry *dentry, struct inode *inode );
+
+#endif	// __ME2FS_DX_H__
@@ -0,0 +1,690 @@
+/********************************************************************************
+	File			: me2fs_falloc.c
+	Description		: Preallocation of file blocks of my ext2 file system
+
+*********************************************************************************/
+#include <linux/buffer_head.h>
+#include <linux/falloc.h>
+#include <linux/quotaops.h>
+
+#include "me2fs.h"
+#include "me2fs_util.h"
+#include "me2fs_block.h"
+#include "me2fs_inode.h"
+#include "me2fs_falloc.h"
+#include "me2fs_inline.h"
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static int reserveBlocks( struct inode *inode, unsigned long count );
+static void releaseBlocks( struct inode *inode );
+static unsigned long
+metaBlocksForRange( struct inode *inode, unsigned long nr );
+static int
+countHoles( struct inode *inode,
+			sector_t start,
+			sector_t end,
+			unsigned long *holes );
+static int allocRange( struct inode *inode, sector_t start, sector_t end );
+static long punchHole( struct file *file, loff_t offset, loff_t len );
+static int zeroPartial( struct file *file, loff_t from, loff_t length );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+/* blocks mapped by one call, far more than an indirect block maps				*/
+#define	FALLOC_MAX_BLOCKS		65536
+/* blocks allocated by one call. they are zeroed under truncate_mutex, which	*/
+/* readers of the file wait on for every hole									*/
+#define	FALLOC_ZERO_BLOCKS		256
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFallocate
+	Input		:struct file *file
+				 < vfs file object >
+				 int mode
+				 < FALLOC_FL_xxx >
+				 loff_t offset
+				 < start of range in bytes >
+				 loff_t len
+				 < length of range in bytes >
+	Output		:void
+	Return		:long
+				 < result >
+
+	Description	:fallocate of file operations
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+long me2fsFallocate( struct file *file, int mode, loff_t offset, loff_t len )
+{
+	struct inode		*inode;
+	struct super_block	*sb;
+	sector_t			start;
+	sector_t			end;
+	unsigned long		holes;
+	loff_t				new_size;
+	long				ret;
+
+	inode	= file_inode( file );
+	sb		= inode->i_sb;
+
+	if( mode & ~( FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE ) )
+	{
+		return( -EOPNOTSUPP );
+	}
+
+	if( !S_ISREG( inode->i_mode ) )
+	{
+		return( -ENODEV );
+	}
+
+	if( mode & FALLOC_FL_PUNCH_HOLE )
+	{
+		/* the size of a file never changes by punching a hole					*/
+		if( !( mode & FALLOC_FL_KEEP_SIZE ) )
+		{
+			return( -EOPNOTSUPP );
+		}
+
+		return( punchHole( file, offset, len ) );
+	}
+
+	new_size	= offset + len;
+	start		= offset >> inode->i_blkbits;
+	end			= ( new_size + sb->s_blocksize - 1 ) >> inode->i_blkbits;
+
+	mutex_lock( &inode->i_mutex );
+
+	/* blocks are never allocated under data kept in the inode					*/
+	if( ( ret = me2fsConvertInline( inode ) ) )
+	{
+		goto out;
+	}
+
+	if( !( mode & FALLOC_FL_KEEP_SIZE ) )
+	{
+		if( ( ret = inode_newsize_ok( inode, new_size ) ) )
+		{
+			goto out;
+		}
+	}
+	else if( sb->s_maxbytes < new_size )
+	{
+		ret = -EFBIG;
+		goto out;
+	}
+	else if( i_size_read( inode ) < new_size )
+	{
+		/* -------------------------------------------------------------------- */
+		/* ext2 has no way to keep blocks beyond the end of file, e2fsck takes	*/
+		/* them for a wrong size												*/
+		/* -------------------------------------------------------------------- */
+		ret = -EOPNOTSUPP;
+		goto out;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* write delayed blocks in the range first, or their pages might be			*/
+	/* written over the zeroes of the blocks allocated here						*/
+	/* ------------------------------------------------------------------------ */
+	if( ME2FS_SB( sb )->s_mount_opt & EXT2_MOUNT_DELALLOC )
+	{
+		ret = filemap_write_and_wait_range( inode->i_mapping,
+											offset,
+											new_size - 1 );
+		if( ret )
+		{
+			goto out;
+		}
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* quota and free space are reserved once for the whole range. the first	*/
+	/* try takes the range for one hole, and only if that does not fit are		*/
+	/* the holes really counted													*/
+	/* ------------------------------------------------------------------------ */
+	holes	= end - start;
+	ret		= reserveBlocks( inode, holes + metaBlocksForRange( inode, holes ) );
+
+	if( ( ret == -ENOSPC ) || ( ret == -EDQUOT ) )
+	{
+		if( !( ret = countHoles( inode, start, end, &holes ) ) )
+		{
+			ret = reserveBlocks( inode,
+								 holes + metaBlocksForRange( inode, holes ) );
+		}
+	}
+
+	if( ret )
+	{
+		goto out;
+	}
+
+	ret = allocRange( inode, start, end );
+
+	releaseBlocks( inode );
+
+	if( !ret )
+	{
+		inode->i_ctime = CURRENT_TIME_SEC;
+
+		if( !( mode & FALLOC_FL_KEEP_SIZE ) &&
+			( i_size_read( inode ) < new_size ) )
+		{
+			i_size_write( inode, new_size );
+		}
+
+		mark_inode_dirty( inode );
+	}
+
+out:
+	mutex_unlock( &inode->i_mutex );
+
+	return( ret );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFallocClaimBlocks
+	Input		:struct inode *inode
+				 < vfs inode >
+				 unsigned long data_blks
+				 < number of data blocks just allocated >
+				 unsigned long meta_blks
+				 < number of indirect blocks just allocated >
+	Output		:void
+	Return		:void
+
+	Description	:charge blocks allocated by fallocate to its reservation
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsFallocClaimBlocks( struct inode *inode,
+							 unsigned long data_blks,
+							 unsigned long meta_blks )
+{
+	struct me2fs_inode_info	*mi;
+	unsigned long			claimed;
+
+	mi = ME2FS_I( inode );
+
+	spin_lock( &mi->i_da_lock );
+	{
+		claimed = min( data_blks + meta_blks, mi->i_falloc_blocks );
+		mi->i_falloc_blocks -= claimed;
+	}
+	spin_unlock( &mi->i_da_lock );
+
+	me2fsUnreserveBlocks( inode->i_sb, claimed );
+	dquot_claim_block( inode, claimed );
+
+	/* ------------------------------------------------------------------------ */
+	/* the reservation is an upper bound, so this is never expected				*/
+	/* ------------------------------------------------------------------------ */
+	if( claimed < ( data_blks + meta_blks ) )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:allocated more blocks than reserved "
+					 "- ino=%lu, blocks=%lu, reserved=%lu\n",
+					 __func__, inode->i_ino, data_blks + meta_blks, claimed );
+		dquot_alloc_block_nofail( inode, data_blks + meta_blks - claimed );
+	}
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:void
+	Input		:void
+	Output		:void
+	Return		:void
+
+	Description	:void
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Local Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+==================================================================================
+	Function	:reserveBlocks
+	Input		:struct inode *inode
+				 < vfs inode >
+				 unsigned long count
+				 < number of blocks to reserve >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:reserve quota and free space for a fallocate call
+==================================================================================
+*/
+static int reserveBlocks( struct inode *inode, unsigned long count )
+{
+	struct me2fs_inode_info	*mi;
+	int						ret;
+
+	mi = ME2FS_I( inode );
+
+	if( ( ret = dquot_reserve_block( inode, count ) ) )
+	{
+		return( ret );
+	}
+
+	if( ( ret = me2fsReserveBlocks( inode->i_sb, count ) ) )
+	{
+		dquot_release_reservation_block( inode, count );
+		return( ret );
+	}
+
+	spin_lock( &mi->i_da_lock );
+	{
+		mi->i_falloc_blocks = count;
+	}
+	spin_unlock( &mi->i_da_lock );
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:releaseBlocks
+	Input		:struct inode *inode
+				 < vfs inode >
+	Output		:void
+	Return		:void
+
+	Description	:give back what a fallocate call did not use of its reservation
+==================================================================================
+*/
+static void releaseBlocks( struct inode *inode )
+{
+	struct me2fs_inode_info	*mi;
+	unsigned long			left;
+
+	mi = ME2FS_I( inode );
+
+	spin_lock( &mi->i_da_lock );
+	{
+		left				= mi->i_falloc_blocks;
+		mi->i_falloc_blocks	= 0;
+	}
+	spin_unlock( &mi->i_da_lock );
+
+	if( left )
+	{
+		me2fsUnreserveBlocks( inode->i_sb, left );
+		dquot_release_reservation_block( inode, left );
+	}
+}
+
+/*
+==================================================================================
+	Function	:metaBlocksForRange
+	Input		:struct inode *inode
+				 < vfs inode >
+				 unsigned long nr
+				 < number of data blocks to allocate >
+	Output		:void
+	Return		:unsigned long
+				 < number of indirect blocks they may need >
+
+	Description	:upper bound of indirect blocks to map nr data blocks
+==================================================================================
+*/
+static unsigned long
+metaBlocksForRange( struct inode *inode, unsigned long nr )
+{
+	unsigned long	apb;
+
+	if( !nr )
+	{
+		return( 0 );
+	}
+
+	apb = inode->i_sb->s_blocksize / sizeof( __u32 );
+
+	/* ------------------------------------------------------------------------ */
+	/* a run of nr blocks spans at most nr / apb + 2 indirect blocks,			*/
+	/* nr / apb^2 + 2 double indirect blocks and the triple indirect block		*/
+	/* ------------------------------------------------------------------------ */
+	return( ( nr / apb + 2 ) + ( nr / ( apb * apb ) + 2 ) + 1 );
+}
+
+/*
+==================================================================================
+	Function	:countHoles
+	Input		:struct inode *inode
+				 < vfs inode >
+				 sector_t start
+				 < first block of range >
+				 sector_t end
+				 < end of range (exclusive) >
+				 unsigned long *holes
+				 < output >
+	Output		:unsigned long *holes
+				 < number of blocks not allocated in the range >
+	Return		:int
+				 < result >
+
+	Description	:count blocks in a range which fallocate has to allocate
+==================================================================================
+*/
+static int
+countHoles( struct inode *inode,
+			sector_t start,
+			sector_t end,
+			unsigned long *holes )
+{
+	struct buffer_head	map;
+	sector_t			iblock;
+	int					ret;
+
+	*holes = 0;
+
+	for( iblock = start ; iblock < end ; )
+	{
+		map.b_state	= 0;
+		map.b_size	= min_t( sector_t, end - iblock, FALLOC_MAX_BLOCKS )
+					  << inode->i_blkbits;
+
+		if( ( ret = me2fsGetBlock( inode, iblock, &map, 0 ) ) )
+		{
+			return( ret );
+		}
+
+		if( buffer_mapped( &map ) )
+		{
+			iblock += map.b_size >> inode->i_blkbits;
+		}
+		else
+		{
+			( *holes )++;
+			iblock++;
+		}
+
+		cond_resched( );
+	}
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:allocRange
+	Input		:struct inode *inode
+				 < vfs inode >
+				 sector_t start
+				 < first block of range >
+				 sector_t end
+				 < end of range (exclusive) >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:allocate all holes in a range, one contiguous run under an
+				 indirect block at a time. get block zeroes new blocks, so
+				 runs are kept short
+==================================================================================
+*/
+static int allocRange( struct inode *inode, sector_t start, sector_t end )
+{
+	struct buffer_head	map;
+	sector_t			iblock;
+	unsigned long		count;
+	int					ret;
+
+	for( iblock = start ; iblock < end ; iblock += count )
+	{
+		map.b_state	= 0;
+		map.b_size	= min_t( sector_t, end - iblock, FALLOC_ZERO_BLOCKS )
+					  << inode->i_blkbits;
+
+		ret = me2fsGetBlock( inode, iblock, &map, ME2FS_GET_BLOCKS_PREALLOC );
+
+		if( ret )
+		{
+			return( ret );
+		}
+
+		count = map.b_size >> inode->i_blkbits;
+
+		if( fatal_signal_pending( current ) )
+		{
+			return( -EINTR );
+		}
+
+		cond_resched( );
+	}
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:punchHole
+	Input		:struct file *file
+				 < vfs file object >
+				 loff_t offset
+				 < start of range in bytes >
+				 loff_t len
+				 < length of range in bytes >
+	Output		:void
+	Return		:long
+				 < result >
+
+	Description	:free the blocks inside a range and zero the rest of it
+==================================================================================
+*/
+static long punchHole( struct file *file, loff_t offset, loff_t len )
+{
+	struct inode	*inode;
+	unsigned long	blocksize;
+	loff_t			size;
+	loff_t			end;
+	sector_t		first;
+	sector_t		last;
+	long			ret;
+
+	inode		= file_inode( file );
+	blocksize	= inode->i_sb->s_blocksize;
+	ret			= 0;
+
+	mutex_lock( &inode->i_mutex );
+
+	size = i_size_read( inode );
+
+	if( size <= offset )
+	{
+		goto out;
+	}
+
+	if( ( ret = me2fsConvertInline( inode ) ) )
+	{
+		goto out;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* a range reaching the end of file takes the whole last block				*/
+	/* ------------------------------------------------------------------------ */
+	end = offset + len;
+
+	if( ( size <= end ) || ( end < offset ) )
+	{
+		end = ( size + blocksize - 1 ) & ~( ( loff_t )blocksize - 1 );
+	}
+
+	inode_dio_wait( inode );
+
+	/* ------------------------------------------------------------------------ */
+	/* no fault brings a page of the range in until its blocks are freed		*/
+	/* ------------------------------------------------------------------------ */
+	down_write( &ME2FS_I( inode )->i_mmap_sem );
+
+	/* ------------------------------------------------------------------------ */
+	/* drop the pages first. delayed blocks give back their reservations here	*/
+	/* and no page is written back to a block after it has been freed			*/
+	/* ------------------------------------------------------------------------ */
+	truncate_pagecache_range( inode, offset, end - 1 );
+
+	first	= ( offset + blocksize - 1 ) >> inode->i_blkbits;
+	last	= end >> inode->i_blkbits;
+
+	if( last < first )
+	{
+		/* the range is inside one block										*/
+		ret = zeroPartial( file, offset, end - offset );
+		up_write( &ME2FS_I( inode )->i_mmap_sem );
+		goto out_time;
+	}
+
+	ret = zeroPartial( file, offset, ( ( loff_t )first << inode->i_blkbits )
+									 - offset );
+	if( !ret )
+	{
+		ret = zeroPartial( file,
+						   ( loff_t )last << inode->i_blkbits,
+						   end - ( ( loff_t )last << inode->i_blkbits ) );
+	}
+
+	if( ret )
+	{
+		up_write( &ME2FS_I( inode )->i_mmap_sem );
+		goto out;
+	}
+
+	me2fsPunchBlocks( inode, first, last );
+
+	/* ------------------------------------------------------------------------ */
+	/* read( ) is not kept out, it may fault on a mapping of this very file		*/
+	/* while copying. a page it read from a freed block meanwhile is dropped	*/
+	/* now, after waiting for its read to end									*/
+	/* ------------------------------------------------------------------------ */
+	truncate_pagecache_range( inode,
+							  ( loff_t )first << inode->i_blkbits,
+							  ( ( loff_t )last << inode->i_blkbits ) - 1 );
+
+	up_write( &ME2FS_I( inode )->i_mmap_sem );
+
+out_time:
+	inode->i_ctime = CURRENT_TIME_SEC;
+	inode->i_mtime = inode->i_ctime;
+
+	if( inode_needs_sync( inode ) )
+	{
+		sync_mapping_buffers( inode->i_mapping );
+		sync_inode_metadata( inode, 1 );
+	}
+	else
+	{
+		mark_inode_dirty( inode );
+	}
+
+out:
+	mutex_unlock( &inode->i_mutex );
+
+	return( ret );
+}
+
+/*
+==================================================================================
+	Function	:zeroPartial
+	Input		:struct file *file
+				 < vfs file object >
+				 loff_t from
+				 < start of range in bytes >
+				 loff_t length
+				 < length of range, not beyond a block >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:zero part of a block which a hole does not free
+==================================================================================
+*/
+static int zeroPartial( struct file *file, loff_t from, loff_t length )
+{
+	struct inode			*inode;
+	struct address_space	*mapping;
+	struct buffer_head		map;
+	struct page				*page;
+	void					*fsdata;
+	loff_t					size;
+	int						ret;
+
+	mapping	= file->f_mapping;
+	inode	= mapping->host;
+	size	= i_size_read( inode );
+
+	/* never write beyond the end of file, it would extend the file				*/
+	if( size <= from )
+	{
+		return( 0 );
+	}
+
+	length = min( length, size - from );
+
+	if( length <= 0 )
+	{
+		return( 0 );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* a hole reads as zeroes already, do not allocate for it. a delayed block	*/
+	/* is not mapped either, its page has been zeroed by the page cache			*/
+	/* ------------------------------------------------------------------------ */
+	map.b_state	= 0;
+	map.b_size	= 1 << inode->i_blkbits;
+
+	if( ( ret = me2fsGetBlock( inode, from >> inode->i_blkbits, &map, 0 ) ) )
+	{
+		return( ret );
+	}
+
+	if( !buffer_mapped( &map ) )
+	{
+		return( 0 );
+	}
+
+	ret = pagecache_write_begin( file, mapping, from, length,
+								 AOP_FLAG_UNINTERRUPTIBLE, &page, &fsdata );
+	if( ret )
+	{
+		return( ret );
+	}
+
+	zero_user( page, from & ( PAGE_CACHE_SIZE - 1 ), length );
+
+	ret = pagecache_write_end( file, mapping, from, length, length,
+							   page, fsdata );
+
+	return( ( ret < 0 ) ? ret : 0 );
+}
@@ -0,0 +1,80 @@
+/*********************************************************************************
+	File			: me2fs_falloc.h
+	Description		: Definitions for preallocation of file blocks
+
+*********************************************************************************/
+#ifndef	__ME2FS_FALLOC_H__
+#define	__ME2FS_FALLOC_H__
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFallocate
+	Input		:struct file *file
+				 < vfs file object >
+				 int mode
+				 < FALLOC_FL_xxx >
+				 loff_t offset
+				 < start of range in bytes >
+				 loff_t len
+				 < length of range in bytes >
+	Output		:void
+	Return		:long
+				 < result >
+
+	Description	:fallocate of file operations
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+long me2fsFallocate( struct file *file, int mode, loff_t offset, loff_t len );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFallocClaimBlocks
+	Input		:struct inode *inode
+				 < vfs inode >
+				 unsigned long data_blks
+				 < number of data blocks just allocated >
+				 unsigned long meta_blks
+				 < number of indirect blocks just allocated >
+	Output		:void
+	Return		:void
+
+	Description	:charge blocks allocated by fallocate to its reservation
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsFallocClaimBlocks( struct inode *inode,
+							 unsigned long data_blks,
+							 unsigned long meta_blks );
+
+#endif	// __ME2FS_FALLOC_H__
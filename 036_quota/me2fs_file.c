@@ -13,6 +13,7 @@
 #include "me2fs_block.h"
 #include "me2fs_xattr.h"
 #include "me2fs_acl.h"
+#include "me2fs_falloc.h"
 
 
 /*
@@ -23,6 +24,11 @@
 ==================================================================================
 */
 static int me2fsReleaseFile( struct inode *inode, struct file *file );
+static int me2fsFileMmap( struct file *file, struct vm_area_struct *vma );
+static int me2fsFilemapFault( struct vm_area_struct *vma,
+							  struct vm_fault *vmf );
+static int me2fsPageMkwrite( struct vm_area_struct *vma,
+							 struct vm_fault *vmf );
 
 /*
 ==================================================================================
@@ -52,7 +58,7 @@ const struct file_operations me2fs_file_operations =
 	//.aio_write		= generic_file_aio_write,
 	.unlocked_ioctl	= me2fsIoctl,
 	.compat_ioctl	= me2fsCompatIoctl,
-	.mmap			= generic_file_mmap,
+	.mmap			= me2fsFileMmap,
 	//.open			= generic_file_open,
 	.open			= dquot_file_open,
 	.release		= me2fsReleaseFile,
@@ -60,6 +66,7 @@ const struct file_operations me2fs_file_operations =
 	.splice_read	= generic_file_splice_read,
 	//.splice_write	= generic_file_splice_write,
 	.splice_write	= iter_file_splice_write,
+	.fallocate		= me2fsFallocate,
 
 };
 const struct inode_operations me2fs_file_inode_operations =
@@ -76,6 +83,17 @@ const struct inode_operations me2fs_file_inode_operations =
 	.set_acl		= me2fsSetAcl,
 };
 
+/* ---------------------------------------------------------------------------- */
+/* faults which bring pages in are kept out while a hole is punched				*/
+/* ---------------------------------------------------------------------------- */
+static const struct vm_operations_struct me2fs_file_vm_ops =
+{
+	.fault			= me2fsFilemapFault,
+	.map_pages		= filemap_map_pages,
+	.page_mkwrite	= me2fsPageMkwrite,
+	.remap_pages	= generic_file_remap_pages,
+};
+
 
 /*
 ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -128,3 +146,92 @@ static int me2fsReleaseFile( struct inode *inode, struct file *filp )
 
 	return( 0 );
 }
+
+/*
+==================================================================================
+	Function	:me2fsFileMmap
+	Input		:struct file *file
+				 < vfs file object >
+				 struct vm_area_struct *vma
+				 < vm area to map the file >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:mmap of file operations
+==================================================================================
+*/
+static int me2fsFileMmap( struct file *file, struct vm_area_struct *vma )
+{
+	if( !file->f_mapping->a_ops->readpage )
+	{
+		return( -ENOEXEC );
+	}
+
+	file_accessed( file );
+	vma->vm_ops = &me2fs_file_vm_ops;
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:me2fsFilemapFault
+	Input		:struct vm_area_struct *vma
+				 < vm area of the file >
+				 struct vm_fault *vmf
+				 < fault information >
+	Output		:void
+	Return		:int
+				 < VM_FAULT_xxx >
+
+	Description	:read a page of a mapped file, not while a hole is punched
+==================================================================================
+*/
+static int me2fsFilemapFault( struct vm_area_struct *vma,
+							  struct vm_fault *vmf )
+{
+	struct inode	*inode;
+	int				ret;
+
+	inode = file_inode( vma->vm_file );
+
+	down_read( &ME2FS_I( inode )->i_mmap_sem );
+	{
+		ret = filemap_fault( vma, vmf );
+	}
+	up_read( &ME2FS_I( inode )->i_mmap_sem );
+
+	return( ret );
+}
+
+/*
+==================================================================================
+	Function	:me2fsPageMkwrite
+	Input		:struct vm_area_struct *vma
+				 < vm area of the file >
+				 struct vm_fault *vmf
+				 < fault information >
+	Output		:void
+	Return		:int
+				 < VM_FAULT_xxx >
+
+	Description	:make a mapped page writable, not while a hole is punched
+==================================================================================
+*/
+static int me2fsPageMkwrite( struct vm_area_struct *vma,
+							 struct vm_fault *vmf )
+{
+	struct inode	*inode;
+	int				ret;
+
+	inode = file_inode( vma->vm_file );
+
+	down_read( &ME2FS_I( inode )->i_mmap_sem );
+	{
+		ret = filemap_page_mkwrite( vma, vmf );
+	}
+	up_read( &ME2FS_I( inode )->i_mmap_sem );
+
+	return( ret );
+}
@@ -0,0 +1,993 @@
+/********************************************************************************
+	File			: me2fs_freemap.c
+	Description		: Free extent index of my ext2 file system
+
+*********************************************************************************/
+#include <linux/buffer_head.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/rbtree_augmented.h>
+
+#include "me2fs.h"
+#include "me2fs_util.h"
+#include "me2fs_freemap.h"
+#include "me2fs_grpinfo.h"
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+struct me2fs_free_extent;
+
+static void buildFreeMap( struct super_block *sb,
+						  unsigned long group,
+						  struct buffer_head *bitmap_bh );
+static void dropFreeMap( struct me2fs_free_map *map );
+static void dropGroupFreeMap( struct super_block *sb, unsigned long group );
+static int searchFreeMap( struct me2fs_free_map *map,
+						  unsigned long start,
+						  unsigned long end,
+						  unsigned long want,
+						  unsigned long *found );
+static struct me2fs_free_extent*
+findFreeExtent( struct rb_root *root, unsigned long block );
+static struct me2fs_free_extent*
+findFitAfter( struct rb_root *root, unsigned long block, unsigned long want );
+static void
+insertFreeExtent( struct rb_root *root, struct me2fs_free_extent *ext );
+static inline unsigned int
+computeMaxLen( struct me2fs_free_extent *ext );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+/*
+---------------------------------------------------------------------------------
+	Free Extent
+	max_len is the longest extent in the subtree, which lets a search skip
+	every subtree without a long enough extent
+---------------------------------------------------------------------------------
+*/
+struct me2fs_free_extent
+{
+	struct rb_node	node;
+	unsigned int	start;			/* first free block (group relative)		*/
+	unsigned int	len;			/* number of free blocks					*/
+	unsigned int	max_len;		/* longest extent in this subtree			*/
+};
+
+/* states of the index of a group												*/
+#define	FREE_MAP_UNBUILT		0	/* not built yet, or thrown away			*/
+#define	FREE_MAP_BUILDING		1	/* being built from the bitmap				*/
+#define	FREE_MAP_STALE			2	/* bitmap changed while building			*/
+#define	FREE_MAP_READY			3	/* exactly matches the bitmap				*/
+#define	FREE_MAP_FRAGMENTED		4	/* too many extents to be worth indexing	*/
+
+/* a group with more free extents is searched in the bitmap						*/
+#define	FREE_MAP_MAX_EXTENTS	2048
+
+RB_DECLARE_CALLBACKS( static, freeExtentCallbacks, struct me2fs_free_extent,
+					  node, unsigned int, max_len, computeMaxLen )
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInitFreeMaps
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:allocate empty free extent indexes of all block groups
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInitFreeMaps( struct super_block *sb )
+{
+	struct me2fs_sb_info	*msi;
+	unsigned long			group;
+
+	msi = ME2FS_SB( sb );
+
+	msi->s_free_maps = vzalloc( msi->s_groups_count
+								* sizeof( struct me2fs_free_map ) );
+
+	if( !msi->s_free_maps )
+	{
+		return( -ENOMEM );
+	}
+
+	for( group = 0 ; group < msi->s_groups_count ; group++ )
+	{
+		msi->s_free_maps[ group ].root	= RB_ROOT;
+		msi->s_free_maps[ group ].state	= FREE_MAP_UNBUILT;
+	}
+
+	return( 0 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDestroyFreeMaps
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:void
+
+	Description	:release free extent indexes of all block groups
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDestroyFreeMaps( struct super_block *sb )
+{
+	struct me2fs_sb_info	*msi;
+	unsigned long			group;
+
+	msi = ME2FS_SB( sb );
+
+	if( !msi->s_free_maps )
+	{
+		return;
+	}
+
+	for( group = 0 ; group < msi->s_groups_count ; group++ )
+	{
+		dropFreeMap( &msi->s_free_maps[ group ] );
+	}
+
+	vfree( msi->s_free_maps );
+	msi->s_free_maps = NULL;
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFreeMapSearch
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 struct buffer_head *bitmap_bh
+				 < block bitmap of the group >
+				 unsigned long start
+				 < first block to search (group relative) >
+				 unsigned long end
+				 < end of search (group relative, exclusive) >
+				 unsigned long want
+				 < number of contiguous blocks wanted >
+				 unsigned long *found
+				 < output >
+	Output		:unsigned long *found
+				 < first block of a free run (group relative) >
+	Return		:int
+				 < 1:found 0:no free block -EAGAIN:no index for the group >
+
+	Description	:find a free run of want blocks nearest after start, or
+				 the first free block after start if there is no such run
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsFreeMapSearch( struct super_block *sb,
+						unsigned long group,
+						struct buffer_head *bitmap_bh,
+						unsigned long start,
+						unsigned long end,
+						unsigned long want,
+						unsigned long *found )
+{
+	struct me2fs_sb_info	*msi;
+	struct me2fs_free_map	*map;
+	int						ret;
+
+	msi = ME2FS_SB( sb );
+	map = &msi->s_free_maps[ group ];
+
+	if( map->state == FREE_MAP_UNBUILT )
+	{
+		buildFreeMap( sb, group, bitmap_bh );
+	}
+
+	spin_lock( getSbBlockGroupLock( msi, group ) );
+	{
+		if( map->state == FREE_MAP_READY )
+		{
+			ret = searchFreeMap( map, start, end, want, found );
+		}
+		else
+		{
+			ret = -EAGAIN;
+		}
+	}
+	spin_unlock( getSbBlockGroupLock( msi, group ) );
+
+	return( ret );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFreeMapUse
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 unsigned long start
+				 < first block set in bitmap (group relative) >
+				 unsigned long len
+				 < number of blocks >
+	Output		:void
+	Return		:void
+
+	Description	:remove blocks just set in the bitmap from the index.
+				 caller holds the block group lock
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsFreeMapUse( struct super_block *sb,
+					  unsigned long group,
+					  unsigned long start,
+					  unsigned long len )
+{
+	struct me2fs_free_map		*map;
+	struct me2fs_free_extent	*ext;
+	struct me2fs_free_extent	*tail_ext;
+	unsigned long				head;
+	unsigned long				tail;
+
+	map = &ME2FS_SB( sb )->s_free_maps[ group ];
+
+	if( map->state == FREE_MAP_BUILDING )
+	{
+		map->state = FREE_MAP_STALE;
+		return;
+	}
+
+	if( map->state != FREE_MAP_READY )
+	{
+		return;
+	}
+
+	ext = findFreeExtent( &map->root, start );
+
+	if( !ext || ( ( ext->start + ext->len ) < ( start + len ) ) )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:index out of step with bitmap - "
+					 "group=%lu, start=%lu, len=%lu\n",
+					 __func__, group, start, len );
+		dropGroupFreeMap( sb, group );
+		return;
+	}
+
+	head = start - ext->start;
+	tail = ext->start + ext->len - ( start + len );
+
+	if( !head && !tail )
+	{
+		rb_erase_augmented( &ext->node, &map->root, &freeExtentCallbacks );
+		kfree( ext );
+		map->nr_extents--;
+		return;
+	}
+
+	if( !head )
+	{
+		ext->start	+= len;
+		ext->len	-= len;
+		freeExtentCallbacks.propagate( &ext->node, NULL );
+		return;
+	}
+
+	ext->len = head;
+	freeExtentCallbacks.propagate( &ext->node, NULL );
+
+	if( !tail )
+	{
+		return;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* the run was taken from the middle of the extent, split it				*/
+	/* ------------------------------------------------------------------------ */
+	if( ( FREE_MAP_MAX_EXTENTS <= map->nr_extents ) ||
+		!( tail_ext = kmalloc( sizeof( *tail_ext ), GFP_ATOMIC ) ) )
+	{
+		dropGroupFreeMap( sb, group );
+		return;
+	}
+
+	tail_ext->start	= start + len;
+	tail_ext->len	= tail;
+	insertFreeExtent( &map->root, tail_ext );
+	map->nr_extents++;
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFreeMapRelease
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 unsigned long start
+				 < first block cleared in bitmap (group relative) >
+				 unsigned long len
+				 < number of blocks >
+	Output		:void
+	Return		:void
+
+	Description	:add blocks just cleared in the bitmap to the index.
+				 caller holds the block group lock
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsFreeMapRelease( struct super_block *sb,
+						  unsigned long group,
+						  unsigned long start,
+						  unsigned long len )
+{
+	struct me2fs_sb_info		*msi;
+	struct me2fs_free_map		*map;
+	struct me2fs_free_extent	*prev;
+	struct me2fs_free_extent	*next;
+	struct me2fs_free_extent	*ext;
+	struct rb_node				*node;
+	int							merge_prev;
+	int							merge_next;
+
+	msi = ME2FS_SB( sb );
+	map = &msi->s_free_maps[ group ];
+
+	switch( map->state )
+	{
+	case	FREE_MAP_BUILDING:
+		map->state = FREE_MAP_STALE;
+		return;
+	case	FREE_MAP_FRAGMENTED:
+		/* -------------------------------------------------------------------- */
+		/* try indexing again once enough blocks came back to the group			*/
+		/* -------------------------------------------------------------------- */
+		map->nr_freed += len;
+		if( ( msi->s_blocks_per_group / 8 ) < map->nr_freed )
+		{
+			map->nr_freed	= 0;
+			map->state		= FREE_MAP_UNBUILT;
+		}
+		return;
+	case	FREE_MAP_READY:
+		break;
+	default:
+		return;
+	}
+
+	prev = findFreeExtent( &map->root, start );
+
+	if( prev )
+	{
+		node = rb_next( &prev->node );
+	}
+	else
+	{
+		node = rb_first( &map->root );
+	}
+
+	next = node ? rb_entry( node, struct me2fs_free_extent, node ) : NULL;
+
+	if( ( prev && ( start < ( prev->start + prev->len ) ) ) ||
+		( next && ( next->start < ( start + len ) ) ) )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:index out of step with bitmap - "
+					 "group=%lu, start=%lu, len=%lu\n",
+					 __func__, group, start, len );
+		dropGroupFreeMap( sb, group );
+		return;
+	}
+
+	merge_prev = prev && ( ( prev->start + prev->len ) == start );
+	merge_next = next && ( next->start == ( start + len ) );
+
+	if( merge_prev && merge_next )
+	{
+		prev->len += len + next->len;
+		rb_erase_augmented( &next->node, &map->root, &freeExtentCallbacks );
+		kfree( next );
+		map->nr_extents--;
+		freeExtentCallbacks.propagate( &prev->node, NULL );
+		return;
+	}
+
+	if( merge_prev )
+	{
+		prev->len += len;
+		freeExtentCallbacks.propagate( &prev->node, NULL );
+		return;
+	}
+
+	if( merge_next )
+	{
+		next->start	= start;
+		next->len	+= len;
+		freeExtentCallbacks.propagate( &next->node, NULL );
+		return;
+	}
+
+	if( ( FREE_MAP_MAX_EXTENTS <= map->nr_extents ) ||
+		!( ext = kmalloc( sizeof( *ext ), GFP_ATOMIC ) ) )
+	{
+		dropGroupFreeMap( sb, group );
+		return;
+	}
+
+	ext->start	= start;
+	ext->len	= len;
+	insertFreeExtent( &map->root, ext );
+	map->nr_extents++;
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFreeMapInvalidate
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+	Output		:void
+	Return		:void
+
+	Description	:throw away the index of a group whose bitmap changed in
+				 an unexpected way. caller holds the block group lock
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsFreeMapInvalidate( struct super_block *sb, unsigned long group )
+{
+	struct me2fs_free_map	*map;
+
+	map = &ME2FS_SB( sb )->s_free_maps[ group ];
+
+	if( map->state == FREE_MAP_BUILDING )
+	{
+		map->state = FREE_MAP_STALE;
+	}
+	else if( map->state == FREE_MAP_READY )
+	{
+		dropGroupFreeMap( sb, group );
+	}
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFreeMapLongest
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+	Output		:void
+	Return		:long
+				 < longest free extent, -1 if the group has no index >
+
+	Description	:get the length of the longest free extent of a group.
+				 caller holds the block group lock
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+long me2fsFreeMapLongest( struct super_block *sb, unsigned long group )
+{
+	struct me2fs_free_map	*map;
+
+	map = &ME2FS_SB( sb )->s_free_maps[ group ];
+
+	if( map->state != FREE_MAP_READY )
+	{
+		return( -1 );
+	}
+
+	if( !map->root.rb_node )
+	{
+		return( 0 );
+	}
+
+	return( rb_entry( map->root.rb_node,
+					  struct me2fs_free_extent,
+					  node )->max_len );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:void
+	Input		:void
+	Output		:void
+	Return		:void
+
+	Description	:void
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Local Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+==================================================================================
+	Function	:buildFreeMap
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 struct buffer_head *bitmap_bh
+				 < block bitmap of the group >
+	Output		:void
+	Return		:void
+
+	Description	:build the index of a group from its block bitmap. the
+				 bitmap is read without the lock, so the result is thrown
+				 away if the bitmap changed meanwhile
+==================================================================================
+*/
+static void buildFreeMap( struct super_block *sb,
+						  unsigned long group,
+						  struct buffer_head *bitmap_bh )
+{
+	struct me2fs_sb_info		*msi;
+	struct me2fs_free_map		*map;
+	struct me2fs_free_map		new_map;
+	struct me2fs_free_extent	*ext;
+	unsigned long				nr_blocks;
+	unsigned long				start;
+	unsigned long				end;
+	unsigned int				state;
+
+	msi = ME2FS_SB( sb );
+	map = &msi->s_free_maps[ group ];
+
+	spin_lock( getSbBlockGroupLock( msi, group ) );
+	{
+		if( map->state != FREE_MAP_UNBUILT )
+		{
+			spin_unlock( getSbBlockGroupLock( msi, group ) );
+			return;
+		}
+
+		map->state = FREE_MAP_BUILDING;
+	}
+	spin_unlock( getSbBlockGroupLock( msi, group ) );
+
+	/* ------------------------------------------------------------------------ */
+	/* the last group may be shorter than the others							*/
+	/* ------------------------------------------------------------------------ */
+	nr_blocks = le32_to_cpu( msi->s_esb->s_blocks_count )
+				- ext2GetFirstBlockNum( sb, group );
+
+	if( msi->s_blocks_per_group < nr_blocks )
+	{
+		nr_blocks = msi->s_blocks_per_group;
+	}
+
+	new_map.root		= RB_ROOT;
+	new_map.nr_extents	= 0;
+	state				= FREE_MAP_READY;
+	end					= 0;
+
+	for( start = find_next_zero_bit_le( bitmap_bh->b_data, nr_blocks, 0 )	;
+		 start < nr_blocks													;
+		 start = find_next_zero_bit_le( bitmap_bh->b_data, nr_blocks, end ) )
+	{
+		end = find_next_bit_le( bitmap_bh->b_data, nr_blocks, start );
+
+		if( FREE_MAP_MAX_EXTENTS <= new_map.nr_extents )
+		{
+			state = FREE_MAP_FRAGMENTED;
+			break;
+		}
+
+		if( !( ext = kmalloc( sizeof( *ext ), GFP_NOFS ) ) )
+		{
+			state = FREE_MAP_UNBUILT;
+			break;
+		}
+
+		ext->start	= start;
+		ext->len	= end - start;
+		insertFreeExtent( &new_map.root, ext );
+		new_map.nr_extents++;
+	}
+
+	spin_lock( getSbBlockGroupLock( msi, group ) );
+	{
+		if( ( map->state == FREE_MAP_BUILDING ) && ( state == FREE_MAP_READY ) )
+		{
+			map->root		= new_map.root;
+			map->nr_extents	= new_map.nr_extents;
+			map->state		= FREE_MAP_READY;
+			new_map.root	= RB_ROOT;
+
+			/* the longest run is known now, not only the free blocks			*/
+			me2fsGroupInfoAddBlocks( sb, group, 0 );
+		}
+		else if( map->state == FREE_MAP_BUILDING )
+		{
+			map->nr_freed	= 0;
+			map->state		= state;
+		}
+		else
+		{
+			/* stale, try again next time										*/
+			map->state		= FREE_MAP_UNBUILT;
+		}
+	}
+	spin_unlock( getSbBlockGroupLock( msi, group ) );
+
+	dropFreeMap( &new_map );
+}
+
+/*
+==================================================================================
+	Function	:dropFreeMap
+	Input		:struct me2fs_free_map *map
+				 < index of a group >
+	Output		:void
+	Return		:void
+
+	Description	:free all extents of the index and mark it unbuilt
+==================================================================================
+*/
+static void dropFreeMap( struct me2fs_free_map *map )
+{
+	struct rb_node	*node;
+
+	while( ( node = rb_first( &map->root ) ) )
+	{
+		rb_erase( node, &map->root );
+		kfree( rb_entry( node, struct me2fs_free_extent, node ) );
+	}
+
+	map->nr_extents	= 0;
+	map->state		= FREE_MAP_UNBUILT;
+}
+
+/*
+==================================================================================
+	Function	:dropGroupFreeMap
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+	Output		:void
+	Return		:void
+
+	Description	:drop the index of a group and let the group summary forget
+				 its longest run. caller holds the block group lock
+==================================================================================
+*/
+static void dropGroupFreeMap( struct super_block *sb, unsigned long group )
+{
+	dropFreeMap( &ME2FS_SB( sb )->s_free_maps[ group ] );
+	me2fsGroupInfoAddBlocks( sb, group, 0 );
+}
+
+/*
+==================================================================================
+	Function	:searchFreeMap
+	Input		:struct me2fs_free_map *map
+				 < index of a group >
+				 unsigned long start
+				 < first block to search >
+				 unsigned long end
+				 < end of search (exclusive) >
+				 unsigned long want
+				 < number of contiguous blocks wanted >
+				 unsigned long *found
+				 < output >
+	Output		:unsigned long *found
+				 < first block of a free run >
+	Return		:int
+				 < 1:found 0:no free block >
+
+	Description	:search the index of a group for a free run near start
+==================================================================================
+*/
+static int searchFreeMap( struct me2fs_free_map *map,
+						  unsigned long start,
+						  unsigned long end,
+						  unsigned long want,
+						  unsigned long *found )
+{
+	struct me2fs_free_extent	*ext;
+	struct me2fs_free_extent	*fit;
+	struct rb_node				*node;
+	unsigned long				ext_end;
+
+	/* ------------------------------------------------------------------------ */
+	/* start itself is free and the run from there is long enough				*/
+	/* ------------------------------------------------------------------------ */
+	ext = findFreeExtent( &map->root, start );
+
+	if( ext && ( start < ( ext->start + ext->len ) ) )
+	{
+		ext_end = min( ( unsigned long )( ext->start + ext->len ), end );
+
+		if( want <= ( ext_end - start ) )
+		{
+			*found = start;
+			return( 1 );
+		}
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* the nearest run which is long enough										*/
+	/* ------------------------------------------------------------------------ */
+	fit = findFitAfter( &map->root, start, want );
+
+	if( fit && ( fit->start < end ) )
+	{
+		*found = fit->start;
+		return( 1 );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* no run is long enough, take the first free block							*/
+	/* ------------------------------------------------------------------------ */
+	if( ext && ( start < ( ext->start + ext->len ) ) && ( start < end ) )
+	{
+		*found = start;
+		return( 1 );
+	}
+
+	node = ext ? rb_next( &ext->node ) : rb_first( &map->root );
+
+	if( node )
+	{
+		ext = rb_entry( node, struct me2fs_free_extent, node );
+
+		if( ext->start < end )
+		{
+			*found = ext->start;
+			return( 1 );
+		}
+	}
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:findFreeExtent
+	Input		:struct rb_root *root
+				 < tree of free extents >
+				 unsigned long block
+				 < block to look up >
+	Output		:void
+	Return		:struct me2fs_free_extent*
+				 < last extent which starts at or before the block >
+
+	Description	:look up the extent which may contain the block
+==================================================================================
+*/
+static struct me2fs_free_extent*
+findFreeExtent( struct rb_root *root, unsigned long block )
+{
+	struct rb_node				*node;
+	struct me2fs_free_extent	*ext;
+	struct me2fs_free_extent	*best;
+
+	node = root->rb_node;
+	best = NULL;
+
+	while( node )
+	{
+		ext = rb_entry( node, struct me2fs_free_extent, node );
+
+		if( block < ext->start )
+		{
+			node = node->rb_left;
+		}
+		else
+		{
+			best = ext;
+			node = node->rb_right;
+		}
+	}
+
+	return( best );
+}
+
+/*
+==================================================================================
+	Function	:findFitAfter
+	Input		:struct rb_root *root
+				 < tree of free extents >
+				 unsigned long block
+				 < search after this block >
+				 unsigned long want
+				 < length wanted >
+	Output		:void
+	Return		:struct me2fs_free_extent*
+				 < first extent after the block at least want long >
+
+	Description	:walk down toward the block remembering the nearest node or
+				 right subtree on the way which can satisfy want, then go
+				 down into the subtree. both walks are O(log n)
+==================================================================================
+*/
+static struct me2fs_free_extent*
+findFitAfter( struct rb_root *root, unsigned long block, unsigned long want )
+{
+	struct rb_node				*node;
+	struct rb_node				*subtree;
+	struct me2fs_free_extent	*ext;
+	struct me2fs_free_extent	*fit;
+
+	node	= root->rb_node;
+	subtree	= NULL;
+	fit		= NULL;
+
+	while( node )
+	{
+		ext = rb_entry( node, struct me2fs_free_extent, node );
+
+		if( ext->max_len < want )
+		{
+			break;
+		}
+
+		if( block < ext->start )
+		{
+			/* ---------------------------------------------------------------- */
+			/* this node and its right subtree come before any candidate found	*/
+			/* higher up the tree												*/
+			/* ---------------------------------------------------------------- */
+			if( want <= ext->len )
+			{
+				fit		= ext;
+				subtree	= NULL;
+			}
+			else if( node->rb_right &&
+					 ( want <= rb_entry( node->rb_right,
+										 struct me2fs_free_extent,
+										 node )->max_len ) )
+			{
+				fit		= NULL;
+				subtree	= node->rb_right;
+			}
+
+			node = node->rb_left;
+		}
+		else
+		{
+			node = node->rb_right;
+		}
+	}
+
+	if( fit || !subtree )
+	{
+		return( fit );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* leftmost extent of the subtree which is long enough						*/
+	/* ------------------------------------------------------------------------ */
+	node = subtree;
+
+	while( node )
+	{
+		ext = rb_entry( node, struct me2fs_free_extent, node );
+
+		if( node->rb_left &&
+			( want <= rb_entry( node->rb_left,
+								struct me2fs_free_extent,
+								node )->max_len ) )
+		{
+			node = node->rb_left;
+		}
+		else if( want <= ext->len )
+		{
+			return( ext );
+		}
+		else
+		{
+			node = node->rb_right;
+		}
+	}
+
+	return( NULL );
+}
+
+/*
+==================================================================================
+	Function	:insertFreeExtent
+	Input		:struct rb_root *root
+				 < tree of free extents >
+				 struct me2fs_free_extent *ext
+				 < extent to insert >
+	Output		:void
+	Return		:void
+
+	Description	:insert an extent which overlaps no other extent
+==================================================================================
+*/
+static void
+insertFreeExtent( struct rb_root *root, struct me2fs_free_extent *ext )
+{
+	struct rb_node				**link;
+	struct rb_node				*parent;
+	struct me2fs_free_extent	*cur;
+
+	link	= &root->rb_node;
+	parent	= NULL;
+
+	while( *link )
+	{
+		parent	= *link;
+		cur		= rb_entry( parent, struct me2fs_free_extent, node );
+
+		if( cur->max_len < ext->len )
+		{
+			cur->max_len = ext->len;
+		}
+
+		if( ext->start < cur->start )
+		{
+			link = &parent->rb_left;
+		}
+		else
+		{
+			link = &parent->rb_right;
+		}
+	}
+
+	ext->max_len = ext->len;
+	rb_link_node( &ext->node, parent, link );
+	rb_insert_augmented( &ext->node, root, &freeExtentCallbacks );
+}
+
+/*
+==================================================================================
+	Function	:computeMaxLen
+	Input		:struct me2fs_free_extent *ext
+				 < extent >
+	Output		:void
+	Return		:unsigned int
+				 < longest extent in the subtree >
+
+	Description	:augmented value of the tree
+==================================================================================
+*/
+static inline unsigned int
+computeMaxLen( struct me2fs_free_extent *ext )
+{
+	unsigned int	max_len;
+
+	max_len = ext->len;
+
+	if( ext->node.rb_left )
+	{
+		max_len = max( max_len, rb_entry( ext->node.rb_left,
+										  struct me2fs_free_extent,
+										  node )->max_len );
+	}
+
+	if( ext->node.rb_right )
+	{
+		max_len = max( max_len, rb_entry( ext->node.rb_right,
+										  struct me2fs_free_extent,
+										  node )->max_len );
+	}
+
+	return( max_len );
+}
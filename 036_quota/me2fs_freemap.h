@@ -0,0 +1,197 @@
+/*********************************************************************************
+	File			: me2fs_freemap.h
+	Description		: Definitions for in-memory free extent index
+
+*********************************************************************************/
+#ifndef	__ME2FS_FREEMAP_H__
+#define	__ME2FS_FREEMAP_H__
+
+#include <linux/rbtree.h>
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+/*
+---------------------------------------------------------------------------------
+	Free Extent Index of a Block Group
+	built from the block bitmap on first use, and kept in step with the
+	bitmap under the block group lock. the bitmap stays authoritative
+---------------------------------------------------------------------------------
+*/
+struct me2fs_free_map
+{
+	struct rb_root	root;			/* free extents sorted by start				*/
+	unsigned int	state;			/* FREE_MAP_xxx in me2fs_freemap.c			*/
+	unsigned int	nr_extents;		/* number of extents in the tree			*/
+	unsigned long	nr_freed;		/* blocks freed while too fragmented		*/
+};
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInitFreeMaps
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:allocate empty free extent indexes of all block groups
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInitFreeMaps( struct super_block *sb );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDestroyFreeMaps
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:void
+
+	Description	:release free extent indexes of all block groups
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDestroyFreeMaps( struct super_block *sb );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFreeMapSearch
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 struct buffer_head *bitmap_bh
+				 < block bitmap of the group >
+				 unsigned long start
+				 < first block to search (group relative) >
+				 unsigned long end
+				 < end of search (group relative, exclusive) >
+				 unsigned long want
+				 < number of contiguous blocks wanted >
+				 unsigned long *found
+				 < output >
+	Output		:unsigned long *found
+				 < first block of a free run (group relative) >
+	Return		:int
+				 < 1:found 0:no free block -EAGAIN:no index for the group >
+
+	Description	:find a free run of want blocks nearest after start, or
+				 the first free block after start if there is no such run
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsFreeMapSearch( struct super_block *sb,
+						unsigned long group,
+						struct buffer_head *bitmap_bh,
+						unsigned long start,
+						unsigned long end,
+						unsigned long want,
+						unsigned long *found );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFreeMapUse
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 unsigned long start
+				 < first block set in bitmap (group relative) >
+				 unsigned long len
+				 < number of blocks >
+	Output		:void
+	Return		:void
+
+	Description	:remove blocks just set in the bitmap from the index.
+				 caller holds the block group lock
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsFreeMapUse( struct super_block *sb,
+					  unsigned long group,
+					  unsigned long start,
+					  unsigned long len );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFreeMapRelease
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 unsigned long start
+				 < first block cleared in bitmap (group relative) >
+				 unsigned long len
+				 < number of blocks >
+	Output		:void
+	Return		:void
+
+	Description	:add blocks just cleared in the bitmap to the index.
+				 caller holds the block group lock
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsFreeMapRelease( struct super_block *sb,
+						  unsigned long group,
+						  unsigned long start,
+						  unsigned long len );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFreeMapInvalidate
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+	Output		:void
+	Return		:void
+
+	Description	:throw away the index of a group whose bitmap changed in
+				 an unexpected way. caller holds the block group lock
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsFreeMapInvalidate( struct super_block *sb, unsigned long group );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsFreeMapLongest
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+	Output		:void
+	Return		:long
+				 < longest free extent, -1 if the group has no index >
+
+	Description	:get the length of the longest free extent of a group.
+				 caller holds the block group lock
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+long me2fsFreeMapLongest( struct super_block *sb, unsigned long group );
+
+#endif	// __ME2FS_FREEMAP_H__
@@ -0,0 +1,670 @@
+/********************************************************************************
+	File			: me2fs_grpinfo.c
+	Description		: In-memory summary of block groups of my ext2 file system
+
+*********************************************************************************/
+#include <linux/buffer_head.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/bitops.h>
+
+#include "me2fs.h"
+#include "me2fs_util.h"
+#include "me2fs_block.h"
+#include "me2fs_freemap.h"
+#include "me2fs_grpinfo.h"
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static void
+moveGroupBucket( struct me2fs_group_index *index,
+				 struct me2fs_group_info *gi );
+static inline int groupBucket( unsigned int max_extent );
+static void
+moveGroupDirBucket( struct me2fs_group_index *index,
+					struct me2fs_group_info *gi );
+static inline int groupDirBucket( struct me2fs_group_info *gi );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+/* groups looked at in the bucket where a fit is not certain					*/
+#define	GROUP_INDEX_SCAN		16
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInitGroupInfo
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:build summaries of all block groups from the descriptors
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInitGroupInfo( struct super_block *sb )
+{
+	struct me2fs_sb_info		*msi;
+	struct me2fs_group_index	*index;
+	struct me2fs_group_info		*gi;
+	struct ext2_group_desc		*gdesc;
+	unsigned long				group;
+	int							i;
+
+	msi = ME2FS_SB( sb );
+
+	msi->s_group_info = vzalloc( msi->s_groups_count
+								 * sizeof( struct me2fs_group_info ) );
+
+	if( !msi->s_group_info )
+	{
+		return( -ENOMEM );
+	}
+
+	if( !( index = kzalloc( sizeof( *index ), GFP_KERNEL ) ) )
+	{
+		vfree( msi->s_group_info );
+		msi->s_group_info = NULL;
+		return( -ENOMEM );
+	}
+
+	spin_lock_init( &index->lock );
+
+	for( i = 0 ; i < ME2FS_GROUP_BUCKETS ; i++ )
+	{
+		INIT_LIST_HEAD( &index->buckets[ i ] );
+		INIT_LIST_HEAD( &index->dir_buckets[ i ] );
+	}
+
+	msi->s_group_index = index;
+
+	for( group = 0 ; group < msi->s_groups_count ; group++ )
+	{
+		gi = &msi->s_group_info[ group ];
+
+		INIT_LIST_HEAD( &gi->gi_bucket_list );
+		INIT_LIST_HEAD( &gi->gi_dir_list );
+
+		if( !( gdesc = me2fsGetGroupDescriptor( sb, group ) ) )
+		{
+			continue;
+		}
+
+		gi->gi_free_blocks	= le16_to_cpu( gdesc->bg_free_blocks_count );
+		gi->gi_free_inodes	= le16_to_cpu( gdesc->bg_free_inodes_count );
+		gi->gi_used_dirs	= le16_to_cpu( gdesc->bg_used_dirs_count );
+
+		/* -------------------------------------------------------------------- */
+		/* until the free extent index of the group is built, all of its free	*/
+		/* blocks may be one run												*/
+		/* -------------------------------------------------------------------- */
+		gi->gi_max_extent	= gi->gi_free_blocks;
+
+		moveGroupBucket( index, gi );
+		moveGroupDirBucket( index, gi );
+	}
+
+	return( 0 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDestroyGroupInfo
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:void
+
+	Description	:release summaries of block groups and their pinned bitmaps
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDestroyGroupInfo( struct super_block *sb )
+{
+	struct me2fs_sb_info	*msi;
+	unsigned long			group;
+
+	msi = ME2FS_SB( sb );
+
+	if( msi->s_group_info )
+	{
+		for( group = 0 ; group < msi->s_groups_count ; group++ )
+		{
+			brelse( msi->s_group_info[ group ].gi_bitmap_bh );
+		}
+
+		vfree( msi->s_group_info );
+		msi->s_group_info = NULL;
+	}
+
+	kfree( msi->s_group_index );
+	msi->s_group_index = NULL;
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGroupInfoAddBlocks
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 long count
+				 < number of blocks freed, negative if allocated >
+	Output		:void
+	Return		:void
+
+	Description	:update free blocks of a group and move it to the bucket of
+				 its longest free extent. caller holds the block group lock
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsGroupInfoAddBlocks( struct super_block *sb,
+							  unsigned long group,
+							  long count )
+{
+	struct me2fs_sb_info	*msi;
+	struct me2fs_group_info	*gi;
+	long					longest;
+
+	msi	= ME2FS_SB( sb );
+	gi	= &msi->s_group_info[ group ];
+
+	gi->gi_free_blocks += count;
+
+	/* ------------------------------------------------------------------------ */
+	/* the free extent index knows the longest run. a group without the index	*/
+	/* is taken to have all of its free blocks in one run, the allocator finds	*/
+	/* out otherwise from the bitmap											*/
+	/* ------------------------------------------------------------------------ */
+	longest = me2fsFreeMapLongest( sb, group );
+
+	if( longest < 0 )
+	{
+		gi->gi_max_extent = gi->gi_free_blocks;
+	}
+	else
+	{
+		gi->gi_max_extent = min_t( unsigned int, longest, gi->gi_free_blocks );
+	}
+
+	if( groupBucket( gi->gi_max_extent ) != gi->gi_bucket )
+	{
+		spin_lock( &msi->s_group_index->lock );
+		{
+			moveGroupBucket( msi->s_group_index, gi );
+		}
+		spin_unlock( &msi->s_group_index->lock );
+	}
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGroupInfoAddInodes
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 int count
+				 < number of inodes freed, negative if allocated >
+				 int dirs
+				 < number of directories created, negative if removed >
+	Output		:void
+	Return		:void
+
+	Description	:update free inodes and directories of a group and move it
+				 to the dir bucket of its directories.
+				 caller holds the block group lock
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsGroupInfoAddInodes( struct super_block *sb,
+							  unsigned long group,
+							  int count,
+							  int dirs )
+{
+	struct me2fs_sb_info	*msi;
+	struct me2fs_group_info	*gi;
+
+	msi	= ME2FS_SB( sb );
+	gi	= &msi->s_group_info[ group ];
+
+	gi->gi_free_inodes	+= count;
+	gi->gi_used_dirs	+= dirs;
+
+	if( groupDirBucket( gi ) != gi->gi_dir_bucket )
+	{
+		spin_lock( &msi->s_group_index->lock );
+		{
+			moveGroupDirBucket( msi->s_group_index, gi );
+		}
+		spin_unlock( &msi->s_group_index->lock );
+	}
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGroupInfoFind
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long want
+				 < number of contiguous free blocks wanted >
+	Output		:void
+	Return		:long
+				 < group number, -1 if no group is known to have the run >
+
+	Description	:pick a group with a free run of want blocks from the
+				 smallest bucket that has one
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+long me2fsGroupInfoFind( struct super_block *sb, unsigned long want )
+{
+	struct me2fs_sb_info		*msi;
+	struct me2fs_group_index	*index;
+	struct me2fs_group_info		*gi;
+	struct me2fs_group_info		*found;
+	int							bucket;
+	int							scan;
+
+	msi		= ME2FS_SB( sb );
+	index	= msi->s_group_index;
+	found	= NULL;
+
+	if( !want )
+	{
+		want = 1;
+	}
+
+	bucket = groupBucket( want );
+
+	if( ME2FS_GROUP_BUCKETS <= bucket )
+	{
+		return( -1 );
+	}
+
+	spin_lock( &index->lock );
+	{
+		/* -------------------------------------------------------------------- */
+		/* groups in the bucket of want itself may or may not have the run		*/
+		/* -------------------------------------------------------------------- */
+		scan = 0;
+		list_for_each_entry( gi, &index->buckets[ bucket ], gi_bucket_list )
+		{
+			if( want <= gi->gi_max_extent )
+			{
+				found = gi;
+				break;
+			}
+
+			if( GROUP_INDEX_SCAN <= ++scan )
+			{
+				break;
+			}
+		}
+
+		/* -------------------------------------------------------------------- */
+		/* every group in a bucket above has it									*/
+		/* -------------------------------------------------------------------- */
+		if( !found )
+		{
+			bucket = find_next_bit( &index->nonempty,
+									ME2FS_GROUP_BUCKETS,
+									bucket + 1 );
+
+			if( bucket < ME2FS_GROUP_BUCKETS )
+			{
+				found = list_first_entry( &index->buckets[ bucket ],
+										  struct me2fs_group_info,
+										  gi_bucket_list );
+			}
+		}
+
+		/* -------------------------------------------------------------------- */
+		/* go round the groups of a bucket so that allocators running at the	*/
+		/* same time do not all pick the same group								*/
+		/* -------------------------------------------------------------------- */
+		if( found )
+		{
+			list_move_tail( &found->gi_bucket_list,
+							&index->buckets[ found->gi_bucket ] );
+		}
+	}
+	spin_unlock( &index->lock );
+
+	if( !found )
+	{
+		return( -1 );
+	}
+
+	return( found - msi->s_group_info );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGroupInfoFindDirGroup
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned int min_inodes
+				 < free inodes the group must have at least >
+				 unsigned long min_blocks
+				 < free blocks the group must have at least >
+	Output		:void
+	Return		:long
+				 < group number, -1 if no group is found >
+
+	Description	:pick a group with enough free inodes and blocks from the
+				 dir bucket with the fewest directories that has one
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+long me2fsGroupInfoFindDirGroup( struct super_block *sb,
+								 unsigned int min_inodes,
+								 unsigned long min_blocks )
+{
+	struct me2fs_sb_info		*msi;
+	struct me2fs_group_index	*index;
+	struct me2fs_group_info		*gi;
+	struct me2fs_group_info		*found;
+	int							bucket;
+	int							scan;
+
+	msi		= ME2FS_SB( sb );
+	index	= msi->s_group_index;
+	found	= NULL;
+
+	spin_lock( &index->lock );
+	{
+		/* -------------------------------------------------------------------- */
+		/* groups of a bucket have directories within twice of each other, so	*/
+		/* the first group with enough room in the lowest bucket is near the	*/
+		/* best. a bucket whose first groups are all short is given up			*/
+		/* -------------------------------------------------------------------- */
+		for_each_set_bit( bucket, &index->dir_nonempty, ME2FS_GROUP_BUCKETS )
+		{
+			scan = 0;
+			list_for_each_entry( gi,
+								 &index->dir_buckets[ bucket ],
+								 gi_dir_list )
+			{
+				if( ( min_inodes <= gi->gi_free_inodes ) &&
+					( min_blocks <= gi->gi_free_blocks ) )
+				{
+					found = gi;
+					break;
+				}
+
+				if( GROUP_INDEX_SCAN <= ++scan )
+				{
+					break;
+				}
+			}
+
+			if( found )
+			{
+				break;
+			}
+		}
+
+		/* -------------------------------------------------------------------- */
+		/* go round the groups of a bucket to spread directories over them		*/
+		/* -------------------------------------------------------------------- */
+		if( found )
+		{
+			list_move_tail( &found->gi_dir_list,
+							&index->dir_buckets[ found->gi_dir_bucket ] );
+		}
+	}
+	spin_unlock( &index->lock );
+
+	if( !found )
+	{
+		return( -1 );
+	}
+
+	return( found - msi->s_group_info );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGroupInfoGetBitmap
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+	Output		:void
+	Return		:struct buffer_head*
+				 < pinned block bitmap with a reference, or NULL >
+
+	Description	:get the block bitmap of a group if it has been read
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+struct buffer_head*
+me2fsGroupInfoGetBitmap( struct super_block *sb, unsigned long group )
+{
+	struct me2fs_sb_info	*msi;
+	struct buffer_head		*bh;
+
+	msi = ME2FS_SB( sb );
+
+	if( !msi->s_group_info )
+	{
+		return( NULL );
+	}
+
+	bh = ACCESS_ONCE( msi->s_group_info[ group ].gi_bitmap_bh );
+
+	/* ------------------------------------------------------------------------ */
+	/* a failed write clears uptodate. the caller reads it again then			*/
+	/* ------------------------------------------------------------------------ */
+	if( !bh || !buffer_uptodate( bh ) )
+	{
+		return( NULL );
+	}
+
+	get_bh( bh );
+
+	return( bh );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGroupInfoPinBitmap
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 struct buffer_head *bh
+				 < block bitmap just read >
+	Output		:void
+	Return		:void
+
+	Description	:keep the block bitmap of a group in memory until unmount
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsGroupInfoPinBitmap( struct super_block *sb,
+							  unsigned long group,
+							  struct buffer_head *bh )
+{
+	struct me2fs_sb_info	*msi;
+
+	msi = ME2FS_SB( sb );
+
+	if( !msi->s_group_info )
+	{
+		return;
+	}
+
+	/* the buffer of a block never changes, so the first one to pin it wins		*/
+	if( !cmpxchg( &msi->s_group_info[ group ].gi_bitmap_bh, NULL, bh ) )
+	{
+		get_bh( bh );
+	}
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:void
+	Input		:void
+	Output		:void
+	Return		:void
+
+	Description	:void
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Local Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+==================================================================================
+	Function	:moveGroupBucket
+	Input		:struct me2fs_group_index *index
+				 < index of block groups >
+				 struct me2fs_group_info *gi
+				 < summary of a block group >
+	Output		:void
+	Return		:void
+
+	Description	:link a group on the bucket of its longest free extent.
+				 caller holds the index lock, or is the only user
+==================================================================================
+*/
+static void
+moveGroupBucket( struct me2fs_group_index *index,
+				 struct me2fs_group_info *gi )
+{
+	int	bucket;
+
+	bucket = groupBucket( gi->gi_max_extent );
+
+	if( gi->gi_bucket )
+	{
+		list_del_init( &gi->gi_bucket_list );
+
+		if( list_empty( &index->buckets[ gi->gi_bucket ] ) )
+		{
+			__clear_bit( gi->gi_bucket, &index->nonempty );
+		}
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* a group with no free block is not worth a bucket							*/
+	/* ------------------------------------------------------------------------ */
+	gi->gi_bucket = 0;
+
+	if( !bucket )
+	{
+		return;
+	}
+
+	list_add_tail( &gi->gi_bucket_list, &index->buckets[ bucket ] );
+	__set_bit( bucket, &index->nonempty );
+	gi->gi_bucket = bucket;
+}
+
+/*
+==================================================================================
+	Function	:groupBucket
+	Input		:unsigned int max_extent
+				 < longest free extent of a group >
+	Output		:void
+	Return		:int
+				 < bucket of the group >
+
+	Description	:bucket of a group, 0 for a group without free block
+==================================================================================
+*/
+static inline int groupBucket( unsigned int max_extent )
+{
+	return( fls( max_extent ) );
+}
+
+/*
+==================================================================================
+	Function	:moveGroupDirBucket
+	Input		:struct me2fs_group_index *index
+				 < index of block groups >
+				 struct me2fs_group_info *gi
+				 < summary of a block group >
+	Output		:void
+	Return		:void
+
+	Description	:link a group on the dir bucket of its directories.
+				 caller holds the index lock, or is the only user
+==================================================================================
+*/
+static void
+moveGroupDirBucket( struct me2fs_group_index *index,
+					struct me2fs_group_info *gi )
+{
+	int	bucket;
+
+	bucket = groupDirBucket( gi );
+
+	if( gi->gi_dir_bucket )
+	{
+		list_del_init( &gi->gi_dir_list );
+
+		if( list_empty( &index->dir_buckets[ gi->gi_dir_bucket ] ) )
+		{
+			__clear_bit( gi->gi_dir_bucket, &index->dir_nonempty );
+		}
+	}
+
+	gi->gi_dir_bucket = bucket;
+
+	if( !bucket )
+	{
+		return;
+	}
+
+	list_add_tail( &gi->gi_dir_list, &index->dir_buckets[ bucket ] );
+	__set_bit( bucket, &index->dir_nonempty );
+}
+
+/*
+==================================================================================
+	Function	:groupDirBucket
+	Input		:struct me2fs_group_info *gi
+				 < summary of a block group >
+	Output		:void
+	Return		:int
+				 < dir bucket of the group >
+
+	Description	:dir bucket of a group, 0 for a group without free inode
+==================================================================================
+*/
+static inline int groupDirBucket( struct me2fs_group_info *gi )
+{
+	if( !gi->gi_free_inodes )
+	{
+		return( 0 );
+	}
+
+	return( fls( gi->gi_used_dirs ) + 1 );
+}
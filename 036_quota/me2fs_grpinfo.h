@@ -0,0 +1,251 @@
+/*********************************************************************************
+	File			: me2fs_grpinfo.h
+	Description		: Definitions for in-memory summary of block groups
+
+*********************************************************************************/
+#ifndef	__ME2FS_GRPINFO_H__
+#define	__ME2FS_GRPINFO_H__
+
+#include <linux/list.h>
+#include <linux/buffer_head.h>
+
+#include "me2fs.h"
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+/* buckets of the group index, by fls() of the longest free extent				*/
+#define	ME2FS_GROUP_BUCKETS			32
+
+/*
+---------------------------------------------------------------------------------
+	Summary of a Block Group
+	counts of the group descriptor in cpu order, kept in step with the
+	descriptor under the block group lock
+---------------------------------------------------------------------------------
+*/
+struct me2fs_group_info
+{
+	unsigned int		gi_free_blocks;		/* bg_free_blocks_count				*/
+	unsigned int		gi_free_inodes;		/* bg_free_inodes_count				*/
+	unsigned int		gi_used_dirs;		/* bg_used_dirs_count				*/
+	unsigned int		gi_max_extent;		/* longest free run, at most		*/
+	int					gi_bucket;			/* bucket linked on, 0 if none		*/
+	struct list_head	gi_bucket_list;		/* by s_group_index->lock			*/
+	int					gi_dir_bucket;		/* dir bucket linked on, 0 if none	*/
+	struct list_head	gi_dir_list;		/* by s_group_index->lock			*/
+	struct buffer_head	*gi_bitmap_bh;		/* block bitmap, pinned				*/
+};
+
+/*
+---------------------------------------------------------------------------------
+	Index of Block Groups
+	groups are linked on the bucket of fls() of their longest free extent,
+	so every group in a bucket above fls( n ) has a run of more than n
+	free blocks. groups with a free inode are also linked on the dir bucket
+	of fls() of their directories plus one, for orlov to find groups with
+	few directories without looking at all of them
+---------------------------------------------------------------------------------
+*/
+struct me2fs_group_index
+{
+	spinlock_t			lock;
+	unsigned long		nonempty;			/* bit per bucket with groups		*/
+	struct list_head	buckets[ ME2FS_GROUP_BUCKETS ];
+	unsigned long		dir_nonempty;		/* bit per dir bucket with groups	*/
+	struct list_head	dir_buckets[ ME2FS_GROUP_BUCKETS ];
+};
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInitGroupInfo
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:build summaries of all block groups from the descriptors
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInitGroupInfo( struct super_block *sb );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDestroyGroupInfo
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:void
+
+	Description	:release summaries of block groups and their pinned bitmaps
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsDestroyGroupInfo( struct super_block *sb );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGroupInfoAddBlocks
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 long count
+				 < number of blocks freed, negative if allocated >
+	Output		:void
+	Return		:void
+
+	Description	:update free blocks of a group and move it to the bucket of
+				 its longest free extent. caller holds the block group lock
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsGroupInfoAddBlocks( struct super_block *sb,
+							  unsigned long group,
+							  long count );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGroupInfoAddInodes
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 int count
+				 < number of inodes freed, negative if allocated >
+				 int dirs
+				 < number of directories created, negative if removed >
+	Output		:void
+	Return		:void
+
+	Description	:update free inodes and directories of a group.
+				 caller holds the block group lock
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsGroupInfoAddInodes( struct super_block *sb,
+							  unsigned long group,
+							  int count,
+							  int dirs );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGroupInfoFind
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long want
+				 < number of contiguous free blocks wanted >
+	Output		:void
+	Return		:long
+				 < group number, -1 if no group is known to have the run >
+
+	Description	:pick a group with a free run of want blocks from the
+				 smallest bucket that has one
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+long me2fsGroupInfoFind( struct super_block *sb, unsigned long want );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGroupInfoFindDirGroup
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned int min_inodes
+				 < free inodes the group must have at least >
+				 unsigned long min_blocks
+				 < free blocks the group must have at least >
+	Output		:void
+	Return		:long
+				 < group number, -1 if no group is found >
+
+	Description	:pick a group with enough free inodes and blocks from the
+				 dir bucket with the fewest directories that has one
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+long me2fsGroupInfoFindDirGroup( struct super_block *sb,
+								 unsigned int min_inodes,
+								 unsigned long min_blocks );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGroupInfoGetBitmap
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+	Output		:void
+	Return		:struct buffer_head*
+				 < pinned block bitmap with a reference, or NULL >
+
+	Description	:get the block bitmap of a group if it has been read
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+struct buffer_head*
+me2fsGroupInfoGetBitmap( struct super_block *sb, unsigned long group );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGroupInfoPinBitmap
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+				 struct buffer_head *bh
+				 < block bitmap just read >
+	Output		:void
+	Return		:void
+
+	Description	:keep the block bitmap of a group in memory until unmount
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsGroupInfoPinBitmap( struct super_block *sb,
+							  unsigned long group,
+							  struct buffer_head *bh );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsGetGroupInfo
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group number >
+	Output		:void
+	Return		:struct me2fs_group_info*
+				 < summary of the group >
+
+	Description	:get summary of a block group
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+static inline struct me2fs_group_info*
+me2fsGetGroupInfo( struct super_block *sb, unsigned long group )
+{
+	return( &ME2FS_SB( sb )->s_group_info[ group ] );
+}
+
+#endif	// __ME2FS_GRPINFO_H__
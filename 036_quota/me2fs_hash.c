@@ -0,0 +1,415 @@
+/********************************************************************************
+	File			: me2fs_hash.c
+	Description		: Directory hash functions of my ext2 file system
+
+*********************************************************************************/
+#include <linux/cryptohash.h>
+
+#include "me2fs.h"
+#include "me2fs_util.h"
+#include "me2fs_hash.h"
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static void teaTransform( u32 buf[ 4 ], const u32 in[ ] );
+static u32 dxHackHashSigned( const char *name, int len );
+static u32 dxHackHashUnsigned( const char *name, int len );
+static void str2HashBufSigned( const char *msg, int len, u32 *buf, int num );
+static void str2HashBufUnsigned( const char *msg, int len, u32 *buf, int num );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+#define	TEA_DELTA		0x9E3779B9
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDirHash
+	Input		:const char *name
+				 < name of directory entry >
+				 int len
+				 < length of the name >
+				 struct me2fs_dx_hash_info *hinfo
+				 < hash version and seed >
+	Output		:struct me2fs_dx_hash_info *hinfo
+				 < major and minor hash of the name >
+	Return		:int
+				 < result >
+
+	Description	:calculate ext3 compatible hash value of a name
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDirHash( const char *name, int len, struct me2fs_dx_hash_info *hinfo )
+{
+	u32			hash;
+	u32			minor_hash;
+	const char	*p;
+	int			i;
+	u32			in[ 8 ];
+	u32			buf[ 4 ];
+	void		( *str2HashBuf )( const char *, int, u32 *, int );
+
+	minor_hash	= 0;
+	str2HashBuf	= str2HashBufSigned;
+
+	/* ------------------------------------------------------------------------ */
+	/* initialize the default seed for the hash checksum functions				*/
+	/* ------------------------------------------------------------------------ */
+	buf[ 0 ] = 0x67452301;
+	buf[ 1 ] = 0xEFCDAB89;
+	buf[ 2 ] = 0x98BADCFE;
+	buf[ 3 ] = 0x10325476;
+
+	/* ------------------------------------------------------------------------ */
+	/* use the seed of super block unless it is all zero						*/
+	/* ------------------------------------------------------------------------ */
+	if( hinfo->seed )
+	{
+		for( i = 0 ; i < 4 ; i++ )
+		{
+			if( hinfo->seed[ i ] )
+			{
+				break;
+			}
+		}
+
+		if( i < 4 )
+		{
+			memcpy( buf, hinfo->seed, sizeof( buf ) );
+		}
+	}
+
+	switch( hinfo->hash_version )
+	{
+	case	EXT2_HASH_LEGACY_UNSIGNED:
+		hash = dxHackHashUnsigned( name, len );
+		break;
+	case	EXT2_HASH_LEGACY:
+		hash = dxHackHashSigned( name, len );
+		break;
+	case	EXT2_HASH_HALF_MD4_UNSIGNED:
+		str2HashBuf = str2HashBufUnsigned;
+		/* fall through															*/
+	case	EXT2_HASH_HALF_MD4:
+		for( p = name ; 0 < len ; len -= 32, p += 32 )
+		{
+			str2HashBuf( p, len, in, 8 );
+			half_md4_transform( buf, in );
+		}
+		minor_hash	= buf[ 2 ];
+		hash		= buf[ 1 ];
+		break;
+	case	EXT2_HASH_TEA_UNSIGNED:
+		str2HashBuf = str2HashBufUnsigned;
+		/* fall through															*/
+	case	EXT2_HASH_TEA:
+		for( p = name ; 0 < len ; len -= 16, p += 16 )
+		{
+			str2HashBuf( p, len, in, 4 );
+			teaTransform( buf, in );
+		}
+		hash		= buf[ 0 ];
+		minor_hash	= buf[ 1 ];
+		break;
+	default:
+		hinfo->hash = 0;
+		return( -EINVAL );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* the lowest bit is used as a collision marker in the index, and the		*/
+	/* largest value is reserved for end of directory							*/
+	/* ------------------------------------------------------------------------ */
+	hash = hash & ~1;
+
+	if( hash == ( EXT2_HTREE_EOF << 1 ) )
+	{
+		hash = ( EXT2_HTREE_EOF - 1 ) << 1;
+	}
+
+	hinfo->hash			= hash;
+	hinfo->minor_hash	= minor_hash;
+
+	return( 0 );
+}
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Local Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+==================================================================================
+	Function	:teaTransform
+	Input		:u32 buf[ 4 ]
+				 < hash state >
+				 const u32 in[ ]
+				 < 4 words of input >
+	Output		:u32 buf[ 4 ]
+				 < updated hash state >
+	Return		:void
+
+	Description	:one round of tiny encryption algorithm
+==================================================================================
+*/
+static void teaTransform( u32 buf[ 4 ], const u32 in[ ] )
+{
+	u32		sum;
+	u32		b0;
+	u32		b1;
+	u32		a, b, c, d;
+	int		n;
+
+	sum	= 0;
+	b0	= buf[ 0 ];
+	b1	= buf[ 1 ];
+	a	= in[ 0 ];
+	b	= in[ 1 ];
+	c	= in[ 2 ];
+	d	= in[ 3 ];
+
+	for( n = 16 ; n ; n-- )
+	{
+		sum	+= TEA_DELTA;
+		b0	+= ( ( b1 << 4 ) + a ) ^ ( b1 + sum ) ^ ( ( b1 >> 5 ) + b );
+		b1	+= ( ( b0 << 4 ) + c ) ^ ( b0 + sum ) ^ ( ( b0 >> 5 ) + d );
+	}
+
+	buf[ 0 ] += b0;
+	buf[ 1 ] += b1;
+}
+
+/*
+==================================================================================
+	Function	:dxHackHashSigned
+	Input		:const char *name
+				 < name to hash >
+				 int len
+				 < length of the name >
+	Output		:void
+	Return		:u32
+				 < hash value >
+
+	Description	:legacy hash of ext3 which treats char as signed
+==================================================================================
+*/
+static u32 dxHackHashSigned( const char *name, int len )
+{
+	u32					hash;
+	u32					hash0;
+	u32					hash1;
+	const signed char	*scp;
+
+	hash0	= 0x12A3FE2D;
+	hash1	= 0x37ABE8F9;
+	scp		= ( const signed char* )name;
+
+	while( len-- )
+	{
+		hash = hash1 + ( hash0 ^ ( ( ( int )*scp++ ) * 7152373 ) );
+
+		if( hash & 0x80000000 )
+		{
+			hash -= 0x7FFFFFFF;
+		}
+
+		hash1 = hash0;
+		hash0 = hash;
+	}
+
+	return( hash0 << 1 );
+}
+
+/*
+==================================================================================
+	Function	:dxHackHashUnsigned
+	Input		:const char *name
+				 < name to hash >
+				 int len
+				 < length of the name >
+	Output		:void
+	Return		:u32
+				 < hash value >
+
+	Description	:legacy hash of ext3 which treats char as unsigned
+==================================================================================
+*/
+static u32 dxHackHashUnsigned( const char *name, int len )
+{
+	u32					hash;
+	u32					hash0;
+	u32					hash1;
+	const unsigned char	*ucp;
+
+	hash0	= 0x12A3FE2D;
+	hash1	= 0x37ABE8F9;
+	ucp		= ( const unsigned char* )name;
+
+	while( len-- )
+	{
+		hash = hash1 + ( hash0 ^ ( ( ( int )*ucp++ ) * 7152373 ) );
+
+		if( hash & 0x80000000 )
+		{
+			hash -= 0x7FFFFFFF;
+		}
+
+		hash1 = hash0;
+		hash0 = hash;
+	}
+
+	return( hash0 << 1 );
+}
+
+/*
+==================================================================================
+	Function	:str2HashBufSigned
+	Input		:const char *msg
+				 < name to pack >
+				 int len
+				 < remaining length of the name >
+				 u32 *buf
+				 < buffer to pack into >
+				 int num
+				 < number of words of the buffer >
+	Output		:u32 *buf
+				 < packed words >
+	Return		:void
+
+	Description	:pack a name into words padded with its length(signed char)
+==================================================================================
+*/
+static void str2HashBufSigned( const char *msg, int len, u32 *buf, int num )
+{
+	u32					pad;
+	u32					val;
+	int					i;
+	const signed char	*scp;
+
+	scp	= ( const signed char* )msg;
+	pad	= ( u32 )len | ( ( u32 )len << 8 );
+	pad	|= pad << 16;
+	val	= pad;
+
+	if( ( num * 4 ) < len )
+	{
+		len = num * 4;
+	}
+
+	for( i = 0 ; i < len ; i++ )
+	{
+		if( ( i % 4 ) == 0 )
+		{
+			val = pad;
+		}
+
+		val = ( ( int )scp[ i ] ) + ( val << 8 );
+
+		if( ( i % 4 ) == 3 )
+		{
+			*buf++	= val;
+			val		= pad;
+			num--;
+		}
+	}
+
+	if( 0 <= --num )
+	{
+		*buf++ = val;
+	}
+
+	while( 0 <= --num )
+	{
+		*buf++ = pad;
+	}
+}
+
+/*
+==================================================================================
+	Function	:str2HashBufUnsigned
+	Input		:const char *msg
+				 < name to pack >
+				 int len
+				 < remaining length of the name >
+				 u32 *buf
+				 < buffer to pack into >
+				 int num
+				 < number of words of the buffer >
+	Output		:u32 *buf
+				 < packed words >
+	Return		:void
+
+	Description	:pack a name into words padded with its length(unsigned char)
+==================================================================================
+*/
+static void str2HashBufUnsigned( const char *msg, int len, u32 *buf, int num )
+{
+	u32					pad;
+	u32					val;
+	int					i;
+	const unsigned char	*ucp;
+
+	ucp	= ( const unsigned char* )msg;
+	pad	= ( u32 )len | ( ( u32 )len << 8 );
+	pad	|= pad << 16;
+	val	= pad;
+
+	if( ( num * 4 ) < len )
+	{
+		len = num * 4;
+	}
+
+	for( i = 0 ; i < len ; i++ )
+	{
+		if( ( i % 4 ) == 0 )
+		{
+			val = pad;
+		}
+
+		val = ( ( int )ucp[ i ] ) + ( val << 8 );
+
+		if( ( i % 4 ) == 3 )
+		{
+			*buf++	= val;
+			val		= pad;
+			num--;
+		}
+	}
+
+	if( 0 <= --num )
+	{
+		*buf++ = val;
+	}
+
+	while( 0 <= --num )
+	{
+		*buf++ = pad;
+	}
+}
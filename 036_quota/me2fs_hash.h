@@ -0,0 +1,67 @@
+/*********************************************************************************
+	File			: me2fs_hash.h
+	Description		: Definitions for directory hash of my ext2 file system
+
+*********************************************************************************/
+#ifndef	__ME2FS_HASH_H__
+#define	__ME2FS_HASH_H__
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+struct me2fs_dx_hash_info
+{
+	u32		hash;
+	u32		minor_hash;
+	int		hash_version;
+	u32		*seed;
+};
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsDirHash
+	Input		:const char *name
+				 < name of directory entry >
+				 int len
+				 < length of the name >
+				 struct me2fs_dx_hash_info *hinfo
+				 < hash version and seed >
+	Output		:struct me2fs_dx_hash_info *hinfo
+				 < major and minor hash of the name >
+	Return		:int
+				 < result >
+
+	Description	:calculate ext3 compatible hash value of a name
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsDirHash( const char *name, int len, struct me2fs_dx_hash_info *hinfo );
+
+#endif	// __ME2FS_HASH_H__
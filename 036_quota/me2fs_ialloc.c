@@ -7,13 +7,18 @@
 #include <linux/sched.h>
 #include <linux/backing-dev.h>
 #include <linux/quotaops.h>
+#include <linux/blkdev.h>
+#include <linux/uaccess.h>
 
 #include "me2fs.h"
 #include "me2fs_util.h"
+#include "me2fs_ialloc.h"
 #include "me2fs_inode.h"
 #include "me2fs_block.h"
+#include "me2fs_grpinfo.h"
 #include "me2fs_xattr_security.h"
 #include "me2fs_acl.h"
+#include "me2fs_inline.h"
 
 
 /*
@@ -33,6 +38,16 @@ static int
 findGroupOther( struct super_block *sb, struct inode *parent );
 static void releaseInode( struct super_block *sb, int group, int dir );
 static void prereadInode( struct inode *inode );
+static int bulkstatGroup( struct super_block *sb,
+						  unsigned long group,
+						  unsigned long *ino,
+						  struct me2fs_bstat __user *ubuf,
+						  unsigned int count,
+						  unsigned int *filled );
+static int fillBstat( struct super_block *sb,
+					  unsigned long ino,
+					  struct ext2_inode *raw,
+					  struct me2fs_bstat *bs );
 
 /*
 ==================================================================================
@@ -239,6 +254,7 @@ got:
 		{
 			le16_add_cpu( &gdesc->bg_used_dirs_count, 1 );
 		}
+		me2fsGroupInfoAddInodes( sb, group, -1, S_ISDIR( mode ) ? 1 : 0 );
 	}
 	spin_unlock( getSbBlockGroupLock( msi, group ) );
 
@@ -269,7 +285,8 @@ got:
 	/* ------------------------------------------------------------------------ */
 	memset( mi->i_data, 0, sizeof( mi->i_data ) );
 
-	mi->i_flags = ME2FS_I( dir )->i_flags & EXT2_FL_INHERITED;
+	mi->i_flags			= ME2FS_I( dir )->i_flags & EXT2_FL_INHERITED;
+	mi->i_me2fs_flags	= 0;
 
 	if( S_ISDIR( mode ) )
 	{
@@ -278,6 +295,11 @@ got:
 	else if( S_ISREG( mode ) )
 	{
 		mi->i_flags &= EXT2_REG_FLMASK;
+
+		if( msi->s_mount_opt & EXT2_MOUNT_INLINE_DATA )
+		{
+			me2fsInitInlineData( inode );
+		}
 	}
 	else
 	{
@@ -494,6 +516,87 @@ void me2fsFreeInode( struct inode *inode )
 
 	brelse( bitmap_bh );
 }
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsBulkstat
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 struct me2fs_bulkstat_req *req
+				 < range of inodes and user buffer >
+	Output		:struct me2fs_bulkstat_req *req
+				 < entries filled and inode to go on from >
+	Return		:int
+				 < result >
+
+	Description	:return attributes of inodes in use from br_ino on, reading
+				 inode tables in order and skipping free slots by bitmap.
+				 the scan is over when the returned br_ino is past the last
+				 inode. passing that back returns no entries, any higher
+				 br_ino is rejected
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsBulkstat( struct super_block *sb, struct me2fs_bulkstat_req *req )
+{
+	struct me2fs_sb_info		*msi;
+	struct me2fs_bstat __user	*ubuf;
+	unsigned long				inodes_count;
+	unsigned long				ino;
+	unsigned int				done;
+	unsigned int				filled;
+	int							err;
+
+	msi				= ME2FS_SB( sb );
+	ubuf			= ( struct me2fs_bstat __user* )
+					  ( unsigned long )req->br_buf;
+	inodes_count	= le32_to_cpu( msi->s_esb->s_inodes_count );
+
+	/* ------------------------------------------------------------------------ */
+	/* checked as 64 bit before it goes into an unsigned long. the br_ino a		*/
+	/* finished scan returns is inodes_count + 1 and is not an error			*/
+	/* ------------------------------------------------------------------------ */
+	if( ( ( __u64 )inodes_count + 1 ) < req->br_ino )
+	{
+		return( -EINVAL );
+	}
+
+	ino				= max_t( __u64, req->br_ino, 1 );
+	done			= 0;
+	err				= 0;
+
+	while( ( done < req->br_count ) && ( ino <= inodes_count ) )
+	{
+		err = bulkstatGroup( sb,
+							 ( ino - 1 ) / msi->s_inodes_per_group,
+							 &ino,
+							 ubuf + done,
+							 req->br_count - done,
+							 &filled );
+
+		done += filled;
+
+		if( err )
+		{
+			break;
+		}
+
+		if( fatal_signal_pending( current ) )
+		{
+			err = -EINTR;
+			break;
+		}
+
+		cond_resched( );
+	}
+
+	req->br_ino		= ino;
+	req->br_ocount	= done;
+
+	/* ------------------------------------------------------------------------ */
+	/* entries already filled are returned, the error comes on the next call	*/
+	/* ------------------------------------------------------------------------ */
+	return( done ? 0 : err );
+}
 /*
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 	Function	:void
@@ -633,7 +736,7 @@ findDirGroupOrlov( struct super_block *sb, struct inode *parent )
 	int						ngroups;
 	int						inodes_per_group;
 
-	struct ext2_group_desc	*gdesc;
+	struct me2fs_group_info	*gi;
 	unsigned int			freei;
 	unsigned int			avefreei;
 	unsigned long			freeb;
@@ -641,7 +744,7 @@ findDirGroupOrlov( struct super_block *sb, struct inode *parent )
 	unsigned int			ndirs;
 	int						max_dirs;
 	int						min_inodes;
-	unsigned long			min_blocks;
+	long					min_blocks;
 	long						group;
 	int						i;
 
@@ -660,78 +763,49 @@ findDirGroupOrlov( struct super_block *sb, struct inode *parent )
 	if( ( parent == sb->s_root->d_inode ) ||
 		( ME2FS_I( parent )->i_flags & EXT2_TOPDIR_FL ) )
 	{
-		int	best_ndir;
-		long	best_group;
+		/* -------------------------------------------------------------------- */
+		/* the group index keeps groups ordered by their directories, so a		*/
+		/* group with few of them is found without looking at every group		*/
+		/* -------------------------------------------------------------------- */
+		group = me2fsGroupInfoFindDirGroup( sb, avefreei, avefreeb );
 
-		best_ndir	= inodes_per_group;
-		best_group	= -1;
+		if( 0 <= group )
+		{
+			return( group );
+		}
 
 		get_random_bytes( &group, sizeof( group ) );
 
 		parent_group = ( unsigned )group % ngroups;
 
-		for( i = 0 ; i < ngroups ; i++ )
-		{
-			group = ( parent_group + i ) % ngroups;
-			gdesc = me2fsGetGroupDescriptor( sb, group );
-			
-			if( !gdesc || !gdesc->bg_free_inodes_count )
-			{
-				continue;
-			}
-
-			if( best_ndir <= le16_to_cpu( gdesc->bg_used_dirs_count ) )
-			{
-				continue;
-			}
-
-			if( le16_to_cpu( gdesc->bg_free_inodes_count ) < avefreei );
-			{
-				continue;
-			}
-
-			if( le16_to_cpu( gdesc->bg_free_blocks_count ) < avefreeb );
-			{
-				continue;
-			}
-
-			best_group	= group;
-			best_ndir	= le16_to_cpu( gdesc->bg_used_dirs_count );
-		}
-
-		if( 0 <= best_group )
-		{
-			return( best_group );
-		}
-
 		goto fallback;
 	}
 
 	max_dirs	= ( ndirs / ngroups ) + ( inodes_per_group / 16 );
 	min_inodes	= avefreei - ( inodes_per_group / 4 );
-	min_blocks	= avefreeb - ( msi->s_blocks_per_group / 4 );
+	min_blocks	= ( long )avefreeb - ( long )( msi->s_blocks_per_group / 4 );
 
 	for( i = 0 ; i < ngroups ; i++ )
 	{
-		group = ( parent_group + i ) % ngroups;
-		gdesc = me2fsGetGroupDescriptor( sb, group );
+		group	= ( parent_group + i ) % ngroups;
+		gi		= me2fsGetGroupInfo( sb, group );
 
-		if( !gdesc || !gdesc->bg_free_inodes_count )
+		if( !gi->gi_free_inodes )
 		{
 			continue;
 		}
 
-		if( max_dirs <= le16_to_cpu( gdesc->bg_used_dirs_count ) )
+		if( max_dirs <= gi->gi_used_dirs )
 		{
 			continue;
 		}
 
-		if( le16_to_cpu( gdesc->bg_free_inodes_count ) < min_inodes );
+		if( ( int )gi->gi_free_inodes < min_inodes )
 		{
 			continue;
 		}
 
-		if( le16_to_cpu( gdesc->bg_free_blocks_count ) < min_blocks );
+		if( ( long )gi->gi_free_blocks < min_blocks )
 		{
 			continue;
 		}
@@ -742,15 +816,15 @@ findDirGroupOrlov( struct super_block *sb, struct inode *parent )
 fallback:
 	for( i = 0 ; i < ngroups ; i++ )
 	{
-		group = ( parent_group + i ) % ngroups;
-		gdesc = me2fsGetGroupDescriptor( sb, group );
+		group	= ( parent_group + i ) % ngroups;
+		gi		= me2fsGetGroupInfo( sb, group );
 
-		if( !gdesc || !gdesc->bg_free_inodes_count )
+		if( !gi->gi_free_inodes )
 		{
 			continue;
 		}
 
-		if( avefreei <= le16_to_cpu( gdesc->bg_free_inodes_count ) )
+		if( avefreei <= gi->gi_free_inodes )
 		{
 			return( group );
 		}
@@ -786,22 +860,49 @@ fallback:
 static int
 findGroupOther( struct super_block *sb, struct inode *parent )
 {
-	struct ext2_group_desc	*gdesc;
+	struct me2fs_sb_info	*msi;
+	struct me2fs_group_info	*gi;
+	unsigned long			spread;
 	int						parent_group;
 	int						group;
 	int						ngroups;
 	int						i;
 
-	parent_group = ME2FS_I( parent )->i_block_group;
+	msi				= ME2FS_SB( sb );
+	parent_group	= ME2FS_I( parent )->i_block_group;
+	ngroups			= msi->s_groups_count;
+
+	/* ------------------------------------------------------------------------ */
+	/* with percpu_ialloc each cpu prefers its own group among the ones next	*/
+	/* to the parent, so that threads creating files in one directory do not	*/
+	/* all fight over the same inode bitmap and block group lock				*/
+	/* ------------------------------------------------------------------------ */
+	if( msi->s_mount_opt & EXT2_MOUNT_PERCPU_IALLOC )
+	{
+		spread = min_t( unsigned long,
+						ACCESS_ONCE( msi->s_ialloc_spread_groups ),
+						ngroups );
+
+		if( 1 < spread )
+		{
+			/* only a hint, the creator may move to another cpu meanwhile		*/
+			group	= ( parent_group + raw_smp_processor_id( ) % spread )
+					  % ngroups;
+			gi		= me2fsGetGroupInfo( sb, group );
+
+			if( gi->gi_free_inodes && gi->gi_free_blocks )
+			{
+				goto found;
+			}
+		}
+	}
 
 	/* ------------------------------------------------------------------------ */
 	/* try to place the inode in its parent directory							*/
 	/* ------------------------------------------------------------------------ */
-	gdesc = me2fsGetGroupDescriptor( sb, parent_group );
+	gi = me2fsGetGroupInfo( sb, parent_group );
 
-	if( gdesc
-		&& le16_to_cpu( gdesc->bg_free_inodes_count )
-		&& le16_to_cpu( gdesc->bg_free_blocks_count ) )
+	if( gi->gi_free_inodes && gi->gi_free_blocks )
 	{
 		group = parent_group;
 		goto found;
@@ -815,7 +916,6 @@ findGroupOther( struct super_block *sb, struct inode *parent )
 	/* different block group.													*/
 	/* so add our directory's i_ino into the starting point for the hash.		*/
 	/* ------------------------------------------------------------------------ */
-	ngroups = ME2FS_SB( sb )->s_groups_count;
 	group = ( parent_group + parent->i_ino ) % ngroups;
 	/* ------------------------------------------------------------------------ */
 	/* use a quadratic hash to find a group with a free inode and some free blk */
@@ -828,11 +928,9 @@ findGroupOther( struct super_block *sb, struct inode *parent )
 			group -= ngroups;
 		}
 
-		gdesc = me2fsGetGroupDescriptor( sb, group );
+		gi = me2fsGetGroupInfo( sb, group );
 
-		if( gdesc
-			&& le16_to_cpu( gdesc->bg_free_inodes_count )
-			&& le16_to_cpu( gdesc->bg_free_blocks_count ) )
+		if( gi->gi_free_inodes && gi->gi_free_blocks )
 		{
 			goto found;
 		}
@@ -850,9 +948,9 @@ findGroupOther( struct super_block *sb, struct inode *parent )
 			group = 0;
 		}
 
-		gdesc = me2fsGetGroupDescriptor( sb, group );
+		gi = me2fsGetGroupInfo( sb, group );
 
-		if( gdesc && le16_to_cpu( gdesc->bg_free_inodes_count ) )
+		if( gi->gi_free_inodes )
 		{
 			goto found;
 		}
@@ -904,7 +1002,9 @@ static void releaseInode( struct super_block *sb, int group, int dir )
 	{
 		le16_add_cpu( &gdesc->bg_used_dirs_count, -1 );
 	}
+	me2fsGroupInfoAddInodes( sb, group, 1, dir ? -1 : 0 );
 	spin_unlock( getSbBlockGroupLock( ME2FS_SB( sb ), group ) );
+	percpu_counter_inc( &ME2FS_SB( sb )->s_freeinodes_counter );
 	if( dir )
 	{
 		percpu_counter_dec( &ME2FS_SB( sb )->s_dirs_counter );
@@ -964,6 +1064,283 @@ static void prereadInode( struct inode *inode )
 	
 	sb_breadahead( inode->i_sb, block );
 }
+
+/*
+==================================================================================
+	Function	:bulkstatGroup
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long group
+				 < block group to scan >
+				 unsigned long *ino
+				 < first inode to look at >
+				 struct me2fs_bstat __user *ubuf
+				 < user buffer >
+				 unsigned int count
+				 < entries left in user buffer >
+				 unsigned int *filled
+				 < entries filled >
+	Output		:unsigned long *ino
+				 < inode to go on from >
+				 unsigned int *filled
+				 < entries filled >
+	Return		:int
+				 < result >
+
+	Description	:fill attributes of inodes in use of a group. the blocks of
+				 the inode table to be used are read ahead at once
+==================================================================================
+*/
+static int bulkstatGroup( struct super_block *sb,
+						  unsigned long group,
+						  unsigned long *ino,
+						  struct me2fs_bstat __user *ubuf,
+						  unsigned int count,
+						  unsigned int *filled )
+{
+	struct me2fs_sb_info	*msi;
+	struct ext2_group_desc	*gdesc;
+	struct buffer_head		*bitmap_bh;
+	struct buffer_head		*bh;
+	struct blk_plug			plug;
+	struct me2fs_bstat		bs;
+	unsigned long			ipg;
+	unsigned long			itb;
+	unsigned long			first;
+	unsigned long			index;
+	unsigned long			last;
+	unsigned long			block;
+	unsigned long			offset;
+	unsigned int			nr;
+	int						err;
+
+	msi		= ME2FS_SB( sb );
+	ipg		= msi->s_inodes_per_group;
+	first	= ( *ino - 1 ) % ipg;
+	*filled	= 0;
+
+	if( !( gdesc = me2fsGetGroupDescriptor( sb, group ) ) )
+	{
+		return( -EIO );
+	}
+
+	if( !( bitmap_bh = readInodeBitmap( sb, group ) ) )
+	{
+		return( -EIO );
+	}
+
+	itb = le32_to_cpu( gdesc->bg_inode_table );
+
+	/* ------------------------------------------------------------------------ */
+	/* find the inode table blocks the user buffer is going to be filled from	*/
+	/* and read them ahead in order												*/
+	/* ------------------------------------------------------------------------ */
+	last	= first;
+	nr		= 0;
+
+	for( index = find_next_bit_le( bitmap_bh->b_data, ipg, first ) ;
+		 ( index < ipg ) && ( nr < count ) ;
+		 index = find_next_bit_le( bitmap_bh->b_data, ipg, index + 1 ) )
+	{
+		last = index;
+		nr++;
+	}
+
+	if( nr && !bdi_read_congested( sb->s_bdi ) )
+	{
+		blk_start_plug( &plug );
+
+		for( block = itb + ( ( first * msi->s_inode_size )
+							 >> sb->s_blocksize_bits ) ;
+			 block <= itb + ( ( last * msi->s_inode_size )
+							  >> sb->s_blocksize_bits ) ;
+			 block++ )
+		{
+			sb_breadahead( sb, block );
+		}
+
+		blk_finish_plug( &plug );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* fill entries																*/
+	/* ------------------------------------------------------------------------ */
+	bh	= NULL;
+	err	= 0;
+
+	for( index = find_next_bit_le( bitmap_bh->b_data, ipg, first ) ;
+		 ( index < ipg ) && ( *filled < count ) ;
+		 index = find_next_bit_le( bitmap_bh->b_data, ipg, index + 1 ) )
+	{
+		offset	= index * msi->s_inode_size;
+		block	= itb + ( offset >> sb->s_blocksize_bits );
+
+		if( !bh || ( bh->b_blocknr != block ) )
+		{
+			brelse( bh );
+
+			if( !( bh = sb_bread( sb, block ) ) )
+			{
+				ME2FS_ERROR( "<ME2FS>%s:unable to read inode block %lu\n",
+							 __func__, block );
+				err = -EIO;
+				break;
+			}
+
+			cond_resched( );
+		}
+
+		*ino = group * ipg + index + 1;
+
+		offset &= ( sb->s_blocksize - 1 );
+
+		if( !fillBstat( sb,
+						*ino,
+						( struct ext2_inode* )( bh->b_data + offset ),
+						&bs ) )
+		{
+			continue;
+		}
+
+		if( copy_to_user( ubuf + *filled, &bs, sizeof( bs ) ) )
+		{
+			err = -EFAULT;
+			break;
+		}
+
+		( *filled )++;
+	}
+
+	brelse( bh );
+	brelse( bitmap_bh );
+
+	/* ------------------------------------------------------------------------ */
+	/* go on after the last inode looked at, or from the next group				*/
+	/* ------------------------------------------------------------------------ */
+	if( err )
+	{
+		return( err );
+	}
+
+	if( index < ipg )
+	{
+		*ino = group * ipg + index + 1;
+	}
+	else
+	{
+		*ino = ( group + 1 ) * ipg + 1;
+	}
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:fillBstat
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long ino
+				 < inode number >
+				 struct ext2_inode *raw
+				 < inode in the inode table >
+				 struct me2fs_bstat *bs
+				 < entry to fill >
+	Output		:struct me2fs_bstat *bs
+				 < attributes of the inode >
+	Return		:int
+				 < 1 : filled 0 : the inode is not to be returned >
+
+	Description	:fill attributes of an inode. a cached inode is newer than
+				 the inode table and is used instead
+==================================================================================
+*/
+static int fillBstat( struct super_block *sb,
+					  unsigned long ino,
+					  struct ext2_inode *raw,
+					  struct me2fs_bstat *bs )
+{
+	struct inode	*inode;
+	uid_t			uid;
+	gid_t			gid;
+
+	/* reserved inodes are not files											*/
+	if( ( ino != ME2FS_EXT2_ROOT_INO ) && ( ino < ME2FS_SB( sb )->s_first_ino ) )
+	{
+		return( 0 );
+	}
+
+	memset( bs, 0, sizeof( *bs ) );
+
+	bs->bs_ino = ino;
+
+	if( ( inode = ilookup( sb, ino ) ) )
+	{
+		if( !inode->i_nlink )
+		{
+			iput( inode );
+			return( 0 );
+		}
+
+		bs->bs_size			= i_size_read( inode );
+		bs->bs_blocks		= inode->i_blocks;
+		bs->bs_mode			= inode->i_mode;
+		bs->bs_nlink		= inode->i_nlink;
+		bs->bs_uid			= from_kuid_munged( current_user_ns( ),
+												inode->i_uid );
+		bs->bs_gid			= from_kgid_munged( current_user_ns( ),
+												inode->i_gid );
+		bs->bs_atime		= inode->i_atime.tv_sec;
+		bs->bs_mtime		= inode->i_mtime.tv_sec;
+		bs->bs_ctime		= inode->i_ctime.tv_sec;
+		bs->bs_generation	= inode->i_generation;
+		bs->bs_file_acl		= ME2FS_I( inode )->i_file_acl;
+		bs->bs_flags		= ME2FS_I( inode )->i_flags & EXT2_FL_USER_VISIBLE;
+
+		iput( inode );
+
+		return( 1 );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* same tests as me2fsGetVfsInode for a deleted inode						*/
+	/* ------------------------------------------------------------------------ */
+	if( !raw->i_links_count || !raw->i_mode || raw->i_dtime )
+	{
+		return( 0 );
+	}
+
+	uid = le16_to_cpu( raw->i_uid );
+	gid = le16_to_cpu( raw->i_gid );
+
+	if( !( ME2FS_SB( sb )->s_mount_opt & EXT2_MOUNT_NO_UID32 ) )
+	{
+		uid |= le16_to_cpu( raw->osd2.linux2.l_i_uid_high ) << 16;
+		gid |= le16_to_cpu( raw->osd2.linux2.l_i_gid_high ) << 16;
+	}
+
+	bs->bs_size			= le32_to_cpu( raw->i_size );
+	bs->bs_mode			= le16_to_cpu( raw->i_mode );
+
+	if( S_ISREG( bs->bs_mode ) )
+	{
+		bs->bs_size		|= ( __u64 )le32_to_cpu( raw->i_dir_acl ) << 32;
+	}
+
+	bs->bs_blocks		= le32_to_cpu( raw->i_blocks );
+	bs->bs_nlink		= le16_to_cpu( raw->i_links_count );
+	bs->bs_uid			= from_kuid_munged( current_user_ns( ),
+											make_kuid( &init_user_ns, uid ) );
+	bs->bs_gid			= from_kgid_munged( current_user_ns( ),
+											make_kgid( &init_user_ns, gid ) );
+	bs->bs_atime		= le32_to_cpu( raw->i_atime );
+	bs->bs_mtime		= le32_to_cpu( raw->i_mtime );
+	bs->bs_ctime		= le32_to_cpu( raw->i_ctime );
+	bs->bs_generation	= le32_to_cpu( raw->i_generation );
+	bs->bs_file_acl		= le32_to_cpu( raw->i_file_acl );
+	bs->bs_flags		= le32_to_cpu( raw->i_flags ) & EXT2_FL_USER_VISIBLE;
+
+	return( 1 );
+}
 /*
 ==================================================================================
 	Function	:void
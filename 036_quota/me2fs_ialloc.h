@@ -98,4 +98,25 @@ _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 */
 void me2fsFreeInode( struct inode *inode );
 
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsBulkstat
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 struct me2fs_bulkstat_req *req
+				 < range of inodes and user buffer >
+	Output		:struct me2fs_bulkstat_req *req
+				 < entries filled and inode to go on from >
+	Return		:int
+				 < result >
+
+	Description	:return attributes of inodes in use from br_ino on, reading
+				 inode tables in order and skipping free slots by bitmap.
+				 the scan is over when the returned br_ino is past the last
+				 inode. passing that back returns no entries, any higher
+				 br_ino is rejected
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsBulkstat( struct super_block *sb, struct me2fs_bulkstat_req *req );
+
 #endif	// __ME2FS_IALLOC_H__
@@ -0,0 +1,499 @@
+/********************************************************************************
+	File			: me2fs_inline.c
+	Description		: Inline data of tiny files of my ext2 file system
+
+*********************************************************************************/
+#include <linux/buffer_head.h>
+#include <linux/highmem.h>
+#include <linux/pagemap.h>
+
+#include "me2fs.h"
+#include "me2fs_util.h"
+#include "me2fs_inline.h"
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static void fillPage( struct inode *inode, struct page *page );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInitInlineData
+	Input		:struct inode *inode
+				 < new regular file >
+	Output		:void
+	Return		:void
+
+	Description	:make a new file keep its data in i_block until it grows
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsInitInlineData( struct inode *inode )
+{
+	ME2FS_I( inode )->i_me2fs_flags |= ME2FS_INLINE_DATA_FL;
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsConvertInline
+	Input		:struct inode *inode
+				 < vfs inode >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:move the data of an inline file to a block. caller holds
+				 i_mutex
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsConvertInline( struct inode *inode )
+{
+	struct me2fs_inode_info	*mi;
+	struct page				*page;
+	void					*fsdata;
+	void					*kaddr;
+	__le32					data[ ME2FS_NR_BLOCKS ];
+	loff_t					size;
+	int						err;
+
+	if( !me2fsHasInlineData( inode ) )
+	{
+		return( 0 );
+	}
+
+	mi = ME2FS_I( inode );
+
+	/* ------------------------------------------------------------------------ */
+	/* a page written through mmap goes back to i_block before it is moved		*/
+	/* ------------------------------------------------------------------------ */
+	err = filemap_write_and_wait_range( inode->i_mapping,
+										0,
+										ME2FS_INLINE_DATA_SIZE - 1 );
+	if( err )
+	{
+		return( err );
+	}
+
+	size = min_t( loff_t, i_size_read( inode ), ME2FS_INLINE_DATA_SIZE );
+
+	/* ------------------------------------------------------------------------ */
+	/* from here i_data is a block map again									*/
+	/* ------------------------------------------------------------------------ */
+	mutex_lock( &mi->truncate_mutex );
+	{
+		memcpy( data, mi->i_data, sizeof( data ) );
+		memset( mi->i_data, 0, sizeof( mi->i_data ) );
+		mi->i_me2fs_flags &= ~ME2FS_INLINE_DATA_FL;
+	}
+	mutex_unlock( &mi->truncate_mutex );
+
+	if( !size )
+	{
+		mark_inode_dirty( inode );
+		return( 0 );
+	}
+
+	err = pagecache_write_begin( NULL, inode->i_mapping, 0, size, 0,
+								 &page, &fsdata );
+	if( err )
+	{
+		goto restore;
+	}
+
+	kaddr = kmap_atomic( page );
+	memcpy( kaddr, data, size );
+	kunmap_atomic( kaddr );
+	flush_dcache_page( page );
+
+	err = pagecache_write_end( NULL, inode->i_mapping, 0, size, size,
+							   page, fsdata );
+	if( err < 0 )
+	{
+		goto restore;
+	}
+
+	mark_inode_dirty( inode );
+
+	DBGPRINT( "<ME2FS>%s:inode [%lu] moved to a block\n",
+			  __func__, inode->i_ino );
+
+	return( 0 );
+
+	/* ------------------------------------------------------------------------ */
+	/* no block was kept for the data, the file stays inline					*/
+	/* ------------------------------------------------------------------------ */
+restore:
+	mutex_lock( &mi->truncate_mutex );
+	{
+		memcpy( mi->i_data, data, sizeof( data ) );
+		mi->i_me2fs_flags |= ME2FS_INLINE_DATA_FL;
+	}
+	mutex_unlock( &mi->truncate_mutex );
+
+	return( err );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInlineReadPage
+	Input		:struct inode *inode
+				 < inline file >
+				 struct page *page
+				 < locked page to be filled with data >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:fill a page from i_block
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInlineReadPage( struct inode *inode, struct page *page )
+{
+	fillPage( inode, page );
+	unlock_page( page );
+
+	return( 0 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInlineWritePage
+	Input		:struct inode *inode
+				 < inline file >
+				 struct page *page
+				 < locked dirty page >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:put a page written through mmap back to i_block
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInlineWritePage( struct inode *inode, struct page *page )
+{
+	struct me2fs_inode_info	*mi;
+	void					*kaddr;
+	loff_t					size;
+
+	mi = ME2FS_I( inode );
+
+	/* only the first page has data, the rest is beyond the end of file			*/
+	if( !page->index )
+	{
+		size = min_t( loff_t, i_size_read( inode ), ME2FS_INLINE_DATA_SIZE );
+
+		kaddr = kmap( page );
+		mutex_lock( &mi->truncate_mutex );
+		{
+			memcpy( mi->i_data, kaddr, size );
+		}
+		mutex_unlock( &mi->truncate_mutex );
+		kunmap( page );
+
+		mark_inode_dirty( inode );
+	}
+
+	unlock_page( page );
+
+	return( 0 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInlineWriteBegin
+	Input		:struct address_space *mapping
+				 < address space of a regular file >
+				 loff_t pos
+				 < position in a file >
+				 unsigned len
+				 < write size >
+				 unsigned flags
+				 < write flags >
+				 struct page **pagep
+				 < page to be written >
+	Output		:struct page **pagep
+				 < locked page filled from i_block >
+	Return		:int
+				 < 1 : the file has no inline data, write through blocks
+				   0 : the page is ready
+				   negative : error >
+
+	Description	:prepare a write to an inline file. a write that does not
+				 fit in i_block moves the data to a block first
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInlineWriteBegin( struct address_space *mapping,
+						   loff_t pos,
+						   unsigned len,
+						   unsigned flags,
+						   struct page **pagep )
+{
+	struct inode	*inode;
+	struct page		*page;
+	int				err;
+
+	inode = mapping->host;
+
+	if( !me2fsHasInlineData( inode ) )
+	{
+		return( 1 );
+	}
+
+	if( ME2FS_INLINE_DATA_SIZE < pos + len )
+	{
+		if( ( err = me2fsConvertInline( inode ) ) )
+		{
+			return( err );
+		}
+
+		return( 1 );
+	}
+
+	if( !( page = grab_cache_page_write_begin( mapping, 0, flags ) ) )
+	{
+		return( -ENOMEM );
+	}
+
+	if( !PageUptodate( page ) )
+	{
+		fillPage( inode, page );
+	}
+
+	*pagep = page;
+
+	return( 0 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInlineWriteEnd
+	Input		:struct inode *inode
+				 < inline file >
+				 loff_t pos
+				 < position in a file >
+				 unsigned copied
+				 < copied number of byte >
+				 struct page *page
+				 < page prepared by me2fsInlineWriteBegin >
+	Output		:void
+	Return		:int
+				 < copied number of byte >
+
+	Description	:commit a write to i_block and release the page
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInlineWriteEnd( struct inode *inode,
+						 loff_t pos,
+						 unsigned copied,
+						 struct page *page )
+{
+	struct me2fs_inode_info	*mi;
+	void					*kaddr;
+
+	mi = ME2FS_I( inode );
+
+	/* ------------------------------------------------------------------------ */
+	/* the page stays clean, i_block holds the data and is written with the		*/
+	/* inode																	*/
+	/* ------------------------------------------------------------------------ */
+	kaddr = kmap( page );
+	mutex_lock( &mi->truncate_mutex );
+	{
+		memcpy( ( char* )mi->i_data + pos, kaddr + pos, copied );
+	}
+	mutex_unlock( &mi->truncate_mutex );
+	kunmap( page );
+
+	if( inode->i_size < pos + copied )
+	{
+		i_size_write( inode, pos + copied );
+	}
+
+	unlock_page( page );
+	page_cache_release( page );
+
+	mark_inode_dirty( inode );
+
+	return( copied );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInlineTruncate
+	Input		:struct inode *inode
+				 < inline file >
+				 loff_t offset
+				 < new size of the file >
+	Output		:void
+	Return		:void
+
+	Description	:clear i_block beyond the new size
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsInlineTruncate( struct inode *inode, loff_t offset )
+{
+	struct me2fs_inode_info	*mi;
+
+	if( ME2FS_INLINE_DATA_SIZE <= offset )
+	{
+		return;
+	}
+
+	mi = ME2FS_I( inode );
+
+	mutex_lock( &mi->truncate_mutex );
+	{
+		memset( ( char* )mi->i_data + offset,
+				0,
+				ME2FS_INLINE_DATA_SIZE - offset );
+	}
+	mutex_unlock( &mi->truncate_mutex );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInlineFiemap
+	Input		:struct inode *inode
+				 < inline file >
+				 struct fiemap_extent_info *fieinfo
+				 < file exent information >
+				 u64 start
+				 < start of range in bytes >
+				 u64 len
+				 < length of range in bytes >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:report the data of an inline file as one inline extent
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInlineFiemap( struct inode *inode,
+					   struct fiemap_extent_info *fieinfo,
+					   u64 start,
+					   u64 len )
+{
+	u64		size;
+	int		ret;
+
+	if( ( ret = fiemap_check_flags( fieinfo, FIEMAP_FLAG_SYNC ) ) )
+	{
+		return( ret );
+	}
+
+	size = i_size_read( inode );
+
+	if( !size || ( size <= start ) )
+	{
+		return( 0 );
+	}
+
+	ret = fiemap_fill_next_extent( fieinfo,
+								   0,
+								   0,
+								   size,
+								   FIEMAP_EXTENT_DATA_INLINE	|
+								   FIEMAP_EXTENT_NOT_ALIGNED	|
+								   FIEMAP_EXTENT_LAST );
+
+	/* 1 only tells that the extent was the last one to fill					*/
+	return( ( ret < 0 ) ? ret : 0 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:void
+	Input		:void
+	Output		:void
+	Return		:void
+
+	Description	:void
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Local Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+==================================================================================
+	Function	:fillPage
+	Input		:struct inode *inode
+				 < inline file >
+				 struct page *page
+				 < locked page >
+	Output		:void
+	Return		:void
+
+	Description	:copy i_block to a page, zero the rest of it and mark it
+				 up to date
+==================================================================================
+*/
+static void fillPage( struct inode *inode, struct page *page )
+{
+	struct me2fs_inode_info	*mi;
+	void					*kaddr;
+	loff_t					size;
+
+	mi		= ME2FS_I( inode );
+	size	= 0;
+
+	/* only the first page has data, the rest of the file is a hole				*/
+	if( !page->index )
+	{
+		size = min_t( loff_t, i_size_read( inode ), ME2FS_INLINE_DATA_SIZE );
+	}
+
+	kaddr = kmap( page );
+	mutex_lock( &mi->truncate_mutex );
+	{
+		memcpy( kaddr, mi->i_data, size );
+	}
+	mutex_unlock( &mi->truncate_mutex );
+	memset( kaddr + size, 0, PAGE_CACHE_SIZE - size );
+	flush_dcache_page( page );
+	kunmap( page );
+
+	SetPageUptodate( page );
+}
+
+/*
+==================================================================================
+	Function	:void
+	Input		:void
+	Output		:void
+	Return		:void
+
+	Description	:void
+==================================================================================
+*/
@@ -0,0 +1,235 @@
+/*********************************************************************************
+	File			: me2fs_inline.h
+	Description		: Definitions for data of tiny files kept in the inode
+
+*********************************************************************************/
+#ifndef	__ME2FS_INLINE_H__
+#define	__ME2FS_INLINE_H__
+
+#include <linux/fs.h>
+
+#include "me2fs.h"
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+/*
+---------------------------------------------------------------------------------
+	On-disk Format of Inline Files
+
+	super block	: ME2FS_FEATURE_INCOMPAT_INLINE_DATA ( 0x80000000 ) is set in
+				  s_feature_incompat. the driver never sets it. mke2fs and
+				  tune2fs do not know the bit, the administrator sets it
+				  with debugfs -w -R "feature FEATURE_I31" <device> and
+				  mounts with inline_data. kernels and e2fsck that do not
+				  know the bit refuse the file system
+	inode		: ME2FS_INLINE_DATA_FL ( 0x0001 ) in l_i_me2fs_flags, the
+				  last 16 bits of osd2.linux2. ext4 names them l_i_reserved
+				  and e2fsprogs does not use them. i_flags is not changed
+	data		: the first i_size bytes of i_block[ 0 .. 14 ], 60 bytes at
+				  most, the rest is zero. no data block is allocated and
+				  i_size has its usual meaning
+	growing		: past 60 bytes the data moves to a block, the flag is
+				  cleared and i_block is a block map again for good
+---------------------------------------------------------------------------------
+*/
+/* bytes of data an inline file can hold, the whole of i_block					*/
+#define	ME2FS_INLINE_DATA_SIZE		( ME2FS_NR_BLOCKS * sizeof( __le32 ) )
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInitInlineData
+	Input		:struct inode *inode
+				 < new regular file >
+	Output		:void
+	Return		:void
+
+	Description	:make a new file keep its data in i_block until it grows
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsInitInlineData( struct inode *inode );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsConvertInline
+	Input		:struct inode *inode
+				 < vfs inode >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:move the data of an inline file to a block. caller holds
+				 i_mutex
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsConvertInline( struct inode *inode );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInlineReadPage
+	Input		:struct inode *inode
+				 < inline file >
+				 struct page *page
+				 < locked page to be filled with data >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:fill a page from i_block
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInlineReadPage( struct inode *inode, struct page *page );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInlineWritePage
+	Input		:struct inode *inode
+				 < inline file >
+				 struct page *page
+				 < locked dirty page >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:put a page written through mmap back to i_block
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInlineWritePage( struct inode *inode, struct page *page );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInlineWriteBegin
+	Input		:struct address_space *mapping
+				 < address space of a regular file >
+				 loff_t pos
+				 < position in a file >
+				 unsigned len
+				 < write size >
+				 unsigned flags
+				 < write flags >
+				 struct page **pagep
+				 < page to be written >
+	Output		:struct page **pagep
+				 < locked page filled from i_block >
+	Return		:int
+				 < 1 : the file has no inline data, write through blocks
+				   0 : the page is ready
+				   negative : error >
+
+	Description	:prepare a write to an inline file. a write that does not
+				 fit in i_block moves the data to a block first
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInlineWriteBegin( struct address_space *mapping,
+						   loff_t pos,
+						   unsigned len,
+						   unsigned flags,
+						   struct page **pagep );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInlineWriteEnd
+	Input		:struct inode *inode
+				 < inline file >
+				 loff_t pos
+				 < position in a file >
+				 unsigned copied
+				 < copied number of byte >
+				 struct page *page
+				 < page prepared by me2fsInlineWriteBegin >
+	Output		:void
+	Return		:int
+				 < copied number of byte >
+
+	Description	:commit a write to i_block and release the page
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInlineWriteEnd( struct inode *inode,
+						 loff_t pos,
+						 unsigned copied,
+						 struct page *page );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInlineTruncate
+	Input		:struct inode *inode
+				 < inline file >
+				 loff_t offset
+				 < new size of the file >
+	Output		:void
+	Return		:void
+
+	Description	:clear i_block beyond the new size
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsInlineTruncate( struct inode *inode, loff_t offset );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInlineFiemap
+	Input		:struct inode *inode
+				 < inline file >
+				 struct fiemap_extent_info *fieinfo
+				 < file exent information >
+				 u64 start
+				 < start of range in bytes >
+				 u64 len
+				 < length of range in bytes >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:report the data of an inline file as one inline extent
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInlineFiemap( struct inode *inode,
+					   struct fiemap_extent_info *fieinfo,
+					   u64 start,
+					   u64 len );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsHasInlineData
+	Input		:struct inode *inode
+				 < vfs inode >
+	Output		:void
+	Return		:int
+				 < 1 : data is kept in i_block, 0 : not >
+
+	Description	:test if a file keeps its data in the inode
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+static inline int me2fsHasInlineData( struct inode *inode )
+{
+	return( ( ME2FS_I( inode )->i_me2fs_flags & ME2FS_INLINE_DATA_FL ) ? 1 : 0 );
+}
+
+#endif	// __ME2FS_INLINE_H__
@@ -11,6 +11,8 @@
 #include <linux/slab.h>
 #include <linux/quotaops.h>
 #include <linux/posix_acl.h>
+#include <linux/blkdev.h>
+#include <linux/sort.h>
 
 #include "me2fs.h"
 #include "me2fs_util.h"
@@ -24,6 +26,10 @@
 #include "me2fs_namei.h"
 #include "me2fs_super.h"
 #include "me2fs_xattr.h"
+#include "me2fs_delalloc.h"
+#include "me2fs_falloc.h"
+#include "me2fs_reclaim.h"
+#include "me2fs_inline.h"
 
 /*
 ==================================================================================
@@ -77,6 +83,14 @@ static int me2fsWriteEnd( struct file *file,
 						  void *fsdata );
 static int me2fsWritePages( struct address_space *mapping,
 							struct writeback_control *wbc );
+static int me2fsDaWritePage( struct page *page, struct writeback_control *wbc );
+static int me2fsDaWriteBegin( struct file *file,
+							  struct address_space *mapping,
+							  loff_t pos,
+							  unsigned len,
+							  unsigned flags,
+							  struct page **pagep,
+							  void **fsdata );
 static sector_t me2fsBmap( struct address_space *mapping, sector_t block );
 static ssize_t
 me2fsDirectIO( int rw,
@@ -94,7 +108,11 @@ me2fsDirectIO( int rw,
 static struct ext2_inode*
 me2fsGetExt2Inode( struct super_block *sb,
 				   unsigned long ino,
-				   struct buffer_head **bhp );
+				   struct buffer_head **bhp,
+				   int lookup );
+static void readaheadInodeTable( struct super_block *sb,
+								 unsigned long itb_start,
+								 unsigned long block );
 static int
 me2fsBlockToPath( struct inode *inode,
 				  unsigned long i_block,
@@ -108,6 +126,17 @@ me2fsGetBranch( struct inode	*inode,
 				int				*err );
 static inline int
 verifyIndirectChain( Indirect *from, Indirect *to );
+static int lookupExtent( struct inode *inode,
+						 unsigned long iblock,
+						 unsigned long maxblocks,
+						 unsigned long *pblk,
+						 unsigned int *gen );
+static void cacheExtent( struct inode *inode,
+						 unsigned int gen,
+						 unsigned long lblk,
+						 unsigned long pblk,
+						 unsigned long len );
+static void invalidateExtents( struct inode *inode );
 static int me2fsGetBlocks( struct inode *inode,
 						   sector_t iblock,
 						   unsigned long maxblocks,
@@ -121,7 +150,8 @@ static int allocBranch( struct inode *inode,
 						int *blks,
 						unsigned long goal,
 						int *offsets,
-						Indirect *branch );
+						Indirect *branch,
+						int reserved );
 static void spliceBranch( struct inode *inode,
 						  long block,
 						  Indirect *where,
@@ -136,7 +166,10 @@ isInodeFastSymlink( struct inode *inode );
 static void truncateBlocks( struct inode *inode, loff_t offset );
 static void __truncateBlocks( struct inode *inode, loff_t offset );
 static inline void
-freeData( struct inode *inode, __le32 *blocks, __le32 *end_block );
+freeData( struct inode *inode,
+		  struct me2fs_free_batch *batch,
+		  __le32 *blocks,
+		  __le32 *end_block );
 static Indirect*
 findShared( struct inode *inode,
 			int depth,
@@ -147,10 +180,26 @@ static inline int
 searchFirstNonZero( __le32 *cur, __le32 *end );
 static void
 freeBranches( struct inode *inode,
+			  struct me2fs_free_batch *batch,
 			  __le32 *cur,
 			  __le32 *end,
 			  int depth );
-static int setInodeSize( struct inode *inode, loff_t newsize );
+static void
+punchBranches( struct inode *inode,
+			   struct me2fs_free_batch *batch,
+			   __le32 *cur,
+			   __le32 *end,
+			   int depth,
+			   u64 first,
+			   u64 span,
+			   u64 start,
+			   u64 last );
+static struct ext2_group_desc*
+getInodeLocation( struct super_block *sb,
+				  unsigned long ino,
+				  unsigned long *block,
+				  unsigned long *offset );
+static int compareBlockNumber( const void *a, const void *b );
 static void writeFailed( struct address_space *mapping, loff_t size );
 static unsigned long
 blocksToAllocate( Indirect *branch,
@@ -162,7 +211,12 @@ static int allocBlocks( struct inode *inode,
 						int indirect_blks,
 						int blks,
 						unsigned long new_blocks[ 4 ],
-						int *err );
+						int *err,
+						int reserved );
+static void forgetBranch( struct inode *inode,
+						  Indirect *branch,
+						  int indirect_blks,
+						  int blks );
 /*
 ==================================================================================
 
@@ -216,6 +270,27 @@ const struct address_space_operations me2fs_aops =
 	.error_remove_page	= generic_error_remove_page,
 };
 
+/*
+---------------------------------------------------------------------------------
+	Address Space Operations for Delayed Allocation
+---------------------------------------------------------------------------------
+*/
+static const struct address_space_operations me2fs_da_aops =
+{
+	.readpage			= me2fsReadPage,
+	.readpages			= me2fsReadPages,
+	.writepage			= me2fsDaWritePage,
+	.write_begin		= me2fsDaWriteBegin,
+	.write_end			= me2fsWriteEnd,
+	.bmap				= me2fsBmap,
+	.invalidatepage		= me2fsDaInvalidatePage,
+	.direct_IO			= me2fsDirectIO,
+	.writepages			= me2fsDaWritePages,
+	.migratepage		= buffer_migrate_page,
+	.is_partially_uptodate = block_is_partially_uptodate,
+	.error_remove_page	= generic_error_remove_page,
+};
+
 /*
 ++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
@@ -272,7 +347,7 @@ struct inode *me2fsGetVfsInode( struct super_block *sb, unsigned int ino )
 	mei = ME2FS_I( inode );
 	mei->i_block_alloc_info = NULL;
 
-	ext2_inode = me2fsGetExt2Inode( inode->i_sb, ino, &bh );
+	ext2_inode = me2fsGetExt2Inode( inode->i_sb, ino, &bh, 1 );
 
 	if( IS_ERR( ext2_inode ) )
 	{
@@ -319,6 +394,18 @@ struct inode *me2fsGetVfsInode( struct super_block *sb, unsigned int ino )
 
 	inode->i_blocks			= le32_to_cpu( ext2_inode->i_blocks );
 	mei->i_flags			= le32_to_cpu( ext2_inode->i_flags );
+	mei->i_me2fs_flags		= 0;
+
+	/* ------------------------------------------------------------------------ */
+	/* the field holds the checksum of ext4 on other file systems				*/
+	/* ------------------------------------------------------------------------ */
+	if( ME2FS_SB( sb )->s_esb->s_feature_incompat &
+		cpu_to_le32( ME2FS_FEATURE_INCOMPAT_INLINE_DATA ) )
+	{
+		mei->i_me2fs_flags =
+			le16_to_cpu( ext2_inode->osd2.linux2.l_i_me2fs_flags );
+	}
+
 	mei->i_faddr			= le32_to_cpu( ext2_inode->i_faddr );
 	mei->i_frag_no			= ext2_inode->osd2.linux2.l_i_frag;
 	mei->i_frag_size		= ext2_inode->osd2.linux2.l_i_fsize;
@@ -351,7 +438,7 @@ struct inode *me2fsGetVfsInode( struct super_block *sb, unsigned int ino )
 	{
 		inode->i_fop			= &me2fs_file_operations;
 		inode->i_op				= &me2fs_file_inode_operations;
-		inode->i_mapping->a_ops	= &me2fs_aops;
+		me2fsSetFileAops( inode );
 	}
 	else if( S_ISDIR( inode->i_mode ) )
 	{
@@ -555,6 +642,7 @@ void me2fsEvictInode( struct inode *inode )
 	/* truncate page cache														*/
 	/* ------------------------------------------------------------------------ */
 	truncate_inode_pages( &inode->i_data, 0 );
+	me2fsDaReleaseInode( inode );
 
 	//DBGPRINT( "<ME2FS>%s:info:end truncate_inode_pages\n", __func__ );
 	//DBGPRINT( "<ME2FS>%s:info:want_delete(%d)\n", __func__, want_delete );
@@ -575,7 +663,7 @@ void me2fsEvictInode( struct inode *inode )
 		/* truncate to 0														*/
 		inode->i_size = 0;
 
-		if( inode->i_blocks )
+		if( inode->i_blocks && !me2fsQueueReclaim( inode ) )
 		{
 			//DBGPRINT( "<ME2FS>%s:info:start truncateBlocks\n", __func__ );
 			/* ---------------------------------------------------------------- */
@@ -600,6 +688,8 @@ void me2fsEvictInode( struct inode *inode )
 		kfree( rsv );
 	}
 
+	me2fsDirSummaryDrop( inode );
+
 	if( want_delete )
 	{
 		//DBGPRINT( "<ME2FS>%s:info:start me2fsFreeInode\n", __func__ );
@@ -639,6 +729,11 @@ int me2fsFiemap( struct inode*inode,
 				 u64 start,
 				 u64 len )
 {
+	if( me2fsHasInlineData( inode ) )
+	{
+		return( me2fsInlineFiemap( inode, fieinfo, start, len ) );
+	}
+
 	return( generic_block_fiemap( inode, fieinfo, start, len, me2fsGetBlock ) );
 }
 
@@ -691,7 +786,7 @@ int me2fsSetAttr( struct dentry *dentry, struct iattr *iattr )
 	if( ( iattr->ia_valid & ATTR_SIZE ) &&
 		( iattr->ia_size != inode->i_size ) )
 	{
-		if( ( error = setInodeSize( inode, iattr->ia_size ) ) )
+		if( ( error = me2fsSetInodeSize( inode, iattr->ia_size ) ) )
 		{
 			return( error );
 		}
@@ -865,7 +960,7 @@ _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 				 struct buffer_head *bh_result
 				 < buffer cache for the block >
 				 int create
-				 < 0 : plain lookup, 1 : creation >
+				 < 0 : plain lookup, ME2FS_GET_BLOCKS_xxx : creation >
 	Output		:struct buffer_head *bh_result
 				 < buffer cache for the block >
 	Return		:int
@@ -905,6 +1000,268 @@ int me2fsGetBlock( struct inode *inode,
 	return( ret );
 }
 
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsPrefetchInodeTables
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long *inos
+				 < inode numbers, used as work area and overwritten >
+				 int count
+				 < number of inode numbers >
+	Output		:void
+	Return		:void
+
+	Description	:start reading the inode table blocks of the inodes not
+				 in the inode cache without waiting. each block is read
+				 once in ascending order under a plug
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsPrefetchInodeTables( struct super_block *sb,
+							   unsigned long *inos,
+							   int count )
+{
+	struct blk_plug	plug;
+	unsigned long	prev;
+	int				nr_blocks;
+	int				i;
+
+	if( !count || bdi_read_congested( sb->s_bdi ) )
+	{
+		return;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* translate inode numbers into inode table blocks. an inode in the cache	*/
+	/* does not need its block													*/
+	/* ------------------------------------------------------------------------ */
+	nr_blocks = 0;
+
+	for( i = 0 ; i < count ; i++ )
+	{
+		struct inode	*inode;
+		unsigned long	block;
+		unsigned long	offset;
+
+		if( ( inode = ilookup( sb, inos[ i ] ) ) )
+		{
+			iput( inode );
+			continue;
+		}
+
+		if( !IS_ERR( getInodeLocation( sb, inos[ i ], &block, &offset ) ) )
+		{
+			inos[ nr_blocks++ ] = block;
+		}
+	}
+
+	sort( inos, nr_blocks, sizeof( *inos ), compareBlockNumber, NULL );
+
+	/* ------------------------------------------------------------------------ */
+	/* submit reads of distinct blocks at once									*/
+	/* ------------------------------------------------------------------------ */
+	blk_start_plug( &plug );
+
+	prev = 0;
+
+	for( i = 0 ; i < nr_blocks ; i++ )
+	{
+		if( inos[ i ] != prev )
+		{
+			sb_breadahead( sb, inos[ i ] );
+			prev = inos[ i ];
+		}
+	}
+
+	blk_finish_plug( &plug );
+}
+
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsSetInodeSize
+	Input		:struct inode *inode
+				 < vfs inode >
+				 loff_t newsize
+				 < new size of a file >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:set size and free blocks beyond it
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsSetInodeSize( struct inode *inode, loff_t newsize )
+{
+	int	error;
+
+	if( !( S_ISREG( inode->i_mode )	||
+		S_ISDIR( inode->i_mode )	||
+		S_ISLNK( inode->i_mode ) ) )
+	{
+		return( -EINVAL );
+	}
+
+	if( isInodeFastSymlink( inode ) )
+	{
+		return( -EINVAL );
+	}
+
+	if( IS_APPEND( inode ) || IS_IMMUTABLE( inode ) )
+	{
+		return( -EPERM );
+	}
+
+	inode_dio_wait( inode );
+
+	/* ------------------------------------------------------------------------ */
+	/* an inline file stays in the inode as long as the new size fits in it		*/
+	/* ------------------------------------------------------------------------ */
+	if( ME2FS_INLINE_DATA_SIZE < newsize )
+	{
+		if( ( error = me2fsConvertInline( inode ) ) )
+		{
+			return( error );
+		}
+	}
+
+#if 0	// as for now, xip is not implemented
+	if( mapping_is_xip( inode->i_mapping ) )
+	{
+		error = xip_truncate_page( inode->i_mapping, newsize );
+	}
+	else if( ME2FS_SB( inode->i_sb )->s_mount_opt & EXT2_MOUNT_NOBH )
+#endif
+	if( me2fsHasInlineData( inode ) )
+	{
+		/* truncate_setsize() zeroes the page beyond the new size				*/
+		error = 0;
+	}
+	else if( ME2FS_SB( inode->i_sb )->s_mount_opt & EXT2_MOUNT_NOBH )
+	{
+		error = nobh_truncate_page( inode->i_mapping, newsize, me2fsGetBlock );
+	}
+	else
+	{
+		error = block_truncate_page( inode->i_mapping, newsize, me2fsGetBlock );
+	}
+
+	if( error )
+	{
+		return( error );
+	}
+
+	truncate_setsize( inode, newsize );
+	__truncateBlocks( inode, newsize );
+
+	inode->i_ctime = CURRENT_TIME_SEC;
+	inode->i_mtime = inode->i_ctime;
+
+	if( inode_needs_sync( inode ) )
+	{
+		sync_mapping_buffers( inode->i_mapping );
+		sync_inode_metadata( inode, 1 );
+	}
+	else
+	{
+		mark_inode_dirty( inode );
+	}
+
+	return( 0 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsPunchBlocks
+	Input		:struct inode *inode
+				 < vfs inode >
+				 sector_t start
+				 < first block to free >
+				 sector_t end
+				 < end of blocks to free (exclusive) >
+	Output		:void
+	Return		:void
+
+	Description	:free blocks in the middle of a file. indirect blocks left
+				 empty are freed as well
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsPunchBlocks( struct inode *inode, sector_t start, sector_t end )
+{
+	struct me2fs_inode_info	*mi;
+	struct me2fs_free_batch	batch;
+	__le32					*i_data;
+	u64						addr_per_block;
+	u64						first;
+	u64						span;
+	int						depth;
+
+	if( end <= start )
+	{
+		return;
+	}
+
+	mi				= ME2FS_I( inode );
+	i_data			= mi->i_data;
+	addr_per_block	= inode->i_sb->s_blocksize / sizeof( __u32 );
+
+	mutex_lock( &mi->truncate_mutex );
+	me2fsInitFreeBatch( &batch, inode->i_sb, inode );
+
+	invalidateExtents( inode );
+
+	punchBranches( inode,
+				   &batch,
+				   i_data,
+				   i_data + ME2FS_NDIR_BLOCKS,
+				   0, 0, 1, start, end );
+
+	/* ------------------------------------------------------------------------ */
+	/* single, double and triple indirect trees in file order					*/
+	/* ------------------------------------------------------------------------ */
+	first	= ME2FS_NDIR_BLOCKS;
+	span	= addr_per_block;
+
+	for( depth = 1 ; ( depth <= 3 ) && ( first < end ) ; depth++ )
+	{
+		punchBranches( inode,
+					   &batch,
+					   i_data + ME2FS_IND_BLOCK + depth - 1,
+					   i_data + ME2FS_IND_BLOCK + depth,
+					   depth, first, span, start, end );
+		first	+= span;
+		span	*= addr_per_block;
+	}
+
+	invalidateExtents( inode );
+
+	me2fsEndFreeBatch( &batch );
+	mutex_unlock( &mi->truncate_mutex );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsSetFileAops
+	Input		:struct inode *inode
+				 < vfs inode of a regular file >
+	Output		:void
+	Return		:void
+
+	Description	:set address space operations of a regular file by the
+				 mount options
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsSetFileAops( struct inode *inode )
+{
+	if( ME2FS_SB( inode->i_sb )->s_mount_opt & EXT2_MOUNT_DELALLOC )
+	{
+		inode->i_mapping->a_ops = &me2fs_da_aops;
+	}
+	else
+	{
+		inode->i_mapping->a_ops = &me2fs_aops;
+	}
+}
 
 /*
 _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
@@ -948,6 +1305,12 @@ _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 static int me2fsReadPage( struct file *filp, struct page *page )
 {
 	DBGPRINT( "<ME2FS>read page\n" );
+
+	if( me2fsHasInlineData( page->mapping->host ) )
+	{
+		return( me2fsInlineReadPage( page->mapping->host, page ) );
+	}
+
 	return( mpage_readpage( page, me2fsGetBlock ) );
 }
 
@@ -975,6 +1338,13 @@ static int me2fsReadPages( struct file *filp,
 {
 	DBGPRINT( "<ME2FS>read page[s]\n" );
 	DBGPRINT( "vfs i_size = %lu\n", ( unsigned long )filp->f_inode->i_size );
+
+	/* the page of an inline file is filled by readpage							*/
+	if( me2fsHasInlineData( mapping->host ) )
+	{
+		return( 0 );
+	}
+
 	return( mpage_readpages( mapping, pages, nr_pages, me2fsGetBlock ) );
 }
 /*
@@ -994,6 +1364,12 @@ static int me2fsReadPages( struct file *filp,
 static int me2fsWritePage( struct page *page, struct writeback_control *wbc )
 {
 	DBGPRINT( "<ME2FS>write page\n" );
+
+	if( me2fsHasInlineData( page->mapping->host ) )
+	{
+		return( me2fsInlineWritePage( page->mapping->host, page ) );
+	}
+
 	return( block_write_full_page( page, me2fsGetBlock, wbc ) );
 }
 
@@ -1032,6 +1408,12 @@ static int me2fsWriteBegin( struct file *file,
 	int		ret;
 
 	DBGPRINT( "<ME2FS>write begin\n" );
+
+	if( ( ret = me2fsInlineWriteBegin( mapping, pos, len, flags, pagep ) ) <= 0 )
+	{
+		return( ret );
+	}
+
 	ret = block_write_begin( mapping, pos, len, flags, pagep, me2fsGetBlock );
 
 	if( ret < 0 )
@@ -1079,6 +1461,11 @@ static int me2fsWriteEnd( struct file *file,
 
 	DBGPRINT( "<ME2FS>write end\n" );
 
+	if( me2fsHasInlineData( mapping->host ) )
+	{
+		return( me2fsInlineWriteEnd( mapping->host, pos, copied, page ) );
+	}
+
 	ret = generic_write_end( file, mapping, pos, len, copied, page, fsdata );
 
 	if( ret < len )
@@ -1108,9 +1495,106 @@ static int me2fsWritePages( struct address_space *mapping,
 {
 	DBGPRINT( "<ME2FS>write page[s]\n" );
 	DBGPRINT( "ino=%lu\n", mapping->host->i_ino );
+
+	if( me2fsHasInlineData( mapping->host ) )
+	{
+		return( generic_writepages( mapping, wbc ) );
+	}
+
 	return( mpage_writepages( mapping, wbc, me2fsGetBlock ) );
 }
 
+/*
+==================================================================================
+	Function	:me2fsDaWritePage
+	Input		:struct page *page
+				 < page cache >
+				 struct writeback_control *wbc
+				 < writeback control information >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:make a write back request of a page cache, allocating its
+				 delayed blocks
+==================================================================================
+*/
+static int me2fsDaWritePage( struct page *page, struct writeback_control *wbc )
+{
+	if( me2fsHasInlineData( page->mapping->host ) )
+	{
+		return( me2fsInlineWritePage( page->mapping->host, page ) );
+	}
+
+	return( block_write_full_page( page, me2fsDaGetBlockWrite, wbc ) );
+}
+
+/*
+==================================================================================
+	Function	:me2fsDaWriteBegin
+	Input		:struct file *file
+				 < vfs file object >
+				 struct address_space *mapping
+				 < address space asociated with the file >
+				 loff_t pos
+				 < position in a file >
+				 unsigned len
+				 < write size >
+				 unsigned flags
+				 < write flags >
+				 struct page **pagep
+				 < pages to be initialized >
+				 void **fsdata
+				 < file system specific data >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:prepare pages to write, reserving holes instead of
+				 allocating them
+==================================================================================
+*/
+static int me2fsDaWriteBegin( struct file *file,
+							  struct address_space *mapping,
+							  loff_t pos,
+							  unsigned len,
+							  unsigned flags,
+							  struct page **pagep,
+							  void **fsdata )
+{
+	int		retried;
+	int		ret;
+
+	retried = 0;
+
+	if( ( ret = me2fsInlineWriteBegin( mapping, pos, len, flags, pagep ) ) <= 0 )
+	{
+		return( ret );
+	}
+
+retry:
+	ret = block_write_begin( mapping, pos, len, flags, pagep,
+							 me2fsDaGetBlockPrep );
+
+	if( ret < 0 )
+	{
+		writeFailed( mapping, pos + len );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* reservations of dirty pages include indirect blocks which are often not	*/
+	/* needed. write them back once and retry, the page is unlocked by now		*/
+	/* ------------------------------------------------------------------------ */
+	if( ( ret == -ENOSPC )
+		&& !retried++
+		&& me2fsDaFlushReserved( mapping->host->i_sb ) )
+	{
+		goto retry;
+	}
+
+	return( ret );
+}
+
 /*
 ==================================================================================
 	Function	:me2fsBmap
@@ -1126,6 +1610,12 @@ static int me2fsWritePages( struct address_space *mapping,
 */
 static sector_t me2fsBmap( struct address_space *mapping, sector_t block )
 {
+	/* data in the inode has no block to map									*/
+	if( me2fsHasInlineData( mapping->host ) )
+	{
+		return( 0 );
+	}
+
 	return( generic_block_bmap( mapping, block, me2fsGetBlock ) );
 }
 
@@ -1167,6 +1657,15 @@ me2fsDirectIO( int rw,
 
 	count	= iov_iter_count( iter );
 
+	/* ------------------------------------------------------------------------ */
+	/* nothing done here makes the caller fall back to buffered i/o, which		*/
+	/* handles an inline file													*/
+	/* ------------------------------------------------------------------------ */
+	if( me2fsHasInlineData( inode ) )
+	{
+		return( 0 );
+	}
+
 	ret = blockdev_direct_IO( rw,
 							  iocb,
 							  inode,
@@ -1199,6 +1698,8 @@ me2fsDirectIO( int rw,
 				 < inode number to get >
 				 struct buffer_head **bhp
 				 < buffer head pointer >
+				 int lookup
+				 < 1 : inode is looked up, inode table may be read ahead >
 	Output		:struct buffer_head **bhp
 				 < buffer cache to be read inode >
 	Return		:struct ext2_inode
@@ -1210,63 +1711,234 @@ me2fsDirectIO( int rw,
 static struct ext2_inode*
 me2fsGetExt2Inode( struct super_block *sb,
 				   unsigned long ino,
-				   struct buffer_head **bhp )
+				   struct buffer_head **bhp,
+				   int lookup )
 {
 	struct ext2_group_desc	*gdesc;
-	unsigned long			block_group;
-	unsigned long			block_offset;		// offset in a block group
-	unsigned long			inode_index;
+	struct buffer_head		*bh;
+	unsigned long			block_offset;		// offset in a block
 	unsigned long			inode_block;
 
 	*bhp = NULL;
 
 	/* ------------------------------------------------------------------------ */
-	/* sanity check for inode number											*/
+	/* get inode block number and read it										*/
 	/* ------------------------------------------------------------------------ */
-	if( ( ino != ME2FS_EXT2_ROOT_INO ) &&
-		( ino < ME2FS_SB( sb )->s_first_ino ) )
+	gdesc = getInodeLocation( sb, ino, &inode_block, &block_offset );
+
+	if( IS_ERR( gdesc ) )
 	{
-		ME2FS_ERROR( "<ME2FS>failed to get ext2 inode [1] (ino=%lu)\n", ino );
-		return( ERR_PTR( -EINVAL ) );
+		ME2FS_ERROR( "<ME2FS>failed to get ext2 inode (ino=%lu)\n", ino );
+		return( ERR_CAST( gdesc ) );
 	}
 
-	if( le32_to_cpu( ME2FS_SB( sb )->s_esb->s_inodes_count ) < ino )
+	if( !( bh = sb_getblk( sb, inode_block ) ) )
 	{
-		ME2FS_ERROR( "<ME2FS>failed to get ext2 inode [2] (ino=%lu)\n", ino );
-		return( ERR_PTR( -EINVAL ) );
+		ME2FS_ERROR( "<ME2FS>unable to read inode block [1].\n" );
+		ME2FS_ERROR( "<ME2FS>( ino=%lu )\n", ino );
+
+		return( ERR_PTR( -EIO ) );
 	}
 
+	if( !bh_uptodate_or_lock( bh ) )
+	{
+		struct blk_plug	plug;
+		int				err;
+
+		/* -------------------------------------------------------------------- */
+		/* the window and the block go down under one plug, where the block		*/
+		/* merges in front of the window as one request							*/
+		/* -------------------------------------------------------------------- */
+		blk_start_plug( &plug );
+
+		if( lookup )
+		{
+			atomic_long_inc( &ME2FS_SB( sb )->s_itb_misses );
+			readaheadInodeTable( sb,
+								 le32_to_cpu( gdesc->bg_inode_table ),
+								 inode_block );
+		}
+
+		err = bh_submit_read( bh );
+
+		blk_finish_plug( &plug );
+
+		if( err )
+		{
+			ME2FS_ERROR( "<ME2FS>unable to read inode block [2].\n" );
+			ME2FS_ERROR( "<ME2FS>( ino=%lu )\n", ino );
+			brelse( bh );
+
+			return( ERR_PTR( -EIO ) );
+		}
+	}
+	else if( lookup )
+	{
+		atomic_long_inc( &ME2FS_SB( sb )->s_itb_hits );
+	}
+
+	*bhp = bh;
+
+	return( ( struct ext2_inode* )( ( *bhp )->b_data + block_offset ) );
+}
+
+/*
+==================================================================================
+	Function	:readaheadInodeTable
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long itb_start
+				 < first block of the inode table of the group >
+				 unsigned long block
+				 < inode table block about to be read >
+	Output		:void
+	Return		:void
+
+	Description	:read ahead the inode table blocks following a block when
+				 misses come near each other. the window doubles while
+				 they do and is dropped when they do not. the block itself
+				 is read by the caller, which holds a plug
+==================================================================================
+*/
+static void readaheadInodeTable( struct super_block *sb,
+								 unsigned long itb_start,
+								 unsigned long block )
+{
+	struct me2fs_sb_info	*msi;
+	unsigned long			max_window;
+	unsigned long			window;
+	unsigned long			last;
+	unsigned long			itb_end;
+	unsigned long			end;
+
+	msi			= ME2FS_SB( sb );
+	max_window	= ACCESS_ONCE( msi->s_itb_ra_blocks );
+	itb_end		= itb_start + msi->s_itb_per_group;
+
 	/* ------------------------------------------------------------------------ */
-	/* get group descriptor														*/
+	/* the state is shared by all lookups of the file system. each field is		*/
+	/* loaded and stored once without a lock, so a lookup may pair the window	*/
+	/* of one racer with the last block of another. that only costs a window	*/
 	/* ------------------------------------------------------------------------ */
-	block_group = ( ino - 1 ) / ME2FS_SB( sb )->s_inodes_per_group;
-	gdesc = ( struct ext2_group_desc* )me2fsGetGroupDescriptor( sb, block_group );
-	if( !gdesc )
+	last	= ACCESS_ONCE( msi->s_itb_ra_last );
+	window	= ACCESS_ONCE( msi->s_itb_ra_window );
+
+	if( ( itb_start <= last ) && ( last < itb_end ) &&
+		( ( block < last ? last - block : block - last )
+		  <= max( window, ( unsigned long )ME2FS_ITB_RA_MIN_BLOCKS ) ) )
+	{
+		window = window ? ( window << 1 ) : ME2FS_ITB_RA_MIN_BLOCKS;
+		window = min( window, max_window );
+	}
+	else
 	{
-		ME2FS_ERROR( "<ME2FS>cannot find group descriptor (ino=%lu)\n", ino );
+		window = 0;
+	}
 
-		return( ERR_PTR( -EIO ) );
+	end = min( block + 1 + window, itb_end );
+
+	ACCESS_ONCE( msi->s_itb_ra_window )	= window;
+	ACCESS_ONCE( msi->s_itb_ra_last )	= end - 1;
+
+	if( !window || bdi_read_congested( sb->s_bdi ) )
+	{
+		return;
 	}
-	
+
+	for( block++ ; block < end ; block++ )
+	{
+		sb_breadahead( sb, block );
+	}
+}
+
+/*
+==================================================================================
+	Function	:getInodeLocation
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long ino
+				 < inode number >
+				 unsigned long *block
+				 < block of inode table which holds the inode >
+				 unsigned long *offset
+				 < offset of the inode in the block >
+	Output		:unsigned long *block
+				 unsigned long *offset
+	Return		:struct ext2_group_desc*
+				 < group descriptor of the inode, or error >
+
+	Description	:get where an inode is on a disk
+==================================================================================
+*/
+static struct ext2_group_desc*
+getInodeLocation( struct super_block *sb,
+				  unsigned long ino,
+				  unsigned long *block,
+				  unsigned long *offset )
+{
+	struct me2fs_sb_info	*msi;
+	struct ext2_group_desc	*gdesc;
+	unsigned long			byte;
+
+	msi = ME2FS_SB( sb );
+
 	/* ------------------------------------------------------------------------ */
-	/* get inode block number and read it										*/
+	/* sanity check for inode number											*/
 	/* ------------------------------------------------------------------------ */
-	block_offset	= ( ( ino - 1 ) % ME2FS_SB( sb )->s_inodes_per_group )
-					  * ME2FS_SB( sb )->s_inode_size;
-	inode_index		= block_offset >> sb->s_blocksize_bits;
-	inode_block		= le32_to_cpu( gdesc->bg_inode_table ) + inode_index;
-	
-	if( !( *bhp = sb_bread( sb, inode_block ) ) )
+	if( ( ( ino != ME2FS_EXT2_ROOT_INO ) && ( ino < msi->s_first_ino ) )
+		|| ( le32_to_cpu( msi->s_esb->s_inodes_count ) < ino ) )
+	{
+		return( ERR_PTR( -EINVAL ) );
+	}
+
+	gdesc = me2fsGetGroupDescriptor( sb, ( ino - 1 ) / msi->s_inodes_per_group );
+
+	if( !gdesc )
+	{
+		return( ERR_PTR( -EIO ) );
+	}
+
+	byte	= ( ( ino - 1 ) % msi->s_inodes_per_group ) * msi->s_inode_size;
+	*block	= le32_to_cpu( gdesc->bg_inode_table )
+			  + ( byte >> sb->s_blocksize_bits );
+	*offset	= byte & ( sb->s_blocksize - 1 );
+
+	return( gdesc );
+}
+
+/*
+==================================================================================
+	Function	:compareBlockNumber
+	Input		:const void *a
+				 < block number >
+				 const void *b
+				 < block number >
+	Output		:void
+	Return		:int
+				 < -1:a is lower 0:same 1:a is higher >
+
+	Description	:compare function to sort block numbers
+==================================================================================
+*/
+static int compareBlockNumber( const void *a, const void *b )
+{
+	unsigned long	block_a;
+	unsigned long	block_b;
+
+	block_a = *( const unsigned long* )a;
+	block_b = *( const unsigned long* )b;
+
+	if( block_a < block_b )
 	{
-		ME2FS_ERROR( "<ME2FS>unable to read inode block [1].\n" );
-		ME2FS_ERROR( "<ME2FS>( ino=%lu )\n", ino );
+		return( -1 );
+	}
 
-		return( ERR_PTR( -EIO ) );
+	if( block_b < block_a )
+	{
+		return( 1 );
 	}
-	
-	block_offset &= ( sb->s_blocksize - 1 );
 
-	return( ( struct ext2_inode* )( ( *bhp )->b_data + block_offset ) );
+	return( 0 );
 }
 
 
@@ -1506,6 +2178,174 @@ verifyIndirectChain( Indirect *from, Indirect *to )
 	return( to < from );
 }
 
+/*
+==================================================================================
+	Function	:lookupExtent
+	Input		:struct inode *inode
+				 < vfs inode >
+				 unsigned long iblock
+				 < block number in file >
+				 unsigned long maxblocks
+				 < max blocks to get >
+				 unsigned long *pblk
+				 < disk block of iblock >
+				 unsigned int *gen
+				 < generation of the cache >
+	Output		:unsigned long *pblk
+				 < disk block of iblock if it is cached >
+				 unsigned int *gen
+				 < generation to cache a run found in the block map with >
+	Return		:int
+				 < number of blocks mapped, 0 if iblock is not cached >
+
+	Description	:map blocks from the runs cached in the inode
+==================================================================================
+*/
+static int lookupExtent( struct inode *inode,
+						 unsigned long iblock,
+						 unsigned long maxblocks,
+						 unsigned long *pblk,
+						 unsigned int *gen )
+{
+	struct me2fs_inode_info	*mi;
+	struct me2fs_extent		*ex;
+	unsigned long			off;
+	int						count;
+	int						i;
+
+	mi		= ME2FS_I( inode );
+	count	= 0;
+
+	spin_lock( &mi->i_extent_lock );
+	{
+		*gen = mi->i_extent_gen;
+
+		for( i = 0 ; i < ME2FS_EXTENT_CACHE_SIZE ; i++ )
+		{
+			ex = &mi->i_extents[ i ];
+
+			if( ( iblock < ex->e_lblk ) ||
+				( ( unsigned long )ex->e_lblk + ex->e_len <= iblock ) )
+			{
+				continue;
+			}
+
+			off		= iblock - ex->e_lblk;
+			*pblk	= ex->e_pblk + off;
+			count	= min_t( unsigned long, ex->e_len - off, maxblocks );
+			break;
+		}
+	}
+	spin_unlock( &mi->i_extent_lock );
+
+	return( count );
+}
+
+/*
+==================================================================================
+	Function	:cacheExtent
+	Input		:struct inode *inode
+				 < vfs inode >
+				 unsigned int gen
+				 < generation of the cache the run was looked up in >
+				 unsigned long lblk
+				 < first block of the run in file >
+				 unsigned long pblk
+				 < first block of the run on disk >
+				 unsigned long len
+				 < number of blocks of the run >
+	Output		:void
+	Return		:void
+
+	Description	:cache a run of mapped blocks. a run following a cached one
+				 on disk and in file extends it, otherwise the oldest slot
+				 is replaced
+==================================================================================
+*/
+static void cacheExtent( struct inode *inode,
+						 unsigned int gen,
+						 unsigned long lblk,
+						 unsigned long pblk,
+						 unsigned long len )
+{
+	struct me2fs_inode_info	*mi;
+	struct me2fs_extent		*ex;
+	int						i;
+
+	mi = ME2FS_I( inode );
+
+	spin_lock( &mi->i_extent_lock );
+	{
+		/* -------------------------------------------------------------------- */
+		/* a truncate after the lookup may have freed the run					*/
+		/* -------------------------------------------------------------------- */
+		if( gen != mi->i_extent_gen )
+		{
+			len = 0;
+		}
+
+		for( i = 0 ; len && ( i < ME2FS_EXTENT_CACHE_SIZE ) ; i++ )
+		{
+			ex = &mi->i_extents[ i ];
+
+			if( !ex->e_len )
+			{
+				continue;
+			}
+
+			/* another lookup has cached it already								*/
+			if( ( ex->e_lblk <= lblk ) &&
+				( lblk < ( unsigned long )ex->e_lblk + ex->e_len ) )
+			{
+				len = 0;
+			}
+			else if( ( ( unsigned long )ex->e_lblk + ex->e_len == lblk ) &&
+					 ( ( unsigned long )ex->e_pblk + ex->e_len == pblk ) )
+			{
+				ex->e_len	+= len;
+				len			= 0;
+			}
+		}
+
+		if( len )
+		{
+			ex					= &mi->i_extents[ mi->i_extent_next ];
+			ex->e_lblk			= lblk;
+			ex->e_pblk			= pblk;
+			ex->e_len			= len;
+			mi->i_extent_next	= ( mi->i_extent_next + 1 )
+								  % ME2FS_EXTENT_CACHE_SIZE;
+		}
+	}
+	spin_unlock( &mi->i_extent_lock );
+}
+
+/*
+==================================================================================
+	Function	:invalidateExtents
+	Input		:struct inode *inode
+				 < vfs inode >
+	Output		:void
+	Return		:void
+
+	Description	:forget all cached runs of an inode. caller holds
+				 truncate_mutex
+==================================================================================
+*/
+static void invalidateExtents( struct inode *inode )
+{
+	struct me2fs_inode_info	*mi;
+
+	mi = ME2FS_I( inode );
+
+	spin_lock( &mi->i_extent_lock );
+	{
+		memset( mi->i_extents, 0, sizeof( mi->i_extents ) );
+		mi->i_extent_gen++;
+	}
+	spin_unlock( &mi->i_extent_lock );
+}
+
 /*
 ==================================================================================
 	Function	:me2fsGetBlocks
@@ -1518,7 +2358,7 @@ verifyIndirectChain( Indirect *from, Indirect *to )
 				 struct buffer_head *bh_result
 				 < buffer cache for the block >
 				 int create
-				 < 0 : plain lookup, 1 : creation >
+				 < 0 : plain lookup, ME2FS_GET_BLOCKS_xxx : creation >
 	Output		:struct buffer_head *bh_result
 				 < buffer cache for the block >
 	Return		:int
@@ -1542,10 +2382,33 @@ static int me2fsGetBlocks( struct inode *inode,
 	int						depth;
 	int						err;
 	int						indirect_blks;
+	int						run;
 	unsigned long			goal;
+	unsigned long			pblk;
+	unsigned int			gen;
 
 	blocks_to_boundary = 0;
 
+	if( me2fsHasInlineData( inode ) )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:inode [%lu] has inline data\n",
+					 __func__, inode->i_ino );
+		return( -EIO );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* a run mapped before is found without reading indirect blocks				*/
+	/* ------------------------------------------------------------------------ */
+	if( ( count = lookupExtent( inode, iblock, maxblocks, &pblk, &gen ) ) )
+	{
+		atomic_long_inc( &ME2FS_SB( inode->i_sb )->s_extent_hits );
+		clear_buffer_new( bh_result );
+		map_bh( bh_result, inode->i_sb, pblk );
+		return( count );
+	}
+
+	atomic_long_inc( &ME2FS_SB( inode->i_sb )->s_extent_misses );
+
 	/* ------------------------------------------------------------------------ */
 	/* translate block number to its reference path								*/
 	/* ------------------------------------------------------------------------ */
@@ -1564,20 +2427,26 @@ static int me2fsGetBlocks( struct inode *inode,
 	/* ------------------------------------------------------------------------ */
 	/* find a block																*/
 	/* ------------------------------------------------------------------------ */
-	count = 0;
+	count	= 0;
+	run		= 0;
 	partial = me2fsGetBranch( inode, depth, offsets, chain, &err );
 	
 	if( !partial )
 	{
 		unsigned long	first_block;
+		unsigned long	limit;
 
 		first_block = le32_to_cpu( chain[ depth - 1 ].key );
 		clear_buffer_new( bh_result );
 		count++;
 		/* -------------------------------------------------------------------- */
-		/* find more available blocks											*/
+		/* find more available blocks. for a caller mapping more than one		*/
+		/* block the run is followed to the end of the indirect block for the	*/
+		/* extent cache, beyond maxblocks. a single block lookup stays cheap	*/
 		/* -------------------------------------------------------------------- */
-		while( ( count < maxblocks ) && ( count <= blocks_to_boundary ) )
+		limit = ( 1 < maxblocks ) ? blocks_to_boundary + 1 : maxblocks;
+
+		while( count < limit )
 		{
 			unsigned long	cur_blk;
 
@@ -1609,6 +2478,8 @@ static int me2fsGetBlocks( struct inode *inode,
 
 		if( err != -EAGAIN )
 		{
+			run		= count;
+			count	= min_t( unsigned long, count, maxblocks );
 			goto found;
 		}
 	}
@@ -1686,7 +2557,9 @@ static int me2fsGetBlocks( struct inode *inode,
 						   &count,
 						   goal,
 						   offsets + ( partial - chain ),
-						   partial );
+						   partial,
+						   ( create == ME2FS_GET_BLOCKS_DELALLOC ) ||
+						   ( create == ME2FS_GET_BLOCKS_PREALLOC ) );
 	
 	if( err )
 	{
@@ -1696,14 +2569,45 @@ static int me2fsGetBlocks( struct inode *inode,
 		goto cleanup;
 	}
 
+	if( create == ME2FS_GET_BLOCKS_PREALLOC )
+	{
+		me2fsFallocClaimBlocks( inode, count, indirect_blks );
+
+		/* -------------------------------------------------------------------- */
+		/* ext2 has no unwritten extents. blocks for fallocate are zeroed		*/
+		/* before they are linked, or a reader would see what was on the disk	*/
+		/* -------------------------------------------------------------------- */
+		err = sb_issue_zeroout( inode->i_sb,
+								le32_to_cpu( partial[ indirect_blks ].key ),
+								count,
+								GFP_NOFS );
+		if( err )
+		{
+			forgetBranch( inode, partial, indirect_blks, count );
+			mutex_unlock( &mi->truncate_mutex );
+			goto cleanup;
+		}
+	}
+
 	spliceBranch( inode, iblock, partial, indirect_blks, count );
 	mutex_unlock( &mi->truncate_mutex );
 	set_buffer_new( bh_result );
 
+	if( create == ME2FS_GET_BLOCKS_DELALLOC )
+	{
+		me2fsDaClaimBlocks( inode, count, indirect_blks );
+	}
+
 found:
 	map_bh( bh_result, inode->i_sb, le32_to_cpu( chain[ depth - 1 ].key ) );
 	/* i dont't care about boundary */
 	err = count;
+
+	cacheExtent( inode,
+				 gen,
+				 iblock,
+				 le32_to_cpu( chain[ depth - 1 ].key ),
+				 max( run, count ) );
 	DBGPRINT( "<ME2FS>%s:found block=%lu, num=%d\n",
 			  __func__,
 			  ( unsigned long )le32_to_cpu( chain[ depth - 1 ].key ), count );
@@ -1769,7 +2673,7 @@ __me2fsWriteInode( struct inode *inode, int do_sync )
 
 	sb			= inode->i_sb;
 	ino			= inode->i_ino;
-	ext2_inode	= me2fsGetExt2Inode( sb, ino, &bh );
+	ext2_inode	= me2fsGetExt2Inode( sb, ino, &bh, 0 );
 
 	if( IS_ERR( ext2_inode ) )
 	{
@@ -1844,6 +2748,13 @@ __me2fsWriteInode( struct inode *inode, int do_sync )
 	ext2_inode->osd2.linux2.l_i_frag	= mi->i_frag_no;
 	ext2_inode->osd2.linux2.l_i_fsize	= mi->i_frag_size;
 
+	if( ME2FS_SB( inode->i_sb )->s_esb->s_feature_incompat &
+		cpu_to_le32( ME2FS_FEATURE_INCOMPAT_INLINE_DATA ) )
+	{
+		ext2_inode->osd2.linux2.l_i_me2fs_flags =
+			cpu_to_le16( mi->i_me2fs_flags );
+	}
+
 	if( !S_ISREG( inode->i_mode ) )
 	{
 		ext2_inode->i_dir_acl = cpu_to_le32( mi->i_dir_acl );
@@ -1928,6 +2839,8 @@ __me2fsWriteInode( struct inode *inode, int do_sync )
 				 < offset of indirect information >
 				 Indirect *branch
 				 < indirect information >
+				 int reserved
+				 < blocks are reserved by delayed allocation >
 	Output		:void
 	Return		:int
 				 < result >
@@ -1940,7 +2853,8 @@ static int allocBranch( struct inode *inode,
 						int *blks,
 						unsigned long goal,
 						int *offsets,
-						Indirect *branch )
+						Indirect *branch,
+						int reserved )
 {
 	int					blocksize;
 	int					i;
@@ -1953,7 +2867,8 @@ static int allocBranch( struct inode *inode,
 	unsigned long		count;
 
 	//new_blocks[ 0 ] = me2fsNewBlocks( inode, goal, &count, &err );
-	num = allocBlocks( inode, goal, indirect_blks, *blks, new_blocks, &err );
+	num = allocBlocks( inode, goal, indirect_blks, *blks,
+					   new_blocks, &err, reserved );
 
 	if( err )
 	{
@@ -2042,6 +2957,43 @@ failed:
 	me2fsFreeBlocks( inode, new_blocks[ i ], num );
 	return( err );
 }
+
+/*
+==================================================================================
+	Function	:forgetBranch
+	Input		:struct inode *inode
+				 < vfs inode >
+				 Indirect *branch
+				 < branch allocated by allocBranch >
+				 int indirect_blks
+				 < number of indirect blocks of the branch >
+				 int blks
+				 < number of direct blocks of the branch >
+	Output		:void
+	Return		:void
+
+	Description	:free a branch which has not been spliced onto inode
+==================================================================================
+*/
+static void forgetBranch( struct inode *inode,
+						  Indirect *branch,
+						  int indirect_blks,
+						  int blks )
+{
+	int		i;
+
+	for( i = 1 ; i <= indirect_blks ; i++ )
+	{
+		bforget( branch[ i ].bh );
+	}
+
+	for( i = 0 ; i < indirect_blks ; i++ )
+	{
+		me2fsFreeBlocks( inode, le32_to_cpu( branch[ i ].key ), 1 );
+	}
+
+	me2fsFreeBlocks( inode, le32_to_cpu( branch[ indirect_blks ].key ), blks );
+}
 /*
 ==================================================================================
 	Function	:spliceBranch
@@ -2095,6 +3047,19 @@ static void spliceBranch( struct inode *inode,
 	/* ------------------------------------------------------------------------ */
 	if( block_i )
 	{
+		/* -------------------------------------------------------------------- */
+		/* count blocks allocated in file order, to tell a streaming writer		*/
+		/* from a random one when the reservation window is resized				*/
+		/* -------------------------------------------------------------------- */
+		if( block == block_i->last_alloc_logical_block + 1 )
+		{
+			block_i->seq_alloc_blocks += blks;
+		}
+		else
+		{
+			block_i->seq_alloc_blocks = 0;
+		}
+
 		block_i->last_alloc_logical_block	= block + blks - 1;
 		block_i->last_alloc_physical_block	= le32_to_cpu( where[ num ].key ) +
 											  blks - 1;
@@ -2205,7 +3170,8 @@ findNear( struct inode *inode, Indirect *ind )
 	bg_start	= ext2GetFirstBlockNum( inode->i_sb, mei->i_block_group );
 	color		= ( current->pid % 16 ) * ( msi->s_blocks_per_group / 16 );
 
-	return( bg_start + color );
+	/* on raid the first block of a file starts a stripe						*/
+	return( me2fsStripeAlign( inode->i_sb, bg_start + color ) );
 }
 /*
 ==================================================================================
@@ -2288,6 +3254,7 @@ static void __truncateBlocks( struct inode *inode, loff_t offset )
 {
 	__le32					*i_data;
 	struct me2fs_inode_info	*mi;
+	struct me2fs_free_batch	batch;
 	int						addr_per_block;
 	int						offsets[ 4 ];
 	Indirect				chain[ 4 ];
@@ -2297,6 +3264,13 @@ static void __truncateBlocks( struct inode *inode, loff_t offset )
 	long					iblock;
 	unsigned				blocksize;
 
+	/* i_data of an inline file holds data, not block numbers					*/
+	if( me2fsHasInlineData( inode ) )
+	{
+		me2fsInlineTruncate( inode, offset );
+		return;
+	}
+
 	blocksize	= inode->i_sb->s_blocksize;
 	iblock		= ( offset + blocksize - 1 )
 				  >> inode->i_sb->s_blocksize_bits;
@@ -2316,10 +3290,17 @@ static void __truncateBlocks( struct inode *inode, loff_t offset )
 	i_data			= mi->i_data;
 	addr_per_block	= inode->i_sb->s_blocksize / sizeof( __u32 );
 	mutex_lock( &mi->truncate_mutex );
+	me2fsInitFreeBatch( &batch, inode->i_sb, inode );
+
+	/* nobody maps blocks from the cache while they are being freed				*/
+	invalidateExtents( inode );
 
 	if( depth == 1 )
 	{
-		freeData( inode, i_data + offsets[ 0 ], i_data + ME2FS_NDIR_BLOCKS );
+		freeData( inode,
+				  &batch,
+				  i_data + offsets[ 0 ],
+				  i_data + ME2FS_NDIR_BLOCKS );
 		goto do_indirects;
 	}
 
@@ -2339,7 +3320,11 @@ static void __truncateBlocks( struct inode *inode, loff_t offset )
 			mark_buffer_dirty_inode( partial->bh, inode );
 		}
 
-		freeBranches( inode, &nr, &nr + 1, ( chain + depth - 1 ) - partial );
+		freeBranches( inode,
+					  &batch,
+					  &nr,
+					  &nr + 1,
+					  ( chain + depth - 1 ) - partial );
 	}
 
 	/* ------------------------------------------------------------------------ */
@@ -2348,6 +3333,7 @@ static void __truncateBlocks( struct inode *inode, loff_t offset )
 	while( chain < partial )
 	{
 		freeBranches( inode,
+					  &batch,
 					  partial->p + 1,
 					  ( __le32* )partial->bh->b_data + addr_per_block,
 					  ( chain + depth - 1 ) - partial );
@@ -2368,7 +3354,7 @@ do_indirects:
 		{
 			i_data[ ME2FS_IND_BLOCK ] = 0;
 			mark_inode_dirty( inode );
-			freeBranches( inode, &nr, &nr + 1, 1 );
+			freeBranches( inode, &batch, &nr, &nr + 1, 1 );
 		}
 		/* go through															*/
 	case	ME2FS_IND_BLOCK:
@@ -2377,7 +3363,7 @@ do_indirects:
 		{
 			i_data[ ME2FS_2IND_BLOCK ] = 0;
 			mark_inode_dirty( inode );
-			freeBranches( inode, &nr, &nr + 1, 2 );
+			freeBranches( inode, &batch, &nr, &nr + 1, 2 );
 		}
 		/* go through															*/
 	case	ME2FS_2IND_BLOCK:
@@ -2386,13 +3372,17 @@ do_indirects:
 		{
 			i_data[ ME2FS_2IND_BLOCK ] = 0;
 			mark_inode_dirty( inode );
-			freeBranches( inode, &nr, &nr + 1, 3 );
+			freeBranches( inode, &batch, &nr, &nr + 1, 3 );
 		}
 		/* go through															*/
 	case	ME2FS_3IND_BLOCK:
 		break;
 	}
 
+	/* drop runs cached by lookups that read the block map while it was cut		*/
+	invalidateExtents( inode );
+
+	me2fsEndFreeBatch( &batch );
 	me2fsDiscardReservation( inode );
 	
 	mutex_unlock( &mi->truncate_mutex );
@@ -2402,6 +3392,8 @@ do_indirects:
 	Function	:freeData
 	Input		:struct inode *inode
 				 < vfs inode to free data >
+				 struct me2fs_free_batch *batch
+				 < batch to collect the blocks in >
 				 __le32 *blocks
 				 < array of block numbers >
 				 __le32 *end_block
@@ -2412,7 +3404,10 @@ do_indirects:
 ==================================================================================
 */
 static inline void
-freeData( struct inode *inode, __le32 *blocks, __le32 *end_block )
+freeData( struct inode *inode,
+		  struct me2fs_free_batch *batch,
+		  __le32 *blocks,
+		  __le32 *end_block )
 {
 	unsigned long	block_to_free;
 	unsigned long	count;
@@ -2442,7 +3437,7 @@ freeData( struct inode *inode, __le32 *blocks, __le32 *end_block )
 			}
 			else
 			{
-				me2fsFreeBlocks( inode, block_to_free, count );
+				me2fsFreeBatchAdd( batch, block_to_free, count );
 				mark_inode_dirty( inode );
 				block_to_free	= block_num;
 				count			= 1;
@@ -2452,7 +3447,7 @@ freeData( struct inode *inode, __le32 *blocks, __le32 *end_block )
 
 	if( 0 < count )
 	{
-		me2fsFreeBlocks( inode, block_to_free, count );
+		me2fsFreeBatchAdd( batch, block_to_free, count );
 		mark_inode_dirty( inode );
 	}
 }
@@ -2581,6 +3576,8 @@ searchFirstNonZero( __le32 *cur, __le32 *end )
 	Function	:freeBranches
 	Input		:struct inode *inode
 				 < host vfs inode >
+				 struct me2fs_free_batch *batch
+				 < batch to collect the blocks in >
 				 __le32 *cur
 				 < array of block numbers >
 				 __le32 *end
@@ -2595,6 +3592,7 @@ searchFirstNonZero( __le32 *cur, __le32 *end )
 */
 static void
 freeBranches( struct inode *inode,
+			  struct me2fs_free_batch *batch,
 			  __le32 *cur,
 			  __le32 *end,
 			  int depth )
@@ -2625,96 +3623,142 @@ freeBranches( struct inode *inode,
 			}
 
 			freeBranches( inode,
+						  batch,
 						  ( __le32* )bh->b_data,
 						  ( __le32* )bh->b_data + addr_per_block,
 						  depth );
 
 			bforget( bh );
-			me2fsFreeBlocks( inode, nr, 1 );
+			me2fsFreeBatchAdd( batch, nr, 1 );
 			mark_inode_dirty( inode );
 		}
 	}
 	else
 	{
-		freeData( inode, cur, end );
+		freeData( inode, batch, cur, end );
 	}
 }
 
 /*
 ==================================================================================
-	Function	:setInodeSize
+	Function	:punchBranches
 	Input		:struct inode *inode
-				 < vfs inode >
-				 loff_t newsize
-				 < new size of a file >
+				 < host vfs inode >
+				 struct me2fs_free_batch *batch
+				 < batch to collect the blocks in >
+				 __le32 *cur
+				 < array of block numbers >
+				 __le32 *end
+				 < pointer immediately past the end of array >
+				 int depth
+				 < depth of the branches >
+				 u64 first
+				 < first file block mapped by *cur >
+				 u64 span
+				 < number of file blocks mapped by one entry >
+				 u64 start
+				 < first block to free >
+				 u64 last
+				 < end of blocks to free (exclusive) >
 	Output		:void
 	Return		:void
 
-	Description	:set size
+	Description	:free the part of an array of branches inside a range.
+				 a run of entries wholly inside the range is given to
+				 freeBranches at once so that its data blocks are freed in
+				 contiguous runs
 ==================================================================================
 */
-static int setInodeSize( struct inode *inode, loff_t newsize )
+static void
+punchBranches( struct inode *inode,
+			   struct me2fs_free_batch *batch,
+			   __le32 *cur,
+			   __le32 *end,
+			   int depth,
+			   u64 first,
+			   u64 span,
+			   u64 start,
+			   u64 last )
 {
-	int	error;
+	struct buffer_head	*bh;
+	__le32				*run;
+	__le32				*child;
+	unsigned long		nr;
+	int					addr_per_block;
 
-	if( !( S_ISREG( inode->i_mode )	||
-		S_ISDIR( inode->i_mode )	||
-		S_ISLNK( inode->i_mode ) ) )
-	{
-		return( -EINVAL );
-	}
+	addr_per_block	= inode->i_sb->s_blocksize / sizeof( __u32 );
+	run				= NULL;
 
-	if( isInodeFastSymlink( inode ) )
+	for( ; ( cur < end ) && ( first < last ) ; cur++, first += span )
 	{
-		return( -EINVAL );
-	}
+		if( ( first + span ) <= start )
+		{
+			continue;
+		}
 
-	if( IS_APPEND( inode ) || IS_IMMUTABLE( inode ) )
-	{
-		return( -EPERM );
-	}
+		if( ( start <= first ) && ( ( first + span ) <= last ) )
+		{
+			if( !run )
+			{
+				run = cur;
+			}
+			continue;
+		}
 
-	inode_dio_wait( inode );
+		/* -------------------------------------------------------------------- */
+		/* the range ends inside this entry. free the run before it and go		*/
+		/* down to the indirect block											*/
+		/* -------------------------------------------------------------------- */
+		if( run )
+		{
+			freeBranches( inode, batch, run, cur, depth );
+			run = NULL;
+		}
 
-#if 0	// as for now, xip is not implemented
-	if( mapping_is_xip( inode->i_mapping ) )
-	{
-		error = xip_truncate_page( inode->i_mapping, newsize );
-	}
-	else if( ME2FS_SB( inode->i_sb )->s_mount_opt & EXT2_MOUNT_NOBH )
-#endif
-	if( ME2FS_SB( inode->i_sb )->s_mount_opt & EXT2_MOUNT_NOBH )
-	{
-		error = nobh_truncate_page( inode->i_mapping, newsize, me2fsGetBlock );
-	}
-	else
-	{
-		error = block_truncate_page( inode->i_mapping, newsize, me2fsGetBlock );
-	}
+		if( !( nr = le32_to_cpu( *cur ) ) )
+		{
+			continue;
+		}
 
-	if( error )
-	{
-		return( error );
-	}
+		if( !( bh = sb_bread( inode->i_sb, nr ) ) )
+		{
+			ME2FS_ERROR( "<ME2FS>%s:error:sb_read inode=%ld, block=%ld\n",
+						 __func__, inode->i_ino, nr );
+			continue;
+		}
 
-	truncate_setsize( inode, newsize );
-	__truncateBlocks( inode, newsize );
+		child = ( __le32* )bh->b_data;
 
-	inode->i_ctime = CURRENT_TIME_SEC;
-	inode->i_mtime = inode->i_ctime;
+		punchBranches( inode,
+					   batch,
+					   child,
+					   child + addr_per_block,
+					   depth - 1,
+					   first,
+					   span / addr_per_block,
+					   start,
+					   last );
 
-	if( inode_needs_sync( inode ) )
-	{
-		sync_mapping_buffers( inode->i_mapping );
-		sync_inode_metadata( inode, 1 );
+		if( searchFirstNonZero( child, child + addr_per_block ) )
+		{
+			*cur = 0;
+			bforget( bh );
+			me2fsFreeBatchAdd( batch, nr, 1 );
+			mark_inode_dirty( inode );
+		}
+		else
+		{
+			mark_buffer_dirty_inode( bh, inode );
+			brelse( bh );
+		}
 	}
-	else
+
+	if( run )
 	{
-		mark_inode_dirty( inode );
+		freeBranches( inode, batch, run, cur, depth );
 	}
-
-	return( 0 );
 }
+
 /*
 ==================================================================================
 	Function	:writeFailed
@@ -2817,6 +3861,8 @@ blocksToAllocate( Indirect *branch,
 				 < blocks to be allocated >
 				 int *err
 				 < result >
+				 int reserved
+				 < blocks are reserved by delayed allocation >
 	Output		:void
 	Return		:int
 				 < number of allocated blocks >
@@ -2829,7 +3875,8 @@ static int allocBlocks( struct inode *inode,
 						int indirect_blks,
 						int blks,
 						unsigned long new_blocks[ 4 ],
-						int *err )
+						int *err,
+						int reserved )
 {
 	int				target;
 	int				i;
@@ -2858,7 +3905,7 @@ static int allocBlocks( struct inode *inode,
 		/* -------------------------------------------------------------------- */
 		/* allocating blocks for indirect blocks and direct blocks				*/
 		/* -------------------------------------------------------------------- */
-		current_block = me2fsNewBlocks( inode, goal, &count, err );
+		current_block = me2fsNewBlocks( inode, goal, &count, err, reserved );
 
 		if( *err )
 		{
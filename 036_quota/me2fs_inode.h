@@ -22,6 +22,10 @@
 
 ==================================================================================
 */
+/* create argument of me2fsGetBlock( )											*/
+#define	ME2FS_GET_BLOCKS_CREATE		1	/* allocate a hole						*/
+#define	ME2FS_GET_BLOCKS_DELALLOC	2	/* allocate a hole from a reservation	*/
+#define	ME2FS_GET_BLOCKS_PREALLOC	3	/* allocate a hole for fallocate		*/
 
 /*
 ==================================================================================
@@ -166,7 +170,7 @@ _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 				 struct buffer_head *bh_result
 				 < buffer cache for the block >
 				 int create
-				 < 0 : plain lookup, 1 : creation >
+				 < 0 : plain lookup, ME2FS_GET_BLOCKS_xxx : creation >
 	Output		:struct buffer_head *bh_result
 				 < buffer cache for the block >
 	Return		:int
@@ -253,4 +257,73 @@ _/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
 */
 int me2fsSetAttr( struct dentry *dentry, struct iattr *iattr );
 
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsPrefetchInodeTables
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 unsigned long *inos
+				 < inode numbers, used as work area and overwritten >
+				 int count
+				 < number of inode numbers >
+	Output		:void
+	Return		:void
+
+	Description	:start reading the inode table blocks of the inodes not
+				 in the inode cache without waiting. each block is read
+				 once in ascending order under a plug
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsPrefetchInodeTables( struct super_block *sb,
+							   unsigned long *inos,
+							   int count );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsSetInodeSize
+	Input		:struct inode *inode
+				 < vfs inode >
+				 loff_t newsize
+				 < new size of a file >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:set size and free blocks beyond it
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsSetInodeSize( struct inode *inode, loff_t newsize );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsPunchBlocks
+	Input		:struct inode *inode
+				 < vfs inode >
+				 sector_t start
+				 < first block to free >
+				 sector_t end
+				 < end of blocks to free (exclusive) >
+	Output		:void
+	Return		:void
+
+	Description	:free blocks in the middle of a file. indirect blocks left
+				 empty are freed as well
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsPunchBlocks( struct inode *inode, sector_t start, sector_t end );
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsSetFileAops
+	Input		:struct inode *inode
+				 < vfs inode of a regular file >
+	Output		:void
+	Return		:void
+
+	Description	:set address space operations of a regular file by the
+				 mount options
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsSetFileAops( struct inode *inode );
+
 #endif	// __ME2FS_INODE_H
@@ -5,11 +5,15 @@
 *********************************************************************************/
 #include <linux/mount.h>
 #include <linux/compat.h>
+#include <linux/quotaops.h>
+#include <linux/blkdev.h>
 
 #include "me2fs.h"
 #include "me2fs_util.h"
 #include "me2fs_inode.h"
 #include "me2fs_block.h"
+#include "me2fs_compact.h"
+#include "me2fs_ialloc.h"
 
 
 /*
@@ -68,6 +72,9 @@ long me2fsIoctl( struct file *filp, unsigned int cmd, unsigned long arg )
 	unsigned int			oldflags;
 	__u32					generation;
 	unsigned short			rsv_window_size;
+	struct fstrim_range		range;
+	struct request_queue	*q;
+	struct me2fs_bulkstat_req	breq;
 
 	DBGPRINT( "<ME2FS>ioctl cmd = %u, arg = %lu\n", cmd, arg );
 
@@ -234,6 +241,90 @@ long me2fsIoctl( struct file *filp, unsigned int cmd, unsigned long arg )
 		mutex_unlock( &mei->truncate_mutex );
 		mnt_drop_write_file( filp );
 		return( 0 );
+	case	ME2FS_IOC_COMPACTDIR:
+		if( !S_ISDIR( inode->i_mode ) )
+		{
+			return( -ENOTDIR );
+		}
+		if( !inode_owner_or_capable( inode ) )
+		{
+			return( -EPERM );
+		}
+		if( ( ret = mnt_want_write_file( filp ) ) )
+		{
+			return( ret );
+		}
+		/* -------------------------------------------------------------------- */
+		/* freed tail blocks are returned to the owner's quota					*/
+		/* -------------------------------------------------------------------- */
+		dquot_initialize( inode );
+
+		mutex_lock( &inode->i_mutex );
+		{
+			ret = me2fsCompactDir( inode );
+		}
+		mutex_unlock( &inode->i_mutex );
+
+		mnt_drop_write_file( filp );
+		return( ret );
+	case	FITRIM:
+		if( !capable( CAP_SYS_ADMIN ) )
+		{
+			return( -EPERM );
+		}
+		q = bdev_get_queue( inode->i_sb->s_bdev );
+		if( !blk_queue_discard( q ) )
+		{
+			return( -EOPNOTSUPP );
+		}
+		if( copy_from_user( &range,
+							( struct fstrim_range __user* )arg,
+							sizeof( range ) ) )
+		{
+			return( -EFAULT );
+		}
+		/* -------------------------------------------------------------------- */
+		/* extents shorter than the device can discard are not worth a command	*/
+		/* -------------------------------------------------------------------- */
+		range.minlen = max_t( u64,
+							  range.minlen,
+							  q->limits.discard_granularity );
+		if( ( ret = me2fsTrimFs( inode->i_sb, &range ) ) )
+		{
+			return( ret );
+		}
+		if( copy_to_user( ( struct fstrim_range __user* )arg,
+						  &range,
+						  sizeof( range ) ) )
+		{
+			return( -EFAULT );
+		}
+		return( 0 );
+	case	ME2FS_IOC_BULKSTAT:
+		/* -------------------------------------------------------------------- */
+		/* every inode of the file system is seen regardless of permissions		*/
+		/* -------------------------------------------------------------------- */
+		if( !capable( CAP_SYS_ADMIN ) )
+		{
+			return( -EPERM );
+		}
+		if( copy_from_user( &breq,
+							( struct me2fs_bulkstat_req __user* )arg,
+							sizeof( breq ) ) )
+		{
+			return( -EFAULT );
+		}
+		if( ( ret = me2fsBulkstat( inode->i_sb, &breq ) ) )
+		{
+			return( ret );
+		}
+		if( copy_to_user( ( struct me2fs_bulkstat_req __user* )arg,
+						  &breq,
+						  sizeof( breq ) ) )
+		{
+			return( -EFAULT );
+		}
+		return( 0 );
 	default:
 		break;
 	}
@@ -273,6 +364,10 @@ long me2fsCompatIoctl( struct file *file, unsigned int cmd, unsigned long arg )
 	case	EXT2_IOC32_SETVERSION:
 		cmd = EXT2_IOC_SETVERSION;
 		break;
+	case	ME2FS_IOC_COMPACTDIR:
+	case	FITRIM:
+	case	ME2FS_IOC_BULKSTAT:
+		break;
 	default:
 		return( -ENOIOCTLCMD );
 	}
@@ -571,7 +571,7 @@ static int me2fsCreate( struct inode *dir,
 	}
 
 	inode->i_op				= &me2fs_file_inode_operations;
-	inode->i_mapping->a_ops	= &me2fs_aops;
+	me2fsSetFileAops( inode );
 	inode->i_fop			= &me2fs_file_operations;
 
 	mark_inode_dirty( inode );
@@ -771,7 +771,7 @@ me2fsTmpFile( struct inode *dir,
 	}
 
 	inode->i_op				= &me2fs_file_inode_operations;
-	inode->i_mapping->a_ops	= &me2fs_aops;
+	me2fsSetFileAops( inode );
 	inode->i_fop			= &me2fs_file_operations;
 
 	mark_inode_dirty( inode );
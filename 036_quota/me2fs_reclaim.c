@@ -0,0 +1,383 @@
+/********************************************************************************
+	File			: me2fs_reclaim.c
+	Description		: Background reclaim of deleted files of my ext2 file system
+
+*********************************************************************************/
+#include <linux/buffer_head.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/quotaops.h>
+
+#include "me2fs.h"
+#include "me2fs_util.h"
+#include "me2fs_block.h"
+#include "me2fs_reclaim.h"
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static void reclaimWorker( struct work_struct *work );
+static void reclaimBranches( struct super_block *sb,
+							 struct me2fs_free_batch *batch,
+							 __le32 *cur,
+							 __le32 *end,
+							 int depth );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+/*
+---------------------------------------------------------------------------------
+	Block Tree of a Deleted File
+	block pointers taken from the inode, which is gone by the time the
+	worker frees them
+---------------------------------------------------------------------------------
+*/
+struct me2fs_reclaim
+{
+	struct work_struct		r_work;
+	struct super_block		*r_sb;
+	unsigned long			r_blocks;			/* added to s_reclaim_pending	*/
+	__le32					r_data[ ME2FS_NR_BLOCKS ];
+};
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Open Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsQueueReclaim
+	Input		:struct inode *inode
+				 < vfs inode being deleted >
+	Output		:void
+	Return		:int
+				 < 1 : blocks are handed to background reclaim
+				   0 : the caller has to truncate the inode itself >
+
+	Description	:detach the block tree of a large deleted file and free it
+				 in background
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsQueueReclaim( struct inode *inode )
+{
+	struct super_block		*sb;
+	struct me2fs_sb_info	*msi;
+	struct me2fs_inode_info	*mi;
+	struct me2fs_reclaim	*rec;
+	loff_t					bytes;
+	unsigned long			blocks;
+
+	sb	= inode->i_sb;
+	msi	= ME2FS_SB( sb );
+	mi	= ME2FS_I( inode );
+
+	if( !( msi->s_mount_opt & EXT2_MOUNT_BG_RECLAIM ) || !msi->s_reclaim_wq )
+	{
+		return( 0 );
+	}
+
+	if( !S_ISREG( inode->i_mode ) || inode_needs_sync( inode ) )
+	{
+		return( 0 );
+	}
+
+	if( IS_APPEND( inode ) || IS_IMMUTABLE( inode ) )
+	{
+		return( 0 );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* the xattr block is freed with the inode, the rest belongs to the tree	*/
+	/* ------------------------------------------------------------------------ */
+	bytes = inode_get_bytes( inode );
+
+	if( mi->i_file_acl )
+	{
+		bytes -= sb->s_blocksize;
+	}
+
+	blocks = ( bytes > 0 ) ? ( bytes >> sb->s_blocksize_bits ) : 0;
+
+	if( !blocks || ( blocks < ACCESS_ONCE( msi->s_reclaim_min_blocks ) ) )
+	{
+		return( 0 );
+	}
+
+	if( !( rec = kmalloc( sizeof( *rec ), GFP_NOFS ) ) )
+	{
+		return( 0 );
+	}
+
+	INIT_WORK( &rec->r_work, reclaimWorker );
+	rec->r_sb		= sb;
+	rec->r_blocks	= blocks;
+
+	mutex_lock( &mi->truncate_mutex );
+	{
+		memcpy( rec->r_data, mi->i_data, sizeof( rec->r_data ) );
+		memset( mi->i_data, 0, sizeof( mi->i_data ) );
+	}
+	mutex_unlock( &mi->truncate_mutex );
+
+	/* ------------------------------------------------------------------------ */
+	/* quota is released now while the inode still holds its dquots. statfs		*/
+	/* counts the blocks as free from here on									*/
+	/* ------------------------------------------------------------------------ */
+	dquot_free_block_nodirty( inode, blocks );
+	mark_inode_dirty( inode );
+
+	atomic_long_add( blocks, &msi->s_reclaim_pending );
+
+	queue_work( msi->s_reclaim_wq, &rec->r_work );
+
+	DBGPRINT( "<ME2FS>%s:queued %lu blocks of inode [%lu]\n",
+			  __func__, blocks, inode->i_ino );
+
+	return( 1 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsWaitReclaim
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:void
+
+	Description	:wait until all queued block trees are freed
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsWaitReclaim( struct super_block *sb )
+{
+	struct me2fs_sb_info	*msi;
+
+	msi = ME2FS_SB( sb );
+
+	if( msi->s_reclaim_wq && atomic_long_read( &msi->s_reclaim_pending ) )
+	{
+		flush_workqueue( msi->s_reclaim_wq );
+	}
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsInitReclaim
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:int
+				 < result >
+
+	Description	:create the reclaim workqueue of a file system
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+int me2fsInitReclaim( struct super_block *sb )
+{
+	struct me2fs_sb_info	*msi;
+
+	msi = ME2FS_SB( sb );
+
+	atomic_long_set( &msi->s_reclaim_pending, 0 );
+
+	/* ------------------------------------------------------------------------ */
+	/* one tree at a time, so that trees do not fight over the same bitmaps		*/
+	/* ------------------------------------------------------------------------ */
+	msi->s_reclaim_wq = alloc_ordered_workqueue( "me2fs-reclaim/%s",
+												 WQ_MEM_RECLAIM,
+												 sb->s_id );
+
+	if( !msi->s_reclaim_wq )
+	{
+		return( -ENOMEM );
+	}
+
+	return( 0 );
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:me2fsStopReclaim
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:void
+
+	Description	:free queued block trees and destroy the reclaim workqueue
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+void me2fsStopReclaim( struct super_block *sb )
+{
+	struct me2fs_sb_info	*msi;
+
+	msi = ME2FS_SB( sb );
+
+	if( !msi->s_reclaim_wq )
+	{
+		return;
+	}
+
+	/* destroy_workqueue() runs the queued works to the end						*/
+	destroy_workqueue( msi->s_reclaim_wq );
+	msi->s_reclaim_wq = NULL;
+}
+
+/*
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+	Function	:void
+	Input		:void
+	Output		:void
+	Return		:void
+
+	Description	:void
+_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/_/
+*/
+
+/*
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+
+	< Local Functions >
+
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+*/
+/*
+==================================================================================
+	Function	:reclaimWorker
+	Input		:struct work_struct *work
+				 < work of a deleted file >
+	Output		:void
+	Return		:void
+
+	Description	:free the block tree of a deleted file
+==================================================================================
+*/
+static void reclaimWorker( struct work_struct *work )
+{
+	struct me2fs_reclaim	*rec;
+	struct super_block		*sb;
+	struct me2fs_free_batch	batch;
+	int						depth;
+
+	rec	= container_of( work, struct me2fs_reclaim, r_work );
+	sb	= rec->r_sb;
+
+	/* ------------------------------------------------------------------------ */
+	/* quota was released at eviction, only the free counter is updated here	*/
+	/* ------------------------------------------------------------------------ */
+	me2fsInitFreeBatch( &batch, sb, NULL );
+
+	reclaimBranches( sb,
+					 &batch,
+					 rec->r_data,
+					 rec->r_data + ME2FS_NDIR_BLOCKS,
+					 0 );
+
+	for( depth = 1 ; depth <= 3 ; depth++ )
+	{
+		reclaimBranches( sb,
+						 &batch,
+						 rec->r_data + ME2FS_IND_BLOCK + depth - 1,
+						 rec->r_data + ME2FS_IND_BLOCK + depth,
+						 depth );
+	}
+
+	me2fsEndFreeBatch( &batch );
+
+	atomic_long_sub( rec->r_blocks, &ME2FS_SB( sb )->s_reclaim_pending );
+
+	kfree( rec );
+}
+
+/*
+==================================================================================
+	Function	:reclaimBranches
+	Input		:struct super_block *sb
+				 < vfs super block >
+				 struct me2fs_free_batch *batch
+				 < batch to collect the blocks in >
+				 __le32 *cur
+				 < array of block numbers >
+				 __le32 *end
+				 < pointer immediately past the end of array >
+				 int depth
+				 < depth of the branches to free >
+	Output		:void
+	Return		:void
+
+	Description	:free an array of branches of a deleted file. unlike
+				 freeBranches the indirect blocks are dropped without
+				 clearing their entries, nobody refers to them any more
+==================================================================================
+*/
+static void reclaimBranches( struct super_block *sb,
+							 struct me2fs_free_batch *batch,
+							 __le32 *cur,
+							 __le32 *end,
+							 int depth )
+{
+	struct buffer_head	*bh;
+	unsigned long		nr;
+	int					addr_per_block;
+
+	addr_per_block = sb->s_blocksize / sizeof( __u32 );
+
+	for( ; cur < end ; cur++ )
+	{
+		if( !( nr = le32_to_cpu( *cur ) ) )
+		{
+			continue;
+		}
+
+		if( depth )
+		{
+			if( !( bh = sb_bread( sb, nr ) ) )
+			{
+				ME2FS_ERROR( "<ME2FS>%s:error:sb_read block=%lu\n",
+							 __func__, nr );
+				continue;
+			}
+
+			reclaimBranches( sb,
+							 batch,
+							 ( __le32* )bh->b_data,
+							 ( __le32* )bh->b_data + addr_per_block,
+							 depth - 1 );
+
+			bforget( bh );
+
+			cond_resched( );
+		}
+
+		me2fsFreeBatchAdd( batch, nr, 1 );
+	}
+}
+/*
+==================================================================================
+	Function	:void
+	Input		:void
+	Output		:void
+	Return		:void
+
+	Description	:void
+==================================================================================
+*/
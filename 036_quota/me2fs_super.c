@@ -22,6 +22,11 @@
 #include "me2fs_ialloc.h"
 #include "me2fs_sysfs.h"
 #include "me2fs_xattr.h"
+#include "me2fs_compact.h"
+#include "me2fs_freemap.h"
+#include "me2fs_delalloc.h"
+#include "me2fs_grpinfo.h"
+#include "me2fs_reclaim.h"
 
 
 /*
@@ -92,6 +97,11 @@ static void me2fsSyncSuper( struct super_block *sb,
 static void clearSuperError( struct super_block *sb );
 static int parseOptions( char *options, struct super_block *sb );
 static unsigned long getSbBlock( void **data );
+static void reconcileCounters( struct work_struct *work );
+static void reconcileCounter( struct percpu_counter *counter,
+							  s64 desc_count,
+							  s64 *last_drift );
+static unsigned long getStripe( struct super_block *sb );
 /*
 =================================================================================
 
@@ -99,6 +109,8 @@ static unsigned long getSbBlock( void **data );
 
 =================================================================================
 */
+/* interval of walking group descriptors to check the free counters				*/
+#define	COUNTER_RECONCILE_DELAY		( 60 * HZ )
 
 /*
 ==================================================================================
@@ -179,6 +191,23 @@ const static struct xattr_handler *me2fs_xattr_handler[ ] =
 
 #endif
 
+/*
+---------------------------------------------------------------------------------
+	Quota Operations
+---------------------------------------------------------------------------------
+*/
+static const struct dquot_operations me2fs_quota_operations =
+{
+	.write_dquot		= dquot_commit,
+	.acquire_dquot		= dquot_acquire,
+	.release_dquot		= dquot_release,
+	.mark_dirty			= dquot_mark_dquot_dirty,
+	.write_info			= dquot_commit_info,
+	.alloc_dquot		= dquot_alloc,
+	.destroy_dquot		= dquot_destroy,
+	.get_reserved_space	= me2fsGetReservedSpace,
+};
+
 /*
 ---------------------------------------------------------------------------------
 	seq options file operations
@@ -235,6 +264,20 @@ enum
 	Opt_grpquota,
 	Opt_reservation,
 	Opt_noreservation,
+	Opt_dir_compact,
+	Opt_nodir_compact,
+	Opt_delalloc,
+	Opt_nodelalloc,
+	Opt_discard,
+	Opt_nodiscard,
+	Opt_bg_reclaim,
+	Opt_nobg_reclaim,
+	Opt_stride,
+	Opt_stripe_width,
+	Opt_percpu_ialloc,
+	Opt_nopercpu_ialloc,
+	Opt_inline_data,
+	Opt_noinline_data,
 };
 
 static const match_table_t tokens =
@@ -269,6 +312,20 @@ static const match_table_t tokens =
 	{ Opt_usrquota,			"usrquota"			},
 	{ Opt_reservation,		"reservation"		},
 	{ Opt_noreservation,	"noreservation"		},
+	{ Opt_dir_compact,		"dircompact"		},
+	{ Opt_nodir_compact,	"nodircompact"		},
+	{ Opt_delalloc,			"delalloc"			},
+	{ Opt_nodelalloc,		"nodelalloc"		},
+	{ Opt_discard,			"discard"			},
+	{ Opt_nodiscard,		"nodiscard"			},
+	{ Opt_bg_reclaim,		"bgreclaim"			},
+	{ Opt_nobg_reclaim,		"nobgreclaim"		},
+	{ Opt_stride,			"stride=%u"			},
+	{ Opt_stripe_width,		"stripe_width=%u"	},
+	{ Opt_percpu_ialloc,	"percpu_ialloc"		},
+	{ Opt_nopercpu_ialloc,	"nopercpu_ialloc"	},
+	{ Opt_inline_data,		"inline_data"		},
+	{ Opt_noinline_data,	"noinline_data"		},
 	{ Opt_err,				NULL				},
 };
 
@@ -423,6 +480,7 @@ static int me2fsFillSuperBlock( struct super_block *sb,
 
 	/* set me2fs information to vfs super block									*/
 	sb->s_fs_info	= ( void* )msi;
+	msi->s_sb		= sb;
 
 	/* ------------------------------------------------------------------------ */
 	/* allocate memory to spin locks for block group							*/
@@ -520,11 +578,28 @@ static int me2fsFillSuperBlock( struct super_block *sb,
 	//msi->s_resuid = make_kuid( &init_user_ns, le16_to_cpu( esb->s_def_resuid ) );
 	//msi->s_resgid = make_kgid( &init_user_ns, le16_to_cpu( esb->s_def_resgid ) );
 
+	/* raid geometry recorded by mke2fs, overridden by mount options			*/
+	msi->s_raid_stride			= le16_to_cpu( esb->s_raid_stride );
+	msi->s_raid_stripe_width	= le32_to_cpu( esb->s_raid_stripe_width );
+
 	if( !parseOptions( ( char* )data, sb ) )
 	{
 		goto error_mount;
 	}
 
+	/* ------------------------------------------------------------------------ */
+	/* inline files change the format of the disk. the administrator opts in	*/
+	/* by setting the feature, the driver never sets it on its own				*/
+	/* ------------------------------------------------------------------------ */
+	if( ( msi->s_mount_opt & EXT2_MOUNT_INLINE_DATA ) &&
+		!( esb->s_feature_incompat &
+		   cpu_to_le32( ME2FS_FEATURE_INCOMPAT_INLINE_DATA ) ) )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:inline_data needs the inline data feature\n",
+					 __func__ );
+		goto error_mount;
+	}
+
 	msi->s_mount_opt |= EXT2_MOUNT_RESERVATION;
 	msi->s_mount_opt &= ~EXT2_MOUNT_OLDALLOC;
 	msi->s_mount_opt &= ~EXT2_MOUNT_MINIX_DF;
@@ -647,7 +722,57 @@ static int me2fsFillSuperBlock( struct super_block *sb,
 	/* deaults(disk information cache)											*/
 	msi->s_resuid = make_kuid( &init_user_ns, le16_to_cpu( esb->s_def_resuid ) );
 	msi->s_resgid = make_kgid( &init_user_ns, le16_to_cpu( esb->s_def_resgid ) );
-	
+
+	/* directory index(disk information cache)									*/
+	if( le32_to_cpu( esb->s_flags ) & EXT2_FLAGS_UNSIGNED_HASH )
+	{
+		msi->s_hash_unsigned = 3;
+	}
+	else if( !( le32_to_cpu( esb->s_flags ) & EXT2_FLAGS_SIGNED_HASH ) &&
+			 !( sb->s_flags & MS_RDONLY ) )
+	{
+		/* -------------------------------------------------------------------- */
+		/* neither flag is set, record signedness of char on this machine		*/
+		/* -------------------------------------------------------------------- */
+#ifdef	__CHAR_UNSIGNED__
+		esb->s_flags			|= cpu_to_le32( EXT2_FLAGS_UNSIGNED_HASH );
+		msi->s_hash_unsigned	= 3;
+#else
+		esb->s_flags			|= cpu_to_le32( EXT2_FLAGS_SIGNED_HASH );
+#endif
+	}
+
+	/* directory readahead, tunable through sysfs								*/
+	msi->s_dir_ra_pages = ME2FS_DEFAULT_DIR_RA_PAGES;
+
+	/* largest reservation window of a streaming writer, tunable through sysfs	*/
+	msi->s_max_rsv_blocks = EXT2_MAX_RESERVE_BLOCKS;
+
+	/* block bitmaps read ahead of group search, tunable through sysfs			*/
+	msi->s_bitmap_ra_groups = ME2FS_DEFAULT_BITMAP_RA_GROUPS;
+
+	/* smallest deleted file freed in background, tunable through sysfs			*/
+	msi->s_reclaim_min_blocks = ME2FS_DEFAULT_RECLAIM_MIN_BLOCKS;
+
+	/* groups new files are spread over by percpu_ialloc, tunable through sysfs	*/
+	msi->s_ialloc_spread_groups = ME2FS_DEFAULT_IALLOC_SPREAD_GROUPS;
+
+	/* inode table blocks read ahead of lookups, tunable through sysfs			*/
+	msi->s_itb_ra_blocks	= ME2FS_DEFAULT_ITB_RA_BLOCKS;
+	msi->s_itb_ra_last		= 0;
+	msi->s_itb_ra_window	= 0;
+	atomic_long_set( &msi->s_itb_hits, 0 );
+	atomic_long_set( &msi->s_itb_misses, 0 );
+
+	/* large allocations are aligned to this, 0 if not on raid					*/
+	msi->s_stripe = getStripe( sb );
+	atomic_long_set( &msi->s_stripe_allocs, 0 );
+	atomic_long_set( &msi->s_stripe_misaligned, 0 );
+
+	/* hit rate of the extent caches of inodes									*/
+	atomic_long_set( &msi->s_extent_hits, 0 );
+	atomic_long_set( &msi->s_extent_misses, 0 );
+
 	dbgPrintMe2fsInfo( msi );
 
 	/* ------------------------------------------------------------------------ */
@@ -755,20 +880,23 @@ static int me2fsFillSuperBlock( struct super_block *sb,
 	}
 
 	/* ------------------------------------------------------------------------ */
-	/* initialize reservation window											*/
+	/* initialize reservation window trees of all block groups					*/
 	/* ------------------------------------------------------------------------ */
-	msi->s_rsv_window_head.rsv_start		= EXT2_RESERVE_WINDOW_NOT_ALLOCATED;
-	msi->s_rsv_window_head.rsv_end			= EXT2_RESERVE_WINDOW_NOT_ALLOCATED;
-	msi->s_rsv_window_head.rsv_alloc_hit	= 0;
-	msi->s_rsv_window_head.rsv_goal_size	= 0;
-	me2fsInsertReserveWindow( sb, &msi->s_rsv_window_head );
+	err = me2fsInitReservation( sb );
+
+	if( err )
+	{
+		ME2FS_ERROR( "<ME2FS>cannot allocate memory for reservation windows\n" );
+		goto error_mount_phase2;
+	}
 
 	/* ------------------------------------------------------------------------ */
 	/* initialize exclusive locks												*/
 	/* ------------------------------------------------------------------------ */
-	spin_lock_init( &msi->s_rsv_window_lock );
 	spin_lock_init( &msi->s_lock );
 
+	me2fsInitDirCompaction( sb );
+
 	bgl_lock_init( msi->s_blockgroup_lock );
 
 	err = percpu_counter_init( &msi->s_freeblocks_counter,
@@ -801,6 +929,48 @@ static int me2fsFillSuperBlock( struct super_block *sb,
 		goto error_mount_phase3;
 	}
 
+	err = percpu_counter_init( &msi->s_dirtyblocks_counter, 0 );
+	
+	if( err )
+	{
+		ME2FS_ERROR( "<ME2FS>cannot allocate memory for percpu counter" );
+		ME2FS_ERROR( "[s_dirtyblocks_counter]\n" );
+		goto error_mount_phase3;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* free extent index, built per group on first allocation					*/
+	/* ------------------------------------------------------------------------ */
+	err = me2fsInitFreeMaps( sb );
+
+	if( err )
+	{
+		ME2FS_ERROR( "<ME2FS>cannot allocate memory for free extent index\n" );
+		goto error_mount_phase3;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* summary of block groups for group selection								*/
+	/* ------------------------------------------------------------------------ */
+	err = me2fsInitGroupInfo( sb );
+
+	if( err )
+	{
+		ME2FS_ERROR( "<ME2FS>cannot allocate memory for group summary\n" );
+		goto error_mount_phase3;
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* workqueue freeing blocks of large deleted files							*/
+	/* ------------------------------------------------------------------------ */
+	err = me2fsInitReclaim( sb );
+
+	if( err )
+	{
+		ME2FS_ERROR( "<ME2FS>cannot create workqueue for reclaim\n" );
+		goto error_mount_phase3;
+	}
+
 	/* ------------------------------------------------------------------------ */
 	/* add kobject to sysfs														*/
 	/* ------------------------------------------------------------------------ */
@@ -818,7 +988,7 @@ static int me2fsFillSuperBlock( struct super_block *sb,
 	sb->s_op		= &me2fs_super_ops;
 	//sb->s_export_op	= &me2fs_export_ops;
 	sb->s_xattr		= me2fs_xattr_handlers;
-	sb->dq_op		= &dquot_operations;
+	sb->dq_op		= &me2fs_quota_operations;
 	sb->s_qcop		= &dquot_quotactl_ops;
 
 	sb->s_maxbytes	= me2fsMaxFileSize( sb );
@@ -857,6 +1027,15 @@ static int me2fsFillSuperBlock( struct super_block *sb,
 
 	me2fsWriteSuper( sb );
 
+	/* ------------------------------------------------------------------------ */
+	/* statfs trusts the free counters, check them against the descriptors		*/
+	/* now and then																*/
+	/* ------------------------------------------------------------------------ */
+	INIT_DELAYED_WORK( &msi->s_reconcile_work, reconcileCounters );
+	queue_delayed_work( system_long_wq,
+						&msi->s_reconcile_work,
+						COUNTER_RECONCILE_DELAY );
+
 	DBGPRINT( "<ME2FS> me2fs is mounted !\n" );
 
 	return( 0 );
@@ -870,9 +1049,14 @@ error_mount_phase4:
 	/* destroy percpu counter													*/
 	/* ------------------------------------------------------------------------ */
 error_mount_phase3:
+	me2fsStopReclaim( sb );
 	percpu_counter_destroy( &msi->s_freeblocks_counter );
 	percpu_counter_destroy( &msi->s_freeinodes_counter );
 	percpu_counter_destroy( &msi->s_dirs_counter );
+	percpu_counter_destroy( &msi->s_dirtyblocks_counter );
+	me2fsDestroyGroupInfo( sb );
+	me2fsDestroyFreeMaps( sb );
+	me2fsDestroyReservation( sb );
 	/* ------------------------------------------------------------------------ */
 	/* release buffer for group descriptors										*/
 	/* ------------------------------------------------------------------------ */
@@ -924,16 +1108,33 @@ static void me2fsPutSuperBlock( struct super_block *sb )
 	struct me2fs_sb_info	*msi;
 	int						i;
 
+	/* ------------------------------------------------------------------------ */
+	/* release directories queued for compaction while quota is still on		*/
+	/* ------------------------------------------------------------------------ */
+	me2fsStopDirCompaction( sb );
+
+	/* ------------------------------------------------------------------------ */
+	/* free the blocks of deleted files before the allocator goes away			*/
+	/* ------------------------------------------------------------------------ */
+	me2fsStopReclaim( sb );
+
 	dquot_disable( sb, -1, DQUOT_USAGE_ENABLED | DQUOT_LIMITS_ENABLED );
 
 	msi = ME2FS_SB( sb );
 
+	cancel_delayed_work_sync( &msi->s_reconcile_work );
+
 	/* ------------------------------------------------------------------------ */
 	/* destroy percpu counter													*/
 	/* ------------------------------------------------------------------------ */
 	percpu_counter_destroy( &msi->s_freeblocks_counter );
 	percpu_counter_destroy( &msi->s_freeinodes_counter );
 	percpu_counter_destroy( &msi->s_dirs_counter );
+	percpu_counter_destroy( &msi->s_dirtyblocks_counter );
+
+	me2fsDestroyGroupInfo( sb );
+	me2fsDestroyFreeMaps( sb );
+	me2fsDestroyReservation( sb );
 
 	/* ------------------------------------------------------------------------ */
 	/* shrink mb cache															*/
@@ -1180,6 +1381,21 @@ static struct inode *me2fsAllocInode( struct super_block *sb )
 	}
 
 	mi->vfs_inode.i_version = 1;
+	mi->i_dir_summary = NULL;
+	atomic_set( &mi->i_dir_streams, 0 );
+	INIT_LIST_HEAD( &mi->i_dir_compact );
+	mi->i_dir_compact_deferred = 0;
+
+	spin_lock_init( &mi->i_da_lock );
+	mi->i_da_data_blocks	= 0;
+	mi->i_da_meta_blocks	= 0;
+	mi->i_da_last_ind		= -1;
+	mi->i_falloc_blocks		= 0;
+	mi->i_reserved_quota	= 0;
+
+	mi->i_extent_gen		= 0;
+	mi->i_extent_next		= 0;
+	memset( mi->i_extents, 0, sizeof( mi->i_extents ) );
 
 	return( &mi->vfs_inode );
 }
@@ -1223,6 +1439,8 @@ static void me2fsInitInodeOnce( void *object )
 	rwlock_init( &ei->i_meta_lock );
 	mutex_init( &ei->truncate_mutex );
 	init_rwsem( &ei->xattr_sem );
+	init_rwsem( &ei->i_mmap_sem );
+	spin_lock_init( &ei->i_extent_lock );
 
 	/* ------------------------------------------------------------------------ */
 	/* initialize vfs inode														*/
@@ -1335,6 +1553,14 @@ static int me2fsSyncFs( struct super_block *sb, int wait )
 
 	DBGPRINT( "<ME2FS>%s:sync_super\n", __func__ );
 
+	/* ------------------------------------------------------------------------ */
+	/* blocks of deleted files are freed before the bitmaps are written out		*/
+	/* ------------------------------------------------------------------------ */
+	if( wait )
+	{
+		me2fsWaitReclaim( sb );
+	}
+
 	/* ------------------------------------------------------------------------ */
 	/* write quota structures to quota file, sync_blockdev() will write them to	*/
 	/* disk later																*/
@@ -1379,13 +1605,18 @@ static void me2fsSyncSuper( struct super_block *sb,
 							int wait )
 {
 	struct me2fs_sb_info	*msi;
+	unsigned long			free_blocks;
+	unsigned long			free_inodes;
 
 	msi = ME2FS_SB( sb );
 
 	clearSuperError( sb );
+	/* walk the descriptors before taking s_lock								*/
+	free_blocks = me2fsCountFreeBlocks( sb );
+	free_inodes = me2fsCountFreeInodes( sb );
 	spin_lock( &msi->s_lock );
-	esb->s_free_blocks_count = cpu_to_le32( me2fsCountFreeBlocks( sb ) );
-	esb->s_free_inodes_count = cpu_to_le32( me2fsCountFreeInodes( sb ) );
+	esb->s_free_blocks_count = cpu_to_le32( free_blocks );
+	esb->s_free_inodes_count = cpu_to_le32( free_inodes );
 	/* unlock before i/o														*/
 	spin_unlock( &msi->s_lock );
 	mark_buffer_dirty( msi->s_sbh );
@@ -1443,6 +1674,8 @@ static int me2fsStatfs( struct dentry *dentry, struct kstatfs *buf )
 	struct me2fs_sb_info	*msi;
 	struct ext2_super_block	*esb;
 	u64						fsid;
+	s64						free;
+	s64						dirty;
 
 	sb	= dentry->d_sb;
 	msi	= ME2FS_SB( sb );
@@ -1495,16 +1728,7 @@ static int me2fsStatfs( struct dentry *dentry, struct kstatfs *buf )
 		buf->f_bsize	= sb->s_blocksize;
 		buf->f_blocks	= le32_to_cpu( esb->s_blocks_count )
 						  - msi->s_overhead_last;
-		buf->f_bfree	= me2fsCountFreeBlocks( sb );
-		
-		esb->s_free_blocks_count = cpu_to_le32( buf->f_bfree );
-		buf->f_bavail	= buf->f_bfree - le32_to_cpu( esb->s_r_blocks_count );
-		if( buf->f_bfree < le32_to_cpu( esb->s_r_blocks_count ) )
-		{
-			buf->f_bavail = 0;
-		}
 		buf->f_files	= le32_to_cpu( esb->s_inodes_count );
-		buf->f_ffree	= me2fsCountFreeInodes( sb );
 		buf->f_namelen	= ME2FS_NAME_LEN;
 		fsid = le64_to_cpup( ( void* )esb->s_uuid ) ^
 			   le64_to_cpup( ( void* )esb->s_uuid + sizeof( u64 ) );
@@ -1513,6 +1737,32 @@ static int me2fsStatfs( struct dentry *dentry, struct kstatfs *buf )
 	}
 	spin_unlock( &msi->s_lock );
 
+	/* ------------------------------------------------------------------------ */
+	/* free counts come from the counters kept by the allocators, instead of	*/
+	/* walking all group descriptors											*/
+	/* ------------------------------------------------------------------------ */
+	free	= percpu_counter_sum_positive( &msi->s_freeblocks_counter );
+	/* blocks of deleted files being reclaimed are as good as free				*/
+	free	+= atomic_long_read( &msi->s_reclaim_pending );
+	/* blocks reserved by delayed allocation are not free any more				*/
+	dirty	= percpu_counter_sum_positive( &msi->s_dirtyblocks_counter );
+
+	if( free < dirty )
+	{
+		buf->f_bfree = 0;
+	}
+	else
+	{
+		buf->f_bfree = free - dirty;
+	}
+
+	buf->f_bavail	= buf->f_bfree - le32_to_cpu( esb->s_r_blocks_count );
+	if( buf->f_bfree < le32_to_cpu( esb->s_r_blocks_count ) )
+	{
+		buf->f_bavail = 0;
+	}
+	buf->f_ffree	= percpu_counter_sum_positive( &msi->s_freeinodes_counter );
+
 	return( 0 );
 }
 /*
@@ -1540,6 +1790,8 @@ static int me2fsRemount( struct super_block *sb,
 		unsigned long	s_mount_opt;
 		kuid_t			s_resuid;
 		kgid_t			s_resgid;
+		unsigned long	s_raid_stride;
+		unsigned long	s_raid_stripe_width;
 	};
 	
 	struct me2fs_sb_info		*msi;
@@ -1564,6 +1816,8 @@ static int me2fsRemount( struct super_block *sb,
 	old_opts.s_mount_opt	= msi->s_mount_opt;
 	old_opts.s_resuid		= msi->s_resuid;
 	old_opts.s_resgid		= msi->s_resgid;
+	old_opts.s_raid_stride			= msi->s_raid_stride;
+	old_opts.s_raid_stripe_width	= msi->s_raid_stripe_width;
 
 	/* ------------------------------------------------------------------------ */
 	/* allow the "check" option to be passed as a remount option				*/
@@ -1574,6 +1828,29 @@ static int me2fsRemount( struct super_block *sb,
 		goto restore_opts;
 	}
 
+	/* ------------------------------------------------------------------------ */
+	/* address space operations of cached inodes follow delalloc at mount		*/
+	/* ------------------------------------------------------------------------ */
+	if( ( old_mount_opt ^ msi->s_mount_opt ) & EXT2_MOUNT_DELALLOC )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:cannot change delalloc on remount\n",
+					 __func__ );
+		err = -EINVAL;
+		goto restore_opts;
+	}
+
+	if( ( msi->s_mount_opt & EXT2_MOUNT_INLINE_DATA ) &&
+		!( msi->s_esb->s_feature_incompat &
+		   cpu_to_le32( ME2FS_FEATURE_INCOMPAT_INLINE_DATA ) ) )
+	{
+		ME2FS_ERROR( "<ME2FS>%s:inline_data needs the inline data feature\n",
+					 __func__ );
+		err = -EINVAL;
+		goto restore_opts;
+	}
+
+	msi->s_stripe = getStripe( sb );
+
 	if( msi->s_mount_opt & EXT2_MOUNT_POSIX_ACL )
 	{
 		sb->s_flags = sb->s_flags | MS_POSIXACL;
@@ -1655,6 +1932,9 @@ restore_opts:
 	msi->s_mount_opt	= old_opts.s_mount_opt;
 	msi->s_resuid		= old_opts.s_resuid;
 	msi->s_resgid		= old_opts.s_resgid;
+	msi->s_raid_stride			= old_opts.s_raid_stride;
+	msi->s_raid_stripe_width	= old_opts.s_raid_stripe_width;
+	msi->s_stripe				= getStripe( sb );
 	sb->s_flags			= old_sb_flags;
 	spin_unlock( &msi->s_lock );
 
@@ -1830,6 +2110,64 @@ static int parseOptions( char *options, struct super_block *sb )
 		case	Opt_reservation:
 			msi->s_mount_opt |=  EXT2_MOUNT_RESERVATION;
 			break;
+		case	Opt_dir_compact:
+			msi->s_mount_opt |=  EXT2_MOUNT_DIR_COMPACT;
+			break;
+		case	Opt_nodir_compact:
+			msi->s_mount_opt &= ~EXT2_MOUNT_DIR_COMPACT;
+			break;
+		case	Opt_delalloc:
+			msi->s_mount_opt |=  EXT2_MOUNT_DELALLOC;
+			break;
+		case	Opt_nodelalloc:
+			msi->s_mount_opt &= ~EXT2_MOUNT_DELALLOC;
+			break;
+		case	Opt_discard:
+			if( !blk_queue_discard( bdev_get_queue( sb->s_bdev ) ) )
+			{
+				ME2FS_ERROR( "<ME2FS>%s:warning:device does not support "
+							 "discard, option ignored\n", __func__ );
+				break;
+			}
+			msi->s_mount_opt |=  EXT2_MOUNT_DISCARD;
+			break;
+		case	Opt_nodiscard:
+			msi->s_mount_opt &= ~EXT2_MOUNT_DISCARD;
+			break;
+		case	Opt_bg_reclaim:
+			msi->s_mount_opt |=  EXT2_MOUNT_BG_RECLAIM;
+			break;
+		case	Opt_nobg_reclaim:
+			msi->s_mount_opt &= ~EXT2_MOUNT_BG_RECLAIM;
+			break;
+		case	Opt_stride:
+			if( match_int( &args[ 0 ], &option ) || ( option < 0 ) )
+			{
+				DBGPRINT( "<ME2FS>option:stride:invalid parameter\n" );
+				return( 0 );
+			}
+			msi->s_raid_stride = option;
+			break;
+		case	Opt_stripe_width:
+			if( match_int( &args[ 0 ], &option ) || ( option < 0 ) )
+			{
+				DBGPRINT( "<ME2FS>option:stripe_width:invalid parameter\n" );
+				return( 0 );
+			}
+			msi->s_raid_stripe_width = option;
+			break;
+		case	Opt_percpu_ialloc:
+			msi->s_mount_opt |=  EXT2_MOUNT_PERCPU_IALLOC;
+			break;
+		case	Opt_nopercpu_ialloc:
+			msi->s_mount_opt &= ~EXT2_MOUNT_PERCPU_IALLOC;
+			break;
+		case	Opt_inline_data:
+			msi->s_mount_opt |=  EXT2_MOUNT_INLINE_DATA;
+			break;
+		case	Opt_noinline_data:
+			msi->s_mount_opt &= ~EXT2_MOUNT_INLINE_DATA;
+			break;
 		case	Opt_ignore:
 			DBGPRINT( "<ME2FS>option:ignore...\n" );
 			break;
@@ -2002,6 +2340,39 @@ static int me2fsShowOptions( struct seq_file *seq, struct dentry *root )
 		{
 			seq_printf( seq, ",noreservation" );
 		}
+		if( msi->s_mount_opt & EXT2_MOUNT_DIR_COMPACT )
+		{
+			seq_printf( seq, ",dircompact" );
+		}
+		if( msi->s_mount_opt & EXT2_MOUNT_DELALLOC )
+		{
+			seq_printf( seq, ",delalloc" );
+		}
+		if( msi->s_mount_opt & EXT2_MOUNT_DISCARD )
+		{
+			seq_printf( seq, ",discard" );
+		}
+		if( msi->s_mount_opt & EXT2_MOUNT_BG_RECLAIM )
+		{
+			seq_printf( seq, ",bgreclaim" );
+		}
+		if( msi->s_mount_opt & EXT2_MOUNT_PERCPU_IALLOC )
+		{
+			seq_printf( seq, ",percpu_ialloc" );
+		}
+		if( msi->s_mount_opt & EXT2_MOUNT_INLINE_DATA )
+		{
+			seq_printf( seq, ",inline_data" );
+		}
+		if( msi->s_raid_stride != le16_to_cpu( esb->s_raid_stride ) )
+		{
+			seq_printf( seq, ",stride=%lu", msi->s_raid_stride );
+		}
+		if( msi->s_raid_stripe_width !=
+			le32_to_cpu( esb->s_raid_stripe_width ) )
+		{
+			seq_printf( seq, ",stripe_width=%lu", msi->s_raid_stripe_width );
+		}
 	}
 	spin_unlock( &msi->s_lock );
 
@@ -2025,6 +2396,13 @@ static int me2fsFreeze( struct super_block *sb )
 
 	DBGPRINT( "<ME2FS>freeze filesystem\n" );
 
+	/* ------------------------------------------------------------------------ */
+	/* deletions finished after sync_fs may have queued block trees. free		*/
+	/* them and write the bitmaps out before the image is frozen				*/
+	/* ------------------------------------------------------------------------ */
+	me2fsWaitReclaim( sb );
+	sync_blockdev( sb->s_bdev );
+
 	if( atomic_long_read( &sb->s_remove_count ) )
 	{
 		me2fsSyncFs( sb, 1 );
@@ -2337,6 +2715,114 @@ static int optionsSeqShow( struct seq_file *seq, void *offset )
 	return( rc );
 }
 
+/*
+==================================================================================
+	Function	:reconcileCounters
+	Input		:struct work_struct *work
+				 < work of a file system >
+	Output		:void
+	Return		:void
+
+	Description	:check free counters against group descriptors in background
+==================================================================================
+*/
+static void reconcileCounters( struct work_struct *work )
+{
+	struct me2fs_sb_info	*msi;
+
+	msi = container_of( to_delayed_work( work ),
+						struct me2fs_sb_info,
+						s_reconcile_work );
+
+	reconcileCounter( &msi->s_freeblocks_counter,
+					  me2fsCountFreeBlocks( msi->s_sb ),
+					  &msi->s_free_blocks_drift );
+	reconcileCounter( &msi->s_freeinodes_counter,
+					  me2fsCountFreeInodes( msi->s_sb ),
+					  &msi->s_free_inodes_drift );
+
+	queue_delayed_work( system_long_wq,
+						&msi->s_reconcile_work,
+						COUNTER_RECONCILE_DELAY );
+}
+
+/*
+==================================================================================
+	Function	:reconcileCounter
+	Input		:struct percpu_counter *counter
+				 < free counter >
+				 s64 desc_count
+				 < free count summed up from group descriptors >
+				 s64 *last_drift
+				 < difference seen by the last pass >
+	Output		:s64 *last_drift
+				 < difference seen by this pass >
+	Return		:void
+
+	Description	:correct a counter which drifted from the descriptors
+==================================================================================
+*/
+static void reconcileCounter( struct percpu_counter *counter,
+							  s64 desc_count,
+							  s64 *last_drift )
+{
+	s64		drift;
+
+	drift = desc_count - percpu_counter_sum( counter );
+
+	/* ------------------------------------------------------------------------ */
+	/* a descriptor and the counter are not updated at once, so a difference	*/
+	/* may be an allocation in flight. only a difference seen twice in a row	*/
+	/* is a real drift, and it is added rather than set so that allocations		*/
+	/* running meanwhile are not lost											*/
+	/* ------------------------------------------------------------------------ */
+	if( drift && ( drift == *last_drift ) )
+	{
+		DBGPRINT( "<ME2FS>%s:free counter drifted by %lld\n",
+				  __func__, drift );
+		percpu_counter_add( counter, drift );
+		drift = 0;
+	}
+
+	*last_drift = drift;
+}
+
+/*
+==================================================================================
+	Function	:getStripe
+	Input		:struct super_block *sb
+				 < vfs super block >
+	Output		:void
+	Return		:unsigned long
+				 < blocks to align large allocations to, 0 if none >
+
+	Description	:choose the stripe from the raid geometry. a full stripe
+				 is preferred to a stride, and a stripe which does not fit
+				 in a block group is ignored
+==================================================================================
+*/
+static unsigned long getStripe( struct super_block *sb )
+{
+	struct me2fs_sb_info	*msi;
+	unsigned long			stripe;
+
+	msi = ME2FS_SB( sb );
+
+	stripe = msi->s_raid_stripe_width;
+
+	if( ( stripe <= 1 ) || ( msi->s_blocks_per_group < stripe ) )
+	{
+		stripe = msi->s_raid_stride;
+	}
+
+	if( ( stripe <= 1 ) || ( msi->s_blocks_per_group < stripe ) )
+	{
+		return( 0 );
+	}
+
+	return( stripe );
+}
+
 /*
 ==================================================================================
 	Function	:void
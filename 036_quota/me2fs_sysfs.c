@@ -26,6 +26,11 @@ static ssize_t ulShow( struct kobject *kobj, struct attribute *attr, char *buf )
 static ssize_t uiShow( struct kobject *kobj, struct attribute *attr, char *buf );
 static ssize_t usShow( struct kobject *kobj, struct attribute *attr, char *buf );
 static ssize_t uxShow( struct kobject *kobj, struct attribute *attr, char *buf );
+static ssize_t alShow( struct kobject *kobj, struct attribute *attr, char *buf );
+static ssize_t ulStore( struct kobject *kobj,
+						struct attribute *attr,
+						const char *buf,
+						size_t count );
 
 /*
 ----------------------------------------------------------------------------------
@@ -56,8 +61,11 @@ struct me2fs_attr
 	ssize_t ( *show )( struct kobject *kobj, struct attribute *attr, char *buf );
 	ssize_t ( *store )( struct kobject *kobj,
 						struct attribute *attr,
-						const char *buf );
+						const char *buf,
+						size_t count );
 	int					offset;
+	unsigned long		min;				/* range of a writable value		*/
+	unsigned long		max;
 };
 
 #define	ATTR_LIST( name )	&me2fs_attr_##name.attr
@@ -83,6 +91,30 @@ ME2FS_ATTR_OFFSET( name, 0444, uiShow, NULL, s_##name )
 ME2FS_ATTR_OFFSET( name, 0444, usShow, NULL, s_##name )
 #define	ME2FS_MI_UX_ATTR( name )												\
 ME2FS_ATTR_OFFSET( name, 0444, uxShow, NULL, s_##name )
+#define	ME2FS_MI_AL_ATTR( name )												\
+ME2FS_ATTR_OFFSET( name, 0444, alShow, NULL, s_##name )
+#define	ME2FS_ATTR_RANGE( _name, _mode, _show, _store, _elname, _min, _max )	\
+static struct me2fs_attr me2fs_attr_##_name = {									\
+	.attr	= { .name = __stringify( _name ), .mode = _mode },					\
+	.show	= _show,															\
+	.store	= _store,															\
+	.offset	= offsetof( struct me2fs_sb_info, _elname ),						\
+	.min	= _min,																\
+	.max	= _max,																\
+}
+
+#define	ME2FS_MI_UL_RW_ATTR( name, min, max )									\
+ME2FS_ATTR_RANGE( name, 0644, ulShow, ulStore, s_##name, min, max )
+
+/* upper limits of the tunables, beyond which they only waste memory and i/o	*/
+#define	ME2FS_MAX_DIR_RA_PAGES				256
+#define	ME2FS_MAX_BITMAP_RA_GROUPS			256
+#define	ME2FS_MAX_IALLOC_SPREAD_GROUPS		1024
+#define	ME2FS_MAX_ITB_RA_BLOCKS				256
+/* as many blocks as a group of 64KiB blocks has								*/
+#define	ME2FS_MAX_RSV_BLOCKS_LIMIT			( 8 * 65536 )
+/* files of 4GiB in 1KiB blocks, larger ones are always reclaimed by the worker	*/
+#define	ME2FS_MAX_RECLAIM_MIN_BLOCKS		( 1UL << 22 )
 
 
 /*
@@ -137,6 +169,22 @@ ME2FS_MI_UL_ATTR( frags_per_block );
 ME2FS_MI_UL_ATTR( frags_per_group );
 ME2FS_MI_UI_ATTR( resuid );
 ME2FS_MI_UI_ATTR( resgid );
+ME2FS_MI_UL_RW_ATTR( dir_ra_pages, 0, ME2FS_MAX_DIR_RA_PAGES );
+ME2FS_MI_UL_RW_ATTR( max_rsv_blocks,
+					 EXT2_DEFAULT_RESERVE_BLOCKS, ME2FS_MAX_RSV_BLOCKS_LIMIT );
+ME2FS_MI_UL_RW_ATTR( bitmap_ra_groups, 0, ME2FS_MAX_BITMAP_RA_GROUPS );
+ME2FS_MI_UL_RW_ATTR( reclaim_min_blocks, 0, ME2FS_MAX_RECLAIM_MIN_BLOCKS );
+ME2FS_MI_UL_RW_ATTR( ialloc_spread_groups, 0, ME2FS_MAX_IALLOC_SPREAD_GROUPS );
+ME2FS_MI_UL_RW_ATTR( itb_ra_blocks, 0, ME2FS_MAX_ITB_RA_BLOCKS );
+ME2FS_MI_AL_ATTR( itb_hits );
+ME2FS_MI_AL_ATTR( itb_misses );
+ME2FS_MI_UL_ATTR( raid_stride );
+ME2FS_MI_UL_ATTR( raid_stripe_width );
+ME2FS_MI_UL_ATTR( stripe );
+ME2FS_MI_AL_ATTR( stripe_allocs );
+ME2FS_MI_AL_ATTR( stripe_misaligned );
+ME2FS_MI_AL_ATTR( extent_hits );
+ME2FS_MI_AL_ATTR( extent_misses );
 
 /* ext2 superblock																*/
 ME2FS_ES_LE32_ATTR( inodes_count );
@@ -190,6 +238,21 @@ static struct attribute *me2fs_attrs[ ] =
 	ATTR_LIST( frags_per_group ),
 	ATTR_LIST( resuid ),
 	ATTR_LIST( resgid ),
+	ATTR_LIST( dir_ra_pages ),
+	ATTR_LIST( max_rsv_blocks ),
+	ATTR_LIST( bitmap_ra_groups ),
+	ATTR_LIST( reclaim_min_blocks ),
+	ATTR_LIST( ialloc_spread_groups ),
+	ATTR_LIST( itb_ra_blocks ),
+	ATTR_LIST( itb_hits ),
+	ATTR_LIST( itb_misses ),
+	ATTR_LIST( raid_stride ),
+	ATTR_LIST( raid_stripe_width ),
+	ATTR_LIST( stripe ),
+	ATTR_LIST( stripe_allocs ),
+	ATTR_LIST( stripe_misaligned ),
+	ATTR_LIST( extent_hits ),
+	ATTR_LIST( extent_misses ),
 	/* ext2 superblock															*/
 	ATTR_LIST( inodes_count ),
 	ATTR_LIST( blocks_count ),
@@ -524,6 +587,85 @@ static ssize_t uxShow( struct kobject *kobj, struct attribute *attr, char *buf )
 	return( scnprintf( buf, PAGE_SIZE, "%08X\n", *ui ) );
 }
 
+/*
+==================================================================================
+	Function	:alShow
+	Input		:struct kobject *kobj
+				 < general object >
+				 struct attribute *attr
+				 < general attribute >
+				 char *buf
+				 < buffer to output >
+	Output		:void
+	Return		:ssize_t
+				 < actual output size >
+
+	Description	:show method for atomic_long_t
+==================================================================================
+*/
+static ssize_t alShow( struct kobject *kobj, struct attribute *attr, char *buf )
+{
+	struct me2fs_sb_info	*mi;
+	struct me2fs_attr		*me_attr;
+	atomic_long_t			*al;
+
+	mi		= container_of( kobj, struct me2fs_sb_info, s_kobj );
+	me_attr	= container_of( attr, struct me2fs_attr, attr );
+
+	al		= ( atomic_long_t* )( ( ( char* )mi ) + me_attr->offset );
+
+	return( scnprintf( buf, PAGE_SIZE, "%ld\n", atomic_long_read( al ) ) );
+}
+
+/*
+==================================================================================
+	Function	:ulStore
+	Input		:struct kobject *kobj
+				 < general object >
+				 struct attribute *attr
+				 < general attribute >
+				 const char *buf
+				 < buffer to input >
+				 size_t count
+				 < size of input >
+	Output		:void
+	Return		:ssize_t
+				 < consumed size or error >
+
+	Description	:store method for unsigned long. a value out of the range
+				 of the attribute is rejected
+==================================================================================
+*/
+static ssize_t ulStore( struct kobject *kobj,
+						struct attribute *attr,
+						const char *buf,
+						size_t count )
+{
+	struct me2fs_sb_info	*mi;
+	struct me2fs_attr		*me_attr;
+	unsigned long			*ul;
+	unsigned long			val;
+	int						err;
+
+	mi		= container_of( kobj, struct me2fs_sb_info, s_kobj );
+	me_attr	= container_of( attr, struct me2fs_attr, attr );
+
+	if( ( err = kstrtoul( skip_spaces( buf ), 0, &val ) ) )
+	{
+		return( err );
+	}
+
+	if( ( val < me_attr->min ) || ( me_attr->max < val ) )
+	{
+		return( -EINVAL );
+	}
+
+	ul		= ( unsigned long* )( ( ( char* )mi ) + me_attr->offset );
+	*ul		= val;
+
+	return( count );
+}
+
 
 /*
 ----------------------------------------------------------------------------------
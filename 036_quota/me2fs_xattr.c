@@ -1572,7 +1572,7 @@ static int xattrSet2( struct inode *inode,
 			goal	= ext2GetFirstBlockNum( sb, ME2FS_I( inode )->i_block_group );
 
 			count	= 1;
-			block	= me2fsNewBlocks( inode, goal, &count, &error );
+			block	= me2fsNewBlocks( inode, goal, &count, &error, 0 );
 
 			if( error )
 			{
@@ -0,0 +1,237 @@
+/********************************************************************************
+	File			: append_bench.c
+	Description		: Parallel appends, one file per thread
+
+	build			: gcc -O2 -Wall -pthread -o append_bench append_bench.c
+	usage			: append_bench <dir> [max threads] [MiB per thread]
+					  [KiB per write]
+					  every write allocates, so writers meet in the block
+					  allocator and its reservation windows
+
+*********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static void *appendFile( void *arg );
+static void removeFiles( int nr_threads );
+static double now( void );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+struct append_arg
+{
+	pthread_t		thread;
+	int				id;
+	int				failed;
+};
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+static const char			*dir;
+static long					mib_per_thread;
+static long					chunk;
+static pthread_barrier_t	start_barrier;
+
+int main( int argc, char *argv[ ] )
+{
+	struct append_arg	*args;
+	double				start;
+	double				elapsed;
+	int					max_threads;
+	int					nr_threads;
+	int					i;
+
+	if( argc < 2 )
+	{
+		fprintf( stderr, "usage: %s <dir> [max threads] [MiB per thread] "
+				 "[KiB per write]\n", argv[ 0 ] );
+		return( 1 );
+	}
+
+	dir				= argv[ 1 ];
+	max_threads		= ( 2 < argc ) ? atoi( argv[ 2 ] ) : 32;
+	mib_per_thread	= ( 3 < argc ) ? atol( argv[ 3 ] ) : 64;
+	chunk			= ( ( 4 < argc ) ? atol( argv[ 4 ] ) : 4 ) * 1024;
+
+	if( !( args = calloc( max_threads, sizeof( *args ) ) ) )
+	{
+		return( 1 );
+	}
+
+	printf( "%8s %12s %12s\n", "threads", "MiB", "MiB/sec" );
+
+	for( nr_threads = 1 ; nr_threads <= max_threads ; nr_threads *= 2 )
+	{
+		pthread_barrier_init( &start_barrier, NULL, nr_threads + 1 );
+
+		for( i = 0 ; i < nr_threads ; i++ )
+		{
+			args[ i ].id		= i;
+			args[ i ].failed	= 0;
+			pthread_create( &args[ i ].thread, NULL, appendFile, &args[ i ] );
+		}
+
+		pthread_barrier_wait( &start_barrier );
+		start = now( );
+
+		for( i = 0 ; i < nr_threads ; i++ )
+		{
+			pthread_join( args[ i ].thread, NULL );
+
+			if( args[ i ].failed )
+			{
+				fprintf( stderr, "thread %d failed to append\n", i );
+				return( 1 );
+			}
+		}
+
+		elapsed = now( ) - start;
+
+		printf( "%8d %12ld %12.1f\n",
+				nr_threads,
+				nr_threads * mib_per_thread,
+				nr_threads * mib_per_thread / elapsed );
+
+		pthread_barrier_destroy( &start_barrier );
+		removeFiles( nr_threads );
+	}
+
+	free( args );
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:appendFile
+	Input		:void *arg
+				 < struct append_arg of the thread >
+	Output		:void
+	Return		:void*
+				 < NULL >
+
+	Description	:append to the file of a thread and sync it
+==================================================================================
+*/
+static void *appendFile( void *arg )
+{
+	struct append_arg	*aarg;
+	char				path[ 4096 ];
+	char				*buf;
+	long				i;
+	long				writes;
+	int					fd;
+
+	aarg	= ( struct append_arg* )arg;
+	writes	= mib_per_thread * 1024 * 1024 / chunk;
+
+	snprintf( path, sizeof( path ), "%s/append.%d", dir, aarg->id );
+
+	buf	= malloc( chunk );
+	fd	= open( path, O_CREAT | O_TRUNC | O_WRONLY | O_APPEND, 0644 );
+
+	if( buf )
+	{
+		memset( buf, 0x5A, chunk );
+	}
+
+	pthread_barrier_wait( &start_barrier );
+
+	if( !buf || ( fd < 0 ) )
+	{
+		aarg->failed = 1;
+		goto out;
+	}
+
+	for( i = 0 ; i < writes ; i++ )
+	{
+		if( write( fd, buf, chunk ) != chunk )
+		{
+			aarg->failed = 1;
+			goto out;
+		}
+	}
+
+	if( fsync( fd ) )
+	{
+		aarg->failed = 1;
+	}
+
+out:
+	if( 0 <= fd )
+	{
+		close( fd );
+	}
+
+	free( buf );
+
+	return( NULL );
+}
+
+/*
+==================================================================================
+	Function	:removeFiles
+	Input		:int nr_threads
+				 < number of threads of the last run >
+	Output		:void
+	Return		:void
+
+	Description	:remove files of the last run, not timed
+==================================================================================
+*/
+static void removeFiles( int nr_threads )
+{
+	char	path[ 4096 ];
+	int		id;
+
+	for( id = 0 ; id < nr_threads ; id++ )
+	{
+		snprintf( path, sizeof( path ), "%s/append.%d", dir, id );
+		unlink( path );
+	}
+
+	sync( );
+}
+
+/*
+==================================================================================
+	Function	:now
+	Input		:void
+	Output		:void
+	Return		:double
+				 < monotonic time in seconds >
+
+	Description	:read the monotonic clock
+==================================================================================
+*/
+static double now( void )
+{
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return( ts.tv_sec + ts.tv_nsec / 1e9 );
+}
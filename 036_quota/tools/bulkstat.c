@@ -0,0 +1,131 @@
+/********************************************************************************
+	File			: bulkstat.c
+	Description		: List inodes in use of my ext2 file system by bulkstat
+
+	build			: gcc -O2 -Wall -o bulkstat bulkstat.c
+	usage			: bulkstat <mount point> [entries per call]
+					  prints "ino mode size mtime" of each inode in use, the
+					  same fields as find <dir> -printf '%i %m %s %T@\n'
+
+*********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/statvfs.h>
+#include <linux/types.h>
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+/* the same as me2fs.h, which is not for user space								*/
+struct me2fs_bstat
+{
+	__u64	bs_ino;
+	__u64	bs_size;
+	__u64	bs_blocks;
+	__u32	bs_mode;
+	__u32	bs_nlink;
+	__u32	bs_uid;
+	__u32	bs_gid;
+	__u32	bs_atime;
+	__u32	bs_mtime;
+	__u32	bs_ctime;
+	__u32	bs_generation;
+	__u32	bs_file_acl;
+	__u32	bs_flags;
+};
+
+struct me2fs_bulkstat_req
+{
+	__u64	br_ino;
+	__u64	br_buf;
+	__u32	br_count;
+	__u32	br_ocount;
+};
+
+#define	ME2FS_IOC_BULKSTAT			_IOWR( 'f', 65, struct me2fs_bulkstat_req )
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+int main( int argc, char *argv[ ] )
+{
+	struct me2fs_bulkstat_req	req;
+	struct me2fs_bstat			*buf;
+	struct statvfs				st;
+	unsigned int				count;
+	unsigned int				i;
+	int							fd;
+
+	if( argc < 2 )
+	{
+		fprintf( stderr, "usage: %s <mount point> [entries per call]\n",
+				 argv[ 0 ] );
+		return( 1 );
+	}
+
+	count = ( 2 < argc ) ? atoi( argv[ 2 ] ) : 4096;
+
+	if( ( ( fd = open( argv[ 1 ], O_RDONLY | O_DIRECTORY ) ) < 0 ) ||
+		fstatvfs( fd, &st ) )
+	{
+		perror( argv[ 1 ] );
+		return( 1 );
+	}
+
+	if( !( buf = calloc( count, sizeof( *buf ) ) ) )
+	{
+		return( 1 );
+	}
+
+	req.br_ino		= 1;
+	req.br_buf		= ( __u64 )( uintptr_t )buf;
+	req.br_count	= count;
+
+	/* ------------------------------------------------------------------------ */
+	/* each call goes on from where the last one stopped, until it passes the	*/
+	/* last inode of the file system											*/
+	/* ------------------------------------------------------------------------ */
+	while( req.br_ino <= st.f_files )
+	{
+		if( ioctl( fd, ME2FS_IOC_BULKSTAT, &req ) )
+		{
+			perror( "ME2FS_IOC_BULKSTAT" );
+			return( 1 );
+		}
+
+		for( i = 0 ; i < req.br_ocount ; i++ )
+		{
+			printf( "%llu %o %llu %u\n",
+					( unsigned long long )buf[ i ].bs_ino,
+					buf[ i ].bs_mode & 07777,
+					( unsigned long long )buf[ i ].bs_size,
+					buf[ i ].bs_mtime );
+		}
+	}
+
+	free( buf );
+	close( fd );
+
+	return( 0 );
+}
@@ -0,0 +1,24 @@
+#!/bin/sh
+#
+# bulkstat_bench.sh : time a cold scan of all inodes by find and by bulkstat
+#
+# usage : bulkstat_bench.sh <mount point>
+#         run as root, bulkstat is built next to this script
+#
+
+MNT=${1:?usage: $0 <mount point>}
+BULKSTAT=$(dirname "$0")/bulkstat
+
+coldCache()
+{
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+}
+
+coldCache
+echo "find -printf:"
+time find "$MNT" -xdev -printf '%i %m %s %T@\n' > /dev/null
+
+coldCache
+echo "bulkstat:"
+time "$BULKSTAT" "$MNT" > /dev/null
@@ -0,0 +1,211 @@
+/********************************************************************************
+	File			: create_bench.c
+	Description		: Parallel file creation in one directory
+
+	build			: gcc -O2 -Wall -pthread -o create_bench create_bench.c
+	usage			: create_bench <dir> [max threads] [files per thread]
+					  run with and without the percpu_ialloc mount option
+
+*********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static void *createFiles( void *arg );
+static void removeFiles( int nr_threads );
+static double now( void );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+struct create_arg
+{
+	pthread_t		thread;
+	int				id;
+	int				failed;
+};
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+static const char			*dir;
+static long					files_per_thread;
+static pthread_barrier_t	start_barrier;
+
+int main( int argc, char *argv[ ] )
+{
+	struct create_arg	*args;
+	double				start;
+	double				elapsed;
+	int					max_threads;
+	int					nr_threads;
+	int					i;
+
+	if( argc < 2 )
+	{
+		fprintf( stderr, "usage: %s <dir> [max threads] [files per thread]\n",
+				 argv[ 0 ] );
+		return( 1 );
+	}
+
+	dir					= argv[ 1 ];
+	max_threads			= ( 2 < argc ) ? atoi( argv[ 2 ] ) : 64;
+	files_per_thread	= ( 3 < argc ) ? atol( argv[ 3 ] ) : 10000;
+
+	if( !( args = calloc( max_threads, sizeof( *args ) ) ) )
+	{
+		return( 1 );
+	}
+
+	printf( "%8s %12s %12s\n", "threads", "files", "files/sec" );
+
+	for( nr_threads = 1 ; nr_threads <= max_threads ; nr_threads *= 2 )
+	{
+		pthread_barrier_init( &start_barrier, NULL, nr_threads + 1 );
+
+		for( i = 0 ; i < nr_threads ; i++ )
+		{
+			args[ i ].id		= i;
+			args[ i ].failed	= 0;
+			pthread_create( &args[ i ].thread, NULL, createFiles, &args[ i ] );
+		}
+
+		/* -------------------------------------------------------------------- */
+		/* all threads start together, the clock runs until the last one ends	*/
+		/* -------------------------------------------------------------------- */
+		pthread_barrier_wait( &start_barrier );
+		start = now( );
+
+		for( i = 0 ; i < nr_threads ; i++ )
+		{
+			pthread_join( args[ i ].thread, NULL );
+
+			if( args[ i ].failed )
+			{
+				fprintf( stderr, "thread %d failed to create files\n", i );
+				return( 1 );
+			}
+		}
+
+		elapsed = now( ) - start;
+
+		printf( "%8d %12ld %12.0f\n",
+				nr_threads,
+				nr_threads * files_per_thread,
+				nr_threads * files_per_thread / elapsed );
+
+		pthread_barrier_destroy( &start_barrier );
+		removeFiles( nr_threads );
+	}
+
+	free( args );
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:createFiles
+	Input		:void *arg
+				 < struct create_arg of the thread >
+	Output		:void
+	Return		:void*
+				 < NULL >
+
+	Description	:create empty files of a thread in the directory
+==================================================================================
+*/
+static void *createFiles( void *arg )
+{
+	struct create_arg	*carg;
+	char				path[ 4096 ];
+	long				i;
+	int					fd;
+
+	carg = ( struct create_arg* )arg;
+
+	pthread_barrier_wait( &start_barrier );
+
+	for( i = 0 ; i < files_per_thread ; i++ )
+	{
+		snprintf( path, sizeof( path ), "%s/t%d.%ld", dir, carg->id, i );
+
+		if( ( fd = open( path, O_CREAT | O_EXCL | O_WRONLY, 0644 ) ) < 0 )
+		{
+			carg->failed = 1;
+			break;
+		}
+
+		close( fd );
+	}
+
+	return( NULL );
+}
+
+/*
+==================================================================================
+	Function	:removeFiles
+	Input		:int nr_threads
+				 < number of threads of the last run >
+	Output		:void
+	Return		:void
+
+	Description	:remove files of the last run, not timed
+==================================================================================
+*/
+static void removeFiles( int nr_threads )
+{
+	char	path[ 4096 ];
+	long	i;
+	int		id;
+
+	for( id = 0 ; id < nr_threads ; id++ )
+	{
+		for( i = 0 ; i < files_per_thread ; i++ )
+		{
+			snprintf( path, sizeof( path ), "%s/t%d.%ld", dir, id, i );
+			unlink( path );
+		}
+	}
+
+	sync( );
+}
+
+/*
+==================================================================================
+	Function	:now
+	Input		:void
+	Output		:void
+	Return		:double
+				 < monotonic time in seconds >
+
+	Description	:read the monotonic clock
+==================================================================================
+*/
+static double now( void )
+{
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return( ts.tv_sec + ts.tv_nsec / 1e9 );
+}
@@ -0,0 +1,249 @@
+/********************************************************************************
+	File			: falloc_bench.c
+	Description		: Interleaved writes with and without fallocate
+
+	build			: gcc -O2 -Wall -o falloc_bench falloc_bench.c
+	usage			: falloc_bench <dir> [files] [KiB per write] [MiB per file]
+
+*********************************************************************************/
+#define	_GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static int runOnce( const char *dir, int prealloc );
+static long countExtents( int fd );
+static double now( void );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+static long		files;
+static long		chunk;
+static long		mib;
+static char		*buf;
+
+int main( int argc, char *argv[ ] )
+{
+	if( argc < 2 )
+	{
+		fprintf( stderr,
+				 "usage: %s <dir> [files] [KiB per write] [MiB per file]\n",
+				 argv[ 0 ] );
+		return( 1 );
+	}
+
+	files	= ( 2 < argc ) ? atol( argv[ 2 ] ) : 8;
+	chunk	= ( ( 3 < argc ) ? atol( argv[ 3 ] ) : 4 ) * 1024;
+	mib		= ( 4 < argc ) ? atol( argv[ 4 ] ) : 64;
+
+	if( !( buf = malloc( chunk ) ) )
+	{
+		return( 1 );
+	}
+
+	memset( buf, 0x5A, chunk );
+
+	printf( "%ld files x %ld MiB in %ld KiB writes\n",
+			files, mib, chunk / 1024 );
+	printf( "%10s %12s %12s %12s\n",
+			"mode", "MiB/sec", "avg extents", "max extents" );
+
+	if( runOnce( argv[ 1 ], 0 ) || runOnce( argv[ 1 ], 1 ) )
+	{
+		return( 1 );
+	}
+
+	free( buf );
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:runOnce
+	Input		:const char *dir
+				 < directory to write files in >
+				 int prealloc
+				 < 0:plain appends 1:fallocate each file first >
+	Output		:void
+	Return		:int
+				 < 0:success -1:error >
+
+	Description	:write files in interleaved chunks and print throughput
+				 and extents per file. fallocate is part of the timed run
+==================================================================================
+*/
+static int runOnce( const char *dir, int prealloc )
+{
+	char	path[ 4096 ];
+	int		*fds;
+	long	rounds;
+	long	extents;
+	long	total;
+	long	max;
+	long	i;
+	long	r;
+	double	start;
+	double	elapsed;
+
+	rounds = mib * 1024 * 1024 / chunk;
+
+	if( !( fds = calloc( files, sizeof( *fds ) ) ) )
+	{
+		return( -1 );
+	}
+
+	for( i = 0 ; i < files ; i++ )
+	{
+		snprintf( path, sizeof( path ), "%s/falloc_bench.%ld", dir, i );
+
+		if( ( fds[ i ] = open( path, O_CREAT | O_TRUNC | O_WRONLY,
+							   0644 ) ) < 0 )
+		{
+			perror( path );
+			return( -1 );
+		}
+	}
+
+	sync( );
+
+	start = now( );
+
+	/* ------------------------------------------------------------------------ */
+	/* ext2 cannot keep blocks past the end of file, so fallocate sets the		*/
+	/* size and the writes below fill the files from offset 0					*/
+	/* ------------------------------------------------------------------------ */
+	for( i = 0 ; prealloc && ( i < files ) ; i++ )
+	{
+		if( fallocate( fds[ i ], 0, 0, mib * 1024 * 1024 ) )
+		{
+			perror( "fallocate" );
+			return( -1 );
+		}
+	}
+
+	for( r = 0 ; r < rounds ; r++ )
+	{
+		for( i = 0 ; i < files ; i++ )
+		{
+			if( write( fds[ i ], buf, chunk ) != chunk )
+			{
+				perror( "write" );
+				return( -1 );
+			}
+		}
+	}
+
+	for( i = 0 ; i < files ; i++ )
+	{
+		fsync( fds[ i ] );
+	}
+
+	elapsed = now( ) - start;
+
+	total	= 0;
+	max		= 0;
+
+	for( i = 0 ; i < files ; i++ )
+	{
+		if( ( extents = countExtents( fds[ i ] ) ) < 0 )
+		{
+			perror( "FS_IOC_FIEMAP" );
+			return( -1 );
+		}
+
+		total	+= extents;
+		max		= ( max < extents ) ? extents : max;
+
+		close( fds[ i ] );
+		snprintf( path, sizeof( path ), "%s/falloc_bench.%ld", dir, i );
+		unlink( path );
+	}
+
+	printf( "%10s %12.1f %12.1f %12ld\n",
+			prealloc ? "fallocate" : "append",
+			files * mib / elapsed,
+			( double )total / files,
+			max );
+
+	free( fds );
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:countExtents
+	Input		:int fd
+				 < file to look at >
+	Output		:void
+	Return		:long
+				 < number of extents, -1 on error >
+
+	Description	:count extents of a file without fetching them
+==================================================================================
+*/
+static long countExtents( int fd )
+{
+	struct fiemap	fm;
+
+	memset( &fm, 0, sizeof( fm ) );
+	fm.fm_start			= 0;
+	fm.fm_length		= FIEMAP_MAX_OFFSET;
+	fm.fm_flags			= FIEMAP_FLAG_SYNC;
+	fm.fm_extent_count	= 0;
+
+	if( ioctl( fd, FS_IOC_FIEMAP, &fm ) )
+	{
+		return( -1 );
+	}
+
+	return( fm.fm_mapped_extents );
+}
+
+/*
+==================================================================================
+	Function	:now
+	Input		:void
+	Output		:void
+	Return		:double
+				 < monotonic time in seconds >
+
+	Description	:read the monotonic clock
+==================================================================================
+*/
+static double now( void )
+{
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return( ts.tv_sec + ts.tv_nsec / 1e9 );
+}
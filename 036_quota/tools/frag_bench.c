@@ -0,0 +1,201 @@
+/********************************************************************************
+	File			: frag_bench.c
+	Description		: Extents per file of interleaved appends
+
+	build			: gcc -O2 -Wall -o frag_bench frag_bench.c
+	usage			: frag_bench <dir> [files] [KiB per write] [MiB per file]
+					  run with and without the delalloc mount option
+
+*********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static long countExtents( int fd );
+static double now( void );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+int main( int argc, char *argv[ ] )
+{
+	char	path[ 4096 ];
+	char	*buf;
+	int		*fds;
+	long	files;
+	long	chunk;
+	long	mib;
+	long	rounds;
+	long	extents;
+	long	total;
+	long	max;
+	long	i;
+	long	r;
+	double	start;
+	double	elapsed;
+
+	if( argc < 2 )
+	{
+		fprintf( stderr,
+				 "usage: %s <dir> [files] [KiB per write] [MiB per file]\n",
+				 argv[ 0 ] );
+		return( 1 );
+	}
+
+	files	= ( 2 < argc ) ? atol( argv[ 2 ] ) : 8;
+	chunk	= ( ( 3 < argc ) ? atol( argv[ 3 ] ) : 4 ) * 1024;
+	mib		= ( 4 < argc ) ? atol( argv[ 4 ] ) : 64;
+	rounds	= mib * 1024 * 1024 / chunk;
+
+	fds	= calloc( files, sizeof( *fds ) );
+	buf	= malloc( chunk );
+
+	if( !fds || !buf )
+	{
+		return( 1 );
+	}
+
+	memset( buf, 0x5A, chunk );
+
+	for( i = 0 ; i < files ; i++ )
+	{
+		snprintf( path, sizeof( path ), "%s/frag_bench.%ld", argv[ 1 ], i );
+
+		if( ( fds[ i ] = open( path, O_CREAT | O_TRUNC | O_WRONLY,
+							   0644 ) ) < 0 )
+		{
+			perror( path );
+			return( 1 );
+		}
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* appends of all files interleave, the way several loggers would write		*/
+	/* ------------------------------------------------------------------------ */
+	start = now( );
+
+	for( r = 0 ; r < rounds ; r++ )
+	{
+		for( i = 0 ; i < files ; i++ )
+		{
+			if( write( fds[ i ], buf, chunk ) != chunk )
+			{
+				perror( "write" );
+				return( 1 );
+			}
+		}
+	}
+
+	for( i = 0 ; i < files ; i++ )
+	{
+		fsync( fds[ i ] );
+	}
+
+	elapsed = now( ) - start;
+
+	total	= 0;
+	max		= 0;
+
+	for( i = 0 ; i < files ; i++ )
+	{
+		if( ( extents = countExtents( fds[ i ] ) ) < 0 )
+		{
+			perror( "FS_IOC_FIEMAP" );
+			return( 1 );
+		}
+
+		total	+= extents;
+		max		= ( max < extents ) ? extents : max;
+
+		close( fds[ i ] );
+		snprintf( path, sizeof( path ), "%s/frag_bench.%ld", argv[ 1 ], i );
+		unlink( path );
+	}
+
+	printf( "files             : %ld x %ld MiB in %ld KiB writes\n",
+			files, mib, chunk / 1024 );
+	printf( "throughput        : %.1f MiB/s\n", files * mib / elapsed );
+	printf( "extents per file  : %.1f average, %ld max\n",
+			( double )total / files, max );
+
+	free( buf );
+	free( fds );
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:countExtents
+	Input		:int fd
+				 < file to look at >
+	Output		:void
+	Return		:long
+				 < number of extents, -1 on error >
+
+	Description	:count extents of a file without fetching them
+==================================================================================
+*/
+static long countExtents( int fd )
+{
+	struct fiemap	fm;
+
+	memset( &fm, 0, sizeof( fm ) );
+	fm.fm_start			= 0;
+	fm.fm_length		= FIEMAP_MAX_OFFSET;
+	fm.fm_flags			= FIEMAP_FLAG_SYNC;
+	fm.fm_extent_count	= 0;
+
+	if( ioctl( fd, FS_IOC_FIEMAP, &fm ) )
+	{
+		return( -1 );
+	}
+
+	return( fm.fm_mapped_extents );
+}
+
+/*
+==================================================================================
+	Function	:now
+	Input		:void
+	Output		:void
+	Return		:double
+				 < monotonic time in seconds >
+
+	Description	:read the monotonic clock
+==================================================================================
+*/
+static double now( void )
+{
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return( ts.tv_sec + ts.tv_nsec / 1e9 );
+}
@@ -0,0 +1,281 @@
+/********************************************************************************
+	File			: lookup_bench.c
+	Description		: Name lookup cost in a growing directory
+
+	build			: gcc -O2 -Wall -o lookup_bench lookup_bench.c
+	usage			: lookup_bench <dir> [max entries] [lookups]
+					  run as root on a flat and on an indexed file system:
+					  mke2fs -t ext2 -O ^dir_index img  (linear)
+					  mke2fs -t ext2 -O dir_index img   (htree)
+					  mount -t me2fs -o loop img /mnt/me2fs
+
+*********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static int createEntries( long from, long to );
+static void removeEntries( long nr_entries );
+static void dropDentries( void );
+static double timeLookups( long nr_entries, long lookups, int miss );
+static double now( void );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+#define	FIRST_ENTRIES		1000
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+static int		dir_fd;
+
+int main( int argc, char *argv[ ] )
+{
+	long	max_entries;
+	long	lookups;
+	long	nr_entries;
+	long	created;
+	double	hit;
+	double	miss;
+
+	if( argc < 2 )
+	{
+		fprintf( stderr, "usage: %s <dir> [max entries] [lookups]\n",
+				 argv[ 0 ] );
+		return( 1 );
+	}
+
+	max_entries	= ( 2 < argc ) ? atol( argv[ 2 ] ) : 1000000;
+	lookups		= ( 3 < argc ) ? atol( argv[ 3 ] ) : 10000;
+
+	/* ------------------------------------------------------------------------ */
+	/* the open directory keeps its inode and page cache across drop_caches		*/
+	/* so that only the name search itself is timed								*/
+	/* ------------------------------------------------------------------------ */
+	if( ( dir_fd = open( argv[ 1 ], O_RDONLY | O_DIRECTORY ) ) < 0 )
+	{
+		perror( argv[ 1 ] );
+		return( 1 );
+	}
+
+	srandom( 1 );
+
+	printf( "%10s %12s %12s\n", "entries", "hit usec", "miss usec" );
+
+	created = 0;
+
+	for( nr_entries = FIRST_ENTRIES ;
+		 nr_entries <= max_entries ;
+		 nr_entries *= 10 )
+	{
+		if( createEntries( created, nr_entries ) < 0 )
+		{
+			fprintf( stderr, "failed to create %ld entries\n", nr_entries );
+			removeEntries( created );
+			return( 1 );
+		}
+
+		created = nr_entries;
+
+		hit		= timeLookups( nr_entries, lookups, 0 );
+		miss	= timeLookups( nr_entries, lookups, 1 );
+
+		printf( "%10ld %12.2f %12.2f\n",
+				nr_entries,
+				hit * 1e6 / lookups,
+				miss * 1e6 / lookups );
+	}
+
+	removeEntries( created );
+	close( dir_fd );
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:createEntries
+	Input		:long from
+				 < first entry to create >
+				 long to
+				 < end of entries to create >
+	Output		:void
+	Return		:int
+				 < 0:success -1:failed >
+
+	Description	:create empty files, not timed
+==================================================================================
+*/
+static int createEntries( long from, long to )
+{
+	char	name[ 64 ];
+	long	i;
+	int		fd;
+
+	for( i = from ; i < to ; i++ )
+	{
+		snprintf( name, sizeof( name ), "entry.%ld", i );
+
+		if( ( fd = openat( dir_fd, name, O_CREAT | O_EXCL | O_WRONLY,
+						   0644 ) ) < 0 )
+		{
+			return( -1 );
+		}
+
+		close( fd );
+	}
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:removeEntries
+	Input		:long nr_entries
+				 < number of entries created >
+	Output		:void
+	Return		:void
+
+	Description	:remove all entries of the run
+==================================================================================
+*/
+static void removeEntries( long nr_entries )
+{
+	char	name[ 64 ];
+	long	i;
+
+	for( i = 0 ; i < nr_entries ; i++ )
+	{
+		snprintf( name, sizeof( name ), "entry.%ld", i );
+		unlinkat( dir_fd, name, 0 );
+	}
+
+	sync( );
+}
+
+/*
+==================================================================================
+	Function	:dropDentries
+	Input		:void
+	Output		:void
+	Return		:void
+
+	Description	:drop cached dentries and inodes so lookups reach the file
+				 system
+==================================================================================
+*/
+static void dropDentries( void )
+{
+	int		fd;
+
+	sync( );
+
+	if( ( fd = open( "/proc/sys/vm/drop_caches", O_WRONLY ) ) < 0 )
+	{
+		perror( "drop_caches" );
+		exit( 1 );
+	}
+
+	if( write( fd, "2\n", 2 ) != 2 )
+	{
+		perror( "drop_caches" );
+		exit( 1 );
+	}
+
+	close( fd );
+}
+
+/*
+==================================================================================
+	Function	:timeLookups
+	Input		:long nr_entries
+				 < number of entries in the directory >
+				 long lookups
+				 < number of lookups to time >
+				 int miss
+				 < 0:look up existing names 1:names that do not exist >
+	Output		:void
+	Return		:double
+				 < elapsed seconds >
+
+	Description	:look up random names with cold dentry cache
+==================================================================================
+*/
+static double timeLookups( long nr_entries, long lookups, int miss )
+{
+	struct stat	st;
+	char		name[ 64 ];
+	double		start;
+	long		i;
+	int			ret;
+
+	dropDentries( );
+
+	start = now( );
+
+	for( i = 0 ; i < lookups ; i++ )
+	{
+		/* -------------------------------------------------------------------- */
+		/* every missing name is new, a negative dentry would hide the search	*/
+		/* -------------------------------------------------------------------- */
+		if( miss )
+		{
+			snprintf( name, sizeof( name ), "none.%ld.%ld", nr_entries, i );
+		}
+		else
+		{
+			snprintf( name, sizeof( name ), "entry.%ld",
+					  random( ) % nr_entries );
+		}
+
+		ret = fstatat( dir_fd, name, &st, 0 );
+
+		if( ( ret == 0 ) == miss )
+		{
+			fprintf( stderr, "unexpected lookup result of %s\n", name );
+			exit( 1 );
+		}
+	}
+
+	return( now( ) - start );
+}
+
+/*
+==================================================================================
+	Function	:now
+	Input		:void
+	Output		:void
+	Return		:double
+				 < monotonic time in seconds >
+
+	Description	:read the monotonic clock
+==================================================================================
+*/
+static double now( void )
+{
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return( ts.tv_sec + ts.tv_nsec / 1e9 );
+}
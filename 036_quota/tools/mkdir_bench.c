@@ -0,0 +1,183 @@
+/********************************************************************************
+	File			: mkdir_bench.c
+	Description		: Directory creation throughput under the Orlov allocator
+
+	build			: gcc -O2 -Wall -o mkdir_bench mkdir_bench.c
+	usage			: mkdir_bench <dir> [top dirs] [sub dirs per top dir]
+					  a file system of 10000 groups to run it on, 10GiB sparse:
+					  truncate -s 10G img
+					  mke2fs -t ext2 -b 1024 -g 1024 -N 2560000 img
+					  mount -t me2fs -o loop,orlov img /mnt/me2fs
+
+*********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <time.h>
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static int makeTree( const char *dir, long nr_top, long nr_sub );
+static void removeTree( const char *dir, long nr_top, long nr_sub );
+static double now( void );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+int main( int argc, char *argv[ ] )
+{
+	double	start;
+	double	elapsed;
+	long	nr_top;
+	long	nr_sub;
+
+	if( argc < 2 )
+	{
+		fprintf( stderr, "usage: %s <dir> [top dirs] [sub dirs per top dir]\n",
+				 argv[ 0 ] );
+		return( 1 );
+	}
+
+	nr_top = ( 2 < argc ) ? atol( argv[ 2 ] ) : 10000;
+	nr_sub = ( 3 < argc ) ? atol( argv[ 3 ] ) : 4;
+
+	/* ------------------------------------------------------------------------ */
+	/* directories right under the root of the file system are the ones Orlov	*/
+	/* spreads over the groups, their sub directories stay near the parent		*/
+	/* ------------------------------------------------------------------------ */
+	start = now( );
+
+	if( makeTree( argv[ 1 ], nr_top, nr_sub ) )
+	{
+		perror( argv[ 1 ] );
+		return( 1 );
+	}
+
+	elapsed = now( ) - start;
+
+	printf( "top dirs   : %ld\n", nr_top );
+	printf( "sub dirs   : %ld\n", nr_top * nr_sub );
+	printf( "mkdir/sec  : %.0f\n", nr_top * ( nr_sub + 1 ) / elapsed );
+
+	removeTree( argv[ 1 ], nr_top, nr_sub );
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:makeTree
+	Input		:const char *dir
+				 < root of the tree >
+				 long nr_top
+				 < number of top directories >
+				 long nr_sub
+				 < number of sub directories of each top directory >
+	Output		:void
+	Return		:int
+				 < 0 : success, -1 : error >
+
+	Description	:create directories like a mkdir -p storm of an unpack job
+==================================================================================
+*/
+static int makeTree( const char *dir, long nr_top, long nr_sub )
+{
+	char	path[ 4096 ];
+	long	top;
+	long	sub;
+
+	for( top = 0 ; top < nr_top ; top++ )
+	{
+		snprintf( path, sizeof( path ), "%s/d%ld", dir, top );
+
+		if( mkdir( path, 0755 ) )
+		{
+			return( -1 );
+		}
+
+		for( sub = 0 ; sub < nr_sub ; sub++ )
+		{
+			snprintf( path, sizeof( path ), "%s/d%ld/s%ld", dir, top, sub );
+
+			if( mkdir( path, 0755 ) )
+			{
+				return( -1 );
+			}
+		}
+	}
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:removeTree
+	Input		:const char *dir
+				 < root of the tree >
+				 long nr_top
+				 < number of top directories >
+				 long nr_sub
+				 < number of sub directories of each top directory >
+	Output		:void
+	Return		:void
+
+	Description	:remove what makeTree created, not timed
+==================================================================================
+*/
+static void removeTree( const char *dir, long nr_top, long nr_sub )
+{
+	char	path[ 4096 ];
+	long	top;
+	long	sub;
+
+	for( top = 0 ; top < nr_top ; top++ )
+	{
+		for( sub = 0 ; sub < nr_sub ; sub++ )
+		{
+			snprintf( path, sizeof( path ), "%s/d%ld/s%ld", dir, top, sub );
+			rmdir( path );
+		}
+
+		snprintf( path, sizeof( path ), "%s/d%ld", dir, top );
+		rmdir( path );
+	}
+}
+
+/*
+==================================================================================
+	Function	:now
+	Input		:void
+	Output		:void
+	Return		:double
+				 < monotonic time in seconds >
+
+	Description	:read the monotonic clock
+==================================================================================
+*/
+static double now( void )
+{
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return( ts.tv_sec + ts.tv_nsec / 1e9 );
+}
@@ -0,0 +1,40 @@
+#!/bin/sh
+#
+# readdir_bench.sh : time a cold readdir of a large directory on a loop device
+#                    for several dir_ra_pages windows
+#
+# usage : readdir_bench.sh <image file> [entries]
+#         run as root, the image is created and removed by the script
+#
+
+IMG=${1:?usage: $0 <image file> [entries]}
+ENTRIES=${2:-200000}
+MNT=$(mktemp -d)
+
+coldCache()
+{
+	sync
+	echo 3 > /proc/sys/vm/drop_caches
+}
+
+truncate -s 2G "$IMG"
+mke2fs -q -F -t ext2 -O ^dir_index "$IMG"
+mount -t me2fs -o loop "$IMG" "$MNT" || exit 1
+
+DEV=$(basename "$(findmnt -n -o SOURCE "$MNT")")
+RA=/sys/fs/me2fs/$DEV/dir_ra_pages
+
+mkdir "$MNT/dir"
+( cd "$MNT/dir" && seq -f "entry.%.0f" 1 "$ENTRIES" | xargs touch )
+
+for pages in 0 8 32 128
+do
+	echo "$pages" > "$RA"
+	coldCache
+	echo "dir_ra_pages=$pages:"
+	time ls -f "$MNT/dir" > /dev/null
+done
+
+umount "$MNT"
+rmdir "$MNT"
+rm -f "$IMG"
@@ -0,0 +1,191 @@
+/********************************************************************************
+	File			: scan_bench.c
+	Description		: Directory entry scan rate of linear lookups
+
+	build			: gcc -O2 -Wall -o scan_bench scan_bench.c
+	usage			: scan_bench <dir> [entries] [lookups]
+					  run as root on a file system without dir_index:
+					  mke2fs -t ext2 -O ^dir_index img
+					  mount -t me2fs -o loop img /mnt/me2fs
+
+*********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static void dropDentries( void );
+static double now( void );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+/* ---------------------------------------------------------------------------- */
+/* entries are even numbers and misses odd ones of the same width, so every		*/
+/* record passes the name_len check and is compared up to the last byte			*/
+/* ---------------------------------------------------------------------------- */
+#define	ENTRY_NAME( buf, n )													\
+	snprintf( ( buf ), sizeof( buf ), "%016ld", 2 * ( n ) )
+#define	MISS_NAME( buf, n )														\
+	snprintf( ( buf ), sizeof( buf ), "%016ld", 2 * ( n ) + 1 )
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+int main( int argc, char *argv[ ] )
+{
+	struct stat	st;
+	char		name[ 64 ];
+	long		nr_entries;
+	long		lookups;
+	long		i;
+	double		start;
+	double		elapsed;
+	int			dir_fd;
+	int			fd;
+
+	if( argc < 2 )
+	{
+		fprintf( stderr, "usage: %s <dir> [entries] [lookups]\n", argv[ 0 ] );
+		return( 1 );
+	}
+
+	nr_entries	= ( 2 < argc ) ? atol( argv[ 2 ] ) : 10000;
+	lookups		= ( 3 < argc ) ? atol( argv[ 3 ] ) : 1000;
+
+	if( ( dir_fd = open( argv[ 1 ], O_RDONLY | O_DIRECTORY ) ) < 0 )
+	{
+		perror( argv[ 1 ] );
+		return( 1 );
+	}
+
+	for( i = 0 ; i < nr_entries ; i++ )
+	{
+		ENTRY_NAME( name, i );
+
+		if( ( fd = openat( dir_fd, name, O_CREAT | O_EXCL | O_WRONLY,
+						   0644 ) ) < 0 )
+		{
+			perror( name );
+			return( 1 );
+		}
+
+		close( fd );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* warm the directory pages once, then time misses which scan all records	*/
+	/* ------------------------------------------------------------------------ */
+	dropDentries( );
+	MISS_NAME( name, nr_entries );
+	fstatat( dir_fd, name, &st, 0 );
+
+	start = now( );
+
+	for( i = 0 ; i < lookups ; i++ )
+	{
+		MISS_NAME( name, i % nr_entries );
+
+		if( fstatat( dir_fd, name, &st, 0 ) == 0 )
+		{
+			fprintf( stderr, "%s should not exist\n", name );
+			return( 1 );
+		}
+
+		/* -------------------------------------------------------------------- */
+		/* a negative dentry would answer the next lookup of the same name		*/
+		/* -------------------------------------------------------------------- */
+		if( ( i % nr_entries ) == ( nr_entries - 1 ) )
+		{
+			elapsed = now( ) - start;
+			dropDentries( );
+			start = now( ) - elapsed;
+		}
+	}
+
+	elapsed = now( ) - start;
+
+	printf( "%12s %12s %16s\n", "entries", "lookups", "entries/sec" );
+	printf( "%12ld %12ld %16.0f\n",
+			nr_entries, lookups, nr_entries * lookups / elapsed );
+
+	for( i = 0 ; i < nr_entries ; i++ )
+	{
+		ENTRY_NAME( name, i );
+		unlinkat( dir_fd, name, 0 );
+	}
+
+	close( dir_fd );
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:dropDentries
+	Input		:void
+	Output		:void
+	Return		:void
+
+	Description	:drop cached dentries and inodes. the open directory keeps
+				 its pages in the page cache
+==================================================================================
+*/
+static void dropDentries( void )
+{
+	int		fd;
+
+	sync( );
+
+	if( ( fd = open( "/proc/sys/vm/drop_caches", O_WRONLY ) ) < 0 )
+	{
+		perror( "drop_caches" );
+		exit( 1 );
+	}
+
+	if( write( fd, "2\n", 2 ) != 2 )
+	{
+		perror( "drop_caches" );
+		exit( 1 );
+	}
+
+	close( fd );
+}
+
+/*
+==================================================================================
+	Function	:now
+	Input		:void
+	Output		:void
+	Return		:double
+				 < monotonic time in seconds >
+
+	Description	:read the monotonic clock
+==================================================================================
+*/
+static double now( void )
+{
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return( ts.tv_sec + ts.tv_nsec / 1e9 );
+}
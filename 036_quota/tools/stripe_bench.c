@@ -0,0 +1,297 @@
+/********************************************************************************
+	File			: stripe_bench.c
+	Description		: Count stripe misaligned allocations of my ext2 file system
+
+	build			: gcc -O2 -Wall -o stripe_bench stripe_bench.c
+	usage			: stripe_bench <dir> <sysfs dir> [files] [MiB per file]
+					  e.g. stripe_bench /mnt/me2fs /sys/fs/me2fs/sdb1 16 64
+
+*********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/statvfs.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static long readCounter( const char *sysfs, const char *name );
+static int writeFile( const char *path, char *buf, long mib );
+static int countExtents( const char *path,
+						 unsigned long block_size,
+						 unsigned long stripe,
+						 long *extents,
+						 long *misaligned );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+#define	CHUNK_SIZE		( 1024 * 1024 )
+#define	MAX_EXTENTS		256
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+int main( int argc, char *argv[ ] )
+{
+	struct statvfs	st;
+	char			path[ 4096 ];
+	char			*buf;
+	long			stripe;
+	long			allocs;
+	long			misaligned;
+	long			extents;
+	long			ext_misaligned;
+	long			files;
+	long			mib;
+	long			i;
+
+	if( argc < 3 )
+	{
+		fprintf( stderr,
+				 "usage: %s <dir> <sysfs dir> [files] [MiB per file]\n",
+				 argv[ 0 ] );
+		return( 1 );
+	}
+
+	files	= ( 3 < argc ) ? atol( argv[ 3 ] ) : 16;
+	mib		= ( 4 < argc ) ? atol( argv[ 4 ] ) : 64;
+
+	if( statvfs( argv[ 1 ], &st ) )
+	{
+		perror( argv[ 1 ] );
+		return( 1 );
+	}
+
+	/* ------------------------------------------------------------------------ */
+	/* stripe is in blocks, 0 when neither the options nor the superblock		*/
+	/* give a geometry															*/
+	/* ------------------------------------------------------------------------ */
+	if( ( stripe = readCounter( argv[ 2 ], "stripe" ) ) <= 0 )
+	{
+		fprintf( stderr, "%s: no stripe geometry\n", argv[ 2 ] );
+		return( 1 );
+	}
+
+	if( !( buf = malloc( CHUNK_SIZE ) ) )
+	{
+		return( 1 );
+	}
+
+	memset( buf, 0x5A, CHUNK_SIZE );
+
+	allocs		= readCounter( argv[ 2 ], "stripe_allocs" );
+	misaligned	= readCounter( argv[ 2 ], "stripe_misaligned" );
+
+	extents			= 0;
+	ext_misaligned	= 0;
+
+	for( i = 0 ; i < files ; i++ )
+	{
+		snprintf( path, sizeof( path ), "%s/stripe_bench.%ld", argv[ 1 ], i );
+
+		if( writeFile( path, buf, mib ) ||
+			countExtents( path, st.f_bsize, stripe,
+						  &extents, &ext_misaligned ) )
+		{
+			perror( path );
+			return( 1 );
+		}
+	}
+
+	allocs		= readCounter( argv[ 2 ], "stripe_allocs" ) - allocs;
+	misaligned	= readCounter( argv[ 2 ], "stripe_misaligned" ) - misaligned;
+
+	printf( "stripe            : %ld blocks of %lu bytes\n",
+			stripe, ( unsigned long )st.f_bsize );
+	printf( "files             : %ld x %ld MiB\n", files, mib );
+	printf( "stripe allocations: %ld, misaligned %ld\n", allocs, misaligned );
+	printf( "extents           : %ld, misaligned %ld\n",
+			extents, ext_misaligned );
+
+	for( i = 0 ; i < files ; i++ )
+	{
+		snprintf( path, sizeof( path ), "%s/stripe_bench.%ld", argv[ 1 ], i );
+		unlink( path );
+	}
+
+	free( buf );
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:readCounter
+	Input		:const char *sysfs
+				 < sysfs directory of a file system >
+				 const char *name
+				 < attribute name >
+	Output		:void
+	Return		:long
+				 < value of the attribute, -1 on error >
+
+	Description	:read a number from a sysfs attribute
+==================================================================================
+*/
+static long readCounter( const char *sysfs, const char *name )
+{
+	char	path[ 4096 ];
+	FILE	*fp;
+	long	val;
+
+	snprintf( path, sizeof( path ), "%s/%s", sysfs, name );
+
+	if( !( fp = fopen( path, "r" ) ) )
+	{
+		return( -1 );
+	}
+
+	if( fscanf( fp, "%ld", &val ) != 1 )
+	{
+		val = -1;
+	}
+
+	fclose( fp );
+
+	return( val );
+}
+
+/*
+==================================================================================
+	Function	:writeFile
+	Input		:const char *path
+				 < file to create >
+				 char *buf
+				 < a chunk of data >
+				 long mib
+				 < size of the file in MiB >
+	Output		:void
+	Return		:int
+				 < 0 : success, -1 : error >
+
+	Description	:write a file sequentially and sync it
+==================================================================================
+*/
+static int writeFile( const char *path, char *buf, long mib )
+{
+	int		fd;
+	long	i;
+
+	if( ( fd = open( path, O_CREAT | O_TRUNC | O_WRONLY, 0644 ) ) < 0 )
+	{
+		return( -1 );
+	}
+
+	for( i = 0 ; i < mib ; i++ )
+	{
+		if( write( fd, buf, CHUNK_SIZE ) != CHUNK_SIZE )
+		{
+			close( fd );
+			return( -1 );
+		}
+	}
+
+	if( fsync( fd ) )
+	{
+		close( fd );
+		return( -1 );
+	}
+
+	return( close( fd ) );
+}
+
+/*
+==================================================================================
+	Function	:countExtents
+	Input		:const char *path
+				 < file to look at >
+				 unsigned long block_size
+				 < block size of the file system >
+				 unsigned long stripe
+				 < stripe width in blocks >
+				 long *extents
+				 < extents counted so far >
+				 long *misaligned
+				 < misaligned extents counted so far >
+	Output		:long *extents
+				 long *misaligned
+	Return		:int
+				 < 0 : success, -1 : error >
+
+	Description	:count extents of a file at least a stripe long, and the
+				 ones of them which do not start on a stripe boundary
+==================================================================================
+*/
+static int countExtents( const char *path,
+						 unsigned long block_size,
+						 unsigned long stripe,
+						 long *extents,
+						 long *misaligned )
+{
+	struct fiemap	*fm;
+	unsigned long	stripe_bytes;
+	unsigned int	i;
+	int				fd;
+	int				ret;
+
+	if( ( fd = open( path, O_RDONLY ) ) < 0 )
+	{
+		return( -1 );
+	}
+
+	fm = calloc( 1, sizeof( *fm )
+					+ MAX_EXTENTS * sizeof( struct fiemap_extent ) );
+
+	if( !fm )
+	{
+		close( fd );
+		return( -1 );
+	}
+
+	stripe_bytes		= stripe * block_size;
+	fm->fm_start		= 0;
+	fm->fm_length		= FIEMAP_MAX_OFFSET;
+	fm->fm_flags		= FIEMAP_FLAG_SYNC;
+	fm->fm_extent_count	= MAX_EXTENTS;
+
+	ret = ioctl( fd, FS_IOC_FIEMAP, fm );
+
+	for( i = 0 ; !ret && ( i < fm->fm_mapped_extents ) ; i++ )
+	{
+		if( fm->fm_extents[ i ].fe_length < stripe_bytes )
+		{
+			continue;
+		}
+
+		( *extents )++;
+
+		if( fm->fm_extents[ i ].fe_physical % stripe_bytes )
+		{
+			( *misaligned )++;
+		}
+	}
+
+	free( fm );
+	close( fd );
+
+	return( ret ? -1 : 0 );
+}
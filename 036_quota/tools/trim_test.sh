@@ -0,0 +1,91 @@
+#!/bin/sh
+#
+# trim_test.sh : check FITRIM and -o discard on a loop device
+#
+# usage : trim_test.sh <image file> [MiB to write]
+#         run as root, the image is created and removed by the script.
+#         the loop driver punches discarded ranges out of the image, so
+#         the blocks the image takes on the host show what was trimmed
+#
+
+IMG=${1:?usage: $0 <image file> [MiB to write]}
+MIB=${2:-256}
+MNT=$(mktemp -d)
+FAILED=0
+
+imageKiB()
+{
+	du -k "$IMG" | cut -f1
+}
+
+freeKiB()
+{
+	df -k --output=avail "$MNT" | tail -1
+}
+
+fail()
+{
+	echo "FAIL: $*"
+	FAILED=1
+}
+
+checkFs()
+{
+	if ! e2fsck -fn "$IMG" > /dev/null 2>&1
+	then
+		fail "e2fsck found errors after $1"
+	fi
+}
+
+truncate -s 1G "$IMG"
+mke2fs -q -F -t ext2 "$IMG"
+
+#
+# FITRIM : free space of the file system must not change, the image must
+# shrink by about what was deleted
+#
+mount -t me2fs -o loop "$IMG" "$MNT" || exit 1
+
+dd if=/dev/urandom of="$MNT/data" bs=1M count="$MIB" conv=fsync 2> /dev/null
+rm "$MNT/data"
+sync
+
+before=$(imageKiB)
+free_before=$(freeKiB)
+fstrim -v "$MNT"
+after=$(imageKiB)
+free_after=$(freeKiB)
+
+echo "fstrim  : image ${before}KiB -> ${after}KiB, free ${free_before}KiB -> ${free_after}KiB"
+
+[ "$free_before" -eq "$free_after" ] || fail "fstrim changed free space"
+[ $(( before - after )) -ge $(( MIB * 1024 * 9 / 10 )) ] ||
+	fail "fstrim released less than the deleted data"
+
+umount "$MNT"
+checkFs fstrim
+
+#
+# -o discard : deleting the file alone must shrink the image
+#
+mount -t me2fs -o loop,discard "$IMG" "$MNT" || exit 1
+
+dd if=/dev/urandom of="$MNT/data" bs=1M count="$MIB" conv=fsync 2> /dev/null
+before=$(imageKiB)
+rm "$MNT/data"
+sync
+after=$(imageKiB)
+
+echo "discard : image ${before}KiB -> ${after}KiB"
+
+[ $(( before - after )) -ge $(( MIB * 1024 * 9 / 10 )) ] ||
+	fail "unlink with -o discard released less than the deleted data"
+
+umount "$MNT"
+checkFs "-o discard"
+
+rmdir "$MNT"
+rm -f "$IMG"
+
+[ "$FAILED" -eq 0 ] && echo "PASS"
+exit "$FAILED"
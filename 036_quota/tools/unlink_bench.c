@@ -0,0 +1,143 @@
+/********************************************************************************
+	File			: unlink_bench.c
+	Description		: Unlink latency of a large fragmented file
+
+	build			: gcc -O2 -Wall -o unlink_bench unlink_bench.c
+	usage			: unlink_bench <dir> [GiB] [KiB per fragment]
+					  the file system needs twice the size free. mount it
+					  with noreservation and without delalloc, so blocks
+					  are allocated by write in the order of the writes
+
+*********************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+
+/*
+==================================================================================
+
+	Prototype Statement
+
+==================================================================================
+*/
+static double now( void );
+
+/*
+==================================================================================
+
+	DEFINES
+
+==================================================================================
+*/
+
+/*
+==================================================================================
+
+	Management
+
+==================================================================================
+*/
+int main( int argc, char *argv[ ] )
+{
+	char	target[ 4096 ];
+	char	filler[ 4096 ];
+	char	*buf;
+	long	gib;
+	long	chunk;
+	long	rounds;
+	long	r;
+	int		fd_target;
+	int		fd_filler;
+	double	start;
+	double	unlink_time;
+	double	sync_time;
+
+	if( argc < 2 )
+	{
+		fprintf( stderr, "usage: %s <dir> [GiB] [KiB per fragment]\n",
+				 argv[ 0 ] );
+		return( 1 );
+	}
+
+	gib		= ( 2 < argc ) ? atol( argv[ 2 ] ) : 4;
+	chunk	= ( ( 3 < argc ) ? atol( argv[ 3 ] ) : 16 ) * 1024;
+	rounds	= gib * 1024 * 1024 * 1024 / chunk;
+
+	snprintf( target, sizeof( target ), "%s/unlink_bench.target", argv[ 1 ] );
+	snprintf( filler, sizeof( filler ), "%s/unlink_bench.filler", argv[ 1 ] );
+
+	fd_target = open( target, O_CREAT | O_TRUNC | O_WRONLY, 0644 );
+	fd_filler = open( filler, O_CREAT | O_TRUNC | O_WRONLY, 0644 );
+
+	if( ( fd_target < 0 ) || ( fd_filler < 0 ) || !( buf = malloc( chunk ) ) )
+	{
+		perror( argv[ 1 ] );
+		return( 1 );
+	}
+
+	memset( buf, 0x5A, chunk );
+
+	/* ------------------------------------------------------------------------ */
+	/* two files written in turn get their chunks interleaved on disk. the		*/
+	/* filler is removed, so the target keeps one extent per chunk				*/
+	/* ------------------------------------------------------------------------ */
+	for( r = 0 ; r < rounds ; r++ )
+	{
+		if( ( write( fd_target, buf, chunk ) != chunk ) ||
+			( write( fd_filler, buf, chunk ) != chunk ) )
+		{
+			perror( "write" );
+			return( 1 );
+		}
+	}
+
+	fsync( fd_target );
+	close( fd_target );
+	close( fd_filler );
+	unlink( filler );
+	sync( );
+
+	/* ------------------------------------------------------------------------ */
+	/* the last reference goes away in unlink, which truncates the file			*/
+	/* ------------------------------------------------------------------------ */
+	start		= now( );
+	unlink( target );
+	unlink_time	= now( ) - start;
+
+	start		= now( );
+	sync( );
+	sync_time	= now( ) - start;
+
+	printf( "file              : %ld GiB in %ld KiB fragments\n",
+			gib, chunk / 1024 );
+	printf( "unlink            : %.3f sec\n", unlink_time );
+	printf( "sync after unlink : %.3f sec\n", sync_time );
+
+	free( buf );
+
+	return( 0 );
+}
+
+/*
+==================================================================================
+	Function	:now
+	Input		:void
+	Output		:void
+	Return		:double
+				 < monotonic time in seconds >
+
+	Description	:read the monotonic clock
+==================================================================================
+*/
+static double now( void )
+{
+	struct timespec	ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return( ts.tv_sec + ts.tv_nsec / 1e9 );
+}